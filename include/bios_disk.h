@@ -27,6 +27,7 @@
 
 #include "bios.h"
 #include "dos_inc.h"
+#include "host_file_cache.h"
 #include "mem.h"
 
 /* The Section handling Bios Disk Access */
@@ -42,12 +43,20 @@ struct diskGeo {
 };
 extern diskGeo DiskGeometryList[];
 
+/* Sectors are read and written through a cache of the image file's pages,
+   so the changes reach the file when they have to make room, on Flush(),
+   or when the disk goes away. */
 class imageDisk  {
 public:
 	Bit8u Read_Sector(Bit32u head,Bit32u cylinder,Bit32u sector,void * data);
+	Bit8u Read_Sectors(Bit32u head,Bit32u cylinder,Bit32u sector,Bit32u count,void * data);
 	Bit8u Write_Sector(Bit32u head,Bit32u cylinder,Bit32u sector,void * data);
+	Bit8u Write_Sectors(Bit32u head,Bit32u cylinder,Bit32u sector,Bit32u count,void * data);
 	Bit8u Read_AbsoluteSector(Bit32u sectnum, void * data);
+	Bit8u Read_AbsoluteSectors(Bit32u sectnum, Bit32u count, void * data);
 	Bit8u Write_AbsoluteSector(Bit32u sectnum, void * data);
+	Bit8u Write_AbsoluteSectors(Bit32u sectnum, Bit32u count, void * data);
+	bool Flush(void);
 
 	void Set_Geometry(Bit32u setHeads, Bit32u setCyl, Bit32u setSect, Bit32u setSectSize);
 	void Get_Geometry(Bit32u * getHeads, Bit32u *getCyl, Bit32u *getSect, Bit32u *getSectSize);
@@ -58,11 +67,7 @@ public:
 	imageDisk(const imageDisk&) = delete; // prevent copy
 	imageDisk& operator=(const imageDisk&) = delete; // prevent assignment
 
-	virtual ~imageDisk()
-	{
-		if (diskimg != nullptr)
-			fclose(diskimg);
-	}
+	virtual ~imageDisk();
 
 	bool hardDrive;
 	bool active;
@@ -72,9 +77,14 @@ public:
 
 	Bit32u sector_size;
 	Bit32u heads,cylinders,sectors;
+
+	// Counts the sectors written through any path, so the users keeping a
+	// copy of some sectors can tell when it may be stale
+	uint32_t write_count = 0;
 private:
-	Bit32u current_fpos;
-	enum { NONE,READ,WRITE } last_action;
+	std::unique_ptr<HostFileCache> cache = {};
+	bool write_checked = false; // the first write goes straight to the file,
+	bool read_only = false;     // to tell if the others can wait
 };
 
 void updateDPT(void);
@@ -26,6 +26,7 @@
 #include <vector>
 
 #include "cross.h"
+#include "host_file_cache.h"
 #include "mem.h"
 #include "support.h"
 
@@ -93,6 +94,8 @@ public:
 	virtual void AddRef() { refCtr++; }
 	virtual Bits RemoveRef() { return --refCtr; }
 	virtual bool UpdateDateTimeFromHost() { return true; }
+	// Writes anything held back to the host or disk image
+	virtual void Flush() {}
 	virtual void SetFlagReadOnlyMedium() {}
 
 	void SetDrive(Bit8u drv) { hdrive=drv;}
@@ -146,6 +149,7 @@ public:
 	localFile(const char *name, FILE *handle, const char *basedir);
 	localFile(const localFile &) = delete;            // prevent copying
 	localFile &operator=(const localFile &) = delete; // prevent assignment
+	~localFile();
 	bool Read(uint8_t *data, uint16_t *size);
 	bool Write(uint8_t *data, uint16_t *size);
 	bool Seek(uint32_t *pos, uint32_t type);
@@ -153,17 +157,20 @@ public:
 	uint16_t GetInformation();
 	bool UpdateDateTimeFromHost();
 	void Flush();
+	// For files open more than once, so the handles see each other's writes
+	void DisableCache()
+	{
+		Flush();
+		cache.Disable(fhandle);
+	}
 	void SetFlagReadOnlyMedium() { read_only_medium = true; }
 	const char *GetBaseDir() const { return basedir; }
 	FILE *fhandle = nullptr; // todo handle this properly
 private:
 	const char *basedir;
-	long stream_pos = 0;
-	bool ftell_and_check();
-	void fseek_and_check(int whence);
-	bool fseek_to_and_check(long pos, int whence);
+	uint32_t stream_pos = 0;
 	bool read_only_medium;
-	enum { NONE,READ,WRITE } last_action;
+	HostFileCache cache;
 };
 
 /* The following variable can be lowered to free up some memory.
@@ -201,6 +208,11 @@ public:
 	void  DeleteEntry          (const char* path, bool ignoreLastDir = false);
 	void  EmptyCache           (void);
 
+	// Follow names the host added to or removed from one of its
+	// directories (without a trailing separator), if that is cached in
+	void  AddHostEntry         (const char* host_dir, const char* name, bool is_directory);
+	void  RemoveHostEntry      (const char* host_dir, const char* name);
+
 	void SetLabel(const char *name, bool cdrom, bool allowupdate);
 	const char *GetLabel() const { return label; }
 
@@ -251,6 +263,9 @@ private:
 	bool		SetResult		(CFileInfo* dir, char * &result, Bitu entryNr);
 	bool		IsCachedIn		(CFileInfo* dir);
 	CFileInfo*	FindDirInfo		(const char* path, char* expandedPath);
+	CFileInfo*	FindCachedDir		(const char* host_dir);
+	Bits		FindHostName		(CFileInfo* dir, const char* name);
+	void		CacheOutDir		(CFileInfo* dir);
 	bool		RemoveSpaces		(char* str);
 	bool		OpenDir			(CFileInfo* dir, const char* path, Bit16u& id);
 	void		CreateEntry		(CFileInfo* dir, const char* name, bool is_directory);
@@ -46,6 +46,8 @@ const char *DOSBOX_GetDetailedVersion() noexcept;
 void DOSBOX_RunMachine();
 void DOSBOX_SetLoop(LoopHandler * handler);
 void DOSBOX_SetNormalLoop();
+// Restarts measuring the host speed for auto and max cycles
+void DOSBOX_ResetAutoCycles();
 
 void DOSBOX_Init(void);
 
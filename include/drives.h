@@ -28,6 +28,7 @@
 
 #include "dos_inc.h"
 #include "dos_system.h"
+#include "host_stat_cache.h"
 
 bool WildFileCmp(const char * file, const char * wild);
 void Set_Label(char const * const input, char * const output, bool cdrom);
@@ -78,10 +79,14 @@ public:
 	const char *GetBasedir() const { return basedir; }
 
 protected:
+	// Brings the directory listings up to date with the host
+	virtual void SyncHostChanges();
+
 	char basedir[CROSS_LEN] = "";
 	struct {
 		char srch_dir[CROSS_LEN] = "";
 	} srchInfo[MAX_OPENDIRS];
+	HostStatCache host_cache;
 
 private:
 	bool IsFirstEncounter(const std::string& filename);
@@ -158,6 +163,7 @@ public:
 	fatDrive(const char * sysFilename, Bit32u bytesector, Bit32u cylsector, Bit32u headscyl, Bit32u cylinders, Bit32u startSector);
 	fatDrive(const fatDrive&) = delete; // prevent copying
 	fatDrive& operator= (const fatDrive&) = delete; // prevent assignment
+	~fatDrive();
 	bool FileOpen(std::unique_ptr<DOS_File> &file, const char * name, Bit32u flags) override;
 	bool FileCreate(std::unique_ptr<DOS_File> &file, const char * name, Bit16u attributes) override;
 	virtual bool FileUnlink(char * name);
@@ -178,15 +184,21 @@ public:
 	virtual void EmptyCache(void){}
 public:
 	Bit8u readSector(Bit32u sectnum, void * data);
+	Bit8u readSectors(Bit32u sectnum, Bit32u count, void * data);
 	Bit8u writeSector(Bit32u sectnum, void * data);
 	Bit32u getAbsoluteSectFromBytePos(Bit32u startClustNum, Bit32u bytePos);
 	Bit32u getSectorSize(void);
 	Bit32u getClusterSize(void);
 	Bit32u getAbsoluteSectFromChain(Bit32u startClustNum, Bit32u logicalSector);
 	bool allocateCluster(Bit32u useCluster, Bit32u prevCluster);
-	Bit32u appendCluster(Bit32u startCluster);
+	Bit32u appendCluster(Bit32u startCluster, Bit32u lastCluster = 0);
 	void deleteClustChain(Bit32u startCluster, Bit32u bytePos);
 	Bit32u getFirstFreeClust(void);
+	Bit32u getNextCluster(Bit32u clustNum);
+	Bit32u getClustFirstSect(Bit32u clustNum);
+	Bit32u getFatGeneration(void);
+	void flushFat(void);
+	void commitChanges(void);
 	bool directoryBrowse(Bit32u dirClustNumber, direntry *useEntry, Bit32s entNum, Bit32s start=0);
 	bool directoryChange(Bit32u dirClustNumber, direntry *useEntry, Bit32s entNum);
 	std::shared_ptr<imageDisk> loadedDisk;
@@ -194,7 +206,9 @@ public:
 private:
 	Bit32u getClusterValue(Bit32u clustNum);
 	void setClusterValue(Bit32u clustNum, Bit32u clustValue);
-	Bit32u getClustFirstSect(Bit32u clustNum);
+	Bit32u getFatEntryOffset(Bit32u clustNum) const;
+	bool loadFat(void);
+	void setClusterFree(Bit32u clustNum, bool isFree);
 	bool FindNextInternal(Bit32u dirClustNumber, DOS_DTA & dta, direntry *foundEntry);
 	bool getDirClustNum(const char * dir, Bit32u * clustNum, bool parDir);
 	bool getFileDirEntry(char const * const filename, direntry * useEntry, Bit32u * dirClust, Bit32u * subEntry);
@@ -212,8 +226,18 @@ private:
 
 	Bit32u cwdDirCluster;
 
-	Bit8u fatSectBuffer[1024];
-	Bit32u curFatSect;
+	/* The first FAT is kept in memory, both as it is on disk and decoded.
+	   Changed sectors are written back to all copies by flushFat(), which
+	   runs when a file or directory operation is done with the FAT. */
+	std::vector<Bit8u> fatSects = {};
+	std::vector<Bit32u> fatEntries = {};
+	std::vector<bool> dirtyFatSects = {};
+	std::vector<uint64_t> freeClusters = {}; // a set bit for each free one
+	Bit32u freeClusterCount = 0;
+	Bit32u firstFreeHint = 0; // no free clusters below this index
+	uint32_t seenWriteCount = 0; // of the disk, to notice others' writes
+	Bit32u fatGeneration = 0; // changes when chains may have been cut
+	bool fatLoaded = false;
 };
 
 class cdromDrive final : public localDrive
@@ -337,6 +361,7 @@ public:
 	virtual bool isRemovable(void);
 	virtual Bits UnMount(void);
 	bool readSector(Bit8u *buffer, Bit32u sector);
+	bool readSectors(uint8_t *buffer, uint32_t sector, uint16_t num);
 	virtual const char *GetLabel() { return discLabel; }
 	virtual void Activate(void);
 private:
@@ -434,6 +459,8 @@ public:
 	virtual bool TestDir(char * dir);
 	virtual bool RemoveDir(char * dir);
 	virtual bool MakeDir(char * dir);
+protected:
+	void SyncHostChanges() override;
 private:
 	char overlaydir[CROSS_LEN];
 	bool Sync_leading_dirs(const char* dos_filename);
@@ -75,6 +75,10 @@ public:
 
 	void Reactivate();
 
+	// True until the envelope goes dormant; callers may bypass Process()
+	// for whole blocks of samples once this is false.
+	bool IsActive() const { return is_active; }
+
 private:
 	Envelope(const Envelope &) = delete;            // prevent copying
 	Envelope &operator=(const Envelope &) = delete; // prevent assignment
@@ -94,6 +98,7 @@ private:
 
 	using process_f = std::function<void(Envelope &, bool, bool, intptr_t[], intptr_t[])>;
 	process_f process = &Envelope::Apply;
+	bool is_active = true;
 
 	const char *channel_name = nullptr;
 	uint32_t expire_after_frames = 0u; // Stop enveloping when this many
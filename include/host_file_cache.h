@@ -0,0 +1,138 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_HOST_FILE_CACHE_H
+#define DOSBOX_HOST_FILE_CACHE_H
+
+#include "config.h"
+
+#include <array>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/*
+Host File Cache
+~~~~~~~~~~~~~~~
+Keeps the recently used pages of one open host file, so the small reads and
+writes DOS programs make are served from memory rather than turned into
+seeks, reads and writes on the host.
+
+Reads that miss the cache fetch the page with a single host read. When the
+misses follow each other through the file, the pages after them are read in
+the same go, twice as many each time up to max_read_ahead.
+
+Writes only change the cached pages. The changed bytes go back to the host
+on Flush(), or when a changed page has to make room for another; in either
+case neighbouring changes are joined into one host write. A cache destroyed
+with changes left writes them to the file it was last given for writing.
+
+The cache keeps up to max_pages pages unless told otherwise; disk images,
+which are read all over and for the whole session, get a larger one.
+
+A disabled cache passes every request straight to the host. That's what a
+file opened more than once for writing needs, as each handle has a cache of
+its own.
+
+The FILE is passed to every call, as its owner may swap it for another
+handle to the same contents.
+*/
+
+class HostFileCache {
+public:
+	static constexpr uint32_t page_size = 4096;
+	static constexpr size_t max_pages = 32;
+	static constexpr uint32_t max_read_ahead = 16; // pages
+
+	struct Stats {
+		uint32_t reads = 0;      // requests
+		uint32_t read_hits = 0;  // requests served without the host
+		uint32_t writes = 0;     // requests
+		uint32_t host_reads = 0; // calls to the host
+		uint32_t host_writes = 0;
+	};
+
+	HostFileCache(FILE *file, bool enabled = true, size_t max_cached = max_pages);
+	HostFileCache(const HostFileCache &) = delete;
+	HostFileCache &operator=(const HostFileCache &) = delete;
+	~HostFileCache();
+
+	bool IsEnabled() const { return enabled; }
+
+	// Writes back the changes and sends everything to the host from now on
+	void Disable(FILE *file);
+
+	uint32_t Size() const { return file_size; }
+	const Stats &GetStats() const { return stats; }
+
+	// Asks the host for the size, as another handle or the host itself may
+	// have grown or cut the file since
+	uint32_t RefreshSize(FILE *file);
+
+	// Both return the bytes read or written, which only fall short of the
+	// size at the end of the file, or when the host fails
+	uint32_t Read(FILE *file, uint32_t pos, uint8_t *data, uint32_t size);
+	uint32_t Write(FILE *file, uint32_t pos, const uint8_t *data, uint32_t size);
+
+	bool Truncate(FILE *file, uint32_t pos);
+
+	// Writes the changed bytes back to the host, returning false if any
+	// couldn't be written
+	bool Flush(FILE *file);
+
+	// Tells if there are changes that haven't been written back
+	bool IsDirty() const;
+
+private:
+	struct Page {
+		uint32_t number = 0;
+		uint32_t dirty_begin = 0; // changed bytes, none when equal
+		uint32_t dirty_end = 0;
+		uint64_t last_use = 0;
+		std::array<uint8_t, page_size> data = {};
+	};
+
+	enum { NONE, READ, WRITE } last_action = NONE;
+
+	Page *FindPage(uint32_t number);
+	Page *GetPage(FILE *file, uint32_t number, bool overwrite);
+	Page *AddPage(FILE *file, uint32_t number);
+	size_t HostRead(FILE *file, uint32_t pos, uint8_t *data, size_t size);
+	size_t HostWrite(FILE *file, uint32_t pos, const uint8_t *data, size_t size);
+
+	std::vector<std::unique_ptr<Page>> pages = {};
+	std::unordered_map<uint32_t, Page *> page_index = {}; // by number
+	std::vector<uint8_t> read_buffer = {};
+	std::vector<uint8_t> write_buffer = {};
+	Stats stats = {};
+	uint64_t use_counter = 0;
+	FILE *host_file = nullptr; // the file the host position is for
+	FILE *last_file = nullptr; // the file given last to write or flush
+	int64_t host_pos = -1;     // -1 when unknown
+	uint32_t file_size = 0;
+	size_t page_limit = max_pages;
+	uint32_t next_miss = UINT32_MAX; // page that would continue the run
+	uint32_t read_ahead = 1;
+	bool enabled = true;
+};
+
+#endif
@@ -0,0 +1,123 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_HOST_STAT_CACHE_H
+#define DOSBOX_HOST_STAT_CACHE_H
+
+#include "config.h"
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+/*
+Host Stat Cache
+~~~~~~~~~~~~~~~
+Remembers the stat() results of host paths, including the paths that don't
+exist, for as long as the host doesn't change them. On Linux, the directory
+holding each remembered path is watched with inotify, and an event for a
+name drops what was remembered about it. The directories above it, up to
+the root the caller sets, are watched for moves and removals only, so a
+renamed ancestor drops the whole tree below it. Elsewhere, or when the
+watches can't be added, every lookup goes to the host as before.
+
+The events are read at most once per poll interval, so a lookup can miss a
+change the host made less than that long ago. Changes DOSBox makes itself
+are never missed: call MarkStale() after writing to the host, and the next
+lookup reads the events first.
+
+Names created and removed in watched directories are also handed back by
+TakeChanges(), so the caller can update its directory listings rather than
+read them again.
+*/
+
+struct HostChange {
+	enum class Type { Added, Removed, Lost };
+	Type type = Type::Lost; // Lost: changes were missed, forget everything
+	std::string dir = {};   // without a trailing separator
+	std::string name = {};
+	bool is_dir = false;
+};
+
+class HostStatCache {
+public:
+	// Without watches, every lookup goes to the host
+	HostStatCache(bool use_watches = true, int poll_interval_us = 1000);
+	HostStatCache(const HostStatCache &) = delete;
+	HostStatCache &operator=(const HostStatCache &) = delete;
+	~HostStatCache();
+
+	bool IsWatching() const { return watch_fd >= 0; }
+
+	// Works like stat(), returning true when the path exists
+	bool Stat(const char *path, struct stat &result);
+
+	// Sets the directory above which nothing is watched, such as the base
+	// directory of a mount; without one, the watches go up to /
+	void SetRoot(const std::string &dir);
+
+	// Watches a directory whose listing the caller keeps
+	void Watch(const std::string &dir);
+
+	// Returns the names added to and removed from watched directories
+	// since the last call
+	std::vector<HostChange> TakeChanges();
+
+	void Clear();
+
+	// Makes every cache read the host's events on its next lookup
+	static void MarkStale() { ++stale_generation; }
+
+	static constexpr size_t max_entries = 65536;
+
+private:
+	void Poll();
+	void ReadEvents();
+	bool WatchParent(const std::string &path);
+	bool WatchWithAncestors(const std::string &dir);
+	bool AddWatch(const std::string &dir, bool is_ancestor);
+	void ForgetDir(const std::string &dir);
+
+	struct Entry {
+		struct stat status;
+		bool exists;
+	};
+
+	std::unordered_map<std::string, Entry> entries = {};
+	std::unordered_map<int, std::string> watched_dirs = {}; // by descriptor
+	std::unordered_map<std::string, int> watches = {};      // by directory
+	std::unordered_set<int> ancestor_watches = {}; // moves and removals only
+	std::string root = {};
+	std::vector<HostChange> changes = {};
+
+	int watch_fd = -1;
+	const int poll_interval_us = 0;
+	int64_t last_poll_us = 0;
+	unsigned seen_generation = 0;
+
+	static unsigned stale_generation;
+};
+
+#endif
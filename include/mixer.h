@@ -24,8 +24,10 @@
 
 #include "dosbox.h"
 
+#include <array>
 #include <atomic>
 #include <functional>
+#include <vector>
 
 #include "envelope.h"
 
@@ -74,6 +76,15 @@ public:
 	void UpdateVolume();
 	void SetFreq(Bitu _freq);
 	void SetPeakAmplitude(uint32_t peak);
+
+	// Lets the mixer run this channel's handler on a worker thread when
+	// parallel mixing is enabled. Only opt in if the handler touches
+	// nothing but its own device's state: no IRQs, DMA, or PIC events. Work
+	// that must happen on the emulation thread can be deferred to the
+	// 'joined' callback, which runs there once the handler has returned.
+	void AllowParallelMix(std::function<void()> joined = nullptr);
+	bool IsParallelMixAllowed() const;
+
 	void Mix(Bitu _needed);
 	void AddSilence(); // Fill up until needed
 
@@ -146,6 +157,20 @@ private:
 	bool interpolate = false;
 	bool last_samples_were_stereo = false;
 	bool last_samples_were_silence = true;
+
+	friend class MixerWorkers;
+
+	// Where AddSamples and friends accumulate the channel's output: the
+	// mixer's work buffer, or our own private one while a worker thread
+	// renders the channel. Both are indexed by the same mixer position.
+	std::array<int32_t, 2> *work = nullptr;
+	std::vector<std::array<int32_t, 2>> private_work = {};
+	std::function<void()> joined = nullptr;
+	bool is_parallel_allowed = false;
+	bool is_mixing_in_parallel = false;
+	// Furthest 'done' reached while mixing in parallel, as disabling the
+	// channel from within its handler resets 'done'.
+	Bitu parallel_done = 0u;
 };
 
 MixerChannel * MIXER_AddChannel(MIXER_Handler handler,Bitu freq,const char * name);
@@ -44,9 +44,6 @@ class PageDirectory;
 
 #define LINK_START	((1024+64)/4)			//Start right after the HMA
 
-//Allow 128 mb of memory to be linked
-#define PAGING_LINKS (128*1024/4)
-
 class PageHandler {
 public:
 	virtual ~PageHandler() = default;
@@ -125,17 +122,22 @@ struct PagingBlock {
 		Bitu page;
 		PhysPt addr;
 	} base;
+	/* Everything a lookup needs for one page sits in a single entry, an
+	 * entry only counts as linked while its generation matches the
+	 * current one, so flushing the whole TLB is a counter increment */
+	struct TLBEntry {
+		HostPt read;
+		HostPt write;
+		PageHandler * readhandler;
+		PageHandler * writehandler;
+		Bit32u phys_page;
+		Bit32u generation;
+	};
 	struct {
-		HostPt read[TLB_SIZE];
-		HostPt write[TLB_SIZE];
-		PageHandler * readhandler[TLB_SIZE];
-		PageHandler * writehandler[TLB_SIZE];
-		Bit32u	phys_page[TLB_SIZE];
+		TLBEntry entries[TLB_SIZE];
+		Bit32u generation;
+		PageHandler * unlinked;
 	} tlb;
-	struct {
-		Bitu used;
-		Bit32u entries[PAGING_LINKS];
-	} links;
 	Bit32u		firstmb[LINK_START];
 	bool		enabled;
 
@@ -159,20 +161,26 @@ public:
 	template <bool read>
 	inline HostPt get_tlb(PhysPt address)
 	{
+		const TLBEntry &entry = tlb.entries[address >> 12];
+		if (entry.generation != tlb.generation)
+			return nullptr;
 		if constexpr (read) {
-			return tlb.read[address >> 12];
+			return entry.read;
 		} else {
-			return tlb.write[address >> 12];
+			return entry.write;
 		}
 	}
 
 	template <bool read>
 	inline PageHandler* get_tlb_handler(PhysPt address)
 	{
+		const TLBEntry &entry = tlb.entries[address >> 12];
+		if (entry.generation != tlb.generation)
+			return tlb.unlinked;
 		if constexpr (read) {
-			return tlb.readhandler[address >> 12];
+			return entry.readhandler;
 		} else {
-			return tlb.writehandler[address >> 12];
+			return entry.writehandler;
 		}
 	}
 
@@ -180,12 +188,12 @@ public:
 	 * functions */
 	inline PhysPt GetPhysicalPage(PhysPt linePage)
 	{
-		return (tlb.phys_page[linePage >> 12] << 12);
+		return (tlb.entries[linePage >> 12].phys_page << 12);
 	}
 
 	inline PhysPt GetPhysicalAddress(PhysPt linAddr)
 	{
-		return (tlb.phys_page[linAddr >> 12] << 12) | (linAddr & 0xfff);
+		return (tlb.entries[linAddr >> 12].phys_page << 12) | (linAddr & 0xfff);
 	}
 };
 
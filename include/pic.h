@@ -31,6 +31,9 @@ extern int32_t CPU_CycleMax;
 typedef void(PIC_EOIHandler)();
 typedef void (*PIC_EventHandler)(uint32_t val);
 
+// Identifies a single queued event; zero is never a valid handle
+typedef uint32_t PIC_EventHandle;
+
 extern uint32_t PIC_IRQCheck;
 
 // Elapsed milliseconds since starting DOSBox
@@ -62,6 +65,40 @@ static inline double PIC_FullIndex()
 	return static_cast<double>(PIC_Ticks) + PIC_TickIndex();
 }
 
+// Emulated time
+// ~~~~~~~~~~~~~
+// A 64-bit count of 1/2^24 milliseconds since the PIC was set up. Each
+// millisecond tick is spread evenly over the CPU cycles run during it, so
+// the clock follows the emulated CPU, and differences between two points in
+// time stay exact however long the session runs.
+typedef int64_t PIC_Time;
+constexpr PIC_Time PIC_TIME_PER_MS = static_cast<PIC_Time>(1) << 24;
+
+// The time at which the current tick started
+extern PIC_Time PIC_TickStart;
+
+static inline PIC_Time PIC_Now()
+{
+	return PIC_TickStart + PIC_TickIndexND() * PIC_TIME_PER_MS / CPU_CycleMax;
+}
+
+static inline PIC_Time PIC_MsToTime(const double ms)
+{
+	return std::llround(ms * static_cast<double>(PIC_TIME_PER_MS));
+}
+
+static inline double PIC_TimeToMs(const PIC_Time time)
+{
+	return static_cast<double>(time) / static_cast<double>(PIC_TIME_PER_MS);
+}
+
+// Scales an amount spanning a whole tick down to the part of the current
+// tick that has run so far
+static inline int64_t PIC_TickPortion(const int64_t amount)
+{
+	return amount * PIC_TickIndexND() / CPU_CycleMax;
+}
+
 void PIC_ActivateIRQ(uint8_t irq);
 void PIC_DeActivateIRQ(uint8_t irq);
 
@@ -69,7 +106,9 @@ void PIC_runIRQs();
 bool PIC_RunQueue();
 
 //Delay in milliseconds
-void PIC_AddEvent(PIC_EventHandler handler, double delay, uint32_t val = 0);
+PIC_EventHandle PIC_AddEvent(PIC_EventHandler handler, double delay, uint32_t val = 0);
+// Cancels the event if it's still pending, stale handles are ignored
+void PIC_RemoveEvent(PIC_EventHandle handle);
 void PIC_RemoveEvents(PIC_EventHandler handler);
 void PIC_RemoveSpecificEvents(PIC_EventHandler handler, uint32_t val);
 
@@ -23,9 +23,11 @@
 
 #include "dosbox.h"
 
+#include <atomic>
 #include <condition_variable>
 #include <deque>
 #include <mutex>
+#include <vector>
 
 template <typename T>
 class RWQueue {
@@ -52,4 +54,45 @@ public:
 	T Dequeue();
 };
 
+// Single-producer, single-consumer variant of RWQueue backed by a ring of
+// preallocated slots. Enqueue and Dequeue are wait-free while the ring has
+// room or items; on a full (or empty) ring the producer (or consumer) blocks,
+// just like with RWQueue.
+template <typename T>
+class SPSCQueue {
+private:
+	std::vector<T> slots{};
+	const size_t capacity = 0;
+
+	// Monotonic counters; the slot index is the counter modulo capacity.
+	alignas(64) std::atomic<size_t> head = {0}; // written by the producer
+	alignas(64) std::atomic<size_t> tail = {0}; // written by the consumer
+
+	// Only touched when one side has to wait for the other
+	alignas(64) std::mutex mutex = {};
+	std::condition_variable has_room = {};
+	std::condition_variable has_items = {};
+	std::atomic_bool producer_waiting = {false};
+	std::atomic_bool consumer_waiting = {false};
+
+	void WaitForRoom();
+	void WaitForItems();
+	void Wake(std::atomic_bool &waiting, std::condition_variable &cv);
+
+public:
+	SPSCQueue() = delete;
+	SPSCQueue(const SPSCQueue<T> &other) = delete;
+	SPSCQueue<T> &operator=(const SPSCQueue<T> &other) = delete;
+
+	SPSCQueue(size_t queue_capacity);
+
+	bool IsEmpty() const;
+	size_t Size() const;
+	size_t MaxCapacity() const;
+
+	void Enqueue(const T &item);
+	void Enqueue(T &&item); // item will be empty (moved-out) after call
+	T Dequeue();
+};
+
 #endif
@@ -0,0 +1,146 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_TICK_PACER_H
+#define DOSBOX_TICK_PACER_H
+
+#include "dosbox.h"
+
+#include <cstdint>
+#include <functional>
+
+#include "timer.h"
+
+/*
+Tick Pacer
+~~~~~~~~~~
+The Tick Pacer keeps the emulated millisecond ticks in step with the host's
+monotonic clock, and tunes the cycles per tick when running with auto or max
+cycles.
+
+Tick k is due k milliseconds after the pacer was reset, so rounding never
+accumulates. When nothing is due, WaitForTick() sleeps and then spins until
+the next tick. The latency target is how late that wake-up may be: the pacer
+learns how far the host oversleeps and hands anything below that target over
+to spinning. A target of 1000 us or more only sleeps, which costs the least
+host CPU; lower targets keep the ticks tighter.
+
+TuneCycles() measures the host time spent emulating, that is everything but
+the pacer's own waits, over windows of about a frame. It scales the cycle
+count so one tick takes the requested share of a millisecond, less the
+headroom kept for rendering, mixing and the host's hiccups. Large errors
+are corrected in steps of at most 2x, and small ones by half the error,
+which settles within a few frames without chasing measurement noise.
+
+Cycles the guest spent halted or in the I/O delay cost the host next to
+nothing, so they're taken out of the measurement; otherwise an idle guest
+would look like a fast host. Windows that suggest cutting the cycles to a
+small fraction are skipped as well, as they come from a passing load on the
+host rather than from the guest.
+
+Usage:
+ 1. Construct it with the latency target in microseconds. Tests can also
+    pass their own clock and sleep functions.
+ 2. Each time the emulated ticks handed out so far are done, call
+    RemoveCycles() with the cycles that did no work, and TuneCycles() if
+    the cycles are automatic, then TicksDue() to get the next batch. If the
+    batch is empty, call WaitForTick().
+ 3. Call TakeStats() now and then to read and restart the metrics.
+*/
+
+struct TickPacerStats {
+	double cycles_per_ms = 0; // emulated cycles run per host millisecond
+	double slack_us = 0;      // mean wake-up time past the tick's deadline
+	double idle_percent = 0;  // share of host time spent waiting for ticks
+	int overruns = 0;         // ticks dropped while running behind
+};
+
+class TickPacer {
+public:
+	using clock_f = std::function<int64_t()>;
+	using sleep_f = std::function<void(int)>;
+
+	TickPacer(const int latency_us,
+	          clock_f clock_fn = GetTicksUs,
+	          sleep_f sleep_fn = DelayUs);
+	TickPacer() = delete;
+
+	// Restarts the tick count from now, e.g. after fast-forwarding
+	void Reset();
+
+	// Hands out the ticks that are due, at most max_backlog at a time; any
+	// beyond that are dropped and counted as overruns
+	int TicksDue(int32_t cycle_max);
+
+	// Waits until the next tick is due
+	void WaitForTick();
+
+	// Leaves cycles that were handed out but did no work, such as those
+	// skipped by HLT or the I/O delay, out of the tuning
+	void RemoveCycles(int64_t cycles);
+
+	// Returns the cycle count to use from now on
+	int32_t TuneCycles(int32_t cycle_max, int percent_used);
+
+	// Restarts the measurement window, e.g. after the cycles were changed
+	void ResetTuning();
+
+	TickPacerStats TakeStats();
+
+	static constexpr int max_backlog = 20;
+	static constexpr int window_ticks = 20;
+	// Windows this long mean the host was busy elsewhere
+	static constexpr int64_t long_window_us = 700 * 1000;
+	// Share of the requested time the emulation aims to fill, leaving the
+	// rest as headroom so a busy tick doesn't make it fall behind
+	static constexpr double target_load = 0.9;
+
+private:
+	clock_f clock;
+	sleep_f sleep;
+	const int latency_us = 0;
+
+	int64_t origin_us = 0; // when tick 0 was due
+	int64_t ticks_done = 0;
+
+	// Running estimate of how much longer than asked the host sleeps
+	double oversleep_us = 0;
+	int64_t slept_us = 0;
+
+	struct {
+		int64_t start_us = 0;
+		int64_t slept_us = 0;
+		int64_t cycles = 0;
+		int64_t removed_cycles = 0;
+		int ticks = 0;
+		int overruns = 0;
+	} window = {};
+
+	struct {
+		int64_t start_us = 0;
+		int64_t slept_us = 0;
+		int64_t cycles = 0;
+		int64_t slack_us = 0;
+		int wakeups = 0;
+		int overruns = 0;
+	} stats = {};
+};
+
+#endif
@@ -23,10 +23,13 @@
 
 #include "inout.h"
 #include "control.h"
+#include "pic.h"
 
-//Don't enable keeping changes and mapping lfb probably...
+// Memory mapped straight to the host (the linear SVGA modes and the LFB)
+// bypasses the page handlers, so writes to it can't be tracked. Those modes
+// are always drawn in full, the others only draw lines that were written to.
 #define VGA_LFB_MAPPED
-//#define VGA_KEEP_CHANGES
+#define VGA_KEEP_CHANGES
 #define VGA_CHANGE_SHIFT	9
 
 class PageHandler;
@@ -157,7 +160,7 @@ struct VGA_Draw {
 	uint32_t parts_left = 0;
 	Bitu byte_panning_shift = 0;
 	struct {
-		double framestart = 0;
+		PIC_Time framestart = 0;
 		double vrstart = 0, vrend = 0;     // V-retrace
 		double hrstart = 0, hrend = 0;     // H-retrace
 		double hblkstart = 0, hblkend = 0; // H-blanking
@@ -391,15 +394,26 @@ struct VGA_Memory {
 };
 
 struct VGA_Changes {
-	//Add a few more just to be safe
-	Bit8u *map = nullptr; /* allocated dynamically: [(VGA_MEMORY >> VGA_CHANGE_SHIFT) + 32] */
+	// One byte per block of drawn memory, each bit marks writes made while
+	// one of the last eight frames was being drawn. Covers the fastmem
+	// pixel buffer, which is twice the size of the video memory.
+	Bit8u *map = nullptr; /* allocated dynamically: [(vmemsize * 2 >> VGA_CHANGE_SHIFT) + 32] */
+	Bitu mapSize = 0;
 	Bit8u checkMask = 0;
 	uint8_t frame = 0;
 	uint8_t writeMask = 0;
-	bool active = 0;
+	bool active = 0;         // unchanged lines are skipped this frame
+	bool tracked = false;    // the installed page handler marks its writes
+	bool fullFrame = true;   // draw every line of the next frame
 	Bit32u clearMask = 0;
-	Bit32u start = 0, last = 0;
-	Bit32u lastAddress = 0;
+	// The layout of the last frame; if any of it moves, lines no longer
+	// show the memory they did before and the frame is drawn in full.
+	Bitu lastAddress = 0;
+	Bitu lastAddressAdd = 0;
+	Bitu lastAddressLine = 0;
+	Bitu lastSplitLine = 0;
+	Bit8u lastModeControl = 0;
+	Bit8u *lastBase = nullptr;
 };
 
 struct VGA_LFB {
@@ -285,7 +285,8 @@ restart_core:
 	CacheBlock * block=chandler->FindCacheBlock(ip_point&4095);
 	if (!block) {
 		if (!chandler->invalidation_map || (chandler->invalidation_map[ip_point&4095]<4)) {
-			block=CreateCacheBlock(chandler,ip_point,32);
+			block=CreateCacheBlock(chandler,ip_point,32,
+				dyn_take_hot_block(chandler,ip_point&4095));
 		} else {
 			Bit32s old_cycles=CPU_Cycles;
 			CPU_Cycles=1;
@@ -332,6 +333,7 @@ run_block:
 #endif
 		goto restart_core;
 	case BR_Cycles:
+		dyn_sample_running_block();
 #if C_DEBUG
 #if C_HEAVY_DEBUG			
 		if (DEBUG_HeavyIsBreakpoint()) return debugCallback;
@@ -48,8 +48,38 @@ static struct DynDecode {
 		Bitu reg;
 	} modrm;
 	DynReg * segprefix;
+	bool superblock;
+	Bitu opcodes_left;
 } decode;
 
+/* Blocks are sampled each time the cycle budget runs out: the block that
+   was entered last gets its counter increased. Blocks that keep showing up
+   are cleared and rebuilt by the second translation pass, which continues
+   decoding across forward jumps inside the page instead of ending the
+   block there. */
+#define DYN_HOT_BLOCK_SAMPLES 16
+
+static struct {
+	CodePageHandler * handler;
+	Bitu start;
+} hot_block;
+
+static void dyn_sample_running_block(void) {
+	CacheBlock * block=cache.block.running;
+	// skip blocks that got invalidated while running
+	if (!block || !block->page.handler || block->exec.superblock) return;
+	if (++block->exec.samples<DYN_HOT_BLOCK_SAMPLES) return;
+	hot_block.handler=block->page.handler;
+	hot_block.start=block->page.start;
+	block->Clear();
+}
+
+static bool dyn_take_hot_block(CodePageHandler * codepage,Bitu start) {
+	if (codepage!=hot_block.handler || start!=hot_block.start) return false;
+	hot_block.handler=0;
+	return true;
+}
+
 static bool MakeCodePage(Bitu lin_addr,CodePageHandler * &cph) {
 	Bit8u rdval;
 	const Bitu cflag = cpu.code.big ? PFLAG_HASCODE32:PFLAG_HASCODE16;
@@ -494,6 +524,29 @@ static void dyn_check_bool_exception_ne(void) {
 	used_save_info++;
 }
 
+static_assert(sizeof(PagingBlock::TLBEntry) == 24, "TLB lookup scales the page by 3*8");
+
+// reg (eax or ecx) holds the linear page number, on return it holds the host
+// pointer of the TLB entry; the returned branch is taken for stale entries
+static const Bit8u* gen_tlb_lookup(Bit8u reg,bool read) {
+	cache_addb(0x8d);		// lea reg,[reg+reg*2]
+	cache_addb(0x04+(reg<<3));
+	cache_addb(0x40+(reg<<3)+reg);
+	cache_addb(0x52);		// push edx
+	cache_addw(0x158b);		// mov edx,[paging.tlb.generation]
+	cache_addd((Bit32u)(&paging.tlb.generation));
+	cache_addw(0x143b);		// cmp edx,paging.tlb.entries[reg*8].generation
+	cache_addb(0xc5+(reg<<3));
+	cache_addd((Bit32u)(&paging.tlb.entries[0].generation));
+	cache_addb(0x5a);		// pop edx
+	const Bit8u* stale_loc=gen_create_branch(BR_NZ);
+	cache_addw(0x048b+(reg<<11));	// mov reg,paging.tlb.entries[reg*8].read/write
+	cache_addb(0xc5+(reg<<3));
+	if (read) cache_addd((Bit32u)(&paging.tlb.entries[0].read));
+	else cache_addd((Bit32u)(&paging.tlb.entries[0].write));
+	return stale_loc;
+}
+
 static void dyn_read_intro(DynReg * addr,bool release_addr=true) {
 	gen_protectflags();
 
@@ -527,9 +580,7 @@ static void dyn_read_byte(DynReg * addr,DynReg * dst,bool high,bool release=fals
 
 	cache_addw(0xe8c1);		// shr eax,0x0c
 	cache_addb(0x0c);
-	cache_addw(0x048b);		// mov eax,paging.tlb.read[eax*TYPE Bit32u]
-	cache_addb(0x85);
-	cache_addd((Bit32u)(&paging.tlb.read[0]));
+	const Bit8u* stale_loc=gen_tlb_lookup(0,true);
 	cache_addw(0xc085);		// test eax,eax
 	const Bit8u* je_loc=gen_create_branch(BR_Z);
 
@@ -538,6 +589,7 @@ static void dyn_read_byte(DynReg * addr,DynReg * dst,bool high,bool release=fals
 	cache_addb(0x08);
 
 	const Bit8u* jmp_loc=gen_create_jump();
+	gen_fill_branch(stale_loc);
 	gen_fill_branch(je_loc);
 	cache_addb(0x51);		// push ecx
 	cache_addb(0xe8);
@@ -604,9 +656,7 @@ static void dyn_read_word(DynReg * addr,DynReg * dst,bool dword,bool release=fal
 	const Bit8u* jb_loc1=gen_create_branch(BR_NB);
 	cache_addb(0x25);       // and eax, 0x000FFFFF
 	cache_addd(0x000fffff);
-	cache_addw(0x048b);		// mov eax,paging.tlb.read[eax*TYPE Bit32u]
-	cache_addb(0x85);
-	cache_addd((Bit32u)(&paging.tlb.read[0]));
+	const Bit8u* stale_loc=gen_tlb_lookup(0,true);
 	cache_addw(0xc085);		// test eax,eax
 	const Bit8u* je_loc=gen_create_branch(BR_Z);
 
@@ -616,6 +666,7 @@ static void dyn_read_word(DynReg * addr,DynReg * dst,bool dword,bool release=fal
 
 	const Bit8u* jmp_loc=gen_create_jump();
 	gen_fill_branch(jb_loc1);
+	gen_fill_branch(stale_loc);
 	gen_fill_branch(je_loc);
 
 	if (!dword) {
@@ -675,9 +726,7 @@ static void dyn_write_byte(DynReg * addr,DynReg * val,bool high,bool release=fal
 	GenReg * genreg=FindDynReg(val);
 	cache_addw(0xe9c1);		// shr ecx,0x0c
 	cache_addb(0x0c);
-	cache_addw(0x0c8b);		// mov ecx,paging.tlb.write[ecx*TYPE Bit32u]
-	cache_addb(0x8d);
-	cache_addd((Bit32u)(&paging.tlb.write[0]));
+	const Bit8u* stale_loc=gen_tlb_lookup(1,false);
 	cache_addw(0xc985);		// test ecx,ecx
 	const Bit8u* je_loc=gen_create_branch(BR_Z);
 
@@ -685,6 +734,7 @@ static void dyn_write_byte(DynReg * addr,DynReg * val,bool high,bool release=fal
 	cache_addb(0x08);
 
 	const Bit8u* jmp_loc=gen_create_jump();
+	gen_fill_branch(stale_loc);
 	gen_fill_branch(je_loc);
 
 	cache_addb(0x52);	// push edx
@@ -719,9 +769,7 @@ static void dyn_write_word(DynReg * addr,DynReg * val,bool dword,bool release=fa
 	const Bit8u* jb_loc1=gen_create_branch(BR_NB);
 	cache_addw(0xe181);     // and ecx, 0x000FFFFF
 	cache_addd(0x000fffff);
-	cache_addw(0x0c8b);		// mov ecx,paging.tlb.write[ecx*TYPE Bit32u]
-	cache_addb(0x8d);
-	cache_addd((Bit32u)(&paging.tlb.write[0]));
+	const Bit8u* stale_loc=gen_tlb_lookup(1,false);
 	cache_addw(0xc985);		// test ecx,ecx
 	const Bit8u* je_loc=gen_create_branch(BR_Z);
 
@@ -731,6 +779,7 @@ static void dyn_write_word(DynReg * addr,DynReg * val,bool dword,bool release=fa
 
 	const Bit8u* jmp_loc=gen_create_jump();
 	gen_fill_branch(jb_loc1);
+	gen_fill_branch(stale_loc);
 	gen_fill_branch(je_loc);
 
 	cache_addb(0x52);	// push edx
@@ -773,6 +822,38 @@ static bool mem_writeb_checked_dcx64(PhysPt address, Bitu val) {
 	return paging.get_tlb_handler<false>(address)->writeb_checked(address, val);
 }
 
+static_assert(sizeof(PagingBlock::TLBEntry) == 40, "TLB lookup scales the page by 5*8");
+
+// grab a second scratch register for the TLB generation check,
+// the registers in use are passed to keep them out of reach
+static Bit8u GetTLBGenReg(int busy0,int busy1,int busy2=-1) {
+	bool saved[X64_REGS];
+	for (Bitu i=0;i<X64_REGS;i++) {
+		GenReg * genreg=x64gen.regs[i];
+		saved[i]=genreg->notusable;
+		if (genreg->index==busy0 || genreg->index==busy1 || genreg->index==busy2)
+			genreg->notusable=true;
+	}
+	Bit8u gen=GetNextReg();
+	for (Bitu i=0;i<X64_REGS;i++) x64gen.regs[i]->notusable=saved[i];
+	return gen;
+}
+
+// tmp holds the linear page number, on return it holds the host pointer of the
+// TLB entry; both returned branches are taken when the page is not linked
+static const Bit8u* gen_tlb_lookup(Bit8u tmp,Bit8u gen,bool read,const Bit8u ** stale) {
+	opcode(tmp).set64().setea(tmp,tmp,2).Emit8(0x8D); // lea tmp, [tmp+4*tmp]
+	opcode(gen).setabsaddr(&paging.tlb.generation).Emit8(0x8B); // mov gen, [paging.tlb.generation]
+	// cmp gen, [8*tmp+paging.tlb.entries[0].generation(rbp)]
+	opcode(gen).setea(5,tmp,3,(Bits)&paging.tlb.entries[0].generation-(Bits)&cpu_regs).Emit8(0x3B);
+	*stale=gen_create_branch(BR_NZ);
+	// mov tmp, [8*tmp+paging.tlb.entries[0].read/write(rbp)]
+	HostPt * ptr = read ? &paging.tlb.entries[0].read : &paging.tlb.entries[0].write;
+	opcode(tmp).set64().setea(5,tmp,3,(Bits)ptr-(Bits)&cpu_regs).Emit8(0x8B);
+	opcode(tmp).set64().setrm(tmp).Emit8(0x85); // test tmp,tmp
+	return gen_create_branch(BR_Z);
+}
+
 static void dyn_read_word(DynReg * addr,DynReg * dst,bool dword,bool release=false) {
 	DynState callstate;
 	Bit8u tmp;
@@ -786,6 +867,7 @@ static void dyn_read_word(DynReg * addr,DynReg * dst,bool dword,bool release=fal
 	x64gen.regs[reg_args[0]]->notusable=true;
 	x64gen.regs[reg_args[1]]->notusable=true;
 	tmp = GetNextReg();
+	Bit8u gen = GetTLBGenReg(tmp,gendst->index);
 	gensrc->notusable = false;
 	x64gen.regs[reg_args[0]]->notusable=false;
 	x64gen.regs[reg_args[1]]->notusable=false;
@@ -803,10 +885,8 @@ static void dyn_read_word(DynReg * addr,DynReg * dst,bool dword,bool release=fal
 	}
 
 	opcode(5).setrm(tmp).setimm(12,1).Emit8(0xC1); // shr tmpd,12
-	// mov tmp, [8*tmp+paging.tlb.read(rbp)]
-	opcode(tmp).set64().setea(5,tmp,3,(Bits)paging.tlb.read-(Bits)&cpu_regs).Emit8(0x8B);
-	opcode(tmp).set64().setrm(tmp).Emit8(0x85); // test tmp,tmp
-	const Bit8u *nomap=gen_create_branch(BR_Z);
+	const Bit8u *stale;
+	const Bit8u *nomap=gen_tlb_lookup(tmp,gen,true,&stale);
 	//mov dst, [tmp+src]
 	opcode(gendst->index,dword).setea(tmp,gensrc->index).Emit8(0x8B);
 	const Bit8u* jmp_loc = gen_create_short_jump();
@@ -815,6 +895,7 @@ static void dyn_read_word(DynReg * addr,DynReg * dst,bool dword,bool release=fal
 	gen_load_imm(tmp, (Bitu)(dword?(void*)mem_unalignedreadd_checked:(void*)mem_unalignedreadw_checked));
 	const Bit8u* page_jmp = gen_create_short_jump();
 
+	gen_fill_branch(stale);
 	gen_fill_branch(nomap);
 	gen_load_imm(tmp, (Bitu)(dword?(void*)mem_readd_checked_dcx64:(void*)mem_readw_checked_dcx64));
 	gen_fill_short_jump(page_jmp);
@@ -842,6 +923,7 @@ static void dyn_read_byte(DynReg * addr,DynReg * dst,bool high,bool release=fals
 	GenReg *gensrc = FindDynReg(addr);
 	GenReg *gendst = FindDynReg(dst);
 	tmp = GetNextReg(high);
+	Bit8u gen = GetTLBGenReg(tmp,gensrc->index,gendst->index);
 	if (release) gen_releasereg(addr);
 	dyn_savestate(&callstate);
 
@@ -849,10 +931,8 @@ static void dyn_read_byte(DynReg * addr,DynReg * dst,bool high,bool release=fals
 
 	opcode(tmp).setrm(gensrc->index).Emit8(0x8B); // mov tmp, src
 	opcode(5).setrm(tmp).setimm(12,1).Emit8(0xC1); // shr tmp,12
-	// mov tmp, [8*tmp+paging.tlb.read(rbp)]
-	opcode(tmp).set64().setea(5,tmp,3,(Bits)paging.tlb.read-(Bits)&cpu_regs).Emit8(0x8B);
-	opcode(tmp).set64().setrm(tmp).Emit8(0x85); // test tmp,tmp
-	const Bit8u *nomap=gen_create_branch(BR_Z);
+	const Bit8u *stale;
+	const Bit8u *nomap=gen_tlb_lookup(tmp,gen,true,&stale);
 
 	int src = gensrc->index;
 	if (high && src>=8) { // can't use REX prefix with high-byte reg
@@ -863,6 +943,7 @@ static void dyn_read_byte(DynReg * addr,DynReg * dst,bool high,bool release=fals
 	opcode(gendst->index,true,high?4:0).setea(tmp,src).Emit8(0x8A);
 	const Bit8u* jmp_loc=gen_create_short_jump();
 
+	gen_fill_branch(stale);
 	gen_fill_branch(nomap);
 	if (gensrc->index != ARG0_REG) {
 		x64gen.regs[reg_args[0]]->Clear();
@@ -889,6 +970,7 @@ static void dyn_write_word(DynReg * addr,DynReg * val,bool dword,bool release=fa
 	x64gen.regs[reg_args[0]]->notusable=true;
 	x64gen.regs[reg_args[1]]->notusable=true;
 	tmp = GetNextReg();
+	Bit8u gen = GetTLBGenReg(tmp,gendst->index,genval->index);
 	x64gen.regs[reg_args[0]]->notusable=false;
 	x64gen.regs[reg_args[1]]->notusable=false;
 	if (release) gen_releasereg(addr);
@@ -906,10 +988,8 @@ static void dyn_write_word(DynReg * addr,DynReg * val,bool dword,bool release=fa
 	}
 
 	opcode(5).setrm(tmp).setimm(12,1).Emit8(0xC1); // shr tmpd,12
-	// mov tmp, [8*tmp+paging.tlb.write(rbp)]
-	opcode(tmp).set64().setea(5,tmp,3,(Bits)paging.tlb.write-(Bits)&cpu_regs).Emit8(0x8B);
-	opcode(tmp).set64().setrm(tmp).Emit8(0x85); // test tmp,tmp
-	const Bit8u *nomap=gen_create_branch(BR_Z);
+	const Bit8u *stale;
+	const Bit8u *nomap=gen_tlb_lookup(tmp,gen,false,&stale);
 	//mov [tmp+src], dst
 	opcode(genval->index,dword).setea(tmp,gendst->index).Emit8(0x89);
 	const Bit8u* jmp_loc = gen_create_short_jump();
@@ -917,6 +997,7 @@ static void dyn_write_word(DynReg * addr,DynReg * val,bool dword,bool release=fa
 	gen_fill_branch(page_brk);
 	gen_load_imm(tmp, (Bitu)(dword?(void*)mem_unalignedwrited_checked:(void*)mem_unalignedwritew_checked));
 	const Bit8u* page_jmp = gen_create_short_jump();
+	gen_fill_branch(stale);
 	gen_fill_branch(nomap);
 	gen_load_imm(tmp, (Bitu)(dword?(void*)mem_writed_checked_dcx64:(void*)mem_writew_checked_dcx64));
 	gen_fill_short_jump(page_jmp);
@@ -940,6 +1021,7 @@ static void dyn_write_byte(DynReg * addr,DynReg * val,bool high,bool release=fal
 	GenReg *gendst = FindDynReg(addr);
 	GenReg *genval = FindDynReg(val);
 	tmp = GetNextReg(high);
+	Bit8u gen = GetTLBGenReg(tmp,gendst->index,genval->index);
 	if (release) gen_releasereg(addr);
 	dyn_savestate(&callstate);
 
@@ -947,10 +1029,8 @@ static void dyn_write_byte(DynReg * addr,DynReg * val,bool high,bool release=fal
 
 	opcode(tmp).setrm(gendst->index).Emit8(0x8B); // mov tmpd, dst
 	opcode(5).setrm(tmp).setimm(12,1).Emit8(0xC1); // shr tmpd,12
-	// mov tmp, [8*tmp+paging.tlb.write(rbp)]
-	opcode(tmp).set64().setea(5,tmp,3,(Bits)paging.tlb.write-(Bits)&cpu_regs).Emit8(0x8B);
-	opcode(tmp).set64().setrm(tmp).Emit8(0x85); // test tmp,tmp
-	const Bit8u *nomap=gen_create_branch(BR_Z);
+	const Bit8u *stale;
+	const Bit8u *nomap=gen_tlb_lookup(tmp,gen,false,&stale);
 
 	int dst = gendst->index;
 	if (high && dst>=8) { // can't use REX prefix with high-byte reg
@@ -961,6 +1041,7 @@ static void dyn_write_byte(DynReg * addr,DynReg * val,bool high,bool release=fal
 	opcode(genval->index,true,high?4:0).setea(tmp,dst).Emit8(0x88);
 
 	const Bit8u* jmp_loc=gen_create_short_jump();
+	gen_fill_branch(stale);
 	gen_fill_branch(nomap);
 
 	if (gendst->index != ARG0_REG) {
@@ -1055,6 +1136,44 @@ static void dyn_pop(DynReg * dynreg,bool checked=true) {
 	}
 }
 
+/* Peek at the instruction following the current one and see if it
+   overwrites all arithmetic flags without reading any of them. In that case
+   the flags produced by the current instruction are dead and don't need to
+   be restored into the host flags before it. Must be called after all bytes
+   of the current instruction were fetched. Only looks at bytes in the
+   current page that will be decoded into this block as well, so that
+   modifying them invalidates the block.
+   The next instruction mustn't have a memory operand either: if that access
+   faulted, the exception handler would get the flags that weren't kept. */
+static bool dyn_flags_dead_after(void) {
+	if (!decode.opcodes_left || decode.page.index>=4095) return false;
+	if (decode.page.invmap && (decode.page.invmap[decode.page.index] ||
+		decode.page.invmap[decode.page.index+1])) return false;
+	const Bit8u next_opcode=mem_readb(decode.code);
+	const Bit8u next_modrm=mem_readb(decode.code+1);
+	const bool next_rm_is_reg=(next_modrm >> 6)==3;
+	switch (next_opcode) {
+	case 0x00:case 0x01:case 0x02:case 0x03:						/* ADD */
+	case 0x08:case 0x09:case 0x0a:case 0x0b:						/* OR */
+	case 0x20:case 0x21:case 0x22:case 0x23:						/* AND */
+	case 0x28:case 0x29:case 0x2a:case 0x2b:						/* SUB */
+	case 0x30:case 0x31:case 0x32:case 0x33:						/* XOR */
+	case 0x38:case 0x39:case 0x3a:case 0x3b:						/* CMP */
+	case 0x84:case 0x85:											/* TEST */
+		return next_rm_is_reg;
+	case 0x04:case 0x05:case 0x0c:case 0x0d:case 0x24:case 0x25:	/* op al/eax,imm */
+	case 0x2c:case 0x2d:case 0x34:case 0x35:case 0x3c:case 0x3d:
+	case 0xa8:case 0xa9:
+		return true;
+	case 0x80:case 0x81:case 0x83: {								/* Group 1 */
+		const Bitu reg=(next_modrm >> 3) & 7;
+		return next_rm_is_reg && (reg!=2) && (reg!=3);	/* ADC and SBB read the carry */
+		}
+	default:
+		return false;
+	}
+}
+
 static INLINE void dyn_get_modrm(void) {
 	decode.modrm.val=decode_fetchb();
 	decode.modrm.mod=(decode.modrm.val >> 6) & 3;
@@ -1394,13 +1513,16 @@ static void dyn_imul_gvev(Bitu immsize) {
 	} else {
 		src=&DynRegs[decode.modrm.rm];
 	}
-	gen_needflags();
+	Bits imm=0;
 	switch (immsize) {
-	case 0:gen_imul_word(decode.big_op,rm_reg,src);break;
-	case 1:gen_imul_word_imm(decode.big_op,rm_reg,src,(Bit8s)decode_fetchb());break;
-	case 2:gen_imul_word_imm(decode.big_op,rm_reg,src,(Bit16s)decode_fetchw());break;
-	case 4:gen_imul_word_imm(decode.big_op,rm_reg,src,(Bit32s)decode_fetchd());break;
-	}
+	case 1:imm=(Bit8s)decode_fetchb();break;
+	case 2:imm=(Bit16s)decode_fetchw();break;
+	case 4:imm=(Bit32s)decode_fetchd();break;
+	}
+	if (dyn_flags_dead_after()) gen_discardflags();
+	else gen_needflags();
+	if (immsize) gen_imul_word_imm(decode.big_op,rm_reg,src,imm);
+	else gen_imul_word(decode.big_op,rm_reg,src);
 	gen_releasereg(DREG(TMPW));
 }
 
@@ -1603,6 +1725,19 @@ enum grp2_types {
 	grp2_1,grp2_imm,grp2_cl,
 };
 
+/* ROL and ROR only alter cf/of and keep the other flags, RCL and RCR read
+   the carry as well. A memory operand is written back after the flags were
+   changed, and a fault on that write needs the old flags intact. */
+static bool dyn_rotate_flags_dead(void) {
+	return decode.modrm.reg<2 && decode.modrm.mod==3 && dyn_flags_dead_after();
+}
+
+/* Shifts and rotates by cl keep all flags when cl is zero */
+static bool dyn_shift_cl_flags_dead(void) {
+	return decode.modrm.reg!=2 && decode.modrm.reg!=3 && decode.modrm.mod==3 &&
+		dyn_flags_dead_after();
+}
+
 static void dyn_grp2_eb(grp2_types type) {
 	dyn_get_modrm();DynReg * src;Bit8u src_i;
 	if (decode.modrm.mod<3) {
@@ -1616,7 +1751,7 @@ static void dyn_grp2_eb(grp2_types type) {
 	switch (type) {
 	case grp2_1:
 		/* rotates (first 4 ops) alter cf/of only; shifts (last 4 ops) alter all flags */
-		if (decode.modrm.reg < 4) gen_needflags();
+		if (decode.modrm.reg < 4 && !dyn_rotate_flags_dead()) gen_needflags();
 		else gen_discardflags();
 		gen_shift_byte_imm(decode.modrm.reg,src,src_i,1);
 		break;
@@ -1624,14 +1759,16 @@ static void dyn_grp2_eb(grp2_types type) {
 		Bit8u imm=decode_fetchb();
 		if (imm) {
 			/* rotates (first 4 ops) alter cf/of only; shifts (last 4 ops) alter all flags */
-			if (decode.modrm.reg < 4) gen_needflags();
+			if (decode.modrm.reg < 4 && !dyn_rotate_flags_dead()) gen_needflags();
 			else gen_discardflags();
 			gen_shift_byte_imm(decode.modrm.reg,src,src_i,imm);
 		} else return;
 		}
 		break;
 	case grp2_cl:
-		gen_needflags();	/* flags must not be changed on ecx==0 */
+		/* flags must not be changed on ecx==0 */
+		if (dyn_shift_cl_flags_dead()) gen_discardflags();
+		else gen_needflags();
 		gen_shift_byte_cl (decode.modrm.reg,src,src_i,DREG(ECX));
 		break;
 	}
@@ -1652,14 +1789,14 @@ static void dyn_grp2_ev(grp2_types type) {
 	switch (type) {
 	case grp2_1:
 		/* rotates (first 4 ops) alter cf/of only; shifts (last 4 ops) alter all flags */
-		if (decode.modrm.reg < 4) gen_needflags();
+		if (decode.modrm.reg < 4 && !dyn_rotate_flags_dead()) gen_needflags();
 		else gen_discardflags();
 		gen_shift_word_imm(decode.modrm.reg,decode.big_op,src,1);
 		break;
 	case grp2_imm: {
 		Bitu val;
 		if (decode_fetchb_imm(val)) {
-			if (decode.modrm.reg < 4) gen_needflags();
+			if (decode.modrm.reg < 4 && !dyn_rotate_flags_dead()) gen_needflags();
 			else gen_discardflags();
 			gen_dop_byte_imm_mem(DOP_MOV,DREG(TMPB),0,(void*)val);
 			gen_shift_word_cl(decode.modrm.reg,decode.big_op,src,DREG(TMPB));
@@ -1669,14 +1806,16 @@ static void dyn_grp2_ev(grp2_types type) {
 		Bit8u imm=(Bit8u)val;
 		if (imm) {
 			/* rotates (first 4 ops) alter cf/of only; shifts (last 4 ops) alter all flags */
-			if (decode.modrm.reg < 4) gen_needflags();
+			if (decode.modrm.reg < 4 && !dyn_rotate_flags_dead()) gen_needflags();
 			else gen_discardflags();
 			gen_shift_word_imm(decode.modrm.reg,decode.big_op,src,imm);
 		} else return;
 		}
 		break;
 	case grp2_cl:
-		gen_needflags();	/* flags must not be changed on ecx==0 */
+		/* flags must not be changed on ecx==0 */
+		if (dyn_shift_cl_flags_dead()) gen_discardflags();
+		else gen_needflags();
 		gen_shift_word_cl (decode.modrm.reg,decode.big_op,src,DREG(ECX));
 		break;
 	}
@@ -1708,10 +1847,14 @@ static void dyn_grp3_eb(void) {
 		set_skipflags(false);gen_sop_byte(SOP_NEG,src,src_i);
 		break;
 	case 0x4:	/* mul Eb */
-		gen_needflags();gen_mul_byte(false,DREG(EAX),src,src_i);
+		if (dyn_flags_dead_after()) gen_discardflags();
+		else gen_needflags();
+		gen_mul_byte(false,DREG(EAX),src,src_i);
 		goto skipsave;
 	case 0x5:	/* imul Eb */
-		gen_needflags();gen_mul_byte(true,DREG(EAX),src,src_i);
+		if (dyn_flags_dead_after()) gen_discardflags();
+		else gen_needflags();
+		gen_mul_byte(true,DREG(EAX),src,src_i);
 		goto skipsave;
 	case 0x6:	/* div Eb */
 	case 0x7:	/* idiv Eb */
@@ -1748,10 +1891,14 @@ static void dyn_grp3_ev(void) {
 		set_skipflags(false);gen_sop_word(SOP_NEG,decode.big_op,src);
 		break;
 	case 0x4:	/* mul Eb */
-		gen_needflags();gen_mul_word(false,DREG(EAX),DREG(EDX),decode.big_op,src);
+		if (dyn_flags_dead_after()) gen_discardflags();
+		else gen_needflags();
+		gen_mul_word(false,DREG(EAX),DREG(EDX),decode.big_op,src);
 		goto skipsave;
 	case 0x5:	/* imul Eb */
-		gen_needflags();gen_mul_word(true,DREG(EAX),DREG(EDX),decode.big_op,src);
+		if (dyn_flags_dead_after()) gen_discardflags();
+		else gen_needflags();
+		gen_mul_word(true,DREG(EAX),DREG(EDX),decode.big_op,src);
 		goto skipsave;
 	case 0x6:	/* div Eb */
 	case 0x7:	/* idiv Eb */
@@ -1890,6 +2037,29 @@ static void dyn_exit_link(Bits eip_change) {
 	dyn_closeblock();
 }
 
+/* Second pass only: keep decoding at the target of a forward jump that stays
+   inside the current page. The skipped bytes are added to the write map, so
+   the block covers one contiguous range and any write to the skipped bytes
+   invalidates it. Ranges that were modified before are not skipped, as that
+   is usually data that keeps changing. In 16-bit code a jump past 0xffff
+   wraps to the start of the segment, so those aren't followed either. */
+static bool dyn_follow_jump(Bits eip_change) {
+	if (!decode.superblock || decode.big_op!=cpu.code.big) return false;
+	if (eip_change<0) return false;
+	const Bitu target=decode.page.index+eip_change;
+	if (target>=4096) return false;
+	if (!decode.big_op && (decode.code-SegPhys(cs))+eip_change>0xffff) return false;
+	if (decode.page.invmap) {
+		for (Bitu i=decode.page.index;i<target;i++)
+			if (decode.page.invmap[i]) return false;
+	}
+	for (Bitu i=decode.page.index;i<target;i++)
+		decode.page.wmap[i]+=0x01;
+	decode.code+=eip_change;
+	decode.page.index=target;
+	return true;
+}
+
 static void dyn_branched_exit(BranchTypes btype,Bit32s eip_add) {
 	Bitu eip_base=decode.code-decode.code_start;
  	gen_needflags();
@@ -2166,9 +2336,10 @@ static void dyn_larlsl(bool islar) {
 #endif
 #include "dyn_fpu.h"
 
-static CacheBlock * CreateCacheBlock(CodePageHandler * codepage,PhysPt start,Bitu max_opcodes) {
+static CacheBlock * CreateCacheBlock(CodePageHandler * codepage,PhysPt start,Bitu max_opcodes,bool superblock) {
 	Bits i;
 /* Init a load of variables */
+	decode.superblock=superblock;
 	decode.code_start=start;
 	decode.code=start;
 	decode.page.code=codepage;
@@ -2177,6 +2348,7 @@ static CacheBlock * CreateCacheBlock(CodePageHandler * codepage,PhysPt start,Bit
 	decode.page.invmap=codepage->invalidation_map;
 	decode.page.first=start >> 12;
 	decode.active_block=decode.block=cache_openblock();
+	decode.block->exec.superblock=superblock;
 	decode.block->page.start=decode.page.index;
 	codepage->AddCacheBlock(decode.block);
 
@@ -2203,6 +2375,7 @@ static CacheBlock * CreateCacheBlock(CodePageHandler * codepage,PhysPt start,Bit
 	bool fpu_used=false;
 #endif
 	while (max_opcodes--) {
+		decode.opcodes_left=max_opcodes;
 /* Init prefixes */
 		decode.big_addr=cpu.code.big;
 		decode.big_op=cpu.code.big;
@@ -2710,13 +2883,23 @@ restart_prefix:
 			dyn_call_near_imm();
 			goto finish_block;
 		case 0xe9:		/* Jmp Ivx */
-			dyn_exit_link(decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw());
+			{
+				Bits eip_change=decode.big_op ? (Bit32s)decode_fetchd() : (Bit16s)decode_fetchw();
+				if (dyn_follow_jump(eip_change)) break;
+				dyn_exit_link(eip_change);
+			}
 			goto finish_block;
 		case 0xea:		/* JMP FAR Ip */
 			dyn_jmp_far_imm();
 			goto finish_block;
 			/* Jmp Ibx */
-		case 0xeb:dyn_exit_link((Bit8s)decode_fetchb());goto finish_block;
+		case 0xeb:
+			{
+				Bits eip_change=(Bit8s)decode_fetchb();
+				if (dyn_follow_jump(eip_change)) break;
+				dyn_exit_link(eip_change);
+			}
+			goto finish_block;
 		/* IN AL/AX,DX*/
 		case 0xec:
 			gen_call_function((void*)&dyn_io_readB,"%Dw",DREG(EDX));
@@ -2176,13 +2176,8 @@ void CPU_Disable_SkipAutoAdjust(void) {
 }
 
 
-extern int ticksDone;
-extern int ticksScheduled;
-
 void CPU_Reset_AutoAdjust(void) {
-	CPU_IODelayRemoved = 0;
-	ticksDone = 0;
-	ticksScheduled = 0;
+	DOSBOX_ResetAutoCycles();
 }
 
 class CPU final : public Module_base {
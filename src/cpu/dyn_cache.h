@@ -96,9 +96,34 @@ public:
 		                  // to this block
 	} link[2];                // maximum two links (conditional jumps)
 
+	struct {
+		uint32_t samples; // times the block was found running when the
+		                  // cycle budget ran out
+		bool superblock;  // block was built by the second translation
+		                  // pass
+	} exec;
+
 	CacheBlock *crossblock;
 };
 
+// NOTE: translated blocks are only valid inside the process that generated
+// them and can't be stored on disk and loaded by a later session. The
+// generated code refers to host addresses directly: the register file,
+// the core's helper functions and data (handed to the code generators as
+// immediate pointers), the link_blocks stubs, and other blocks in the
+// code cache (through the jumps patched in by LinkTo). All of these move
+// between runs because of ASLR and because the cache memory is allocated
+// at runtime.
+//
+// Hashing the guest page contents and CPU mode identifies the guest code,
+// but says nothing about the host-side state that the generated code
+// depends on. Saving blocks would need code generators that emit
+// relocatable code plus a relocation pass when loading. The in-memory
+// cache below already keeps blocks as long as the guest doesn't modify
+// their code (CodePageHandler ignores writes that leave a byte unchanged),
+// so an unchanged program loaded again at the same address keeps its
+// translations.
+
 static struct {
 	struct {
 		CacheBlock *first;   // the first cache block in the list
@@ -600,6 +625,8 @@ skipresize:
 	// adjust parameters and open this block
 	block->cache.size=size;
 	block->cache.next=nextblock;
+	block->exec.samples=0;
+	block->exec.superblock=false;
 	cache.pos=block->cache.start;
 	return block;
 }
@@ -168,11 +168,8 @@ void PAGING_PageFault(PhysPt lin_addr,Bitu page_addr,uint32_t faultcode) {
 
 static INLINE void InitPageUpdateLink(Bitu relink,PhysPt addr) {
 	if (relink==0) return;
-	if (paging.links.used) {
-		if (paging.links.entries[paging.links.used-1]==(addr>>12)) {
-			paging.links.used--;
-			paging.UnlinkPages(addr >> 12, 1);
-		}
+	if (paging.tlb.entries[addr >> 12].generation==paging.tlb.generation) {
+		paging.UnlinkPages(addr >> 12, 1);
 	}
 	if (relink>1) paging.LinkPage(addr >> 12, relink, true);
 }
@@ -642,35 +639,34 @@ bool PAGING_ForcePageInit(Bitu lin_addr) {
 	return false;
 }
 
+static void UnlinkEntry(PagingBlock::TLBEntry & entry) {
+	entry.read = 0;
+	entry.write = 0;
+	entry.readhandler = &init_page_handler;
+	entry.writehandler = &init_page_handler;
+	entry.generation = 0;
+}
+
 void PAGING_InitTLB(void) {
 	for (Bitu i=0;i<TLB_SIZE;i++) {
-		paging.tlb.read[i]=0;
-		paging.tlb.write[i]=0;
-		paging.tlb.readhandler[i]=&init_page_handler;
-		paging.tlb.writehandler[i]=&init_page_handler;
+		UnlinkEntry(paging.tlb.entries[i]);
 	}
-	paging.links.used=0;
+	paging.tlb.generation=1;
+	paging.tlb.unlinked=&init_page_handler;
 }
 
 void PagingBlock::clearTLB()
 {
-	Bit32u * entries = &links.entries[0];
-	for (;links.used > 0; links.used--) {
-		Bitu page = *entries++;
-		tlb.read[page] = 0;
-		tlb.write[page] = 0;
-		tlb.readhandler[page] = &init_page_handler;
-		tlb.writehandler[page] = &init_page_handler;
+	/* Generation 0 is reserved for unlinked entries, so when the counter
+	 * wraps every entry is swept once and numbering starts over */
+	if (GCC_UNLIKELY(++tlb.generation == 0)) {
+		PAGING_InitTLB();
 	}
-	links.used = 0;
 }
 
 void PagingBlock::UnlinkPages(Bitu lin_page,Bitu pages) {
 	for (; pages > 0; pages--) {
-		tlb.read[lin_page] = 0;
-		tlb.write[lin_page] = 0;
-		tlb.readhandler[lin_page] = &init_page_handler;
-		tlb.writehandler[lin_page] = &init_page_handler;
+		UnlinkEntry(tlb.entries[lin_page]);
 		lin_page++;
 	}
 }
@@ -678,10 +674,7 @@ void PagingBlock::UnlinkPages(Bitu lin_page,Bitu pages) {
 void PagingBlock::MapPage(Bitu lin_page,Bitu phys_page) {
 	if (lin_page < LINK_START) {
 		firstmb[lin_page] = phys_page;
-		tlb.read[lin_page] = 0;
-		tlb.write[lin_page] = 0;
-		tlb.readhandler[lin_page] = &init_page_handler;
-		tlb.writehandler[lin_page] = &init_page_handler;
+		UnlinkEntry(tlb.entries[lin_page]);
 	} else {
 		LinkPage(lin_page, phys_page);
 	}
@@ -694,21 +687,15 @@ void PagingBlock::LinkPage(Bitu lin_page, Bitu phys_page, bool readOnly)
 	if (lin_page >= TLB_SIZE || phys_page >= TLB_SIZE) 
 		E_Exit("Illegal page");
 
-	if (links.used >= PAGING_LINKS) {
-		LOG(LOG_PAGING,LOG_NORMAL)("Not enough paging links, resetting cache");
-		clearTLB();
-		assert(links.used == 0);
-	}
-
-	tlb.phys_page[lin_page] = phys_page;
-	tlb.read[lin_page] = (handler->flags & PFLAG_READABLE) ?
+	TLBEntry &entry = tlb.entries[lin_page];
+	entry.phys_page = phys_page;
+	entry.read = (handler->flags & PFLAG_READABLE) ?
 		handler->GetHostReadPt(phys_page) - lin_base : 0;
-	tlb.write[lin_page] = (!readOnly && (handler->flags & PFLAG_WRITEABLE)) ? 
+	entry.write = (!readOnly && (handler->flags & PFLAG_WRITEABLE)) ? 
 	    handler->GetHostWritePt(phys_page) - lin_base : 0;
-
-	links.entries[links.used++] = lin_page;
-	tlb.readhandler[lin_page] = handler;
-	tlb.writehandler[lin_page] = (readOnly) ? &init_page_handler_userro : handler;
+	entry.readhandler = handler;
+	entry.writehandler = (readOnly) ? &init_page_handler_userro : handler;
+	entry.generation = tlb.generation;
 }
 
 void PagingBlock::SetDirBase(Bitu cr3) 
@@ -37,6 +37,7 @@
 #include <SDL_thread.h>
 
 #include "support.h"
+#include "decode_ahead.h"
 #include "mem.h"
 #include "mixer.h"
 #include "../libs/decoders/SDL_sound.h"
@@ -159,6 +160,14 @@ private:
 		virtual Bit8u    getChannels() = 0;
 		virtual int      getLength() = 0;
 		virtual void setAudioPosition(uint32_t pos) = 0;
+
+		// Points at the requested bytes when the whole range is held in
+		// memory, otherwise returns the nullptr
+		virtual const uint8_t *getMapping(MAYBE_UNUSED const uint32_t offset,
+		                                  MAYBE_UNUSED const uint32_t bytes)
+		{
+			return nullptr;
+		}
 		const Bit16u chunkSize = 0;
 	};
 
@@ -186,6 +195,35 @@ private:
 		std::ifstream   *file;
 	};
 
+	// A binary track file mapped into memory, so data sectors can be copied
+	// straight out of it. Fails where the host can't map the file, in which
+	// case the BinaryFile is used instead.
+	class MappedFile final : public TrackFile {
+	public:
+		MappedFile      (const char *filename, bool &error);
+		~MappedFile     ();
+
+		MappedFile      () = delete;
+		MappedFile      (const MappedFile&) = delete; // prevent copying
+		MappedFile&     operator= (const MappedFile&) = delete; // prevent assignment
+
+		bool            read(uint8_t *buffer,
+		                     const uint32_t offset,
+		                     const uint32_t requested_bytes);
+		bool            seek(const uint32_t offset);
+		uint32_t        decode(int16_t *buffer, const uint32_t desired_track_frames);
+		Bit16u          getEndian();
+		Bit32u          getRate() { return 44100; }
+		Bit8u           getChannels() { return 2; }
+		int             getLength() { return length_redbook_bytes; }
+		void setAudioPosition(uint32_t pos) { audio_pos = pos; }
+		const uint8_t  *getMapping(const uint32_t offset, const uint32_t bytes);
+
+	private:
+		uint8_t         *mapping = nullptr;
+		size_t          mapping_size = 0;
+	};
+
 	class AudioFile final : public TrackFile {
 	public:
 		AudioFile       (const char *filename, bool &error);
@@ -208,7 +246,42 @@ private:
 		// areas of this class.
 		void setAudioPosition(MAYBE_UNUSED uint32_t pos) {}
 	private:
+		void            startDecoder();
+		bool            seekSource(const uint32_t ms);
+		uint32_t        decodeSource(int16_t *buffer, const uint32_t frames,
+		                             bool &failed);
+		void            hashStep();
+		void            openCache();
+		void            buildCache();
+		void            useCache();
+		void            dropBuild();
+
 		Sound_Sample *sample = nullptr;
+		std::string  filename = {};
+
+		/**
+		 *  Once the track is played, a decoder thread owns the sample and
+		 *  keeps a ring of decoded frames ahead of the playback position.
+		 *  The ring holds samples in the track's own format.
+		 */
+		std::unique_ptr<DecodeAhead> decoder = nullptr;
+		uint64_t source_frame = 0; // next frame to decode
+
+		/**
+		 *  While the ring is full the thread hashes the track file, then
+		 *  writes a decoded copy of the whole track to the cache directory,
+		 *  named after the hash. Once it's complete, or if it was already
+		 *  there, the copy is read instead of decoding the sample.
+		 */
+		FILE         *hashing = nullptr;
+		uint64_t     track_hash = 0;
+		FILE         *cache = nullptr;
+		FILE         *build = nullptr;
+		Sound_Sample *builder = nullptr;
+		std::string  cache_path = {};
+		std::string  build_path = {};
+		uint64_t     cache_limit = 0; // bytes, zero when disabled
+		bool         cache_checked = false;
 	};
 
 public:
@@ -242,6 +315,7 @@ public:
 	bool	ReadSectors             (PhysPt buffer, const bool raw, const uint32_t sector, const uint16_t num);
 	bool	LoadUnloadMedia         (bool unload);
 	bool	ReadSector              (uint8_t *buffer, const bool raw, const uint32_t sector);
+	bool	ReadSectorsHost         (uint8_t *buffer, const bool raw, const uint32_t sector, const uint32_t num);
 	bool	HasDataTrack            (void);
 	static CDROM_Interface_Image* images[26];
 
@@ -264,6 +338,17 @@ private:
 
 	// Private utility functions
 	bool  LoadIsoFile(char *filename);
+	static std::shared_ptr<TrackFile> OpenBinaryFile(const char *filename,
+	                                                 bool &error);
+	bool  GetSectorOffset(const Track &track,
+	                      const bool raw,
+	                      const uint32_t sector,
+	                      uint32_t &offset);
+	uint32_t MapSectors(const bool raw,
+	                    const uint32_t sector,
+	                    const uint32_t num,
+	                    const uint8_t *&data,
+	                    uint32_t &stride);
 	bool  CanReadPVD(TrackFile *file,
 	                 const uint16_t sectorSize,
 	                 const bool mode2);
@@ -23,8 +23,10 @@
 
 #include "cdrom.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cctype>
+#include <cinttypes>
 #include <chrono>
 #include <cmath>
 #include <cstdio>
@@ -35,12 +37,23 @@
 #include <sstream>
 #include <vector>
 
+#include <sys/stat.h>
+#include <sys/types.h>
+
 #if !defined(WIN32)
 #include <libgen.h>
 #else
 #include <cstring>
 #endif
 
+#if defined(HAVE_MMAP)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "control.h"
+#include "cross.h"
 #include "drives.h"
 #include "fs_utils.h"
 #include "setup.h"
@@ -217,6 +230,173 @@ uint32_t CDROM_Interface_Image::BinaryFile::decode(int16_t *buffer,
 	return ceil_udivide(bytes_read, BYTES_PER_REDBOOK_PCM_FRAME);
 }
 
+CDROM_Interface_Image::MappedFile::MappedFile(const char *filename, bool &error)
+        : TrackFile(BYTES_PER_RAW_REDBOOK_FRAME)
+{
+	error = true;
+#if defined(HAVE_MMAP)
+	const int fd = open(filename, O_RDONLY);
+	if (fd < 0)
+		return;
+	struct stat status;
+	// Empty or oversized images are left to the BinaryFile to report
+	if (fstat(fd, &status) == 0 && status.st_size > 0 &&
+	    static_cast<uint64_t>(status.st_size) <= MAX_REDBOOK_BYTES) {
+		const auto size = static_cast<size_t>(status.st_size);
+		void *addr = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (addr != MAP_FAILED) {
+			mapping = static_cast<uint8_t *>(addr);
+			mapping_size = size;
+			length_redbook_bytes = static_cast<int>(size);
+			error = false;
+		}
+	}
+	// The mapping stays valid after the descriptor is closed
+	close(fd);
+#else
+	(void)filename;
+#endif
+}
+
+CDROM_Interface_Image::MappedFile::~MappedFile()
+{
+#if defined(HAVE_MMAP)
+	if (mapping)
+		munmap(mapping, mapping_size);
+#endif
+	mapping = nullptr;
+}
+
+const uint8_t *CDROM_Interface_Image::MappedFile::getMapping(const uint32_t offset,
+                                                             const uint32_t bytes)
+{
+	if (!mapping || offset > mapping_size || bytes > mapping_size - offset)
+		return nullptr;
+	return mapping + offset;
+}
+
+bool CDROM_Interface_Image::MappedFile::read(uint8_t *buffer,
+                                             const uint32_t offset,
+                                             const uint32_t requested_bytes)
+{
+	// Check for logic bugs and illegal values
+	assertm(mapping && buffer, "The mapping and/or buffer pointer is invalid");
+	assertm(offset <= MAX_REDBOOK_BYTES, "Requested offset exceeds CDROM size");
+	assertm(requested_bytes <= MAX_REDBOOK_BYTES, "Requested bytes exceeds CDROM size");
+
+	const uint32_t adjusted_bytes = adjustOverRead(offset, requested_bytes);
+	if (adjusted_bytes == 0) // no work to do!
+		return true;
+
+	memcpy(buffer, mapping + offset, adjusted_bytes);
+	return true;
+}
+
+Bit16u CDROM_Interface_Image::MappedFile::getEndian()
+{
+	// Image files are always little endian
+	return AUDIO_S16LSB;
+}
+
+bool CDROM_Interface_Image::MappedFile::seek(const uint32_t offset)
+{
+	// There's no position to move, as every access names its own offset
+	return offsetInsideTrack(offset);
+}
+
+uint32_t CDROM_Interface_Image::MappedFile::decode(int16_t *buffer,
+                                                   const uint32_t desired_track_frames)
+{
+	// Guard against logic bugs and illegal values
+	assertm(buffer && mapping, "The mapping or buffer are invalid");
+	assertm(desired_track_frames <= MAX_REDBOOK_FRAMES,
+	        "Requested number of frames exceeds the maximum for a CDROM");
+	assertm(audio_pos < MAX_REDBOOK_BYTES,
+	        "Tried to decode audio before the playback position was set");
+
+	if (audio_pos >= mapping_size)
+		return 0;
+	const auto bytes_read = static_cast<uint32_t>(
+	        std::min<size_t>(desired_track_frames * BYTES_PER_REDBOOK_PCM_FRAME,
+	                         mapping_size - audio_pos));
+	memcpy(buffer, mapping + audio_pos, bytes_read);
+
+	// decoding is an audio-task, so update our audio position
+	audio_pos += bytes_read;
+
+	// Return the number of decoded Redbook frames
+	return ceil_udivide(bytes_read, BYTES_PER_REDBOOK_PCM_FRAME);
+}
+
+// Decoded frames kept ahead of playback, and the most decoded in one go
+constexpr uint32_t decoder_ring_ms = 1000;
+constexpr uint32_t decoder_chunk_frames = 2048;
+
+// Megabytes of disk the decoded track copies can take up, zero if disabled
+static uint32_t cdaudio_cache_mb()
+{
+	const auto section = static_cast<Section_prop *>(control->GetSection("dos"));
+	return section ? static_cast<uint32_t>(section->Get_int("cdaudio_cache")) : 0;
+}
+
+static std::string cdaudio_cache_dir()
+{
+	return CROSS_GetPlatformConfigDir() + "cdaudio-cache" + CROSS_FILESPLIT;
+}
+
+// The cache is keyed on an FNV-1a hash of the whole track file, so renamed
+// or moved copies share it. The file is hashed a block per idle step.
+constexpr uint64_t fnv1a_offset = 0xcbf29ce484222325ULL;
+constexpr size_t cache_hash_block_bytes = 64 * 1024;
+
+static void fnv1a_update(uint64_t &hash, const uint8_t *data, const size_t bytes)
+{
+	for (size_t i = 0; i < bytes; ++i)
+		hash = (hash ^ data[i]) * 0x100000001b3ULL;
+}
+
+// Removes the least recently written copies until the cache fits its limit
+static void trim_cdaudio_cache(const std::string &dir, const uint64_t limit)
+{
+	struct Entry {
+		std::string path = {};
+		uint64_t size = 0;
+		time_t written = 0;
+	};
+	std::vector<Entry> entries = {};
+	uint64_t total = 0;
+
+	dir_information *listing = open_directory(dir.c_str());
+	if (!listing)
+		return;
+	char name[CROSS_LEN];
+	bool is_directory = false;
+	for (bool found = read_directory_first(listing, name, is_directory); found;
+	     found = read_directory_next(listing, name, is_directory)) {
+		const std::string entry_name = name;
+		if (is_directory || !ends_with(entry_name, ".pcm"))
+			continue;
+		struct stat status;
+		const auto path = dir + entry_name;
+		if (stat(path.c_str(), &status) != 0)
+			continue;
+		entries.push_back({path, static_cast<uint64_t>(status.st_size),
+		                   status.st_mtime});
+		total += static_cast<uint64_t>(status.st_size);
+	}
+	close_directory(listing);
+
+	std::sort(entries.begin(), entries.end(), [](const Entry &a, const Entry &b) {
+		return a.written < b.written;
+	});
+	for (const auto &entry : entries) {
+		if (total <= limit)
+			break;
+		if (remove(entry.path.c_str()) == 0)
+			total -= entry.size;
+	}
+}
+
 CDROM_Interface_Image::AudioFile::AudioFile(const char *filename, bool &error)
 	: TrackFile(4096)
 {
@@ -226,6 +406,8 @@ CDROM_Interface_Image::AudioFile::AudioFile(const char *filename, bool &error)
 	const std::string filename_only = get_basename(filename);
 	if (sample) {
 		error = false;
+		this->filename = filename;
+		cache_limit = static_cast<uint64_t>(cdaudio_cache_mb()) * 1024 * 1024;
 		LOG_MSG("CDROM: Loaded %s [%d Hz, %d-channel, %2.1f minutes]",
 		        filename_only.c_str(), getRate(), getChannels(),
 		        getLength() / static_cast<double>(REDBOOK_PCM_BYTES_PER_MIN));
@@ -237,6 +419,17 @@ CDROM_Interface_Image::AudioFile::AudioFile(const char *filename, bool &error)
 
 CDROM_Interface_Image::AudioFile::~AudioFile()
 {
+	decoder.reset();
+	if (hashing) {
+		fclose(hashing);
+		hashing = nullptr;
+	}
+	dropBuild();
+	if (cache) {
+		fclose(cache);
+		cache = nullptr;
+	}
+
 	// Guard to prevent double-free or nullptr free
 	if (sample == nullptr)
 		return;
@@ -245,6 +438,176 @@ CDROM_Interface_Image::AudioFile::~AudioFile()
 	sample = nullptr;
 }
 
+void CDROM_Interface_Image::AudioFile::startDecoder()
+{
+	if (decoder)
+		return;
+	const auto seek = [this](const uint32_t ms) { return seekSource(ms); };
+	const auto decode = [this](int16_t *buffer, const uint32_t frames, bool &failed) {
+		return decodeSource(buffer, frames, failed);
+	};
+	// Once playback is ahead, check for and build the cached copy
+	const auto idle = [this]() {
+		if (cache_checked && !build)
+			return false;
+		if (!cache_checked)
+			hashStep();
+		else
+			buildCache();
+		return true;
+	};
+	decoder = std::make_unique<DecodeAhead>(getChannels(),
+	                                        getRate() * decoder_ring_ms / 1000,
+	                                        decoder_chunk_frames, seek,
+	                                        decode, idle);
+}
+
+bool CDROM_Interface_Image::AudioFile::seekSource(const uint32_t ms)
+{
+	source_frame = static_cast<uint64_t>(ms) * getRate() / 1000;
+	if (cache) {
+		const uint64_t pos = source_frame * getChannels() * REDBOOK_BPS;
+		return fseek(cache, static_cast<long>(pos), SEEK_SET) == 0;
+	}
+	return Sound_Seek(sample, ms);
+}
+
+uint32_t CDROM_Interface_Image::AudioFile::decodeSource(int16_t *buffer,
+                                                        const uint32_t frames,
+                                                        bool &failed)
+{
+	uint32_t decoded = 0;
+	if (cache) {
+		const size_t frame_bytes = getChannels() * REDBOOK_BPS;
+		decoded = static_cast<uint32_t>(fread(buffer, frame_bytes, frames, cache));
+		if (ferror(cache))
+			failed = true;
+	} else {
+		// Sound_Decode_Direct returns frames (agnostic of bitrate and channels)
+		decoded = Sound_Decode_Direct(sample, buffer, frames);
+		if (sample->flags & SOUND_SAMPLEFLAG_ERROR)
+			failed = true;
+	}
+	source_frame += decoded;
+	return decoded;
+}
+
+// Hashes the next block of the track file, and looks for its cached copy
+// once the whole file is in. Short steps let playback and seeks go on.
+void CDROM_Interface_Image::AudioFile::hashStep()
+{
+	if (!hashing) {
+		hashing = cache_limit ? fopen(filename.c_str(), "rb") : nullptr;
+		if (!hashing) {
+			cache_checked = true;
+			return;
+		}
+		track_hash = fnv1a_offset;
+	}
+	std::vector<uint8_t> block(cache_hash_block_bytes);
+	const size_t bytes = fread(block.data(), 1, block.size(), hashing);
+	fnv1a_update(track_hash, block.data(), bytes);
+	if (bytes == block.size())
+		return;
+
+	const bool read_all = !ferror(hashing);
+	fclose(hashing);
+	hashing = nullptr;
+	if (read_all)
+		openCache();
+	else
+		cache_checked = true;
+}
+
+void CDROM_Interface_Image::AudioFile::openCache()
+{
+	cache_checked = true;
+	const auto dir = cdaudio_cache_dir();
+	if (create_dir(dir.c_str(), 0700, OK_IF_EXISTS) != 0)
+		return;
+
+	char name[64];
+	safe_sprintf(name, "%016" PRIx64 "-%u-%u-%x.pcm", track_hash, getRate(),
+	             getChannels(), getEndian());
+	cache_path = dir + name;
+	if (path_exists(cache_path)) {
+		useCache();
+		return;
+	}
+
+	// Leave tracks out that would push everything else out of the cache
+	const uint64_t track_bytes = static_cast<uint64_t>(Sound_GetDuration(sample)) *
+	                             getRate() / 1000 * getChannels() * REDBOOK_BPS;
+	if (track_bytes > cache_limit / 2)
+		return;
+
+	Sound_AudioInfo desired = {AUDIO_S16, 0, 0};
+	builder = Sound_NewSampleFromFile(filename.c_str(), &desired);
+	build_path = cache_path + "." + std::to_string(reinterpret_cast<uintptr_t>(this)) + ".tmp";
+	build = builder ? fopen(build_path.c_str(), "wb") : nullptr;
+	if (!build)
+		dropBuild();
+}
+
+void CDROM_Interface_Image::AudioFile::buildCache()
+{
+	std::vector<int16_t> frames(decoder_chunk_frames * getChannels());
+	const uint32_t decoded = Sound_Decode_Direct(builder, frames.data(),
+	                                             decoder_chunk_frames);
+	const size_t frame_bytes = getChannels() * REDBOOK_BPS;
+	if ((builder->flags & SOUND_SAMPLEFLAG_ERROR) ||
+	    fwrite(frames.data(), frame_bytes, decoded, build) != decoded) {
+		dropBuild();
+		return;
+	}
+	if (decoded)
+		return;
+
+	// The whole track is in; only complete copies get the cache's name
+	const bool closed = (fclose(build) == 0);
+	build = nullptr;
+	if (!closed || rename(build_path.c_str(), cache_path.c_str()) != 0) {
+		dropBuild();
+		return;
+	}
+	Sound_FreeSample(builder);
+	builder = nullptr;
+	LOG_MSG("CDROM: Cached the decoded audio of %s",
+	        get_basename(filename).c_str());
+	trim_cdaudio_cache(cdaudio_cache_dir(), cache_limit);
+	useCache();
+}
+
+// Switches the decoder over to the cached copy, where the sample is now
+void CDROM_Interface_Image::AudioFile::useCache()
+{
+	FILE *file = fopen(cache_path.c_str(), "rb");
+	if (!file)
+		return;
+	const uint64_t pos = source_frame * getChannels() * REDBOOK_BPS;
+	if (fseek(file, static_cast<long>(pos), SEEK_SET) != 0) {
+		fclose(file);
+		return;
+	}
+	cache = file;
+}
+
+void CDROM_Interface_Image::AudioFile::dropBuild()
+{
+	if (build) {
+		fclose(build);
+		build = nullptr;
+	}
+	if (!build_path.empty()) {
+		remove(build_path.c_str());
+		build_path.clear();
+	}
+	if (builder) {
+		Sound_FreeSample(builder);
+		builder = nullptr;
+	}
+}
+
 /**
  *  Seek takes in a Redbook CD-DA byte offset relative to the track's start
  *  time and returns true if the seek succeeded.
@@ -288,8 +651,9 @@ bool CDROM_Interface_Image::AudioFile::seek(const uint32_t requested_pos)
 	clock::time_point begin = clock::now(); // start the timer
 #endif
 
-	// Perform the seek and update our position
-	const bool result = Sound_Seek(sample, pos_in_ms);
+	// Have the decoder perform the seek and update our position
+	startDecoder();
+	const bool result = decoder->Seek(pos_in_ms);
 	audio_pos = result ? requested_pos : std::numeric_limits<uint32_t>::max();
 
 #ifdef DEBUG
@@ -362,10 +726,10 @@ bool CDROM_Interface_Image::AudioFile::read(uint8_t *buffer,
 	uint32_t decoded_bytes = 0;
 	uint32_t decoded_frames = 0;
 	while (decoded_frames < requested_frames) {
-		const uint32_t decoded = Sound_Decode_Direct(sample,
-		                                             buffer + decoded_bytes,
-		                                             requested_frames - decoded_frames);
-		if (sample->flags & (SOUND_SAMPLEFLAG_ERROR | SOUND_SAMPLEFLAG_EOF) || !decoded)
+		const uint32_t decoded = decoder->Take(reinterpret_cast<int16_t *>(
+		                                               buffer + decoded_bytes),
+		                                       requested_frames - decoded_frames);
+		if (!decoded)
 			break;
 		decoded_frames += decoded;
 		decoded_bytes = decoded_frames * bytes_per_frame;
@@ -421,7 +785,7 @@ bool CDROM_Interface_Image::AudioFile::read(uint8_t *buffer,
 	}
 	// reading DAE is an audio-task, so update our audio position
 	audio_pos += decoded_bytes;
-	return !(sample->flags & SOUND_SAMPLEFLAG_ERROR);
+	return !decoder->HasFailed();
 }
 
 uint32_t CDROM_Interface_Image::AudioFile::decode(int16_t *buffer,
@@ -430,9 +794,7 @@ uint32_t CDROM_Interface_Image::AudioFile::decode(int16_t *buffer,
 	assertm(audio_pos < MAX_REDBOOK_BYTES,
 	        "Tried to decode audio before the playback position was set");
 
-	// Sound_Decode_Direct returns frames (agnostic of bitrate and channels)
-	const uint32_t frames_decoded =
-	    Sound_Decode_Direct(sample, (void*)buffer, desired_track_frames);
+	const uint32_t frames_decoded = decoder->Take(buffer, desired_track_frames);
 
 	// decoding is an audio-task, so update our audio position
 	// in terms of Redbook-equivalent bytes
@@ -850,39 +1212,112 @@ bool CDROM_Interface_Image::ReadSectors(PhysPt buffer,
 {
 	const uint16_t sectorSize = (raw ? BYTES_PER_RAW_REDBOOK_FRAME
 	                                 : BYTES_PER_COOKED_REDBOOK_FRAME);
-	const uint32_t requested_bytes = num * sectorSize;
 
 	// Resize our underlying vector if it's not big enough
-	if (readBuffer.size() < requested_bytes)
-		readBuffer.resize(requested_bytes);
+	if (readBuffer.size() < sectorSize)
+		readBuffer.resize(sectorSize);
 
 	// Setup state-tracking variables to be used in the read-loop
 	bool success = true; //Gobliiins reads 0 sectors
-	uint32_t bytes_read = 0;
-	uint32_t current_sector = sector;
-	uint8_t* buffer_position = readBuffer.data();
+	uint32_t sectors_read = 0;
 
 	// Read until we have enough or fail
-	while (bytes_read < requested_bytes) {
-		success = ReadSector(buffer_position, raw, current_sector);
-		if (!success)
-			break;
-		current_sector++;
-		bytes_read += sectorSize;
-		buffer_position += sectorSize;
+	while (sectors_read < num) {
+		const uint32_t current_sector = sector + sectors_read;
+		const PhysPt buffer_position = buffer + sectors_read * sectorSize;
+
+		// Sectors held in memory go straight into the guest's buffer
+		const uint8_t *mapped = nullptr;
+		uint32_t stride = 0;
+		const uint32_t mapped_sectors = MapSectors(raw, current_sector,
+		                                           num - sectors_read,
+		                                           mapped, stride);
+		if (mapped_sectors && stride == sectorSize) {
+			MEM_BlockWrite(buffer_position, mapped, mapped_sectors * sectorSize);
+		} else if (mapped_sectors) {
+			for (uint32_t i = 0; i < mapped_sectors; ++i)
+				MEM_BlockWrite(buffer_position + i * sectorSize,
+				               mapped + i * stride, sectorSize);
+		} else {
+			success = ReadSector(readBuffer.data(), raw, current_sector);
+			if (!success)
+				break;
+			MEM_BlockWrite(buffer_position, readBuffer.data(), sectorSize);
+		}
+		sectors_read += std::max(mapped_sectors, 1u);
 	}
-	// Write only the successfully read bytes
-	MEM_BlockWrite(buffer, readBuffer.data(), bytes_read);
 #ifdef DEBUG
 	LOG_MSG("CDROM: Read %u %s sectors at sector %u: "
 	        "%s after %u sectors (%u bytes)",
 	        num, raw ? "raw" : "cooked", sector,
 	        success ? "Succeeded" : "Failed",
-	        ceil_udivide(bytes_read, sectorSize), bytes_read);
+	        sectors_read, sectors_read * sectorSize);
 #endif
 	return success;
 }
 
+bool CDROM_Interface_Image::ReadSectorsHost(uint8_t *buffer,
+                                            const bool raw,
+                                            const uint32_t sector,
+                                            const uint32_t num)
+{
+	const uint16_t sectorSize = (raw ? BYTES_PER_RAW_REDBOOK_FRAME
+	                                 : BYTES_PER_COOKED_REDBOOK_FRAME);
+	uint32_t sectors_read = 0;
+	while (sectors_read < num) {
+		const uint32_t current_sector = sector + sectors_read;
+		uint8_t *buffer_position = buffer + sectors_read * sectorSize;
+
+		const uint8_t *mapped = nullptr;
+		uint32_t stride = 0;
+		const uint32_t mapped_sectors = MapSectors(raw, current_sector,
+		                                           num - sectors_read,
+		                                           mapped, stride);
+		if (mapped_sectors && stride == sectorSize) {
+			memcpy(buffer_position, mapped, mapped_sectors * sectorSize);
+		} else if (mapped_sectors) {
+			for (uint32_t i = 0; i < mapped_sectors; ++i)
+				memcpy(buffer_position + i * sectorSize,
+				       mapped + i * stride, sectorSize);
+		} else if (!ReadSector(buffer_position, raw, current_sector)) {
+			return false;
+		}
+		sectors_read += std::max(mapped_sectors, 1u);
+	}
+	return true;
+}
+
+/**
+ *  Finds how many of the num sectors starting at the given sector can be
+ *  copied straight out of their track's memory mapping, stopping at the end
+ *  of the track. Returns zero if the first can't, in which case the sector
+ *  needs to go through ReadSector. The sectors start at data and follow each
+ *  other stride bytes apart.
+ */
+uint32_t CDROM_Interface_Image::MapSectors(const bool raw,
+                                           const uint32_t sector,
+                                           const uint32_t num,
+                                           const uint8_t *&data,
+                                           uint32_t &stride)
+{
+	track_const_iter track = GetTrack(sector);
+	if (track == tracks.end() || !track->file || sector < track->start)
+		return 0;
+
+	uint32_t offset = 0;
+	if (!GetSectorOffset(*track, raw, sector, offset))
+		return 0;
+
+	const uint32_t length = (raw ? BYTES_PER_RAW_REDBOOK_FRAME
+	                             : BYTES_PER_COOKED_REDBOOK_FRAME);
+	const uint32_t count = std::min(num, track->start + track->length - sector);
+	data = track->file->getMapping(offset, (count - 1) * track->sectorSize + length);
+	if (!data)
+		return 0;
+	stride = track->sectorSize;
+	return count;
+}
+
 bool CDROM_Interface_Image::LoadUnloadMedia(bool /*unload*/)
 {
 	return true;
@@ -936,6 +1371,22 @@ track_iter CDROM_Interface_Image::GetTrack(const uint32_t sector)
 	return track;
 }
 
+bool CDROM_Interface_Image::GetSectorOffset(const Track &track,
+                                            const bool raw,
+                                            const uint32_t sector,
+                                            uint32_t &offset)
+{
+	if (track.sectorSize != BYTES_PER_RAW_REDBOOK_FRAME && raw) {
+		return false;
+	}
+	offset = track.skip + (sector - track.start) * track.sectorSize;
+	if (track.sectorSize == BYTES_PER_RAW_REDBOOK_FRAME && !track.mode2 && !raw)
+		offset += 16;
+	if (track.mode2 && !raw)
+		offset += 24;
+	return true;
+}
+
 bool CDROM_Interface_Image::ReadSector(uint8_t *buffer, const bool raw, const uint32_t sector)
 {
 	track_const_iter track = GetTrack(sector);
@@ -949,15 +1400,10 @@ bool CDROM_Interface_Image::ReadSector(uint8_t *buffer, const bool raw, const ui
 #endif
 		return false;
 	}
-	uint32_t offset = track->skip + (sector - track->start) * track->sectorSize;
-	const uint16_t length = (raw ? BYTES_PER_RAW_REDBOOK_FRAME : BYTES_PER_COOKED_REDBOOK_FRAME);
-	if (track->sectorSize != BYTES_PER_RAW_REDBOOK_FRAME && raw) {
+	uint32_t offset = 0;
+	if (!GetSectorOffset(*track, raw, sector, offset))
 		return false;
-	}
-	if (track->sectorSize == BYTES_PER_RAW_REDBOOK_FRAME && !track->mode2 && !raw)
-		offset += 16;
-	if (track->mode2 && !raw)
-		offset += 24;
+	const uint16_t length = (raw ? BYTES_PER_RAW_REDBOOK_FRAME : BYTES_PER_COOKED_REDBOOK_FRAME);
 
 #if 0 // Excessively verbose.. only enable if needed
 #ifdef DEBUG
@@ -1031,6 +1477,16 @@ void CDROM_Interface_Image::CDAudioCallBack(Bitu desired_track_frames)
 	}
 }
 
+// Maps the file where the host allows, and otherwise reads it as a stream
+std::shared_ptr<CDROM_Interface_Image::TrackFile> CDROM_Interface_Image::OpenBinaryFile(
+        const char *filename, bool &error)
+{
+	auto mapped = make_shared<MappedFile>(filename, error);
+	if (!error)
+		return mapped;
+	return make_shared<BinaryFile>(filename, error);
+}
+
 bool CDROM_Interface_Image::LoadIsoFile(char* filename)
 {
 	tracks.clear();
@@ -1038,7 +1494,7 @@ bool CDROM_Interface_Image::LoadIsoFile(char* filename)
 	// data track (track 1)
 	Track track;
 	bool error;
-	track.file = make_shared<BinaryFile>(filename, error);
+	track.file = OpenBinaryFile(filename, error);
 
 	if (error) {
 		return false;
@@ -1215,7 +1671,7 @@ bool CDROM_Interface_Image::LoadCueSheet(char *cuefile)
 
 			bool error = true;
 			if (type == "BINARY") {
-				track.file = make_shared<BinaryFile>(filename.c_str(), error);
+				track.file = OpenBinaryFile(filename.c_str(), error);
 			}
 			else {
 				track.file = make_shared<AudioFile>(filename.c_str(), error);
@@ -0,0 +1,144 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "decode_ahead.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "support.h"
+
+DecodeAhead::DecodeAhead(const int num_channels,
+                         const uint32_t ring_frames,
+                         const uint32_t chunk_frames,
+                         seek_f seek,
+                         decode_f decode,
+                         idle_f idle)
+        : channels(static_cast<size_t>(num_channels)),
+          seek_source(std::move(seek)),
+          decode_source(std::move(decode)),
+          idle_work(std::move(idle))
+{
+	ring.resize(std::max(ring_frames, 2 * chunk_frames) * channels);
+	staging.resize(chunk_frames * channels);
+	idle_done = !idle_work;
+	thread = std::thread(&DecodeAhead::Run, this);
+	set_thread_name(thread, "dosbox:cdaudio");
+}
+
+DecodeAhead::~DecodeAhead()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	has_work.notify_one();
+	thread.join();
+}
+
+bool DecodeAhead::Seek(const uint32_t ms)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	seek_ms = ms;
+	seek_pending = true;
+	has_work.notify_one();
+	seek_done.wait(lock, [this] { return !seek_pending; });
+	return !seek_failed;
+}
+
+uint32_t DecodeAhead::Take(int16_t *buffer, const uint32_t frames)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	// The thread stops decoding once a chunk no longer fits on the ring
+	const size_t wanted = std::min(frames * channels, ring.size() - staging.size());
+	has_frames.wait(lock, [&] {
+		return (ring_fill >= wanted && !seek_pending) || end_of_track || stopping;
+	});
+	const size_t samples = std::min(wanted, ring_fill);
+	const size_t first = std::min(samples, ring.size() - ring_start);
+	std::copy_n(ring.begin() + ring_start, first, buffer);
+	std::copy_n(ring.begin(), samples - first, buffer + first);
+	ring_start = (ring_start + samples) % ring.size();
+	ring_fill -= samples;
+	has_work.notify_one();
+	return static_cast<uint32_t>(samples / channels);
+}
+
+bool DecodeAhead::HasFailed()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	return decode_error;
+}
+
+void DecodeAhead::Run()
+{
+	const auto chunk_frames = static_cast<uint32_t>(staging.size() / channels);
+	std::unique_lock<std::mutex> lock(mutex);
+	while (!stopping) {
+		if (seek_pending) {
+			const uint32_t ms = seek_ms;
+			lock.unlock();
+			const bool seeked = seek_source(ms);
+			lock.lock();
+			ring_start = 0;
+			ring_fill = 0;
+			end_of_track = !seeked;
+			seek_failed = !seeked;
+			seek_pending = false;
+			seek_done.notify_all();
+			has_frames.notify_all();
+			continue;
+		}
+
+		// Playback comes first...
+		if (!end_of_track && ring.size() - ring_fill >= staging.size()) {
+			lock.unlock();
+			bool failed = false;
+			const uint32_t frames = decode_source(staging.data(),
+			                                      chunk_frames, failed);
+			lock.lock();
+			if (failed)
+				decode_error = true;
+			// The frames are from before a seek that came in meanwhile
+			if (seek_pending)
+				continue;
+			const size_t samples = frames * channels;
+			const size_t at = (ring_start + ring_fill) % ring.size();
+			const size_t first = std::min(samples, ring.size() - at);
+			std::copy_n(staging.begin(), first, ring.begin() + at);
+			std::copy_n(staging.begin() + first, samples - first, ring.begin());
+			ring_fill += samples;
+			if (frames == 0)
+				end_of_track = true;
+			has_frames.notify_all();
+			continue;
+		}
+
+		// ...then the idle work, a step at a time
+		if (!idle_done) {
+			lock.unlock();
+			const bool more = idle_work();
+			lock.lock();
+			idle_done = !more;
+			continue;
+		}
+		has_work.wait(lock);
+	}
+}
@@ -0,0 +1,95 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_DECODE_AHEAD_H
+#define DOSBOX_DECODE_AHEAD_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+Decode Ahead
+~~~~~~~~~~~~
+Runs an audio decoder on a thread of its own, keeping a ring of decoded
+frames ahead of the playback position, so playing a compressed CD audio
+track never waits on the codec.
+
+The source is only ever touched by the thread: it seeks, decodes a chunk at
+a time while the ring has room, and does the idle work, such as caching the
+decoded track, once the ring is full. Seek() hands the position to the
+thread and waits for it, and Take() waits for frames when the thread is
+behind. The mutex guards the ring along with every flag the two share.
+*/
+
+class DecodeAhead {
+public:
+	using seek_f = std::function<bool(uint32_t ms)>;
+	// Returns the frames decoded, zero at the end; sets failed on errors
+	using decode_f = std::function<uint32_t(int16_t *buffer, uint32_t frames, bool &failed)>;
+	// Does a step of work; returns false when there's none left
+	using idle_f = std::function<bool()>;
+
+	DecodeAhead(int channels, uint32_t ring_frames, uint32_t chunk_frames,
+	            seek_f seek, decode_f decode, idle_f idle = {});
+	DecodeAhead(const DecodeAhead &) = delete;
+	DecodeAhead &operator=(const DecodeAhead &) = delete;
+	~DecodeAhead();
+
+	// Returns false if the source couldn't seek there
+	bool Seek(uint32_t ms);
+
+	// Returns fewer frames than asked for at the end of the track, or when
+	// asked for more than the ring holds ahead
+	uint32_t Take(int16_t *buffer, uint32_t frames);
+
+	// Tells if the source failed to decode since it was opened
+	bool HasFailed();
+
+private:
+	void Run();
+
+	const size_t channels = 0;
+	seek_f seek_source;
+	decode_f decode_source;
+	idle_f idle_work;
+
+	std::thread thread = {};
+	std::mutex mutex = {};
+	std::condition_variable has_work = {};
+	std::condition_variable has_frames = {};
+	std::condition_variable seek_done = {};
+	std::vector<int16_t> ring = {};
+	std::vector<int16_t> staging = {};
+	size_t ring_start = 0;
+	size_t ring_fill = 0;
+	uint32_t seek_ms = 0;
+	bool seek_pending = false;
+	bool seek_failed = false;
+	bool end_of_track = true; // until the first seek
+	bool decode_error = false;
+	bool idle_done = false;
+	bool stopping = false;
+};
+
+#endif
@@ -1362,6 +1362,9 @@ public:
 		}
 	}
 	~DOS(){
+		// Close the files left open first, writing back what they cached
+		for (auto &file : Files)
+			file.reset();
 		for (Bit16u i=0;i<DOS_DRIVES;i++) Drives[i].reset();
 	}
 };
@@ -482,6 +482,8 @@ bool DOS_FlushFile(Bit16u entry) {
 		return false;
 	};
 	LOG(LOG_DOSMISC,LOG_NORMAL)("FFlush used.");
+	// Commit what the file's cache still holds
+	Files[handle]->Flush();
 	return true;
 }
 
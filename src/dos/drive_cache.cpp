@@ -337,6 +337,10 @@ void DOS_Drive_Cache::CacheOut(const char* path, bool ignoreLastDir) {
 	}
 
 //	LOG_DEBUG("DIR: Caching out %s : dir %s",expand,dir->orgname);
+	CacheOutDir(dir);
+}
+
+void DOS_Drive_Cache::CacheOutDir(CFileInfo* dir) {
 	// delete file objects...
 	//Maybe check if it is a file and then only delete the file and possibly the long name. instead of all objects in the dir.
 	for(Bit32u i=0; i<dir->fileList.size(); i++) {
@@ -351,6 +355,63 @@ void DOS_Drive_Cache::CacheOut(const char* path, bool ignoreLastDir) {
 	save_dir = nullptr;
 }
 
+void DOS_Drive_Cache::AddHostEntry(const char* host_dir, const char* name, bool is_directory) {
+	CFileInfo* dir = FindCachedDir(host_dir);
+	if (!dir || FindHostName(dir, name) >= 0) return;
+
+	CreateEntry(dir, name, is_directory);
+	Bits index = FindHostName(dir, name);
+	// Keep open searches of this directory on the entry they were at
+	for (Bit32u i=0; i<MAX_OPENDIRS; i++) {
+		if ((dirSearch[i]==dir) && ((Bit32u)index<=dirSearch[i]->nextEntry))
+			dirSearch[i]->nextEntry++;
+	}
+}
+
+void DOS_Drive_Cache::RemoveHostEntry(const char* host_dir, const char* name) {
+	// The short names that follow the removed one may change, so read the
+	// directory again rather than take the entry out
+	CFileInfo* dir = FindCachedDir(host_dir);
+	if (dir && FindHostName(dir, name) >= 0) CacheOutDir(dir);
+}
+
+// Follows a host directory down from the base by the original names, without
+// caching anything in on the way
+DOS_Drive_Cache::CFileInfo* DOS_Drive_Cache::FindCachedDir(const char* host_dir) {
+	const size_t base_len = safe_strlen(basePath);
+	if (!dirBase || base_len == 0 || basePath[base_len - 1] != CROSS_FILESPLIT) return nullptr;
+	if (strncmp(host_dir, basePath, base_len - 1) != 0) return nullptr;
+
+	const char* start = host_dir + base_len - 1;
+	if (*start && *start != CROSS_FILESPLIT) return nullptr;
+	CFileInfo* curDir = dirBase;
+	while (*start) {
+		start++;
+		const char* pos = strchr(start, CROSS_FILESPLIT);
+		const size_t len = pos ? (size_t)(pos - start) : strlen(start);
+		if (len) {
+			CFileInfo* next = nullptr;
+			for (CFileInfo* info : curDir->fileList) {
+				if (info->isDir && strncmp(info->orgname, start, len) == 0 && info->orgname[len] == 0) {
+					next = info;
+					break;
+				}
+			}
+			if (!next) return nullptr;
+			curDir = next;
+		}
+		start += len;
+	}
+	return IsCachedIn(curDir) ? curDir : nullptr;
+}
+
+Bits DOS_Drive_Cache::FindHostName(CFileInfo* dir, const char* name) {
+	for (size_t i = 0; i < dir->fileList.size(); i++) {
+		if (strcmp(dir->fileList[i]->orgname, name) == 0) return (Bits)i;
+	}
+	return -1;
+}
+
 bool DOS_Drive_Cache::IsCachedIn(CFileInfo* curDir) {
 	return (curDir->isOverlayDir || curDir->fileList.size()>0);
 }
@@ -18,6 +18,7 @@
 
 #include "drives.h"
 
+#include <algorithm>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -27,6 +28,7 @@
 #include "bios.h"
 #include "cross.h"
 #include "dos_inc.h"
+#include "fat_cluster_map.h"
 #include "string_utils.h"
 #include "support.h"
 
@@ -49,6 +51,10 @@ public:
 	bool Close();
 	Bit16u GetInformation(void);
 	bool UpdateDateTimeFromHost(void);   
+	void Flush();
+private:
+	Bit32u getSectorAt(Bit32u bytePos, Bit32u *runSects = nullptr);
+	Bit32u extendChain(void);
 public:
 	Bit32u firstCluster;
 	Bit32u seekpos;
@@ -62,6 +68,9 @@ public:
 
 	bool loadedSector;
 	fatDrive *myDrive;
+
+private:
+	FatClusterMap clusterMap;
 };
 
 
@@ -96,7 +105,8 @@ fatFile::fatFile(const char* /*name*/,
 	  dirCluster(0),
 	  dirIndex(0),
 	  loadedSector(false),
-	  myDrive(useDrive)
+	  myDrive(useDrive),
+	  clusterMap()
 {
 	Bit32u seekto = 0;
 	open = true;
@@ -110,51 +120,53 @@ bool fatFile::Read(Bit8u * data, Bit16u *size) {
 		DOS_SetError(DOSERR_ACCESS_DENIED);
 		return false;
 	}
-	Bit16u sizedec, sizecount;
 	if(seekpos >= filelength) {
 		*size = 0;
 		return true;
 	}
 
-	if (!loadedSector) {
-		currentSector = myDrive->getAbsoluteSectFromBytePos(firstCluster, seekpos);
-		if(currentSector == 0) {
-			/* EOC reached before EOF */
-			*size = 0;
-			loadedSector = false;
-			return true;
-		}
-		curSectOff = seekpos % myDrive->getSectorSize();
-		myDrive->readSector(currentSector, sectorBuffer);
-		loadedSector = true;
-	}
-
-	sizedec = *size;
-	sizecount = 0;
-	while(sizedec != 0) {
-		if(seekpos >= filelength) {
-			*size = sizecount;
-			return true; 
-		}
-		data[sizecount++] = sectorBuffer[curSectOff++];
-		seekpos++;
-		if(curSectOff >= myDrive->getSectorSize()) {
-			currentSector = myDrive->getAbsoluteSectFromBytePos(firstCluster, seekpos);
+	const Bit32u sectSize = myDrive->getSectorSize();
+	const Bit32u toRead = std::min<Bit32u>(*size, filelength - seekpos);
+	Bit32u sizecount = 0;
+	while(sizecount < toRead) {
+		if (!loadedSector) {
+			Bit32u runSects = 0;
+			currentSector = getSectorAt(seekpos, &runSects);
 			if(currentSector == 0) {
 				/* EOC reached before EOF */
-				//LOG_MSG("EOC reached before EOF, seekpos %d, filelen %d", seekpos, filelength);
-				*size = sizecount;
-				loadedSector = false;
+				*size = (Bit16u)sizecount;
 				return true;
 			}
-			curSectOff = 0;
+			curSectOff = seekpos % sectSize;
+			/* Whole sectors go straight to the caller, a run at a time */
+			const Bit32u wholeSects = std::min(runSects, (toRead - sizecount) / sectSize);
+			if (curSectOff == 0 && wholeSects > 0) {
+				myDrive->readSectors(currentSector, wholeSects, data + sizecount);
+				sizecount += wholeSects * sectSize;
+				seekpos += wholeSects * sectSize;
+				continue;
+			}
 			myDrive->readSector(currentSector, sectorBuffer);
 			loadedSector = true;
-			//LOG_MSG("Reading absolute sector at %d for seekpos %d", currentSector, seekpos);
 		}
-		--sizedec;
+		const Bit32u chunk = std::min(toRead - sizecount, sectSize - curSectOff);
+		memcpy(data + sizecount, sectorBuffer + curSectOff, chunk);
+		sizecount += chunk;
+		seekpos += chunk;
+		curSectOff += chunk;
+		if (curSectOff >= sectSize) loadedSector = false;
 	}
-	*size =sizecount;
+
+	/* Leave the sector at the new position loaded, as Write expects */
+	if (!loadedSector) {
+		currentSector = getSectorAt(seekpos);
+		if (currentSector != 0) {
+			curSectOff = seekpos % sectSize;
+			myDrive->readSector(currentSector, sectorBuffer);
+			loadedSector = true;
+		}
+	}
+	*size = (Bit16u)sizecount;
 	return true;
 }
 
@@ -187,7 +199,7 @@ bool fatFile::Write(Bit8u * data, Bit16u *size) {
 		}
 		filelength = ((filelength - 1) / clustSize + 1) * clustSize;
 		while(filelength < seekpos) {
-			if(myDrive->appendCluster(firstCluster) == 0) goto finalizeWrite; // out of space
+			if(extendChain() == 0) goto finalizeWrite; // out of space
 			filelength += clustSize;
 		}
 		if(filelength > seekpos) filelength = seekpos;
@@ -201,17 +213,17 @@ bool fatFile::Write(Bit8u * data, Bit16u *size) {
 				firstCluster = myDrive->getFirstFreeClust();
 				if(firstCluster == 0) goto finalizeWrite; // out of space
 				myDrive->allocateCluster(firstCluster, 0);
-				currentSector = myDrive->getAbsoluteSectFromBytePos(firstCluster, seekpos);
+				currentSector = getSectorAt(seekpos);
 				myDrive->readSector(currentSector, sectorBuffer);
 				loadedSector = true;
 			}
 			if (!loadedSector) {
-				currentSector = myDrive->getAbsoluteSectFromBytePos(firstCluster, seekpos);
+				currentSector = getSectorAt(seekpos);
 				if(currentSector == 0) {
 					/* EOC reached before EOF - try to increase file allocation */
-					myDrive->appendCluster(firstCluster);
+					extendChain();
 					/* Try getting sector again */
-					currentSector = myDrive->getAbsoluteSectFromBytePos(firstCluster, seekpos);
+					currentSector = getSectorAt(seekpos);
 					if(currentSector == 0) {
 						/* No can do. lets give up and go home.  We must be out of room */
 						goto finalizeWrite;
@@ -228,7 +240,7 @@ bool fatFile::Write(Bit8u * data, Bit16u *size) {
 		if(curSectOff >= myDrive->getSectorSize()) {
 			if(loadedSector) myDrive->writeSector(currentSector, sectorBuffer);
 
-			currentSector = myDrive->getAbsoluteSectFromBytePos(firstCluster, seekpos);
+			currentSector = getSectorAt(seekpos);
 			if(currentSector == 0) loadedSector = false;
 			else {
 				curSectOff = 0;
@@ -245,6 +257,7 @@ finalizeWrite:
 	tmpentry.entrysize = filelength;
 	tmpentry.loFirstClust = (Bit16u)firstCluster;
 	myDrive->directoryChange(dirCluster, &tmpentry, dirIndex);
+	myDrive->flushFat();
 
 	*size =sizecount;
 	return true;
@@ -269,7 +282,7 @@ bool fatFile::Seek(Bit32u *pos, Bit32u type) {
 
 	if(seekto<0) seekto = 0;
 	seekpos = (Bit32u)seekto;
-	currentSector = myDrive->getAbsoluteSectFromBytePos(firstCluster, seekpos);
+	currentSector = getSectorAt(seekpos);
 	if (currentSector == 0) {
 		/* not within file size, thus no sector is available */
 		loadedSector = false;
@@ -282,13 +295,45 @@ bool fatFile::Seek(Bit32u *pos, Bit32u type) {
 	return true;
 }
 
+void fatFile::Flush() {
+	if (loadedSector) myDrive->writeSector(currentSector, sectorBuffer);
+	myDrive->commitChanges();
+}
+
 bool fatFile::Close() {
 	/* Flush buffer */
-	if (loadedSector) myDrive->writeSector(currentSector, sectorBuffer);
+	Flush();
 
 	return false;
 }
 
+/* Returns the sector holding the byte at bytePos, or 0 past the end of the
+   chain. runSects tells how many sectors follow it on the disk in one run,
+   including itself. */
+Bit32u fatFile::getSectorAt(Bit32u bytePos, Bit32u *runSects) {
+	const Bit32u sectSize = myDrive->getSectorSize();
+	const Bit32u clustSects = myDrive->getClusterSize() / sectSize;
+	const Bit32u logicalSector = bytePos / sectSize;
+	Bit32u runClusts = 0;
+	const Bit32u clust = clusterMap.find(firstCluster, myDrive->getFatGeneration(),
+	                                     logicalSector / clustSects,
+	                                     [this](Bit32u c) { return myDrive->getNextCluster(c); },
+	                                     &runClusts);
+	if (clust == 0) return 0;
+	const Bit32u sectInClust = logicalSector % clustSects;
+	if (runSects) *runSects = runClusts * clustSects - sectInClust;
+	return myDrive->getClustFirstSect(clust) + sectInClust;
+}
+
+/* Adds a cluster to the end of the file, keeping the map in step */
+Bit32u fatFile::extendChain(void) {
+	const Bit32u lastClust = clusterMap.lastCluster(firstCluster, myDrive->getFatGeneration(),
+	                                                [this](Bit32u c) { return myDrive->getNextCluster(c); });
+	const Bit32u newClust = myDrive->appendCluster(firstCluster, lastClust);
+	if (newClust != 0 && lastClust != 0) clusterMap.append(newClust);
+	return newClust;
+}
+
 Bit16u fatFile::GetInformation(void) {
 	return 0;
 }
@@ -301,111 +346,184 @@ Bit32u fatDrive::getClustFirstSect(Bit32u clustNum) {
 	return ((clustNum - 2) * bootbuffer.sectorspercluster) + firstDataSector;
 }
 
-Bit32u fatDrive::getClusterValue(Bit32u clustNum) {
-	Bit32u fatoffset=0;
-	Bit32u fatsectnum;
-	Bit32u fatentoff;
-	Bit32u clustValue=0;
-
+Bit32u fatDrive::getFatEntryOffset(Bit32u clustNum) const {
 	switch(fattype) {
-		case FAT12:
-			fatoffset = clustNum + (clustNum / 2);
-			break;
-		case FAT16:
-			fatoffset = clustNum * 2;
-			break;
-		case FAT32:
-			fatoffset = clustNum * 4;
-			break;
+		case FAT12: return clustNum + (clustNum / 2);
+		case FAT16: return clustNum * 2;
+		case FAT32: return clustNum * 4;
 	}
-	fatsectnum = bootbuffer.reservedsectors + (fatoffset / bootbuffer.bytespersector) + partSectOff;
-	fatentoff = fatoffset % bootbuffer.bytespersector;
+	return 0;
+}
 
-	if(curFatSect != fatsectnum) {
-		/* Load two sectors at once for FAT12 */
-		readSector(fatsectnum, &fatSectBuffer[0]);
-		if (fattype==FAT12)
-			readSector(fatsectnum+1, &fatSectBuffer[512]);
-		curFatSect = fatsectnum;
+/* Reads the first FAT into memory, unless it's there already and nothing
+   else wrote to the disk meanwhile */
+bool fatDrive::loadFat(void) {
+	if (!loadedDisk) return false;
+	if (fatLoaded && seenWriteCount == loadedDisk->write_count) return true;
+
+	/* Keep our own changes over those made behind our back */
+	if (fatLoaded) flushFat();
+
+	const Bit32u entryCount = CountOfClusters + 2;
+	const Bit32u bytesPerSect = bootbuffer.bytespersector;
+	const Bit32u lastEntryEnd = getFatEntryOffset(entryCount - 1) +
+	                            ((fattype == FAT32) ? 4 : 2);
+	const Bit32u sectCount = std::max<Bit32u>(bootbuffer.sectorsperfat,
+	                         (lastEntryEnd + bytesPerSect - 1) / bytesPerSect);
+	const Bit32u firstFatSect = bootbuffer.reservedsectors + partSectOff;
+
+	fatSects.resize(sectCount * bytesPerSect);
+	for (Bit32u i = 0; i < sectCount; i++)
+		readSector(firstFatSect + i, &fatSects[i * bytesPerSect]);
+	dirtyFatSects.assign(sectCount, false);
+
+	fatEntries.resize(entryCount);
+	freeClusters.assign((CountOfClusters + 63) / 64, 0);
+	freeClusterCount = 0;
+	firstFreeHint = 0;
+	for (Bit32u clustNum = 0; clustNum < entryCount; clustNum++) {
+		const Bit8u *entry = &fatSects[getFatEntryOffset(clustNum)];
+		Bit32u clustValue = 0;
+		switch(fattype) {
+			case FAT12:
+				clustValue = var_read((Bit16u *)entry);
+				if(clustNum & 0x1) {
+					clustValue >>= 4;
+				} else {
+					clustValue &= 0xfff;
+				}
+				break;
+			case FAT16:
+				clustValue = var_read((Bit16u *)entry);
+				break;
+			case FAT32:
+				clustValue = var_read((Bit32u *)entry);
+				break;
+		}
+		fatEntries[clustNum] = clustValue;
+		if (clustNum >= 2 && clustValue == 0) setClusterFree(clustNum, true);
 	}
+	seenWriteCount = loadedDisk->write_count;
+	fatGeneration++;
+	fatLoaded = true;
+	return true;
+}
 
-	switch(fattype) {
-		case FAT12:
-			clustValue = var_read((Bit16u *)&fatSectBuffer[fatentoff]);
-			if(clustNum & 0x1) {
-				clustValue >>= 4;
-			} else {
-				clustValue &= 0xfff;
-			}
-			break;
-		case FAT16:
-			clustValue = var_read((Bit16u *)&fatSectBuffer[fatentoff]);
-			break;
-		case FAT32:
-			clustValue = var_read((Bit32u *)&fatSectBuffer[fatentoff]);
-			break;
+void fatDrive::setClusterFree(Bit32u clustNum, bool isFree) {
+	const Bit32u index = clustNum - 2;
+	const uint64_t bit = uint64_t(1) << (index % 64);
+	uint64_t &word = freeClusters[index / 64];
+	if (((word & bit) != 0) == isFree) return;
+	if (isFree) {
+		word |= bit;
+		freeClusterCount++;
+		firstFreeHint = std::min(firstFreeHint, index);
+	} else {
+		word &= ~bit;
+		freeClusterCount--;
 	}
-
-	return clustValue;
 }
 
-void fatDrive::setClusterValue(Bit32u clustNum, Bit32u clustValue) {
-	Bit32u fatoffset=0;
-	Bit32u fatsectnum;
-	Bit32u fatentoff;
-
-	switch(fattype) {
-		case FAT12:
-			fatoffset = clustNum + (clustNum / 2);
-			break;
-		case FAT16:
-			fatoffset = clustNum * 2;
-			break;
-		case FAT32:
-			fatoffset = clustNum * 4;
-			break;
+Bit32u fatDrive::getClusterValue(Bit32u clustNum) {
+	if (!loadFat()) return 0;
+	if (clustNum >= fatEntries.size()) {
+		/* Beyond the FAT; end the chain that leads here */
+		switch(fattype) {
+			case FAT12: return 0xfff;
+			case FAT16: return 0xffff;
+			default:    return 0xffffffff;
+		}
 	}
-	fatsectnum = bootbuffer.reservedsectors + (fatoffset / bootbuffer.bytespersector) + partSectOff;
-	fatentoff = fatoffset % bootbuffer.bytespersector;
+	return fatEntries[clustNum];
+}
 
-	if(curFatSect != fatsectnum) {
-		/* Load two sectors at once for FAT12 */
-		readSector(fatsectnum, &fatSectBuffer[0]);
-		if (fattype==FAT12)
-			readSector(fatsectnum+1, &fatSectBuffer[512]);
-		curFatSect = fatsectnum;
-	}
+void fatDrive::setClusterValue(Bit32u clustNum, Bit32u clustValue) {
+	if (!loadFat() || clustNum >= fatEntries.size()) return;
 
+	const Bit32u fatoffset = getFatEntryOffset(clustNum);
+	Bit8u *entry = &fatSects[fatoffset];
+	Bit32u entrySize = 2;
 	switch(fattype) {
 		case FAT12: {
-			Bit16u tmpValue = var_read((Bit16u *)&fatSectBuffer[fatentoff]);
+			Bit16u tmpValue = var_read((Bit16u *)entry);
 			if(clustNum & 0x1) {
 				clustValue &= 0xfff;
 				clustValue <<= 4;
 				tmpValue &= 0xf;
 				tmpValue |= (Bit16u)clustValue;
-
+				clustValue >>= 4;
 			} else {
 				clustValue &= 0xfff;
 				tmpValue &= 0xf000;
 				tmpValue |= (Bit16u)clustValue;
 			}
-			var_write((Bit16u *)&fatSectBuffer[fatentoff], tmpValue);
+			var_write((Bit16u *)entry, tmpValue);
 			break;
 			}
 		case FAT16:
-			var_write((Bit16u *)&fatSectBuffer[fatentoff], (Bit16u)clustValue);
+			clustValue &= 0xffff;
+			var_write((Bit16u *)entry, (Bit16u)clustValue);
 			break;
 		case FAT32:
-			var_write((Bit32u *)&fatSectBuffer[fatentoff], clustValue);
+			var_write((Bit32u *)entry, clustValue);
+			entrySize = 4;
 			break;
 	}
-	for(int fc=0;fc<bootbuffer.fatcopies;fc++) {
-		writeSector(fatsectnum + (fc * bootbuffer.sectorsperfat), &fatSectBuffer[0]);
-		if (fattype==FAT12) {
-			if (fatentoff>=511)
-				writeSector(fatsectnum+1+(fc * bootbuffer.sectorsperfat), &fatSectBuffer[512]);
-		}
+	const Bit32u oldValue = fatEntries[clustNum];
+	fatEntries[clustNum] = clustValue;
+	/* Open files only map their chains again if this may have cut them */
+	const Bit32u endOfChain = (fattype == FAT12) ? 0xff8 : (fattype == FAT16) ? 0xfff8 : 0xfffffff8;
+	if (FatClusterMap::invalidates(oldValue, clustValue, oldValue >= endOfChain)) fatGeneration++;
+	if (clustNum >= 2) setClusterFree(clustNum, clustValue == 0);
+
+	/* A FAT12 entry can straddle two sectors */
+	const Bit32u bytesPerSect = bootbuffer.bytespersector;
+	dirtyFatSects[fatoffset / bytesPerSect] = true;
+	dirtyFatSects[(fatoffset + entrySize - 1) / bytesPerSect] = true;
+}
+
+/* Returns the cluster after this one in its chain, or 0 at the end */
+Bit32u fatDrive::getNextCluster(Bit32u clustNum) {
+	const Bit32u clustValue = getClusterValue(clustNum);
+	switch(fattype) {
+		case FAT12:
+			if(clustValue >= 0xff8) return 0;
+			break;
+		case FAT16:
+			if(clustValue >= 0xfff8) return 0;
+			break;
+		case FAT32:
+			if(clustValue >= 0xfffffff8) return 0;
+			break;
+	}
+	return clustValue;
+}
+
+/* Tells if a FAT entry that chains of open files run through may have
+   changed since the last call */
+Bit32u fatDrive::getFatGeneration(void) {
+	loadFat();
+	return fatGeneration;
+}
+
+/* Writes the FAT and the disk's cached sectors to the image, so that anything
+   else opening it, such as BOOT, finds the directories as DOS left them */
+void fatDrive::commitChanges(void) {
+	flushFat();
+	if (loadedDisk) loadedDisk->Flush();
+}
+
+/* Writes the changed FAT sectors to every copy of the FAT */
+void fatDrive::flushFat(void) {
+	if (!fatLoaded) return;
+	const Bit32u bytesPerSect = bootbuffer.bytespersector;
+	const Bit32u firstFatSect = bootbuffer.reservedsectors + partSectOff;
+	for (Bit32u i = 0; i < dirtyFatSects.size(); i++) {
+		if (!dirtyFatSects[i]) continue;
+		for (int fc = 0; fc < bootbuffer.fatcopies; fc++)
+			writeSector(firstFatSect + i + (fc * bootbuffer.sectorsperfat),
+			            &fatSects[i * bytesPerSect]);
+		dirtyFatSects[i] = false;
 	}
 }
 
@@ -530,21 +648,46 @@ Bit8u fatDrive::readSector(Bit32u sectnum, void * data) {
 	return loadedDisk->Read_Sector(head, cylinder, sector, data);
 }
 
-Bit8u fatDrive::writeSector(Bit32u sectnum, void * data) {
+Bit8u fatDrive::readSectors(Bit32u sectnum, Bit32u count, void * data) {
 	// Guard
 	if (!loadedDisk) {
 		return 0;
 	}
 
 	if (absolute) {
-		return loadedDisk->Write_AbsoluteSector(sectnum, data);
+		return loadedDisk->Read_AbsoluteSectors(sectnum, count, data);
 	}
-	Bit32u cylindersize = bootbuffer.headcount * bootbuffer.sectorspertrack;
-	Bit32u cylinder = sectnum / cylindersize;
-	sectnum %= cylindersize;
-	Bit32u head = sectnum / bootbuffer.sectorspertrack;
-	Bit32u sector = sectnum % bootbuffer.sectorspertrack + 1L;
-	return loadedDisk->Write_Sector(head, cylinder, sector, data);
+	Bit8u *sectData = static_cast<Bit8u *>(data);
+	Bit8u result = 0;
+	for (Bit32u i = 0; i < count; i++) {
+		const Bit8u sectResult = readSector(sectnum + i, sectData);
+		if (sectResult) result = sectResult;
+		sectData += bootbuffer.bytespersector;
+	}
+	return result;
+}
+
+Bit8u fatDrive::writeSector(Bit32u sectnum, void * data) {
+	// Guard
+	if (!loadedDisk) {
+		return 0;
+	}
+
+	/* Only our own writes leave the cached FAT current */
+	const bool fatCurrent = fatLoaded && seenWriteCount == loadedDisk->write_count;
+	Bit8u result;
+	if (absolute) {
+		result = loadedDisk->Write_AbsoluteSector(sectnum, data);
+	} else {
+		Bit32u cylindersize = bootbuffer.headcount * bootbuffer.sectorspertrack;
+		Bit32u cylinder = sectnum / cylindersize;
+		sectnum %= cylindersize;
+		Bit32u head = sectnum / bootbuffer.sectorspertrack;
+		Bit32u sector = sectnum % bootbuffer.sectorspertrack + 1L;
+		result = loadedDisk->Write_Sector(head, cylinder, sector, data);
+	}
+	if (fatCurrent) seenWriteCount = loadedDisk->write_count;
+	return result;
 }
 
 Bit32u fatDrive::getSectorSize(void) {
@@ -643,9 +786,10 @@ void fatDrive::deleteClustChain(Bit32u startCluster, Bit32u bytePos) {
 	}
 }
 
-Bit32u fatDrive::appendCluster(Bit32u startCluster) {
+/* lastCluster, if known, spares walking the chain to find its end */
+Bit32u fatDrive::appendCluster(Bit32u startCluster, Bit32u lastCluster) {
 	Bit32u testvalue;
-	Bit32u currentClust = startCluster;
+	Bit32u currentClust = lastCluster ? lastCluster : startCluster;
 	bool isEOF = false;
 	
 	while(!isEOF) {
@@ -719,9 +863,7 @@ fatDrive::fatDrive(const char *sysFilename,
 	  partSectOff(0),
 	  firstDataSector(0),
 	  firstRootDirSect(0),
-	  cwdDirCluster(0),
-	  fatSectBuffer{0},
-	  curFatSect(0)
+	  cwdDirCluster(0)
 {
 	FILE *diskfile;
 	Bit32u filesize;
@@ -901,9 +1043,6 @@ fatDrive::fatDrive(const char *sysFilename,
 	/* There is no cluster 0, this means we are in the root directory */
 	cwdDirCluster = 0;
 
-	memset(fatSectBuffer,0,1024);
-	curFatSect = 0xffffffff;
-
 	safe_strcpy(info, "fatDrive ");
 	safe_strcat(info, sysFilename);
 }
@@ -916,7 +1055,6 @@ bool fatDrive::AllocationInfo(Bit16u *_bytes_sector, Bit8u *_sectors_cluster, Bi
 
 	Bit32u hs, cy, sect,sectsize;
 	Bit32u countFree = 0;
-	Bit32u i;
 
 	loadedDisk->Get_Geometry(&hs, &cy, &sect, &sectsize);
 	*_bytes_sector = (Bit16u)sectsize;
@@ -929,11 +1067,7 @@ bool fatDrive::AllocationInfo(Bit16u *_bytes_sector, Bit8u *_sectors_cluster, Bi
 		*_total_clusters = 65535;
 	}
 
-	for (i=0; i<CountOfClusters; i++) {
-		if (!getClusterValue(i + 2)) {
-			countFree++;
-		}
-	}
+	if (loadFat()) countFree = freeClusterCount;
 
 	if (countFree<65536) {
 		*_free_clusters = (Bit16u)countFree;
@@ -945,18 +1079,30 @@ bool fatDrive::AllocationInfo(Bit16u *_bytes_sector, Bit8u *_sectors_cluster, Bi
 }
 
 Bit32u fatDrive::getFirstFreeClust(void) {
-	Bit32u i;
-	for(i=0;i<CountOfClusters;i++) {
-		if(!getClusterValue(i+2)) return (i+2);
+	if (!loadFat()) return 0;
+	for (Bit32u w = firstFreeHint / 64; w < freeClusters.size(); w++) {
+		const uint64_t word = freeClusters[w];
+		if (!word) continue;
+		Bit32u index = w * 64;
+		while (!(word & (uint64_t(1) << (index % 64)))) index++;
+		firstFreeHint = index;
+		return index + 2;
 	}
 
 	/* No free cluster found */
+	firstFreeHint = CountOfClusters;
 	return 0;
 }
 
 bool fatDrive::isRemote(void) {	return false; }
 bool fatDrive::isRemovable(void) { return false; }
 
+fatDrive::~fatDrive() {
+	flushFat();
+	/* The disk may live on for BIOS access, but its changes are done */
+	if (loadedDisk) loadedDisk->Flush();
+}
+
 Bits fatDrive::UnMount(void) {
 	delete this;
 	return 0;
@@ -996,6 +1142,7 @@ bool fatDrive::FileCreate(std::unique_ptr<DOS_File> &file, const char *name, Bit
 		/* Check if file exists now */
 		if(!getFileDirEntry(name, &fileEntry, &dirClust, &subEntry)) return false;
 	}
+	commitChanges();
 
 	/* Empty file created, now lets open it */
 	/* TODO: check for read-only flag and requested write access */
@@ -1066,6 +1213,7 @@ bool fatDrive::FileUnlink(char * name) {
 	directoryChange(dirClust, &fileEntry, subEntry);
 
 	if(fileEntry.loFirstClust != 0) deleteClustChain(fileEntry.loFirstClust, 0);
+	commitChanges();
 
 	return true;
 }
@@ -1427,6 +1575,7 @@ bool fatDrive::MakeDir(char *dir) {
 	tmpentry.hiFirstClust = (Bit16u)(dirClust >> 16);
 	tmpentry.attrib = DOS_ATTR_DIRECTORY;
 	addDirectoryEntry(dummyClust, tmpentry);
+	commitChanges();
 
 	return true;
 }
@@ -1473,6 +1622,7 @@ bool fatDrive::RemoveDir(char *dir) {
 			tmpentry.entryname[0] = 0xe5;
 			directoryChange(dirClust, &tmpentry, fileidx);
 			deleteClustChain(dummyClust, 0);
+			commitChanges();
 
 			break;
 		}
@@ -1515,6 +1665,7 @@ bool fatDrive::Rename(char * oldname, char * newname) {
 		/* Remove old entry */
 		fileEntry1.entryname[0] = 0xe5;
 		directoryChange(dirClust1, &fileEntry1, subEntry1);
+		commitChanges();
 
 		return true;
 	}
@@ -18,6 +18,7 @@
 
 #include "drives.h"
 
+#include <algorithm>
 #include <cctype>
 #include <cstring>
 
@@ -71,41 +72,37 @@ bool isoFile::Read(Bit8u *data, Bit16u *size) {
 	if (filePos + *size > fileEnd)
 		*size = (Bit16u)(fileEnd - filePos);
 
+	static_assert(ISO_FRAMESIZE <= UINT16_MAX, "");
 	uint16_t nowSize = 0;
-	uint32_t sector = filePos / ISO_FRAMESIZE;
-
-	if (static_cast<int>(sector) != cachedSector) {
-		if (drive->readSector(buffer, sector)) {
-			cachedSector = static_cast<int>(sector);
-		} else {
-			*size = 0;
-			cachedSector = -1;
+	while (nowSize < *size) {
+		const uint32_t sector = filePos / ISO_FRAMESIZE;
+		const auto sectorPos = static_cast<uint16_t>(filePos % ISO_FRAMESIZE);
+		const uint16_t remSize = *size - nowSize;
+
+		// Whole sectors go straight into the caller's buffer
+		if (sectorPos == 0 && remSize >= ISO_FRAMESIZE) {
+			const uint16_t count = remSize / ISO_FRAMESIZE;
+			if (!drive->readSectors(&data[nowSize], sector, count))
+				break;
+			nowSize += count * ISO_FRAMESIZE;
+			filePos += count * ISO_FRAMESIZE;
+			continue;
 		}
-	}
-
-	static_assert(ISO_FRAMESIZE <= UINT16_MAX, "");
-	auto sectorPos = static_cast<uint16_t>(filePos % ISO_FRAMESIZE);
 
-	while (nowSize < *size) {
-		Bit16u remSector = ISO_FRAMESIZE - sectorPos;
-		Bit16u remSize = *size - nowSize;
-		if(remSector < remSize) {
-			memcpy(&data[nowSize], &buffer[sectorPos], remSector);
-			nowSize += remSector;
-			sectorPos = 0;
-			sector++;
-			cachedSector++;
+		if (static_cast<int>(sector) != cachedSector) {
 			if (!drive->readSector(buffer, sector)) {
-				*size = nowSize;
 				cachedSector = -1;
+				break;
 			}
-		} else {
-			memcpy(&data[nowSize], &buffer[sectorPos], remSize);
-			nowSize += remSize;
+			cachedSector = static_cast<int>(sector);
 		}
+		const auto remSector = static_cast<uint16_t>(ISO_FRAMESIZE - sectorPos);
+		const uint16_t chunk = std::min(remSector, remSize);
+		memcpy(&data[nowSize], &buffer[sectorPos], chunk);
+		nowSize += chunk;
+		filePos += chunk;
 	}
 	*size = nowSize;
-	filePos += *size;
 	return true;
 }
 
@@ -479,6 +476,12 @@ inline bool isoDrive :: readSector(Bit8u *buffer, Bit32u sector) {
 	return CDROM_Interface_Image::images[subUnit]->ReadSector(buffer, false, sector);
 }
 
+bool isoDrive::readSectors(uint8_t *buffer, uint32_t sector, uint16_t num)
+{
+	return CDROM_Interface_Image::images[subUnit]->ReadSectorsHost(buffer, false,
+	                                                               sector, num);
+}
+
 int isoDrive :: readDirEntry(isoDirEntry *de, Bit8u *data) {
 	// copy data into isoDirEntry struct, data[0] = length of DirEntry
 //	if (data[0] > sizeof(isoDirEntry)) return -1;//check disabled as isoDirentry is currently 258 bytes large. So it always fits
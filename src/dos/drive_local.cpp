@@ -39,6 +39,7 @@
 #include <utime.h>
 #endif
 
+#include "control.h"
 #include "dos_inc.h"
 #include "dos_mscdex.h"
 #include "fs_utils.h"
@@ -46,6 +47,14 @@
 #include "cross.h"
 #include "inout.h"
 
+static bool use_host_cache()
+{
+	const auto section = static_cast<Section_prop *>(control->GetSection("dos"));
+	return !section || section->Get_bool("host_cache");
+}
+
+DOS_File *FindOpenFile(const DOS_Drive *drive, const char *name);
+
 bool localDrive::FileCreate(std::unique_ptr<DOS_File> &file, const char * name,Bit16u /*attributes*/) {
 //TODO Maybe care for attributes but not likely
 	char newname[CROSS_LEN];
@@ -63,16 +72,26 @@ bool localDrive::FileCreate(std::unique_ptr<DOS_File> &file, const char * name,B
 
 	}
 	
+	// A handle still open on the file must see it cut, and then see the
+	// writes through the new one
+	auto open_file = dynamic_cast<localFile *>(FindOpenFile(this, name));
+	if (open_file)
+		open_file->DisableCache();
+
 	FILE * hand = fopen_wrap(temp_name,"wb+");
 	if (!hand) {
 		LOG_MSG("Warning: file creation failed: %s",newname);
 		return false;
 	}
+	HostStatCache::MarkStale();
    
 	if (!existing_file) dirCache.AddEntry(newname, true);
 	/* Make the 16 bit device information */
-	file = std::make_unique<localFile>(name, hand, basedir);
-	file->flags=OPEN_READWRITE;
+	auto local_file = std::make_unique<localFile>(name, hand, basedir);
+	local_file->flags = OPEN_READWRITE;
+	if (open_file)
+		local_file->DisableCache();
+	file = std::move(local_file);
 
 	return true;
 }
@@ -111,6 +130,7 @@ DOS_File *FindOpenFile(const DOS_Drive *drive, const char *name)
 
 bool localDrive::FileOpen(std::unique_ptr<DOS_File> &file, const char *name, Bit32u flags)
 {
+	SyncHostChanges();
 	const char *type = nullptr;
 	switch (flags&0xf) {
 	case OPEN_READ:        type = "rb" ; break;
@@ -190,8 +210,14 @@ bool localDrive::FileOpen(std::unique_ptr<DOS_File> &file, const char *name, Bit
 #endif
 
 	if (fhandle) {
-		file = std::make_unique<localFile>(name, fhandle, basedir);
-		file->flags = flags;  // for the inheritance flag and maybe check for others.
+		auto local_file = std::make_unique<localFile>(name, fhandle, basedir);
+		local_file->flags = flags;  // for the inheritance flag and maybe check for others.
+		// Handles to the same file would miss each other's cached writes
+		if (open_file) {
+			open_file->DisableCache();
+			local_file->DisableCache();
+		}
+		file = std::move(local_file);
 	} else {
 		// Otherwise we really can't open the file.
 		DOS_SetError(DOSERR_INVALID_HANDLE);
@@ -236,6 +262,7 @@ bool localDrive::FileUnlink(char * name) {
 
 	// Can we remove the file without issue?
 	if (remove(fullname) == 0) {
+		HostStatCache::MarkStale();
 		dirCache.DeleteEntry(newname);
 		return true;
 	}
@@ -253,6 +280,7 @@ bool localDrive::FileUnlink(char * name) {
 		}
 		// and try removing it again.
 		if (remove(fullname) == 0) {
+			HostStatCache::MarkStale();
 			dirCache.DeleteEntry(newname);
 			return true;
 		}
@@ -276,6 +304,10 @@ bool localDrive::FindFirst(char * _dir,DOS_DTA & dta,bool fcb_findfirst) {
 	if (tempDir[strlen(tempDir) - 1] != CROSS_FILESPLIT)
 		safe_strcat(tempDir, end);
 
+	// Watch the directory before its listing is read, so no change is missed
+	SyncHostChanges();
+	host_cache.Watch(dirCache.GetExpandName(tempDir));
+
 	Bit16u id;
 	if (!dirCache.FindFirst(tempDir,id)) {
 		DOS_SetError(DOSERR_PATH_NOT_FOUND);
@@ -343,7 +375,7 @@ again:
 	//and due to its design dir_ent might be lost.)
 	//Copying dir_ent first
 	safe_strcpy(dir_entcopy, dir_ent);
-	if (stat(dirCache.GetExpandName(full_name),&stat_block)!=0) { 
+	if (!host_cache.Stat(dirCache.GetExpandName(full_name), stat_block)) {
 		goto again;//No symlinks and such
 	}	
 
@@ -380,10 +412,11 @@ bool localDrive::GetFileAttr(char * name,Bit16u * attr) {
 	safe_strcpy(newname, basedir);
 	safe_strcat(newname, name);
 	CROSS_FILENAME(newname);
+	SyncHostChanges();
 	dirCache.ExpandName(newname);
 
 	struct stat status;
-	if (stat(newname,&status)==0) {
+	if (host_cache.Stat(newname, status)) {
 		*attr=DOS_ATTR_ARCHIVE;
 		if (status.st_mode & S_IFDIR) *attr|=DOS_ATTR_DIRECTORY;
 		return true;
@@ -398,8 +431,10 @@ bool localDrive::MakeDir(char * dir) {
 	safe_strcat(newdir, dir);
 	CROSS_FILENAME(newdir);
 	const int temp = create_dir(dirCache.GetExpandName(newdir), 0775);
-	if (temp == 0)
+	if (temp == 0) {
+		HostStatCache::MarkStale();
 		dirCache.CacheOut(newdir, true);
+	}
 	return (temp==0);// || ((temp!=0) && (errno==EEXIST));
 }
 
@@ -409,7 +444,10 @@ bool localDrive::RemoveDir(char * dir) {
 	safe_strcat(newdir, dir);
 	CROSS_FILENAME(newdir);
 	int temp=rmdir(dirCache.GetExpandName(newdir));
-	if (temp==0) dirCache.DeleteEntry(newdir,true);
+	if (temp==0) {
+		HostStatCache::MarkStale();
+		dirCache.DeleteEntry(newdir,true);
+	}
 	return (temp==0);
 }
 
@@ -418,13 +456,14 @@ bool localDrive::TestDir(char * dir) {
 	safe_strcpy(newdir, basedir);
 	safe_strcat(newdir, dir);
 	CROSS_FILENAME(newdir);
+	SyncHostChanges();
 	dirCache.ExpandName(newdir);
 	// Skip directory test, if "\"
 	size_t len = safe_strlen(newdir);
 	if (len && (newdir[len-1]!='\\')) {
 		// It has to be a directory !
 		struct stat test;
-		if (stat(newdir,&test))			return false;
+		if (!host_cache.Stat(newdir, test))	return false;
 		if ((test.st_mode & S_IFDIR)==0)	return false;
 	};
 	return path_exists(newdir);
@@ -442,7 +481,10 @@ bool localDrive::Rename(char * oldname,char * newname) {
 	safe_strcat(newnew, newname);
 	CROSS_FILENAME(newnew);
 	int temp=rename(newold,dirCache.GetExpandName(newnew));
-	if (temp==0) dirCache.CacheOut(newnew);
+	if (temp==0) {
+		HostStatCache::MarkStale();
+		dirCache.CacheOut(newnew);
+	}
 	return (temp==0);
 
 }
@@ -460,9 +502,10 @@ bool localDrive::FileExists(const char* name) {
 	safe_strcpy(newname, basedir);
 	safe_strcat(newname, name);
 	CROSS_FILENAME(newname);
+	SyncHostChanges();
 	dirCache.ExpandName(newname);
 	struct stat temp_stat;
-	if (stat(newname,&temp_stat)!=0) return false;
+	if (!host_cache.Stat(newname, temp_stat)) return false;
 	if (temp_stat.st_mode & S_IFDIR) return false;
 	return true;
 }
@@ -472,9 +515,14 @@ bool localDrive::FileStat(const char* name, FileStat_Block * const stat_block) {
 	safe_strcpy(newname, basedir);
 	safe_strcat(newname, name);
 	CROSS_FILENAME(newname);
+	SyncHostChanges();
 	dirCache.ExpandName(newname);
+	// An open handle may still hold some of the file's size
+	auto open_file = dynamic_cast<localFile *>(FindOpenFile(this, name));
+	if (open_file)
+		open_file->Flush();
 	struct stat temp_stat;
-	if (stat(newname,&temp_stat)!=0) return false;
+	if (!host_cache.Stat(newname, temp_stat)) return false;
 	/* Convert the stat to a FileStat */
 	struct tm datetime;
 	if (cross::localtime_r(&temp_stat.st_mtime, &datetime)) {
@@ -487,6 +535,21 @@ bool localDrive::FileStat(const char* name, FileStat_Block * const stat_block) {
 	return true;
 }
 
+void localDrive::SyncHostChanges()
+{
+	for (const auto &change : host_cache.TakeChanges()) {
+		switch (change.type) {
+		case HostChange::Type::Added:
+			dirCache.AddHostEntry(change.dir.c_str(),
+			                      change.name.c_str(), change.is_dir);
+			break;
+		case HostChange::Type::Removed:
+			dirCache.RemoveHostEntry(change.dir.c_str(), change.name.c_str());
+			break;
+		case HostChange::Type::Lost: EmptyCache(); break;
+		}
+	}
+}
 
 Bit8u localDrive::GetMediaByte(void) {
 	return allocation.mediaid;
@@ -511,7 +574,8 @@ localDrive::localDrive(const char * startdir,
                        Bit16u _total_clusters,
                        Bit16u _free_clusters,
                        Bit8u _mediaid)
-	: write_protected_files{},
+	: host_cache(use_host_cache()),
+	  write_protected_files{},
 	  allocation{_bytes_sector,
 	             _sectors_cluster,
 	             _total_clusters,
@@ -521,43 +585,9 @@ localDrive::localDrive(const char * startdir,
 	safe_strcpy(basedir, startdir);
 	sprintf(info,"local directory %s",startdir);
 	dirCache.SetBaseDir(basedir);
+	host_cache.SetRoot(basedir);
 }
 
-// Updates the internal file's current position
-bool localFile::ftell_and_check()
-{
-	if (!fhandle)
-		return false;
-
-	stream_pos = ftell(fhandle);
-	if (stream_pos >= 0)
-		return true;
-
-	DEBUG_LOG_MSG("FS: Failed obtaining position in file %s", name.c_str());
-	return false;
-}
-
-// Seeks the internal file to the specified position relative to whence
-bool localFile::fseek_to_and_check(long pos, int whence)
-{
-	if (!fhandle)
-		return false;
-
-	if (fseek(fhandle, pos, whence) == 0) {
-		stream_pos = pos;
-		return true;
-	}
-	DEBUG_LOG_MSG("FS: Failed seeking to byte %ld in file %s", stream_pos, name.c_str());
-	return false;
-}
-
-// Seeks the internal file to the internal position relative to whence
-void localFile::fseek_and_check(int whence)
-{
-	static_cast<void>(fseek_to_and_check(stream_pos, whence));
-}
-
-//TODO Maybe use fflush, but that seemed to fuck up in visual c
 bool localFile::Read(uint8_t *data, uint16_t *size)
 {
 	// check if the file is opened in write-only mode
@@ -566,20 +596,11 @@ bool localFile::Read(uint8_t *data, uint16_t *size)
 		return false;
 	}
 
-	// Seek if we last wrote
-	if (last_action == WRITE)
-		if (ftell_and_check())
-			fseek_and_check(SEEK_SET);
-
-	last_action = READ;
-	const auto requested = *size;
-	const auto actual = static_cast<uint16_t>(fread(data, 1, requested, fhandle));
+	const auto actual = static_cast<uint16_t>(
+	        cache.Read(fhandle, stream_pos, data, *size));
+	stream_pos += actual;
 	*size = actual; // always save the actual
 
-	// if (actual != requested)
-	//	DEBUG_LOG_MSG("FS: Only read %u of %u requested bytes from file %s",
-	//	              actual, requested, name.c_str());
-
 	/* Fake harddrive motion. Inspector Gadget with soundblaster compatible */
 	/* Same for Igor */
 	/* hardrive motion => unmask irq 2. Only do it when it's masked as
@@ -598,90 +619,79 @@ bool localFile::Write(uint8_t *data, uint16_t *size)
 		return false;
 	}
 
-	// Seek if we last read
-	if (last_action == READ)
-		if (ftell_and_check())
-			fseek_and_check(SEEK_SET);
-
-	last_action = WRITE;
-
 	// Truncate the file
 	if (*size == 0) {
-		const auto file = cross_fileno(fhandle);
-		if (file == -1) {
-			DEBUG_LOG_MSG("FS: Could not resolve file number for %s", name.c_str());
-			return false;
-		}
-		if (!ftell_and_check()) {
-			return false;
-		}
-		if (ftruncate(file, stream_pos) != 0) {
+		if (!cache.Truncate(fhandle, stream_pos)) {
 			DEBUG_LOG_MSG("FS: Failed truncating file %s", name.c_str());
 			return false;
 		}
+		HostStatCache::MarkStale();
 		// Truncation succeeded if we made it here
 		return true;
 	}
 
 	// Otherwise we have some data to write
 	const auto requested = *size;
-	const auto actual = static_cast<uint16_t>(fwrite(data, 1, requested, fhandle));
+	const auto actual = static_cast<uint16_t>(
+	        cache.Write(fhandle, stream_pos, data, requested));
 	if (actual != requested)
 		DEBUG_LOG_MSG("FS: Only wrote %u of %u requested bytes to file %s",
 		              actual, requested, name.c_str());
+	stream_pos += actual;
 	*size = actual; // always save the actual
+	if (!cache.IsEnabled())
+		HostStatCache::MarkStale();
 	return true;    // always return true, even if partially written
 }
 
 bool localFile::Seek(uint32_t *pos_addr, uint32_t type)
 {
-	int seektype;
+	// The inbound position is actually an int32_t being passed through a
+	// uint32_t* pointer (pos_addr), so reinterpret the underlying memory as
+	// such to prevent rollover into the unsigned range.
+	const auto pos = *reinterpret_cast<int32_t *>(pos_addr);
+
+	int64_t seek_to = 0;
 	switch (type) {
-	case DOS_SEEK_SET:seektype=SEEK_SET;break;
-	case DOS_SEEK_CUR:seektype=SEEK_CUR;break;
-	case DOS_SEEK_END:seektype=SEEK_END;break;
+	case DOS_SEEK_SET: seek_to = pos; break;
+	case DOS_SEEK_CUR: seek_to = int64_t{stream_pos} + pos; break;
+	case DOS_SEEK_END: seek_to = int64_t{cache.RefreshSize(fhandle)} + pos; break;
 	default:
 	//TODO Give some doserrorcode;
 		return false;//ERROR
 	}
 
-	// The inbound position is actually an int32_t being passed through a
-	// uint32_t* pointer (pos_addr), so reinterpret the underlying memory as
-	// such to prevent rollover into the unsigned range.
-	const auto pos = *reinterpret_cast<int32_t *>(pos_addr);
-	if (!fseek_to_and_check(pos, seektype)) {
-		// Failed to seek, but try again this time seeking to
-		// the end of file, which satisfies Black Thorne.
-		stream_pos = 0;
-		fseek_and_check(SEEK_END);
-	}
-#if 0
-	fpos_t temppos;
-	fgetpos(fhandle,&temppos);
-	Bit32u * fake_pos=(Bit32u*)&temppos;
-	*pos_addr = *fake_pos;
-#endif
-	static_cast<void>(ftell_and_check());
+	// A seek before the start fails on the host, so seek to the end of
+	// the file instead, which satisfies Black Thorne.
+	if (seek_to < 0 || seek_to > std::numeric_limits<int32_t>::max())
+		seek_to = cache.RefreshSize(fhandle);
+	stream_pos = static_cast<uint32_t>(seek_to);
 
 	// The inbound position is actually an int32_t being passed through a
 	// uint32_t* pointer (pos_addr), so before we save the seeked position
-	// back into it we first ensure the current long stream_pos (which is a
-	// signed 64-bit on some platforms + OSes) can fit within the int32_t
-	// range before assigning it.
-	assert(stream_pos >= std::numeric_limits<int32_t>::min() &&
-	       stream_pos <= std::numeric_limits<int32_t>::max());
+	// back into it we first ensure the stream_pos can fit within the
+	// int32_t range before assigning it.
+	assert(stream_pos <= static_cast<uint32_t>(std::numeric_limits<int32_t>::max()));
 	*reinterpret_cast<int32_t *>(pos_addr) = static_cast<int32_t>(stream_pos);
-
-	last_action = NONE;
 	return true;
 }
 
 bool localFile::Close() {
 	// only close if one reference left
 	if (refCtr==1) {
-		if (fhandle) fclose(fhandle);
+		if (fhandle) {
+			Flush();
+			const auto &stats = cache.GetStats();
+			if (stats.reads)
+				LOG(LOG_FILES, LOG_NORMAL)("FS: %u of %u reads from %s hit the cache",
+				                           stats.read_hits, stats.reads, name.c_str());
+			// Changes that couldn't be written can't follow the handle
+			cache.Disable(fhandle);
+			fclose(fhandle);
+		}
 		fhandle = 0;
 		open = false;
+		HostStatCache::MarkStale();
 	};
 
 	if (newtime) {
@@ -711,6 +721,7 @@ bool localFile::Close() {
 		if (utime(fullname, &ftim)) {
 			return false;
 		}
+		HostStatCache::MarkStale();
 	}
 
 	return true;
@@ -724,7 +735,7 @@ localFile::localFile(const char *_name, FILE *handle, const char *_basedir)
         : fhandle(handle),
           basedir(_basedir),
           read_only_medium(false),
-          last_action(NONE)
+          cache(handle)
 {
 	open=true;
 	UpdateDateTimeFromHost();
@@ -734,6 +745,16 @@ localFile::localFile(const char *_name, FILE *handle, const char *_basedir)
 	SetName(_name);
 }
 
+// Files left open, as at shutdown, still write back their changes
+localFile::~localFile()
+{
+	if (fhandle) {
+		Flush();
+		cache.Disable(fhandle);
+		fclose(fhandle);
+	}
+}
+
 bool localFile::UpdateDateTimeFromHost()
 {
 	if (!open)
@@ -762,14 +783,11 @@ bool localFile::UpdateDateTimeFromHost()
 
 void localFile::Flush()
 {
-	if (last_action != WRITE)
-		return;
-
-	if (ftell_and_check())
-		fseek_and_check(SEEK_SET);
-
-	// Always reset the state even if the file is broken
-	last_action = NONE;
+	const bool changed = cache.IsDirty();
+	if (!cache.Flush(fhandle))
+		LOG_MSG("FS: Failed writing to file %s", name.c_str());
+	if (changed)
+		HostStatCache::MarkStale();
 }
 
 // ********************************************
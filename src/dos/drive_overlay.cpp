@@ -297,6 +297,7 @@ static std::unique_ptr<OverlayFile> ccc(localFile &file) {
 	                                   file.GetBaseDir());
 	ret->flags = file.flags;
 	ret->refCtr = file.refCtr;
+	file.fhandle = nullptr; // the handle belongs to the overlayFile now
 	return ret;
 }
 
@@ -417,6 +418,8 @@ bool Overlay_Drive::FileOpen(std::unique_ptr<DOS_File> &file, const char *name,
 	}
 
 	//Flush the buffer of handles for the same file. (Betrayal in Antara)
+	//Their caches are dropped too, so the handles see each other's writes.
+	bool shared = false;
 	uint8_t drive = DOS_DRIVES;
 	for (uint8_t i = 0; i < DOS_DRIVES; ++i) {
 		if (Drives[i].get() == this) {
@@ -427,7 +430,10 @@ bool Overlay_Drive::FileOpen(std::unique_ptr<DOS_File> &file, const char *name,
 	for (uint8_t i = 0; i < DOS_FILES; ++i) {
 		if (Files[i] && Files[i]->IsOpen() && Files[i]->GetDrive()==drive && Files[i]->IsName(name)) {
 			localFile *lfp = dynamic_cast<localFile *>(Files[i].get());
-			if (lfp) lfp->Flush();
+			if (lfp) {
+				lfp->DisableCache();
+				shared = true;
+			}
 		}
 	}
 
@@ -464,6 +470,7 @@ bool Overlay_Drive::FileOpen(std::unique_ptr<DOS_File> &file, const char *name,
 		auto f = ccc(*local_file);
 		f->flags = flags; //ccc copies the flags of the localfile, which were not correct in this case
 		f->overlay_active = overlayed; //No need to switch if already in overlayed.
+		if (shared) f->DisableCache();
 		file = std::move(f);
 	}
 	return fileopened;
@@ -1221,3 +1228,10 @@ void Overlay_Drive::EmptyCache(void){
 	update_cache(true);//lets rebuild it.
 }
 
+// The listing here also holds the overlay, which update_cache() keeps in step,
+// so the host's changes only reach it through a rescan
+void Overlay_Drive::SyncHostChanges()
+{
+	host_cache.TakeChanges();
+}
+
@@ -0,0 +1,136 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_FAT_CLUSTER_MAP_H
+#define DOSBOX_FAT_CLUSTER_MAP_H
+
+#include "dosbox.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+/* The clusters of an open FAT file found so far, in runs of consecutive ones,
+   so neither seeking nor reading has to walk the chain again.
+
+   The chain is followed lazily through a nextCluster(clust) callable, which
+   returns 0 at its end. The map starts over when the drive's FAT generation
+   moves on, which only happens on changes that can take clusters out of a
+   chain: see invalidates(). Allocating free clusters and linking them onto
+   the end of a chain leave the maps alone, so a file being written doesn't
+   make the other open files walk their chains again; a chain found to have
+   grown is followed on from its last mapped cluster. */
+class FatClusterMap {
+public:
+	/* Tells if setting a FAT entry that held oldValue, the end of a chain
+	   when oldIsEnd, to newValue may change chains that were mapped */
+	static bool invalidates(Bit32u oldValue, Bit32u newValue, bool oldIsEnd)
+	{
+		if (oldValue == 0) return false;             // allocated
+		if (oldIsEnd && newValue != 0) return false; // chain extended
+		return oldValue != newValue;
+	}
+
+	/* Returns the disk cluster holding the file's cluster fileClust, or 0
+	   past the end of the chain. runClusts tells how many clusters follow
+	   it on the disk in one run, including itself. */
+	template <typename NextCluster>
+	Bit32u find(Bit32u firstCluster, Bit32u generation, Bit32u fileClust,
+	            NextCluster nextCluster, Bit32u *runClusts = nullptr)
+	{
+		if (!map(firstCluster, generation, fileClust, nextCluster)) return 0;
+
+		const auto inRun = [fileClust](const ClusterRun &run) {
+			return fileClust >= run.fileClust &&
+			       fileClust < run.fileClust + run.count;
+		};
+		if (!inRun(runs[lastRun])) {
+			if (lastRun + 1 < runs.size() && inRun(runs[lastRun + 1])) {
+				lastRun++;
+			} else {
+				const auto next = std::upper_bound(runs.begin(), runs.end(), fileClust,
+				                                   [](Bit32u clust, const ClusterRun &run) {
+					                                   return clust < run.fileClust;
+				                                   });
+				lastRun = (size_t)(next - runs.begin()) - 1;
+			}
+		}
+		const ClusterRun &run = runs[lastRun];
+		if (runClusts) *runClusts = run.count - (fileClust - run.fileClust);
+		return run.firstClust + (fileClust - run.fileClust);
+	}
+
+	/* Returns the last cluster of the chain, or 0 if it has none */
+	template <typename NextCluster>
+	Bit32u lastCluster(Bit32u firstCluster, Bit32u generation, NextCluster nextCluster)
+	{
+		map(firstCluster, generation, UINT32_MAX, nextCluster);
+		return runs.empty() ? 0 : runs.back().firstClust + runs.back().count - 1;
+	}
+
+	/* Records a cluster that was just linked after lastCluster() */
+	void append(Bit32u clust)
+	{
+		if (!runs.empty() && runs.back().firstClust + runs.back().count == clust) {
+			runs.back().count++;
+		} else {
+			runs.push_back({mappedClusts, clust, 1});
+		}
+		mappedClusts++;
+	}
+
+private:
+	/* Follows the chain until the file's cluster number fileClust is
+	   mapped, returning false if the chain ends before it */
+	template <typename NextCluster>
+	bool map(Bit32u firstCluster, Bit32u generation, Bit32u fileClust,
+	         NextCluster nextCluster)
+	{
+		if (mapGeneration != generation || mappedFrom != firstCluster) {
+			runs.clear();
+			lastRun = 0;
+			mappedClusts = 0;
+			mappedFrom = firstCluster;
+			mapGeneration = generation;
+		}
+		while (fileClust >= mappedClusts) {
+			if (firstCluster == 0) return false;
+			const Bit32u nextClust = runs.empty()
+			        ? firstCluster
+			        : nextCluster(runs.back().firstClust + runs.back().count - 1);
+			if (nextClust == 0) return false;
+			append(nextClust);
+		}
+		return true;
+	}
+
+	struct ClusterRun {
+		Bit32u fileClust; // of its first cluster, counted within the file
+		Bit32u firstClust;
+		Bit32u count;
+	};
+	std::vector<ClusterRun> runs = {};
+	size_t lastRun = 0;       // the one used last, most likely used next
+	Bit32u mappedClusts = 0;
+	Bit32u mappedFrom = 0;    // the first cluster the runs were found from
+	Bit32u mapGeneration = 0; // of the FAT, when the runs were found
+};
+
+#endif
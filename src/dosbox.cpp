@@ -28,7 +28,7 @@
 #include <limits>
 #include <unistd.h>
 
-#include <functional>
+#include <memory>
 
 #include "debug.h"
 #include "cpu.h"
@@ -52,6 +52,7 @@
 #include "pci_bus.h"
 #include "midi.h"
 #include "hardware.h"
+#include "tick_pacer.h"
 
 #if C_NE2000
 //#include "ne2000.h"
@@ -136,12 +137,10 @@ void INT10_Init(Section*);
 
 static LoopHandler * loop;
 
-static std::function<void(int)> delay_fn = Delay;
+static std::unique_ptr<TickPacer> tick_pacer = {};
+static bool log_pacing_stats = false;
+static int64_t pacing_stats_start = 0;
 static int ticksRemain;
-static int64_t ticksLast;
-static int ticksAdded;
-int ticksDone;
-int ticksScheduled;
 bool ticksLocked;
 void increaseticks();
 
@@ -172,152 +171,58 @@ static Bitu Normal_Loop(void) {
 	}
 }
 
+static void log_pacing_stats_every(const int milliseconds)
+{
+	if (GetTicksSince(pacing_stats_start) < milliseconds)
+		return;
+	pacing_stats_start = GetTicks();
+
+	const auto stats = tick_pacer->TakeStats();
+	LOG_MSG("PACING: %.0f cycles/ms, %.0f us wake-up slack, %.0f%% idle, %d overruns",
+	        stats.cycles_per_ms, stats.slack_us, stats.idle_percent,
+	        stats.overruns);
+}
+
 void increaseticks() { //Make it return ticksRemain and set it in the function above to remove the global variable.
+	// Cycles skipped by HLT and the I/O delay took no host time
+	tick_pacer->RemoveCycles(CPU_IODelayRemoved);
+	CPU_IODelayRemoved = 0;
+
 	if (GCC_UNLIKELY(ticksLocked)) { // For Fast Forward Mode
 		ticksRemain=5;
 		/* Reset any auto cycle guessing for this frame */
-		ticksLast = GetTicks();
-		ticksAdded = 0;
-		ticksDone = 0;
-		ticksScheduled = 0;
+		tick_pacer->Reset();
 		return;
 	}
 
-	static Bit32s lastsleepDone = -1;
-	static Bitu sleep1count = 0;
-
-	const auto ticksNew = GetTicks();
-	ticksScheduled += ticksAdded;
-	if (ticksNew <= ticksLast) { //lower should not be possible, only equal.
-		ticksAdded = 0;
-
-		if (!CPU_CycleAutoAdjust || CPU_SkipCycleAutoAdjust || sleep1count < 3) {
-			delay_fn(1);
-		} else {
-			/* Certain configurations always give an exact sleepingtime of 1, this causes problems due to the fact that
-			   dosbox keeps track of full blocks.
-			   This code introduces some randomness to the time slept, which improves stability on those configurations
-			 */
-			static const Bit32u sleeppattern[] = { 2, 2, 3, 2, 2, 4, 2 };
-			static Bit32u sleepindex = 0;
-			if (ticksDone != lastsleepDone) sleepindex = 0;
-			delay_fn(sleeppattern[sleepindex++]);
-			sleepindex %= sizeof(sleeppattern) / sizeof(sleeppattern[0]);
+	if (log_pacing_stats)
+		log_pacing_stats_every(5000);
+
+	// Is the system in auto cycle mode guessing? (It can be temporary disabled)
+	if (CPU_CycleAutoAdjust && !CPU_SkipCycleAutoAdjust) {
+		auto new_cmax = tick_pacer->TuneCycles(CPU_CycleMax, CPU_CyclePercUsed);
+		if (new_cmax != CPU_CycleMax) {
+			if (new_cmax < CPU_CYCLES_LOWER_LIMIT)
+				new_cmax = CPU_CYCLES_LOWER_LIMIT;
+			if (CPU_CycleLimit > 0) {
+				if (new_cmax > CPU_CycleLimit) new_cmax = CPU_CycleLimit;
+			} else if (new_cmax > 2000000) new_cmax = 2000000; //Hardcoded limit, if no limit was specified.
+			CPU_CycleMax = new_cmax;
 		}
-		auto timeslept = GetTicksSince(ticksNew);
-		// Count how many times in the current block (of 250 ms) the time slept was 1 ms
-		if (CPU_CycleAutoAdjust && !CPU_SkipCycleAutoAdjust && timeslept == 1) sleep1count++;
-		lastsleepDone = ticksDone;
-
-		// Update ticksDone with the time spent sleeping
-		ticksDone -= timeslept;
-		if (ticksDone < 0)
-			ticksDone = 0;
-		return; //0
-
-		// If we do work this tick and sleep till the next tick, then ticksDone is decreased,
-		// despite the fact that work was done as well in this tick. Maybe make it depend on an extra parameter.
-		// What do we know: ticksRemain = 0 (condition to enter this function)
-		// ticksNew = time before sleeping
-
-		// maybe keep track of sleeped time in this frame, and use sleeped and done as indicators. (and take care of the fact there
-		// are frames that have both.
+	} else {
+		tick_pacer->ResetTuning();
 	}
 
-	//TicksNew > ticksLast
-	ticksRemain = GetTicksDiff(ticksNew, ticksLast);
-	ticksLast = ticksNew;
-	ticksDone += ticksRemain;
-	if ( ticksRemain > 20 ) {
-//		LOG(LOG_MISC,LOG_ERROR)("large remain %d",ticksRemain);
-		ticksRemain = 20;
-	}
-	ticksAdded = ticksRemain;
-
-	// Is the system in auto cycle mode guessing ? If not just exit. (It can be temporary disabled)
-	if (!CPU_CycleAutoAdjust || CPU_SkipCycleAutoAdjust) return;
-
-	if (ticksScheduled >= 250 || ticksDone >= 250 || (ticksAdded > 15 && ticksScheduled >= 5) ) {
-		if(ticksDone < 1) ticksDone = 1; // Protect against div by zero
-		/* ratio we are aiming for is around 90% usage*/
-		Bit32s ratio = (ticksScheduled * (CPU_CyclePercUsed*90*1024/100/100)) / ticksDone;
-		Bit32s new_cmax = CPU_CycleMax;
-		Bit64s cproc = (Bit64s)CPU_CycleMax * (Bit64s)ticksScheduled;
-		double ratioremoved = 0.0; //increase scope for logging
-		if (cproc > 0) {
-			/* ignore the cycles added due to the IO delay code in order
-			   to have smoother auto cycle adjustments */
-			ratioremoved = (double) CPU_IODelayRemoved / (double) cproc;
-			if (ratioremoved < 1.0) {
-				double ratio_not_removed = 1 - ratioremoved;
-				ratio = (Bit32s)((double)ratio * ratio_not_removed);
-
-				/* Don't allow very high ratio which can cause us to lock as we don't scale down
-				 * for very low ratios. High ratio might result because of timing resolution */
-				if (ticksScheduled >= 250 && ticksDone < 10 && ratio > 16384)
-					ratio = 16384;
-
-				// Limit the ratio even more when the cycles are already way above the realmode default.
-				if (ticksScheduled >= 250 && ticksDone < 10 && ratio > 5120 && CPU_CycleMax > 50000)
-					ratio = 5120;
-
-				// When downscaling multiple times in a row, ensure a minimum amount of downscaling
-				if (ticksAdded > 15 && ticksScheduled >= 5 && ticksScheduled <= 20 && ratio > 800)
-					ratio = 800;
-
-				if (ratio <= 1024) {
-					// ratio_not_removed = 1.0; //enabling this restores the old formula
-					double r = (1.0 + ratio_not_removed) /(ratio_not_removed + 1024.0/(static_cast<double>(ratio)));
-					new_cmax = 1 + static_cast<Bit32s>(CPU_CycleMax * r);
-				} else {
-					Bit64s ratio_with_removed = (Bit64s) ((((double)ratio - 1024.0) * ratio_not_removed) + 1024.0);
-					Bit64s cmax_scaled = (Bit64s)CPU_CycleMax * ratio_with_removed;
-					new_cmax = (Bit32s)(1 + (CPU_CycleMax >> 1) + cmax_scaled / (Bit64s)2048);
-				}
-			}
-		}
-
-		if (new_cmax < CPU_CYCLES_LOWER_LIMIT)
-			new_cmax = CPU_CYCLES_LOWER_LIMIT;
-		/*
-		LOG(LOG_MISC,LOG_ERROR)("cyclelog: current %06d   cmax %06d   ratio  %05d  done %03d   sched %03d Add %d rr %4.2f",
-			CPU_CycleMax,
-			new_cmax,
-			ratio,
-			ticksDone,
-			ticksScheduled,
-			ticksAdded,
-			ratioremoved);
-		*/
-
-		/* ratios below 1% are considered to be dropouts due to
-		   temporary load imbalance, the cycles adjusting is skipped */
-		if (ratio > 10) {
-			/* ratios below 12% along with a large time since the last update
-			   has taken place are most likely caused by heavy load through a
-			   different application, the cycles adjusting is skipped as well */
-			if ((ratio > 120) || (ticksDone < 700)) {
-				CPU_CycleMax = new_cmax;
-				if (CPU_CycleLimit > 0) {
-					if (CPU_CycleMax > CPU_CycleLimit) CPU_CycleMax = CPU_CycleLimit;
-				} else if (CPU_CycleMax > 2000000) CPU_CycleMax = 2000000; //Hardcoded limit, if no limit was specified.
-			}
-		}
+	ticksRemain = tick_pacer->TicksDue(CPU_CycleMax);
+	if (ticksRemain == 0)
+		tick_pacer->WaitForTick();
+}
 
-		//Reset cycleguessing parameters.
-		CPU_IODelayRemoved = 0;
-		ticksDone = 0;
-		ticksScheduled = 0;
-		lastsleepDone = -1;
-		sleep1count = 0;
-	} else if (ticksAdded > 15) {
-		/* ticksAdded > 15 but ticksScheduled < 5, lower the cycles
-		   but do not reset the scheduled/done ticks to take them into
-		   account during the next auto cycle adjustment */
-		CPU_CycleMax /= 3;
-		if (CPU_CycleMax < CPU_CYCLES_LOWER_LIMIT)
-			CPU_CycleMax = CPU_CYCLES_LOWER_LIMIT;
-	} //if (ticksScheduled >= 250 || ticksDone >= 250 || (ticksAdded > 15 && ticksScheduled >= 5) )
+void DOSBOX_ResetAutoCycles()
+{
+	CPU_IODelayRemoved = 0;
+	if (tick_pacer)
+		tick_pacer->ResetTuning();
 }
 
 void DOSBOX_SetLoop(LoopHandler * handler) {
@@ -359,10 +264,11 @@ static void DOSBOX_RealInit(Section * sec) {
 	Section_prop * section=static_cast<Section_prop *>(sec);
 	/* Initialize some dosbox internals */
 
-	delay_fn = CanDelayPrecise() ? DelayPrecise : Delay;
+	tick_pacer = std::make_unique<TickPacer>(section->Get_int("pacing_latency"));
+	log_pacing_stats = section->Get_bool("pacing_stats");
+	pacing_stats_start = GetTicks();
 
 	ticksRemain=0;
-	ticksLast=GetTicks();
 	ticksLocked = false;
 	DOSBOX_SetLoop(&Normal_Loop);
 	MSG_Init(section);
@@ -467,6 +373,31 @@ void DOSBOX_Init(void) {
 	pstring->Set_help(
 	        "Directory where things like wave, midi, screenshot get captured.");
 
+	pint = secprop->Add_int("png_compression", only_at_start, 9);
+	pint->SetMinMax(0, 9);
+	pint->Set_help(
+	        "Compression level of screenshots and frame dumps, from 0 (fastest) to\n"
+	        "9 (smallest files).");
+
+	pint = secprop->Add_int("frame_dump", only_at_start, 0);
+	pint->SetMinMax(0, 100000);
+	pint->Set_help(
+	        "Save every Nth rendered frame as frame_NNNNNN.png in the capture directory,\n"
+	        "numbered from the start of the run, e.g. to compare the output of two runs.\n"
+	        "Dumps from an earlier run get overwritten. 0 disables dumping.");
+
+	pint = secprop->Add_int("pacing_latency", only_at_start, 250);
+	pint->SetMinMax(0, 1000);
+	pint->Set_help(
+	        "How late, in microseconds, an emulated millisecond may start after it's due.\n"
+	        "Lower values keep timing tighter but spin the host CPU for longer while\n"
+	        "waiting. 1000 only sleeps, which suits busy or shared hosts best.");
+
+	Pbool = secprop->Add_bool("pacing_stats", only_at_start, false);
+	Pbool->Set_help(
+	        "Log the achieved cycles per millisecond, wake-up slack, idle share and\n"
+	        "overruns every five seconds.");
+
 #if C_DEBUG
 	LOG_StartUp();
 #endif
@@ -667,6 +598,14 @@ void DOSBOX_Init(void) {
 	Pbool->Set_help("Allow system audio driver to negotiate optimal rate and blocksize\n"
 	                "as close to the specified values as possible.");
 
+	Pint = secprop->Add_int("threads", only_at_start, 0);
+	Pint->SetMinMax(0, 16);
+	Pint->Set_help("Number of worker threads that render sound devices in parallel (0 renders\n"
+	               "every device on the emulation thread). Helps when several demanding\n"
+	               "devices play at once, at the cost of waking the workers every millisecond.\n"
+	               "Devices that raise interrupts or use DMA from their audio callback are\n"
+	               "always rendered on the emulation thread.");
+
 	secprop = control->AddSection_prop("midi", &MIDI_Init, true);
 	secprop->AddInitFunction(&MPU401_Init, true);
 
@@ -798,6 +737,10 @@ void DOSBOX_Init(void) {
 	        "Provider for the OPL emulation. 'compat' provides better quality,\n"
 	        "'nuked' is the default and most accurate (but the most CPU-intensive).");
 
+	Pbool = secprop->Add_bool("oplthread", when_idle, true);
+	Pbool->Set_help("Render the OPL on its own thread. Register writes are then applied at the\n"
+	                "exact sample they were made at, for about two milliseconds of extra latency.");
+
 	// Configure Gravis UltraSound emulation
 	GUS_AddConfigSection(control);
 
@@ -954,6 +897,17 @@ void DOSBOX_Init(void) {
 	Pbool = secprop->Add_bool("umb", when_idle, true);
 	Pbool->Set_help("Enable UMB support.");
 
+	Pbool = secprop->Add_bool("host_cache", when_idle, true);
+	Pbool->Set_help("Remember the files and directories of mounted host directories, and\n"
+	                "follow the changes other programs make to them as they happen\n"
+	                "(Linux only). Disable to look everything up on the host each time.");
+
+	Pint = secprop->Add_int("cdaudio_cache", when_idle, 1024);
+	Pint->SetMinMax(0, 100000);
+	Pint->Set_help("Megabytes of disk space for keeping decoded copies of the compressed\n"
+	               "audio tracks of mounted CD images (1024 by default), so playing and\n"
+	               "seeking them again doesn't need decoding. Set to 0 to disable.");
+
 	pstring = secprop->Add_string("ver", when_idle, "5.0");
 	pstring->Set_help("Set DOS version (5.0 by default). Specify as major.minor format.\n"
 	                  "A single number is treated as the major version.\n"
@@ -55,6 +55,9 @@ These are common options:
 
   -fullscreen         Start dosbox in fullscreen mode.
 
+  -headless           Run without a window or sound output, e.g. for batch
+                      jobs. Screenshots and captures still work.
+
   -lang <langfile>    Start dosbox with the language specified in
                       <langfile>.
 
@@ -115,6 +115,8 @@ static void RENDER_StartLineHandler(const void * s) {
 			if (GCC_UNLIKELY(src_val != cache[0])) {
 				if (!GFX_StartUpdate(render.scale.outWrite, render.scale.outPitch)) {
 					RENDER_DrawLine = RENDER_EmptyLineHandler;
+					// The VGA won't pass on these changes again
+					render.scale.clearCache = true;
 					return;
 				}
 				render.scale.outWrite += render.scale.outPitch * Scaler_ChangedLines[0];
@@ -165,6 +167,11 @@ bool RENDER_StartUpdate(void) {
 		return false;
 	}
 	render.frameskip.count=0;
+	if (render.headless && !(CaptureState & (CAPTURE_IMAGE|CAPTURE_VIDEO|CAPTURE_FRAMES))) {
+		// Nobody sees the frame, so the next captured one starts afresh
+		render.scale.clearCache = true;
+		return false;
+	}
 	if (render.scale.inMode == scalerMode8) {
 		Check_Palette();
 	}
@@ -193,7 +200,7 @@ bool RENDER_StartUpdate(void) {
 			render.fullFrame = true;
 		} else {
 			RENDER_DrawLine = RENDER_StartLineHandler;
-			if (GCC_UNLIKELY(CaptureState & (CAPTURE_IMAGE|CAPTURE_VIDEO))) 
+			if (GCC_UNLIKELY(CaptureState & (CAPTURE_IMAGE|CAPTURE_VIDEO|CAPTURE_FRAMES))) 
 				render.fullFrame = true;
 			else
 				render.fullFrame = false;
@@ -215,7 +222,7 @@ void RENDER_EndUpdate( bool abort ) {
 	if (GCC_UNLIKELY(!render.updating))
 		return;
 	RENDER_DrawLine = RENDER_EmptyLineHandler;
-	if (GCC_UNLIKELY(CaptureState & (CAPTURE_IMAGE|CAPTURE_VIDEO))) {
+	if (GCC_UNLIKELY(CaptureState & (CAPTURE_IMAGE|CAPTURE_VIDEO|CAPTURE_FRAMES))) {
 		Bitu pitch, flags;
 		flags = 0;
 		if (render.src.dblw != render.src.dblh) {
@@ -730,7 +737,9 @@ void RENDER_Init(Section * sec) {
 	render.scale.forced = false;
 	if(f == "forced") render.scale.forced = true;
    
-	const bool in_pixel_perfect_mode = (GFX_GetBestMode(0) & GFX_UNITY_SCALE);
+	const Bitu best_mode = GFX_GetBestMode(0);
+	const bool in_pixel_perfect_mode = (best_mode & GFX_UNITY_SCALE);
+	render.headless = (best_mode & GFX_HEADLESS);
 
 	if (scaler == "none" || in_pixel_perfect_mode) { render.scale.op = scalerOpNormal;render.scale.size = 1; }
 	else if (scaler == "normal2x") { render.scale.op = scalerOpNormal;render.scale.size = 2; }
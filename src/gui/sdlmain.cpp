@@ -31,6 +31,7 @@
 #include <stdarg.h>
 #include <sys/types.h>
 #include <tuple>
+#include <vector>
 #include <math.h>
 #ifdef WIN32
 #include <signal.h>
@@ -226,6 +227,7 @@ enum MouseControlType {
 enum SCREEN_TYPES	{
 	SCREEN_SURFACE,
 	SCREEN_TEXTURE,
+	SCREEN_HEADLESS,
 #if C_OPENGL
 	SCREEN_OPENGL
 #endif
@@ -263,6 +265,7 @@ struct SDL_Block {
 	bool update_display_contents = true;
 	bool resizing_window = false;
 	bool wait_on_error = false;
+	bool headless = false;
 	SCALING_MODE scaling_mode = SCALING_MODE::NONE;
 	struct {
 		int width = 0;
@@ -352,6 +355,8 @@ struct SDL_Block {
 		SDL_Texture *texture = nullptr;
 		SDL_PixelFormat *pixelFormat = nullptr;
 	} texture = {};
+	// Only allocated once a headless run captures a frame
+	std::vector<uint8_t> headless_frame = {};
 	struct {
 		int xsensitivity = 0;
 		int ysensitivity = 0;
@@ -633,6 +638,11 @@ check_surface:
 		flags|=GFX_SCALING;
 		flags&=~(GFX_CAN_8|GFX_CAN_15|GFX_CAN_16);
 		break;
+	case SCREEN_HEADLESS:
+		// Frames are only drawn to be captured, so skip the scalers
+		flags |= GFX_UNITY_SCALE | GFX_HEADLESS;
+		flags &= ~(GFX_CAN_8 | GFX_CAN_15 | GFX_CAN_16);
+		break;
 	default:
 		goto check_surface;
 		break;
@@ -1472,6 +1482,13 @@ dosurface:
 		break; // SCREEN_OPENGL
 	}
 #endif // C_OPENGL
+	case SCREEN_HEADLESS:
+		// Drop the old frame; GFX_StartUpdate() sizes a new one when
+		// something gets captured
+		sdl.headless_frame = {};
+		retFlags = GFX_CAN_32;
+		sdl.desktop.type = SCREEN_HEADLESS;
+		break;
 	}
 
 	if (retFlags)
@@ -1697,12 +1714,34 @@ bool GFX_StartUpdate(uint8_t * &pixels, int &pitch)
 		pitch = sdl.surface->pitch;
 		sdl.updating = true;
 		return true;
+	case SCREEN_HEADLESS:
+		pitch = sdl.draw.width * 4;
+		if (sdl.headless_frame.empty())
+			sdl.headless_frame.resize(static_cast<size_t>(pitch) * sdl.draw.height);
+		pixels = sdl.headless_frame.data();
+		sdl.updating = true;
+		return true;
 	}
 	return false;
 }
 
 static Pacer render_pacer("Render", 7000);
 
+// Calls update(y, height) for each run of changed lines. The renderer lists
+// them as alternating counts of unchanged and changed lines.
+template <typename Update>
+static void for_each_changed_run(const Bit16u *changedLines, const int height, Update &&update)
+{
+	int y = 0;
+	size_t index = 0;
+	while (y < height) {
+		if (index & 1)
+			update(y, changedLines[index]);
+		y += changedLines[index];
+		index++;
+	}
+}
+
 void GFX_EndUpdate(const Bit16u *changedLines)
 {
 	if (!sdl.update_display_contents)
@@ -1718,12 +1757,24 @@ void GFX_EndUpdate(const Bit16u *changedLines)
 	sdl.updating = false;
 	switch (sdl.desktop.type) {
 	case SCREEN_TEXTURE: {
-		assert(sdl.texture.input_surface);
-		if (render_pacer.CanRun()) {
+		const auto surface = sdl.texture.input_surface;
+		assert(surface);
+		// Upload even if this frame isn't shown, as the next frame only
+		// brings the lines that changed since this one
+		if (changedLines) {
+			const auto pixels = static_cast<uint8_t *>(surface->pixels);
+			for_each_changed_run(changedLines, sdl.draw.height, [&](int y, int height) {
+				const SDL_Rect rect = {0, y, surface->w, height};
+				SDL_UpdateTexture(sdl.texture.texture, &rect,
+				                  pixels + y * surface->pitch,
+				                  surface->pitch);
+			});
+		} else {
 			SDL_UpdateTexture(sdl.texture.texture,
 			                  nullptr, // update entire texture
-			                  sdl.texture.input_surface->pixels,
-			                  sdl.texture.input_surface->pitch);
+			                  surface->pixels, surface->pitch);
+		}
+		if (render_pacer.CanRun()) {
 			SDL_RenderClear(sdl.renderer);
 			SDL_RenderCopy(sdl.renderer, sdl.texture.texture,
 			               nullptr, &sdl.clip);
@@ -1748,28 +1799,32 @@ void GFX_EndUpdate(const Bit16u *changedLines)
 		glClear(GL_COLOR_BUFFER_BIT);
 		if (sdl.opengl.pixel_buffer_object) {
 			glUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_EXT);
-			glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, sdl.draw.width,
-			                sdl.draw.height, GL_BGRA_EXT,
-			                GL_UNSIGNED_INT_8_8_8_8_REV, 0);
-			glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_EXT, 0);
-		} else if (changedLines) {
-			int y = 0;
-			size_t index = 0;
-			while (y < sdl.draw.height) {
-				if (!(index & 1)) {
-					y += changedLines[index];
-				} else {
-					Bit8u *pixels = (Bit8u *)sdl.opengl.framebuf + y * sdl.opengl.pitch;
-					int height = changedLines[index];
+			if (changedLines) {
+				// With a bound buffer, the pixels are an offset into it
+				for_each_changed_run(changedLines, sdl.draw.height, [&](int y, int height) {
+					const uintptr_t offset = static_cast<uintptr_t>(y) * sdl.opengl.pitch;
 					glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y,
 					                sdl.draw.width, height,
 					                GL_BGRA_EXT,
 					                GL_UNSIGNED_INT_8_8_8_8_REV,
-					                pixels);
-					y += height;
-				}
-				index++;
+					                reinterpret_cast<void *>(offset));
+				});
+			} else {
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0,
+				                sdl.draw.width, sdl.draw.height,
+				                GL_BGRA_EXT,
+				                GL_UNSIGNED_INT_8_8_8_8_REV, 0);
 			}
+			glBindBufferARB(GL_PIXEL_UNPACK_BUFFER_EXT, 0);
+		} else if (changedLines) {
+			for_each_changed_run(changedLines, sdl.draw.height, [&](int y, int height) {
+				Bit8u *pixels = (Bit8u *)sdl.opengl.framebuf + y * sdl.opengl.pitch;
+				glTexSubImage2D(GL_TEXTURE_2D, 0, 0, y,
+				                sdl.draw.width, height,
+				                GL_BGRA_EXT,
+				                GL_UNSIGNED_INT_8_8_8_8_REV,
+				                pixels);
+			});
 		} else {
 			return;
 		}
@@ -1789,22 +1844,14 @@ void GFX_EndUpdate(const Bit16u *changedLines)
 #endif
 	case SCREEN_SURFACE:
 		if (changedLines) {
-			int y = 0;
-			size_t index = 0;
 			size_t rect_count = 0;
-			while (y < sdl.draw.height) {
-				if (!(index & 1)) {
-					y += changedLines[index];
-				} else {
-					SDL_Rect *rect = &sdl.updateRects[rect_count++];
-					rect->x = sdl.clip.x;
-					rect->y = sdl.clip.y + y;
-					rect->w = sdl.draw.width;
-					rect->h = changedLines[index];
-					y += changedLines[index];
-				}
-				index++;
-			}
+			for_each_changed_run(changedLines, sdl.draw.height, [&](int y, int height) {
+				SDL_Rect *rect = &sdl.updateRects[rect_count++];
+				rect->x = sdl.clip.x;
+				rect->y = sdl.clip.y + y;
+				rect->w = sdl.draw.width;
+				rect->h = height;
+			});
 			if (rect_count) {
 				if (render_pacer.CanRun()) {
 					SDL_UpdateWindowSurfaceRects(sdl.window,
@@ -1815,6 +1862,9 @@ void GFX_EndUpdate(const Bit16u *changedLines)
 			}
 		}
 		break;
+	case SCREEN_HEADLESS:
+		// Nothing to present
+		break;
 	}
 }
 
@@ -1826,8 +1876,9 @@ Bitu GFX_GetRGB(Bit8u red,Bit8u green,Bit8u blue) {
 		return SDL_MapRGB(sdl.texture.pixelFormat, red, green, blue);
 #if C_OPENGL
 	case SCREEN_OPENGL:
-		return ((blue << 0) | (green << 8) | (red << 16)) | (255 << 24);
 #endif
+	case SCREEN_HEADLESS:
+		return ((blue << 0) | (green << 8) | (red << 16)) | (255 << 24);
 	}
 	return 0;
 }
@@ -2568,7 +2619,9 @@ static void GUI_StartUp(Section *sec)
 
 	std::string output=section->Get_string("output");
 
-	if (output == "surface") {
+	if (sdl.headless) {
+		sdl.desktop.want_type = SCREEN_HEADLESS;
+	} else if (output == "surface") {
 		sdl.desktop.want_type=SCREEN_SURFACE;
 	} else if (output == "texture") {
 		sdl.desktop.want_type=SCREEN_TEXTURE;
@@ -2710,7 +2763,7 @@ static void GUI_StartUp(Section *sec)
 	                                 splash_image.height > sdl.desktop.full.height;
 	if ((control->GetStartupVerbosity() == Verbosity::High ||
 	     control->GetStartupVerbosity() == Verbosity::SplashOnly) &&
-	    !(sdl.desktop.fullscreen && tiny_fullresolution)) {
+	    !(sdl.desktop.fullscreen && tiny_fullresolution) && !sdl.headless) {
 		GFX_Start();
 		DisplaySplash(1000);
 		GFX_Stop();
@@ -3743,6 +3796,14 @@ int sdl_main(int argc, char *argv[])
 	LOG_MSG("dosbox-staging version %s", DOSBOX_GetDetailedVersion());
 	LOG_MSG("---");
 
+	// Batch runs nobody watches or listens to can skip the display and
+	// the sound server altogether
+	sdl.headless = control->cmdline->FindExist("-headless");
+	if (sdl.headless) {
+		SDL_setenv("SDL_VIDEODRIVER", "dummy", 1);
+		SDL_setenv("SDL_AUDIODRIVER", "dummy", 1);
+	}
+
 	if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO) < 0)
 		E_Exit("Can't init SDL %s", SDL_GetError());
 	sdl.initialized = true;
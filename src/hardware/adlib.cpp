@@ -18,6 +18,7 @@
 
 #include "adlib.h"
 
+#include <algorithm>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -46,14 +47,15 @@ struct Handler : public Adlib::Handler {
 	virtual void WriteReg(Bit32u reg, Bit8u val) { adlib_write(reg, val); }
 	virtual Bit32u WriteAddr(io_port_t, Bit8u val) { return val; }
 
-	virtual void Generate(MixerChannel *chan, const uint16_t samples)
+	virtual void Generate(Bit32s *frames, const uint16_t samples)
 	{
 		Bit16s buf[1024];
 		int remaining = samples;
 		while (remaining > 0) {
 			const auto todo = std::min(remaining, 1024);
 			adlib_getsample(buf, todo);
-			chan->AddSamples_m16(todo, buf);
+			Adlib::MonoToStereo(buf, frames, todo);
+			frames += todo * 2;
 			remaining -= todo;
 		}
 	}
@@ -68,20 +70,32 @@ namespace OPL3 {
 	#include "opl.cpp"
 
 struct Handler : public Adlib::Handler {
+	bool is_opl3_mode = false;
+
 	virtual void WriteReg(Bit32u reg, Bit8u val) { adlib_write(reg, val); }
+	virtual void LatchReg(Bit32u reg, Bit8u val)
+	{
+		if (reg == 0x105)
+			is_opl3_mode = val & 1;
+	}
+	// Same as adlib_write_index(), but using the latched mode because
+	// adlibreg[0x105] might only be written later by the renderer
 	virtual Bit32u WriteAddr(io_port_t port, Bit8u val)
 	{
-		adlib_write_index(port, val);
-		return opl_index;
+		Bit32u index = val;
+		if ((port & 3) && (is_opl3_mode || index == 5))
+			index |= ARC_SECONDSET;
+		return index;
 	}
-	virtual void Generate(MixerChannel *chan, const uint16_t samples)
+	virtual void Generate(Bit32s *frames, const uint16_t samples)
 	{
 		Bit16s buf[1024 * 2];
 		int remaining = samples;
 		while (remaining > 0) {
 			const auto todo = std::min(remaining, 1024);
 			adlib_getsample(buf, todo);
-			chan->AddSamples_s16(todo, buf);
+			std::copy_n(buf, todo * 2, frames);
+			frames += todo * 2;
 			remaining -= todo;
 		}
 	}
@@ -101,14 +115,15 @@ struct Handler : public Adlib::Handler {
 		ym3812_write(chip, 1, val);
 	}
 	virtual Bit32u WriteAddr(io_port_t, Bit8u val) { return val; }
-	virtual void Generate(MixerChannel *chan, const uint16_t samples)
+	virtual void Generate(Bit32s *frames, const uint16_t samples)
 	{
-		Bit16s buf[1024 * 2];
+		Bit16s buf[1024];
 		int remaining = samples;
 		while (remaining > 0) {
 			const auto todo = std::min(remaining, 1024);
 			ym3812_update_one(chip, buf, todo);
-			chan->AddSamples_m16(todo, buf);
+			Adlib::MonoToStereo(buf, frames, todo);
+			frames += todo * 2;
 			remaining -= todo;
 		}
 	}
@@ -134,12 +149,11 @@ struct Handler : public Adlib::Handler {
 		ymf262_write(chip, 1, val);
 	}
 	virtual Bit32u WriteAddr(io_port_t, Bit8u val) { return val; }
-	virtual void Generate(MixerChannel *chan, const uint16_t samples)
+	virtual void Generate(Bit32s *frames, const uint16_t samples)
 	{
 		// We generate data for 4 channels, but only the first 2 are
 		// connected on a pc
 		Bit16s buf[4][1024];
-		Bit16s result[1024][2];
 		Bit16s* buffers[4] = { buf[0], buf[1], buf[2], buf[3] };
 
 		int remaining = samples;
@@ -148,10 +162,9 @@ struct Handler : public Adlib::Handler {
 			ymf262_update_one(chip, buffers, todo);
 			//Interleave the samples before mixing
 			for (int i = 0; i < todo; i++) {
-				result[i][0] = buf[0][i];
-				result[i][1] = buf[1][i];
+				*frames++ = buf[0][i];
+				*frames++ = buf[1][i];
 			}
-			chan->AddSamples_s16(todo, result[0]);
 			remaining -= todo;
 		}
 	}
@@ -175,8 +188,12 @@ struct Handler : public Adlib::Handler {
 	void WriteReg(Bit32u reg, Bit8u val) override
 	{
 		OPL3_WriteRegBuffered(&chip, (Bit16u)reg, val);
+	}
+
+	void LatchReg(Bit32u reg, Bit8u val) override
+	{
 		if (reg == 0x105)
-			newm = reg & 0x01;
+			newm = val & 0x01;
 	}
 
 	Bit32u WriteAddr(io_port_t port, Bit8u val) override
@@ -189,13 +206,14 @@ struct Handler : public Adlib::Handler {
 		return addr;
 	}
 
-	void Generate(MixerChannel *chan, uint16_t samples) override
+	void Generate(Bit32s *frames, uint16_t samples) override
 	{
 		int16_t buf[1024 * 2];
 		while (samples > 0) {
 			uint32_t todo = samples > 1024 ? 1024 : samples;
 			OPL3_GenerateStream(&chip, buf, todo);
-			chan->AddSamples_s16(todo, buf);
+			std::copy_n(buf, todo * 2, frames);
+			frames += todo * 2;
 			samples -= todo;
 		}
 	}
@@ -535,6 +553,128 @@ Bit8u Chip::Read( ) {
 	return ret;
 }
 
+/*
+Renderer
+*/
+
+// Frames the renderer can hold, which bounds how far it can run ahead
+constexpr uint64_t RENDERER_RING_FRAMES = 4096;
+
+Renderer::Renderer(Handler *_handler, uint32_t frame_rate)
+        : handler(_handler),
+          ring(RENDERER_RING_FRAMES * 2),
+          frames_per_tick(frame_rate / 1000.0),
+          // Two ticks' worth, so the mixer taking a few frames more than
+          // usual doesn't have to wait on the renderer
+          lead_frames(2 * static_cast<uint64_t>(ceil(frames_per_tick)))
+{
+	target = lead_frames;
+	thread = std::thread(&Renderer::Render, this);
+	set_thread_name(thread, "dosbox:opl");
+}
+
+Renderer::~Renderer()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		keep_rendering = false;
+	}
+	has_work.notify_one();
+	thread.join();
+}
+
+void Renderer::WriteReg(Bit32u addr, Bit8u val)
+{
+	const auto offset = static_cast<uint64_t>(PIC_TickIndex() * frames_per_tick);
+	std::lock_guard<std::mutex> lock(mutex);
+	// Keep writes in order when the mixer took less than a tick's worth
+	// of frames since the previous one
+	last_event_frame = std::max(last_event_frame, target + offset);
+	events.push_back({last_event_frame, addr, val});
+}
+
+void Renderer::Generate(Bit32s *frames, uint16_t samples)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (samples > 0) {
+		const auto todo = std::min<uint64_t>(samples, RENDERER_RING_FRAMES / 2);
+		const auto end = played + todo;
+		if (target < end) {
+			target = end;
+			has_work.notify_one();
+		}
+		has_frames.wait(lock, [&] { return rendered >= end; });
+		for (auto frame = played; frame < end; ++frame) {
+			const auto pos = (frame % RENDERER_RING_FRAMES) * 2;
+			*frames++ = ring[pos];
+			*frames++ = ring[pos + 1];
+		}
+		played = end;
+		samples -= static_cast<uint16_t>(todo);
+	}
+	// Let the renderer get ahead on the frames for the coming tick
+	target = std::max(target, played + lead_frames);
+	lock.unlock();
+	has_work.notify_one();
+}
+
+void Renderer::Render()
+{
+	std::vector<Event> due = {};
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		has_work.wait(lock, [this] {
+			return !keep_rendering ||
+			       (rendered < target &&
+			        rendered - played < RENDERER_RING_FRAMES);
+		});
+		if (!keep_rendering)
+			return;
+
+		// Take the writes due at this frame ...
+		const auto begin = rendered;
+		due.clear();
+		while (!events.empty() && events.front().frame <= begin) {
+			due.push_back(events.front());
+			events.pop_front();
+		}
+		// ... and render up to the next one, the target, or the end of
+		// the ring, whichever comes first
+		const auto pos = begin % RENDERER_RING_FRAMES;
+		auto end = std::min({target, played + RENDERER_RING_FRAMES,
+		                     begin + RENDERER_RING_FRAMES - pos,
+		                     begin + 1024});
+		if (!events.empty())
+			end = std::min(end, events.front().frame);
+		lock.unlock();
+
+		for (const auto &event : due)
+			handler->WriteReg(event.addr, event.val);
+		handler->Generate(&ring[pos * 2], static_cast<uint16_t>(end - begin));
+
+		lock.lock();
+		rendered = end;
+		has_frames.notify_one();
+	}
+}
+
+void Module::SynthWrite(Bit32u reg, Bit8u val)
+{
+	handler->LatchReg(reg, val);
+	if (renderer)
+		renderer->WriteReg(reg, val);
+	else
+		handler->WriteReg(reg, val);
+}
+
+void Module::Generate(Bit32s *frames, uint16_t samples)
+{
+	if (renderer)
+		renderer->Generate(frames, samples);
+	else
+		handler->Generate(frames, samples);
+}
+
 void Module::CacheWrite(Bit32u port, Bit8u val)
 {
 	// capturing?
@@ -565,7 +705,7 @@ void Module::DualWrite(Bit8u index, Bit8u port, Bit8u val)
 		val |= index ? 0xA0 : 0x50;
 	}
 	const uint32_t full_port = port + (index ? 0x100 : 0);
-	handler->WriteReg(full_port, val);
+	SynthWrite(full_port, val);
 	CacheWrite(full_port, val);
 }
 
@@ -619,7 +759,7 @@ void Module::PortWrite(io_port_t port, uint8_t val, io_width_t)
 		case MODE_OPL2:
 		case MODE_OPL3:
 			if ( !chip[0].Write( reg.normal, val ) ) {
-				handler->WriteReg( reg.normal, val );
+				SynthWrite( reg.normal, val );
 				CacheWrite( reg.normal, val );
 			}
 			break;
@@ -729,7 +869,7 @@ void Module::Init( Mode m ) {
 		break;
 	case MODE_DUALOPL2:
 		//Setup opl3 mode in the hander
-		handler->WriteReg( 0x105, 1 );
+		SynthWrite( 0x105, 1 );
 		//Also set it up in the cache so the capturing will start opl3
 		CacheWrite( 0x105, 1 );
 		break;
@@ -742,7 +882,13 @@ static Adlib::Module* module = 0;
 
 static void OPL_CallBack(uint16_t len)
 {
-	module->handler->Generate(module->mixerChan, len);
+	Bit32s frames[512 * 2];
+	while (len > 0) {
+		const auto todo = std::min<uint16_t>(len, 512);
+		module->Generate(frames, todo);
+		module->mixerChan->AddSamples_s32(todo, frames);
+		len -= todo;
+	}
 	// Disable the sound generation after 30 seconds of silence
 	if ((PIC_Ticks - module->lastUsed) > 30000) {
 		uint8_t i;
@@ -845,6 +991,7 @@ Module::Module(Section *configuration)
 	  mixerChan(nullptr),
 	  lastUsed(0),
 	  handler(nullptr),
+	  renderer(nullptr),
 	  capture(nullptr)
 {
 	Section_prop * section=static_cast<Section_prop *>(configuration);
@@ -853,11 +1000,14 @@ Module::Module(Section *configuration)
 	ctrl.mixer = section->Get_bool("sbmixer");
 
 	mixerChan = mixerObject.Install(OPL_CallBack, 0, "FM");
+	mixerChan->AllowParallelMix();
 	//Used to be 2.0, which was measured to be too high. Exact value depends on card/clone.
 	mixerChan->SetScale( 1.5f );  
 
 	handler = make_opl_handler(section->Get_string("oplemu"), oplmode);
 	handler->Init(mixerChan->GetSampleRate());
+	if (section->Get_bool("oplthread"))
+		renderer = new Renderer(handler, mixerChan->GetSampleRate());
 
 	bool single = false;
 	switch ( oplmode ) {
@@ -902,6 +1052,8 @@ Module::Module(Section *configuration)
 Module::~Module() {
 	delete capture;
 	capture = nullptr;
+	delete renderer;
+	renderer = nullptr;
 	delete handler;
 	handler = nullptr;
 }
@@ -28,6 +28,11 @@
 #include "hardware.h"
 
 #include <cmath>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 namespace Adlib {
 
@@ -137,15 +142,82 @@ class Handler {
 public:
 	//Write an address to a chip, returns the address the chip sets
 	virtual Bit32u WriteAddr(io_port_t port, Bit8u val) = 0;
+	//Track the register state WriteAddr depends on. This is called on the
+	//emulation thread for every register write, even when the Renderer
+	//only passes the write on to WriteReg later.
+	virtual void LatchReg(Bit32u /*addr*/, Bit8u /*val*/) {}
 	//Write to a specific register in the chip
 	virtual void WriteReg( Bit32u addr, Bit8u val ) = 0;
-	//Generate a certain amount of samples
-	virtual void Generate(MixerChannel *chan, uint16_t samples) = 0;
+	//Generate a certain amount of interleaved stereo frames
+	virtual void Generate(Bit32s *frames, uint16_t samples) = 0;
 	//Initialize at a specific sample rate and mode
 	virtual void Init(uint32_t rate) = 0;
 	virtual ~Handler() = default;
 };
 
+//Copy mono samples into both sides of interleaved stereo frames
+template <typename T>
+inline void MonoToStereo(const T *samples, Bit32s *frames, int count)
+{
+	for (int i = 0; i < count; ++i) {
+		*frames++ = samples[i];
+		*frames++ = samples[i];
+	}
+}
+
+/*  Renderer
+ *  --------
+ *  Runs a handler on its own thread. Register writes are queued together
+ *  with the output frame they land on, and the thread applies each write
+ *  right before rendering that frame, so their timing is sample-accurate
+ *  instead of being rounded to the mixer's millisecond ticks.
+ *
+ *  A write's frame is the position the thread may render up to (the
+ *  target) plus how far the CPU is into the current tick. Every time the
+ *  mixer takes frames, the target moves a fixed lead ahead of them, which
+ *  the thread renders while the guest runs the next tick. Writes made
+ *  during that tick lie past the target and so are never late; the whole
+ *  stream is just delayed by the lead.
+ */
+class Renderer {
+public:
+	Renderer(Handler *handler, uint32_t frame_rate);
+	~Renderer();
+
+	//Queue a register write at the current emulated time
+	void WriteReg(Bit32u addr, Bit8u val);
+	//Hand over the next rendered frames, waiting for them if needed
+	void Generate(Bit32s *frames, uint16_t samples);
+
+	Renderer(const Renderer &) = delete;
+	Renderer &operator=(const Renderer &) = delete;
+
+private:
+	struct Event {
+		uint64_t frame = 0;
+		Bit32u addr = 0;
+		Bit8u val = 0;
+	};
+
+	void Render();
+
+	Handler *handler;
+	std::vector<Bit32s> ring = {}; //rendered stereo frames
+	std::deque<Event> events = {};
+	std::mutex mutex = {};
+	std::condition_variable has_work = {};
+	std::condition_variable has_frames = {};
+	std::thread thread = {};
+	const double frames_per_tick;
+	const uint64_t lead_frames;
+	//Guarded by the mutex
+	uint64_t rendered = 0;
+	uint64_t played = 0;
+	uint64_t target = 0;
+	uint64_t last_event_frame = 0;
+	bool keep_rendering = true;
+};
+
 //The cache for 2 chips or an opl3
 typedef Bit8u RegisterCache[512];
 
@@ -172,6 +244,7 @@ class Module: public Module_base {
 		bool mixer;
 	} ctrl;
 	void CacheWrite( Bit32u reg, Bit8u val );
+	void SynthWrite(Bit32u reg, Bit8u val);
 	void DualWrite( Bit8u index, Bit8u reg, Bit8u val );
 	void CtrlWrite( Bit8u val );
 	uint8_t CtrlRead(void);
@@ -182,10 +255,13 @@ public:
 	Bit32u lastUsed;				//Ticks when adlib was last used to turn of mixing after a few second
 
 	Handler* handler;				//Handler that will generate the sound
+	Renderer* renderer;				//Runs the handler on its own thread, if enabled
 	RegisterCache cache;
 	Capture* capture;
 	Chip	chip[2];
 
+	//Generate interleaved stereo frames through the renderer or directly
+	void Generate(Bit32s *frames, uint16_t samples);
 	//Handle port writes
 	void PortWrite(io_port_t port, uint8_t val, io_width_t width);
 	uint8_t PortRead(io_port_t port, io_width_t width);
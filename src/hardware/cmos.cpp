@@ -20,6 +20,7 @@
 
 #include <cmath>
 #include <ctime>
+#include <utility>
 
 #include "bios_disk.h"
 #include "cross.h"
@@ -39,6 +40,7 @@ static struct {
 		Bit8u div;
 		double delay;
 		bool acknowledged;
+		PIC_EventHandle event; // the next periodic interrupt
 	} timer;
 	struct {
 		double timer;
@@ -55,13 +57,13 @@ static void cmos_timerevent(uint32_t /*val*/)
 		PIC_ActivateIRQ(8);
 	}
 	if (cmos.timer.enabled) {
-		PIC_AddEvent(cmos_timerevent,cmos.timer.delay);
+		cmos.timer.event = PIC_AddEvent(cmos_timerevent, cmos.timer.delay);
 		cmos.regs[0xc] = 0xC0;//Contraption Zack (music)
 	}
 }
 
 static void cmos_checktimer(void) {
-	PIC_RemoveEvents(cmos_timerevent);
+	PIC_RemoveEvent(std::exchange(cmos.timer.event, 0));
 	if (cmos.timer.div<=2) cmos.timer.div+=7;
 	cmos.timer.delay = (1000.0 / (32768.0 / (1 << (cmos.timer.div - 1))));
 	if (!cmos.timer.div || !cmos.timer.enabled) return;
@@ -70,7 +72,7 @@ static void cmos_checktimer(void) {
 	/* A rtc is always running */
 	const auto remd = fmod(PIC_FullIndex(), cmos.timer.delay);
 	// Should be more like a real pc. Check
-	PIC_AddEvent(cmos_timerevent, cmos.timer.delay - remd);
+	cmos.timer.event = PIC_AddEvent(cmos_timerevent, cmos.timer.delay - remd);
 	// Status reg A reading with this (and with other delays actually)
 }
 
@@ -34,6 +34,7 @@
 
 #include "dbopl.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstddef>
@@ -1186,19 +1187,6 @@ void Chip::WriteReg( Bit32u reg, Bit8u val ) {
 	}
 }
 
-Bit32u Chip::WriteAddr(uint16_t port, Bit8u val)
-{
-	switch (port & 3) {
-	case 0: return val;
-	case 2:
-		if ( opl3Active || (val == 0x05) )
-			return 0x100 | val;
-		else 
-			return val;
-	}
-	return 0;
-}
-
 void Chip::GenerateBlock2(uint16_t total, Bit32s *output)
 {
 	while (total > 0) {
@@ -1524,25 +1512,42 @@ void InitTables( void ) {
 #endif
 }
 
+// Uses the latched OPL3 mode rather than the chip's, as the chip might only
+// see the register write later on the renderer's thread
 Bit32u Handler::WriteAddr(io_port_t port, Bit8u val)
 {
-	return chip.WriteAddr(port, val);
+	switch (port & 3) {
+	case 0: return val;
+	case 2:
+		if ( is_opl3_mode || (val == 0x05) )
+			return 0x100 | val;
+		else 
+			return val;
+	}
+	return 0;
+}
+void Handler::LatchReg(Bit32u addr, Bit8u val)
+{
+	if (addr == 0x105)
+		is_opl3_mode = val & 1;
 }
 void Handler::WriteReg( Bit32u addr, Bit8u val ) {
 	chip.WriteReg( addr, val );
 }
 
-void Handler::Generate(MixerChannel *chan, uint16_t samples)
+void Handler::Generate(Bit32s *frames, uint16_t samples)
 {
-	Bit32s buffer[512 * 2];
-	if (GCC_UNLIKELY(samples > 512))
-		samples = 512;
-	if ( !chip.opl3Active ) {
-		chip.GenerateBlock2( samples, buffer );
-		chan->AddSamples_m32( samples, buffer );
-	} else {
-		chip.GenerateBlock3( samples, buffer );
-		chan->AddSamples_s32( samples, buffer );
+	Bit32s buffer[512];
+	while (samples > 0) {
+		const uint16_t todo = std::min<uint16_t>(samples, 512);
+		if ( !chip.opl3Active ) {
+			chip.GenerateBlock2( todo, buffer );
+			Adlib::MonoToStereo(buffer, frames, todo);
+		} else {
+			chip.GenerateBlock3( todo, frames );
+		}
+		frames += todo * 2;
+		samples -= todo;
 	}
 }
 
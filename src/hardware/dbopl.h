@@ -234,8 +234,6 @@ struct Chip {
 	void WriteBD( Bit8u val );
 	void WriteReg(Bit32u reg, Bit8u val );
 
-	Bit32u WriteAddr(uint16_t port, Bit8u val);
-
 	void GenerateBlock2(uint16_t samples, Bit32s *output);
 	void GenerateBlock3(uint16_t samples, Bit32s *output);
 
@@ -249,9 +247,11 @@ struct Chip {
 
 struct Handler : public Adlib::Handler {
 	DBOPL::Chip chip = {};
+	bool is_opl3_mode = false;
 	virtual Bit32u WriteAddr(io_port_t port, Bit8u val);
+	virtual void LatchReg(Bit32u addr, Bit8u val);
 	virtual void WriteReg( Bit32u addr, Bit8u val );
-	virtual void Generate(MixerChannel *chan, uint16_t samples);
+	virtual void Generate(Bit32s *frames, uint16_t samples);
 	virtual void Init(uint32_t rate);
 };
 
@@ -148,6 +148,7 @@ public:
 
 		/* Register the Mixer CallBack */
 		cms_chan = MixerChan.Install(CMS_CallBack,sampleRate,"CMS");
+		cms_chan->AllowParallelMix();
 
 		lastWriteTicks = PIC_Ticks;
 
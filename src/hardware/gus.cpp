@@ -40,6 +40,10 @@
 
 #define LOG_GUS 0 // set to 1 for detailed logging
 
+// Set to 1 to render every voice one frame at a time, which is the reference
+// that the block renderer must match bit-for-bit
+#define GUS_REFERENCE_RENDERER 0
+
 // Global Constants
 // ----------------
 
@@ -167,6 +171,15 @@ private:
 	uint8_t ReadCtrlState(const VoiceCtrl &ctrl) const noexcept;
 	void IncrementCtrlPos(VoiceCtrl &ctrl, bool skip_loop) noexcept;
 	bool UpdateCtrlState(VoiceCtrl &ctrl, uint8_t state) noexcept;
+	void RenderFrame(float *frame, const ram_array_t &ram,
+	                 const vol_scalars_array_t &vol_scalars,
+	                 const AudioFrame &pan_scalar);
+	void RenderBlock(float *frames, const ram_array_t &ram,
+	                 const vol_scalars_array_t &vol_scalars,
+	                 const AudioFrame &pan_scalar, int block_frames);
+	int GetBlockFrames(int max_frames) const noexcept;
+	int32_t GetCtrlStep(const VoiceCtrl &ctrl) const noexcept;
+	int GetStepsToBoundary(const VoiceCtrl &ctrl, int max_steps) const noexcept;
 
 	// Control states
 	enum CTRL : uint8_t {
@@ -231,6 +244,8 @@ private:
 	void BeginPlayback();
 	void CheckIrq();
 	void CheckVoiceIrq();
+	bool UpdateVoiceIrq();
+	void RaisePendingVoiceIrq();
 	uint32_t Dma8Addr() noexcept;
 	uint32_t Dma16Addr() noexcept;
 	void DmaCallback(DmaChannel *chan, DMAEvent event);
@@ -314,6 +329,7 @@ private:
 	bool dac_enabled = false;
 	bool irq_enabled = false;
 	bool is_running = false;
+	bool has_pending_voice_irq = false; // raised once rendering is joined
 	bool should_change_irq_dma = false;
 };
 
@@ -444,15 +460,132 @@ void Voice::GenerateSamples(std::vector<float> &render_buffer,
 
 	// Add the samples to the render_buffer, angled in L-R space
 	while (val < last_val) {
-		float sample = GetSample(ram);
-		sample *= PopVolScalar(vol_scalars);
-		*val++ += sample * pan_scalar.left;
-		*val++ += sample * pan_scalar.right;
+		const auto remaining = static_cast<int>(last_val - val) / 2;
+		const auto block_frames = GUS_REFERENCE_RENDERER
+		                                  ? 0
+		                                  : GetBlockFrames(remaining);
+		if (block_frames > 0) {
+			RenderBlock(&*val, ram, vol_scalars, pan_scalar, block_frames);
+			val += block_frames * 2;
+		} else {
+			RenderFrame(&*val, ram, vol_scalars, pan_scalar);
+			val += 2;
+		}
 	}
 	// Keep track of how many ms this voice has generated
 	Is8Bit() ? generated_8bit_ms++ : generated_16bit_ms++;
 }
 
+void Voice::RenderFrame(float *frame, const ram_array_t &ram,
+                        const vol_scalars_array_t &vol_scalars,
+                        const AudioFrame &pan_scalar)
+{
+	float sample = GetSample(ram);
+	sample *= PopVolScalar(vol_scalars);
+	frame[0] += sample * pan_scalar.left;
+	frame[1] += sample * pan_scalar.right;
+}
+
+// The signed amount a control's position moves per frame
+int32_t Voice::GetCtrlStep(const VoiceCtrl &ctrl) const noexcept
+{
+	if (ctrl.state & CTRL::DISABLED)
+		return 0;
+	return (ctrl.state & CTRL::DECREASING) ? -ctrl.inc : ctrl.inc;
+}
+
+// How many steps a control can take before reaching a boundary, where it
+// might raise an IRQ, loop, or stop.
+int Voice::GetStepsToBoundary(const VoiceCtrl &ctrl, const int max_steps) const noexcept
+{
+	if (ctrl.state & CTRL::DISABLED)
+		return max_steps; // the position doesn't move
+	const int64_t distance = (ctrl.state & CTRL::DECREASING)
+	                                 ? int64_t{ctrl.pos} - ctrl.start
+	                                 : int64_t{ctrl.end} - ctrl.pos;
+	if (distance <= 0 || ctrl.inc < 0)
+		return 0;
+	if (ctrl.inc == 0)
+		return max_steps;
+	return static_cast<int>(std::min<int64_t>((distance - 1) / ctrl.inc, max_steps));
+}
+
+// The number of frames, up to max_frames, that RenderBlock can render in one
+// go: neither control may hit a boundary, and all volume indexes must be
+// valid. Zero means the next frame has to go through RenderFrame.
+int Voice::GetBlockFrames(const int max_frames) const noexcept
+{
+	const auto frames = std::min(GetStepsToBoundary(wave_ctrl, max_frames),
+	                             GetStepsToBoundary(vol_ctrl, max_frames));
+	if (frames <= 0)
+		return 0;
+	// The volume moves in one direction, so checking the ends will do
+	const auto vol_step = GetCtrlStep(vol_ctrl);
+	const auto first = ceil_sdivide(vol_ctrl.pos, VOLUME_INC_SCALAR);
+	const auto last = ceil_sdivide(vol_ctrl.pos + (frames - 1) * vol_step,
+	                               VOLUME_INC_SCALAR);
+	constexpr auto max_index = static_cast<int32_t>(VOLUME_LEVELS - 1);
+	if (std::min(first, last) < 0 || std::max(first, last) > max_index)
+		return 0;
+	return frames;
+}
+
+// Renders frames that cross no control boundary, which makes both the wave
+// and volume positions simple linear sequences. The work is split into
+// passes over separate sample, fraction, and volume arrays that the compiler
+// can vectorize. Every value is computed with the same operations, in the
+// same order, as RenderFrame so the output is bit-identical.
+void Voice::RenderBlock(float *frames, const ram_array_t &ram,
+                        const vol_scalars_array_t &vol_scalars,
+                        const AudioFrame &pan_scalar, const int block_frames)
+{
+	assert(block_frames > 0 && block_frames <= BUFFER_FRAMES);
+	std::array<float, BUFFER_FRAMES> samples;
+	std::array<float, BUFFER_FRAMES> next_samples;
+	std::array<float, BUFFER_FRAMES> fractions;
+	std::array<float, BUFFER_FRAMES> volumes;
+
+	// Read the samples at, and after, each position
+	const auto wave_step = GetCtrlStep(wave_ctrl);
+	const bool is_8bit = Is8Bit();
+	int32_t pos = wave_ctrl.pos;
+	for (int i = 0; i < block_frames; ++i, pos += wave_step) {
+		const auto addr = pos / WAVE_WIDTH;
+		const auto fraction = pos & (WAVE_WIDTH - 1);
+		samples[i] = is_8bit ? Read8BitSample(ram, addr)
+		                     : Read16BitSample(ram, addr);
+		next_samples[i] = is_8bit ? Read8BitSample(ram, addr + 1)
+		                          : Read16BitSample(ram, addr + 1);
+		fractions[i] = static_cast<float>(fraction);
+	}
+	wave_ctrl.pos = pos;
+
+	// Interpolate between them. A zero fraction adds a zero, which leaves
+	// the sample as is, just like skipping the interpolation does.
+	if (wave_ctrl.inc < WAVE_WIDTH) {
+		constexpr float WAVE_WIDTH_INV = 1.0 / WAVE_WIDTH;
+		for (int i = 0; i < block_frames; ++i)
+			samples[i] += (next_samples[i] - samples[i]) *
+			              fractions[i] * WAVE_WIDTH_INV;
+	}
+
+	// Look up the volume scalars
+	const auto vol_step = GetCtrlStep(vol_ctrl);
+	int32_t vol_pos = vol_ctrl.pos;
+	for (int i = 0; i < block_frames; ++i, vol_pos += vol_step) {
+		const auto index = ceil_sdivide(vol_pos, VOLUME_INC_SCALAR);
+		volumes[i] = vol_scalars[static_cast<size_t>(index)];
+	}
+	vol_ctrl.pos = vol_pos;
+
+	// Apply the volume and pan, and accumulate into the render buffer
+	for (int i = 0; i < block_frames; ++i) {
+		const float sample = samples[i] * volumes[i];
+		frames[i * 2] += sample * pan_scalar.left;
+		frames[i * 2 + 1] += sample * pan_scalar.right;
+	}
+}
+
 // Returns the current wave position and increments the position
 // to the next wave position.
 int32_t Voice::PopWavePos() noexcept
@@ -608,6 +741,9 @@ Gus::Gus(uint16_t port, uint8_t dma, uint8_t irq, const std::string &ultradir)
 	// Let the mixer command adjust the GUS's internal amplitude level's
 	const auto set_level_callback = std::bind(&Gus::SetLevelCallback, this, _1);
 	audio_channel->RegisterLevelCallBack(set_level_callback);
+	// Voices can be rendered off-thread because their IRQs are only raised
+	// from the joined callback
+	audio_channel->AllowParallelMix(std::bind(&Gus::RaisePendingVoiceIrq, this));
 
 	UpdateDmaAddress(dma);
 
@@ -660,7 +796,8 @@ void Gus::AudioCallback(const uint16_t requested_frames)
 		}
 		soft_limiter.Process(render_buffer, frames, play_buffer);
 		audio_channel->AddSamples_s16(frames, play_buffer.data());
-		CheckVoiceIrq();
+		if (UpdateVoiceIrq())
+			has_pending_voice_irq = true;
 		generated_frames += frames;
 	}
 }
@@ -699,22 +836,40 @@ bool Gus::CheckTimer(const size_t t)
 }
 
 void Gus::CheckVoiceIrq()
+{
+	if (UpdateVoiceIrq())
+		CheckIrq();
+}
+
+// Updates the IRQ status from the voices, without touching the PIC, and
+// returns true if any voice is waiting on an IRQ.
+bool Gus::UpdateVoiceIrq()
 {
 	irq_status &= 0x9f;
 	const Bitu totalmask = (voice_irq.vol_state | voice_irq.wave_state) &
 	                       active_voice_mask;
 	if (!totalmask)
-		return;
+		return false;
 	if (voice_irq.vol_state)
 		irq_status |= 0x40;
 	if (voice_irq.wave_state)
 		irq_status |= 0x20;
-	CheckIrq();
 	while (!(totalmask & 1ULL << voice_irq.status)) {
 		voice_irq.status++;
 		if (voice_irq.status >= active_voices)
 			voice_irq.status = 0;
 	}
+	return true;
+}
+
+// Voice states only accumulate while rendering, so raising the IRQ once
+// afterwards has the same effect as raising it after every rendered chunk.
+void Gus::RaisePendingVoiceIrq()
+{
+	if (!has_pending_voice_irq)
+		return;
+	has_pending_voice_irq = false;
+	CheckIrq();
 }
 
 uint32_t Gus::Dma8Addr() noexcept
@@ -18,10 +18,14 @@
 
 #include "hardware.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cerrno>
 #include <string.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <thread>
+#include <vector>
 
 #include "cross.h"
 #include "dosbox.h"
@@ -31,9 +35,11 @@
 #include "pic.h"
 #include "render.h"
 #include "rgb24.h"
+#include "rwqueue.h"
 #include "setup.h"
 #include "string_utils.h"
 #include "support.h"
+#include "timer.h"
 
 #if (C_SSHOT)
 #include <png.h>
@@ -48,6 +54,126 @@ Bitu CaptureState;
 #define MIDI_BUF 4*1024
 #define AVI_HEADER_SIZE	500
 
+#if (C_SSHOT)
+/*  Video Encoder
+ *  -------------
+ *  The emulation thread copies each captured frame, along with the audio
+ *  mixed since the last one, into a buffer from a small pool and hands it
+ *  over to the encoder thread. That thread compresses the frames in order
+ *  and writes the AVI chunks, so the emulation thread only pays for the
+ *  copy.
+ *
+ *  The codec spreads its motion vector search over a few more threads,
+ *  tile by tile. Its deflate stream spans all frames since the last
+ *  keyframe, which is what decoders expect, so it can't be split up and
+ *  stays on the encoder thread.
+ *
+ *  When every buffer is still waiting to be encoded, the emulation thread
+ *  waits for one rather than drop a frame. These stalls are counted and
+ *  reported with the other statistics when the capture stops.
+ */
+struct CaptureFrame {
+	std::vector<uint8_t> pixels = {}; // rows of 'row_size' bytes
+	std::vector<int16_t> audio = {};  // interleaved stereo samples
+	char palette[256 * 4] = {};
+	zmbv_format_t format = ZMBV_FORMAT_NONE;
+	size_t row_size = 0;
+	bool is_keyframe = false;
+};
+
+class CaptureEncoder {
+public:
+	~CaptureEncoder() { Stop(); }
+
+	void Start(int search_threads);
+	// Encodes the frames handed over so far, then ends the thread
+	void Stop();
+	bool IsRunning() const { return thread.joinable(); }
+	bool HasFailed() const { return failed; }
+
+	// Returns the next buffer to fill, waiting for one if need be
+	CaptureFrame &NextFrame();
+	void Submit();
+
+	void LogStats() const;
+
+private:
+	void Encode();
+	bool EncodeFrame(const CaptureFrame &frame);
+
+	static constexpr int pool_size = 8;
+
+	std::vector<CaptureFrame> pool = std::vector<CaptureFrame>(pool_size);
+	SPSCQueue<int> free_frames{pool_size};
+	SPSCQueue<int> pending{pool_size + 1}; // room for the stop marker
+	std::thread thread = {};
+	std::atomic_bool failed = {false};
+	int current = -1;
+	bool is_filled = false; // the pool's indices are in free_frames
+
+	// Statistics, the encoder's are only read after joining
+	int submitted = 0;
+	int stalls = 0;
+	int64_t stalled_us = 0;
+	size_t max_backlog = 0;
+	int64_t encode_us = 0;
+};
+
+/*  Image Encoder
+ *  -------------
+ *  Screenshots and frame dumps are written out as PNGs on a thread of their
+ *  own. The emulation thread opens the file and copies the frame's source
+ *  rows and palette into a buffer from a small pool; the encoder thread does
+ *  the pixel conversion and the compression, at the zlib level picked with
+ *  'png_compression'.
+ *
+ *  Frame dumps save every Nth frame rendered, named after the frame's number
+ *  since dumping started, so the dumps of two runs of a program can be told
+ *  apart image by image. Frames are never dropped: when the encoder falls
+ *  behind, the emulation waits for it.
+ */
+struct CaptureImage {
+	std::vector<uint8_t> rows = {}; // source rows of 'row_size' bytes
+	Bit8u palette[256 * 4] = {};
+	FILE *file = nullptr;
+	Bitu width = 0; // before doubling
+	Bitu height = 0;
+	Bitu bpp = 0;
+	Bitu flags = 0;
+	size_t row_size = 0;
+	int compression = Z_BEST_COMPRESSION;
+};
+
+class ImageEncoder {
+public:
+	~ImageEncoder() { Stop(); }
+
+	// Writes out the images handed over so far, then ends the thread
+	void Stop();
+
+	// Returns the next buffer to fill, starting the thread or waiting for
+	// a buffer if need be
+	CaptureImage &NextImage();
+	void Submit();
+
+	void LogStats() const;
+
+private:
+	void Encode();
+
+	static constexpr int pool_size = 4;
+
+	std::vector<CaptureImage> pool = std::vector<CaptureImage>(pool_size);
+	SPSCQueue<int> free_images{pool_size};
+	SPSCQueue<int> pending{pool_size + 1}; // room for the stop marker
+	std::thread thread = {};
+	int current = -1;
+	bool is_filled = false; // the pool's indices are in free_images
+	int submitted = 0;
+	int stalls = 0;
+};
+#endif
+
 static struct {
 	struct {
 		FILE * handle;
@@ -64,6 +190,9 @@ static struct {
 	} midi;
 	struct {
 		Bitu rowlen;
+		int compression;   // zlib level of the PNGs
+		int dump_interval; // frames between dumps, 0 when not dumping
+		Bitu frames;       // frames rendered since dumping started
 	} image;
 #if (C_SSHOT)
 	struct {
@@ -85,6 +214,11 @@ static struct {
 #endif
 } capture;
 
+#if (C_SSHOT)
+static CaptureEncoder video_encoder;
+static ImageEncoder image_encoder;
+#endif
+
 FILE * OpenCaptureFile(const char * type,const char * ext) {
 	if(capturedir.empty()) {
 		LOG_MSG("Please specify a capture directory");
@@ -168,6 +302,176 @@ static void CAPTURE_AddAviChunk(const char * tag, Bit32u size, void * data, Bit3
 	host_write<uint32_t>(index+8, pos);
 	host_write<uint32_t>(index+12, size);
 }
+
+void CaptureEncoder::Start(const int search_threads)
+{
+	assert(!IsRunning());
+	if (!is_filled) {
+		for (int i = 0; i < pool_size; ++i)
+			free_frames.Enqueue(i);
+		is_filled = true;
+	}
+	failed = false;
+	submitted = 0;
+	stalls = 0;
+	stalled_us = 0;
+	max_backlog = 0;
+	encode_us = 0;
+	capture.video.codec->SetSearchThreads(search_threads);
+	thread = std::thread(&CaptureEncoder::Encode, this);
+	set_thread_name(thread, "dosbox:capture");
+}
+
+void CaptureEncoder::Stop()
+{
+	if (!IsRunning())
+		return;
+	pending.Enqueue(-1);
+	thread.join();
+	if (current >= 0) {
+		free_frames.Enqueue(current); // taken but never submitted
+		current = -1;
+	}
+	// Don't hold on to the frames between captures
+	for (auto &frame : pool) {
+		frame.pixels = {};
+		frame.audio = {};
+	}
+}
+
+CaptureFrame &CaptureEncoder::NextFrame()
+{
+	if (current < 0) {
+		if (free_frames.IsEmpty()) {
+			++stalls;
+			const auto start = GetTicksUs();
+			current = free_frames.Dequeue();
+			stalled_us += GetTicksUsSince(start);
+		} else {
+			current = free_frames.Dequeue();
+		}
+	}
+	return pool[current];
+}
+
+void CaptureEncoder::Submit()
+{
+	assert(current >= 0);
+	pool[current].is_keyframe = (submitted++ % 300 == 0);
+	pending.Enqueue(current);
+	current = -1;
+	max_backlog = std::max(max_backlog, pending.Size());
+}
+
+void CaptureEncoder::Encode()
+{
+	while (true) {
+		const int i = pending.Dequeue();
+		if (i < 0)
+			return;
+		if (!failed) {
+			const auto start = GetTicksUs();
+			failed = !EncodeFrame(pool[i]);
+			encode_us += GetTicksUsSince(start);
+		}
+		free_frames.Enqueue(i);
+	}
+}
+
+bool CaptureEncoder::EncodeFrame(const CaptureFrame &frame)
+{
+	auto &video = capture.video;
+	const int codec_flags = frame.is_keyframe ? 1 : 0;
+	if (!video.codec->PrepareCompressFrame(codec_flags, frame.format,
+	                                       const_cast<char *>(frame.palette),
+	                                       video.buf, video.bufSize))
+		return false;
+
+	const size_t rows = frame.pixels.size() / frame.row_size;
+	for (size_t i = 0; i < rows; ++i) {
+		void *row = const_cast<uint8_t *>(&frame.pixels[i * frame.row_size]);
+		video.codec->CompressLines(1, &row);
+	}
+	const int written = video.codec->FinishCompressFrame();
+	if (written < 0)
+		return false;
+	CAPTURE_AddAviChunk("00dc", written, video.buf, frame.is_keyframe ? 0x10 : 0x0);
+	video.frames++;
+	if (!frame.audio.empty()) {
+		const auto bytes = static_cast<Bit32u>(frame.audio.size() * sizeof(int16_t));
+		CAPTURE_AddAviChunk("01wb", bytes, const_cast<int16_t *>(frame.audio.data()), 0);
+		video.audiowritten = bytes;
+	}
+	return true;
+}
+
+void CaptureEncoder::LogStats() const
+{
+	const auto frames = std::max(submitted, 1);
+	LOG_MSG("CAPTURE: Encoded %d frames in %.2f ms each on average, up to %zu queued",
+	        submitted, static_cast<double>(encode_us) / 1000 / frames, max_backlog);
+	if (stalls)
+		LOG_MSG("CAPTURE: Emulation waited for the encoder %d times, for %.1f ms in total",
+		        stalls, static_cast<double>(stalled_us) / 1000);
+}
+
+static void write_png(CaptureImage &image);
+
+void ImageEncoder::Stop()
+{
+	if (!thread.joinable())
+		return;
+	pending.Enqueue(-1);
+	thread.join();
+	for (auto &image : pool)
+		image.rows = {};
+}
+
+CaptureImage &ImageEncoder::NextImage()
+{
+	assert(current < 0);
+	if (!thread.joinable()) {
+		if (!is_filled) {
+			for (int i = 0; i < pool_size; ++i)
+				free_images.Enqueue(i);
+			is_filled = true;
+		}
+		thread = std::thread(&ImageEncoder::Encode, this);
+		set_thread_name(thread, "dosbox:png");
+	}
+	if (free_images.IsEmpty())
+		++stalls;
+	current = free_images.Dequeue();
+	return pool[current];
+}
+
+void ImageEncoder::Submit()
+{
+	assert(current >= 0);
+	pending.Enqueue(current);
+	current = -1;
+	++submitted;
+}
+
+void ImageEncoder::Encode()
+{
+	while (true) {
+		const int i = pending.Dequeue();
+		if (i < 0)
+			return;
+		auto &image = pool[i];
+		write_png(image);
+		fclose(image.file);
+		image.file = nullptr;
+		free_images.Enqueue(i);
+	}
+}
+
+void ImageEncoder::LogStats() const
+{
+	LOG_MSG("CAPTURE: Saved %d images, emulation waited for the encoder %d times",
+	        submitted, stalls);
+}
 #endif
 
 #if (C_SSHOT)
@@ -178,6 +482,10 @@ static void CAPTURE_VideoEvent(bool pressed) {
 		/* Close the video */
 		CaptureState &= ~CAPTURE_VIDEO;
 		LOG_MSG("Stopped capturing video.");	
+		if (video_encoder.IsRunning()) {
+			video_encoder.Stop();
+			video_encoder.LogStats();
+		}
 
 		Bit8u avi_header[AVI_HEADER_SIZE];
 		Bitu main_list;
@@ -333,6 +641,184 @@ void CAPTURE_VideoStop() {
 #endif
 }
 
+#if (C_SSHOT)
+// Runs on the image encoder's thread
+static void write_png(CaptureImage &image)
+{
+	png_color palette[256];
+	Bit8u doubleRow[SCALER_MAXWIDTH*4];
+	const Bitu countWidth = image.width;
+	const Bitu flags = image.flags;
+	const Bitu bpp = image.bpp;
+	const Bit8u *pal = image.palette;
+	const auto width = static_cast<png_uint_32>(
+	        (flags & CAPTURE_FLAG_DBLW) ? image.width * 2 : image.width);
+	const auto height = static_cast<png_uint_32>(
+	        (flags & CAPTURE_FLAG_DBLH) ? image.height * 2 : image.height);
+
+	/* First try to allocate the png structures */
+	png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL,NULL, NULL);
+	if (!png_ptr)
+		return;
+	png_infop info_ptr = png_create_info_struct(png_ptr);
+	if (!info_ptr) {
+		png_destroy_write_struct(&png_ptr, (png_infopp)NULL);
+		return;
+	}
+	
+	/* Finalize the initing of png library */
+	png_init_io(png_ptr, image.file);
+	png_set_compression_level(png_ptr, image.compression);
+	
+	/* set other zlib parameters */
+	png_set_compression_mem_level(png_ptr, 8);
+	png_set_compression_strategy(png_ptr,Z_DEFAULT_STRATEGY);
+	png_set_compression_window_bits(png_ptr, 15);
+	png_set_compression_method(png_ptr, 8);
+	png_set_compression_buffer_size(png_ptr, 8192);
+	
+	if (bpp==8) {
+		png_set_IHDR(png_ptr, info_ptr, width, height,
+			8, PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
+			PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+		for (int i=0;i<256;i++) {
+			palette[i].red=pal[i*4+0];
+			palette[i].green=pal[i*4+1];
+			palette[i].blue=pal[i*4+2];
+		}
+		png_set_PLTE(png_ptr, info_ptr, palette,256);
+	} else {
+		png_set_bgr( png_ptr );
+		png_set_IHDR(png_ptr, info_ptr, width, height,
+			8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+			PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+	}
+#ifdef PNG_TEXT_SUPPORTED
+	constexpr char keyword[] = "Software";
+	constexpr char value[] = "dosbox-staging " VERSION;
+	constexpr int num_text = 1;
+	static_assert(sizeof(keyword) < 80, "libpng limit");
+	png_text texts[num_text] = {};
+	texts[0].compression = PNG_TEXT_COMPRESSION_NONE;
+	texts[0].key = const_cast<png_charp>(keyword);
+	texts[0].text = const_cast<png_charp>(value);
+	texts[0].text_length = sizeof(value);
+	png_set_text(png_ptr, info_ptr, texts, num_text);
+#endif
+	png_write_info(png_ptr, info_ptr);
+	for (png_uint_32 i=0;i<height;i++) {
+		void *rowPointer;
+		void *srcLine;
+		if (flags & CAPTURE_FLAG_DBLH)
+			srcLine=&image.rows[(i >> 1)*image.row_size];
+		else
+			srcLine=&image.rows[(i >> 0)*image.row_size];
+		rowPointer=srcLine;
+		switch (bpp) {
+		case 8:
+			if (flags & CAPTURE_FLAG_DBLW) {
+   					for (Bitu x=0;x<countWidth;x++)
+					doubleRow[x*2+0] =
+					doubleRow[x*2+1] = ((Bit8u *)srcLine)[x];
+				rowPointer = doubleRow;
+			}
+			break;
+		case 15:
+			if (flags & CAPTURE_FLAG_DBLW) {
+				for (Bitu x=0;x<countWidth;x++) {
+					const Bitu pixel = host_to_le(static_cast<uint16_t *>(srcLine)[x]);
+					doubleRow[x*6+0] = doubleRow[x*6+3] = ((pixel& 0x001f) * 0x21) >>  2;
+					doubleRow[x*6+1] = doubleRow[x*6+4] = ((pixel& 0x03e0) * 0x21) >>  7;
+					doubleRow[x*6+2] = doubleRow[x*6+5] = ((pixel& 0x7c00) * 0x21) >>  12;
+				}
+			} else {
+				for (Bitu x=0;x<countWidth;x++) {
+					const Bitu pixel = host_to_le(static_cast<uint16_t *>(srcLine)[x]);
+					doubleRow[x*3+0] = ((pixel& 0x001f) * 0x21) >>  2;
+					doubleRow[x*3+1] = ((pixel& 0x03e0) * 0x21) >>  7;
+					doubleRow[x*3+2] = ((pixel& 0x7c00) * 0x21) >>  12;
+				}
+			}
+			rowPointer = doubleRow;
+			break;
+		case 16:
+			if (flags & CAPTURE_FLAG_DBLW) {
+				for (Bitu x=0;x<countWidth;x++) {
+					const Bitu pixel = host_to_le(static_cast<uint16_t *>(srcLine)[x]);
+					doubleRow[x*6+0] = doubleRow[x*6+3] = ((pixel& 0x001f) * 0x21) >> 2;
+					doubleRow[x*6+1] = doubleRow[x*6+4] = ((pixel& 0x07e0) * 0x41) >> 9;
+					doubleRow[x*6+2] = doubleRow[x*6+5] = ((pixel& 0xf800) * 0x21) >> 13;
+				}
+			} else {
+				for (Bitu x=0;x<countWidth;x++) {
+					const Bitu pixel = host_to_le(static_cast<uint16_t *>(srcLine)[x]);
+					doubleRow[x*3+0] = ((pixel& 0x001f) * 0x21) >>  2;
+					doubleRow[x*3+1] = ((pixel& 0x07e0) * 0x41) >>  9;
+					doubleRow[x*3+2] = ((pixel& 0xf800) * 0x21) >>  13;
+				}
+			}
+			rowPointer = doubleRow;
+			break;
+		case 24:
+			if (flags & CAPTURE_FLAG_DBLW) {
+				for (uint32_t x = 0; x < countWidth; ++x) {
+					const auto pixel = host_to_le(static_cast<rgb24 *>(srcLine)[x]);
+					reinterpret_cast<rgb24 *>(doubleRow)[x * 2 + 0] = pixel;
+					reinterpret_cast<rgb24 *>(doubleRow)[x * 2 + 1] = pixel;
+					rowPointer = doubleRow;
+				}
+			}
+			// There is no else statement here because
+			// rowPointer is already defined as srcLine
+			// above which is already 24-bit single row
+
+			break;
+		case 32:
+			if (flags & CAPTURE_FLAG_DBLW) {
+				for (Bitu x=0;x<countWidth;x++) {
+					doubleRow[x*6+0] = doubleRow[x*6+3] = ((Bit8u *)srcLine)[x*4+0];
+					doubleRow[x*6+1] = doubleRow[x*6+4] = ((Bit8u *)srcLine)[x*4+1];
+					doubleRow[x*6+2] = doubleRow[x*6+5] = ((Bit8u *)srcLine)[x*4+2];
+				}
+			} else {
+				for (Bitu x=0;x<countWidth;x++) {
+					doubleRow[x*3+0] = ((Bit8u *)srcLine)[x*4+0];
+					doubleRow[x*3+1] = ((Bit8u *)srcLine)[x*4+1];
+					doubleRow[x*3+2] = ((Bit8u *)srcLine)[x*4+2];
+				}
+			}
+			rowPointer = doubleRow;
+			break;
+		}
+		png_write_row(png_ptr, (png_bytep)rowPointer);
+	}
+	/* Finish writing */
+	png_write_end(png_ptr, 0);
+	/*Destroy PNG structs*/
+	png_destroy_write_struct(&png_ptr, &info_ptr);
+}
+
+static void CAPTURE_QueueImage(FILE *fp, Bitu width, Bitu height, Bitu bpp,
+                               Bitu pitch, Bitu flags, const Bit8u *data,
+                               const Bit8u *pal)
+{
+	CaptureImage &image = image_encoder.NextImage();
+	image.file = fp;
+	image.width = width;
+	image.height = height;
+	image.bpp = bpp;
+	image.flags = flags;
+	image.compression = capture.image.compression;
+	image.row_size = width * ((bpp + 7) / 8);
+	image.rows.resize(image.row_size * height);
+	for (Bitu i = 0; i < height; ++i)
+		memcpy(&image.rows[i * image.row_size], data + i * pitch, image.row_size);
+	if (bpp == 8)
+		memcpy(image.palette, pal, sizeof(image.palette));
+	image_encoder.Submit();
+}
+#endif
+
 void CAPTURE_AddImage(MAYBE_UNUSED Bitu width,
                       MAYBE_UNUSED Bitu height,
                       MAYBE_UNUSED Bitu bpp,
@@ -344,8 +830,8 @@ void CAPTURE_AddImage(MAYBE_UNUSED Bitu width,
 {
 #if (C_SSHOT)
 	Bitu i;
-	Bit8u doubleRow[SCALER_MAXWIDTH*4];
-	Bitu countWidth = width;
+	const Bitu countWidth = width;
+	const Bitu countHeight = height;
 
 	if (flags & CAPTURE_FLAG_DBLH)
 		height *= 2;
@@ -358,162 +844,31 @@ void CAPTURE_AddImage(MAYBE_UNUSED Bitu width,
 		return;
 	
 	if (CaptureState & CAPTURE_IMAGE) {
-		png_structp png_ptr;
-		png_infop info_ptr;
-		png_color palette[256];
-
 		CaptureState &= ~CAPTURE_IMAGE;
 		/* Open the actual file */
 		FILE *fp = OpenCaptureFile("Screenshot", ".png");
-		if (!fp)
-			goto skip_shot;
-		/* First try to allocate the png structures */
-		png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL,NULL, NULL);
-		if (!png_ptr) {
-			fclose(fp);
-			goto skip_shot;
-		}
-		info_ptr = png_create_info_struct(png_ptr);
-		if (!info_ptr) {
-			png_destroy_write_struct(&png_ptr, (png_infopp)NULL);
-			fclose(fp);
-			goto skip_shot;
-		}
-	
-		/* Finalize the initing of png library */
-		png_init_io(png_ptr, fp);
-		png_set_compression_level(png_ptr,Z_BEST_COMPRESSION);
-		
-		/* set other zlib parameters */
-		png_set_compression_mem_level(png_ptr, 8);
-		png_set_compression_strategy(png_ptr,Z_DEFAULT_STRATEGY);
-		png_set_compression_window_bits(png_ptr, 15);
-		png_set_compression_method(png_ptr, 8);
-		png_set_compression_buffer_size(png_ptr, 8192);
-	
-		if (bpp==8) {
-			png_set_IHDR(png_ptr, info_ptr, width, height,
-				8, PNG_COLOR_TYPE_PALETTE, PNG_INTERLACE_NONE,
-				PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-			for (i=0;i<256;i++) {
-				palette[i].red=pal[i*4+0];
-				palette[i].green=pal[i*4+1];
-				palette[i].blue=pal[i*4+2];
-			}
-			png_set_PLTE(png_ptr, info_ptr, palette,256);
-		} else {
-			png_set_bgr( png_ptr );
-			png_set_IHDR(png_ptr, info_ptr, width, height,
-				8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
-				PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
-		}
-#ifdef PNG_TEXT_SUPPORTED
-		constexpr char keyword[] = "Software";
-		constexpr char value[] = "dosbox-staging " VERSION;
-		constexpr int num_text = 1;
-		static_assert(sizeof(keyword) < 80, "libpng limit");
-		png_text texts[num_text] = {};
-		texts[0].compression = PNG_TEXT_COMPRESSION_NONE;
-		texts[0].key = const_cast<png_charp>(keyword);
-		texts[0].text = const_cast<png_charp>(value);
-		texts[0].text_length = sizeof(value);
-		png_set_text(png_ptr, info_ptr, texts, num_text);
-#endif
-		png_write_info(png_ptr, info_ptr);
-		for (i=0;i<height;i++) {
-			void *rowPointer;
-			void *srcLine;
-			if (flags & CAPTURE_FLAG_DBLH)
-				srcLine=(data+(i >> 1)*pitch);
-			else
-				srcLine=(data+(i >> 0)*pitch);
-			rowPointer=srcLine;
-			switch (bpp) {
-			case 8:
-				if (flags & CAPTURE_FLAG_DBLW) {
-   					for (Bitu x=0;x<countWidth;x++)
-						doubleRow[x*2+0] =
-						doubleRow[x*2+1] = ((Bit8u *)srcLine)[x];
-					rowPointer = doubleRow;
-				}
-				break;
-			case 15:
-				if (flags & CAPTURE_FLAG_DBLW) {
-					for (Bitu x=0;x<countWidth;x++) {
-						const Bitu pixel = host_to_le(static_cast<uint16_t *>(srcLine)[x]);
-						doubleRow[x*6+0] = doubleRow[x*6+3] = ((pixel& 0x001f) * 0x21) >>  2;
-						doubleRow[x*6+1] = doubleRow[x*6+4] = ((pixel& 0x03e0) * 0x21) >>  7;
-						doubleRow[x*6+2] = doubleRow[x*6+5] = ((pixel& 0x7c00) * 0x21) >>  12;
-					}
-				} else {
-					for (Bitu x=0;x<countWidth;x++) {
-						const Bitu pixel = host_to_le(static_cast<uint16_t *>(srcLine)[x]);
-						doubleRow[x*3+0] = ((pixel& 0x001f) * 0x21) >>  2;
-						doubleRow[x*3+1] = ((pixel& 0x03e0) * 0x21) >>  7;
-						doubleRow[x*3+2] = ((pixel& 0x7c00) * 0x21) >>  12;
-					}
-				}
-				rowPointer = doubleRow;
-				break;
-			case 16:
-				if (flags & CAPTURE_FLAG_DBLW) {
-					for (Bitu x=0;x<countWidth;x++) {
-						const Bitu pixel = host_to_le(static_cast<uint16_t *>(srcLine)[x]);
-						doubleRow[x*6+0] = doubleRow[x*6+3] = ((pixel& 0x001f) * 0x21) >> 2;
-						doubleRow[x*6+1] = doubleRow[x*6+4] = ((pixel& 0x07e0) * 0x41) >> 9;
-						doubleRow[x*6+2] = doubleRow[x*6+5] = ((pixel& 0xf800) * 0x21) >> 13;
-					}
-				} else {
-					for (Bitu x=0;x<countWidth;x++) {
-						const Bitu pixel = host_to_le(static_cast<uint16_t *>(srcLine)[x]);
-						doubleRow[x*3+0] = ((pixel& 0x001f) * 0x21) >>  2;
-						doubleRow[x*3+1] = ((pixel& 0x07e0) * 0x41) >>  9;
-						doubleRow[x*3+2] = ((pixel& 0xf800) * 0x21) >>  13;
-					}
-				}
-				rowPointer = doubleRow;
-				break;
-			case 24:
-				if (flags & CAPTURE_FLAG_DBLW) {
-					for (uint32_t x = 0; x < countWidth; ++x) {
-						const auto pixel = host_to_le(static_cast<rgb24 *>(srcLine)[x]);
-						reinterpret_cast<rgb24 *>(doubleRow)[x * 2 + 0] = pixel;
-						reinterpret_cast<rgb24 *>(doubleRow)[x * 2 + 1] = pixel;
-						rowPointer = doubleRow;
-					}
-				}
-				// There is no else statement here because
-				// rowPointer is already defined as srcLine
-				// above which is already 24-bit single row
-
-				break;
-			case 32:
-				if (flags & CAPTURE_FLAG_DBLW) {
-					for (Bitu x=0;x<countWidth;x++) {
-						doubleRow[x*6+0] = doubleRow[x*6+3] = ((Bit8u *)srcLine)[x*4+0];
-						doubleRow[x*6+1] = doubleRow[x*6+4] = ((Bit8u *)srcLine)[x*4+1];
-						doubleRow[x*6+2] = doubleRow[x*6+5] = ((Bit8u *)srcLine)[x*4+2];
-					}
-				} else {
-					for (Bitu x=0;x<countWidth;x++) {
-						doubleRow[x*3+0] = ((Bit8u *)srcLine)[x*4+0];
-						doubleRow[x*3+1] = ((Bit8u *)srcLine)[x*4+1];
-						doubleRow[x*3+2] = ((Bit8u *)srcLine)[x*4+2];
-					}
-				}
-				rowPointer = doubleRow;
-				break;
+		if (fp)
+			CAPTURE_QueueImage(fp, countWidth, countHeight, bpp, pitch,
+			                   flags, data, pal);
+	}
+	if (CaptureState & CAPTURE_FRAMES) {
+		const Bitu frame = capture.image.frames++;
+		if (frame % capture.image.dump_interval == 0) {
+			char file_name[CROSS_LEN];
+			snprintf(file_name, sizeof(file_name), "%s%cframe_%06u.png",
+			         capturedir.c_str(), CROSS_FILESPLIT,
+			         static_cast<unsigned>(frame));
+			FILE *fp = fopen(file_name, "wb");
+			if (fp) {
+				CAPTURE_QueueImage(fp, countWidth, countHeight, bpp,
+				                   pitch, flags, data, pal);
+			} else {
+				LOG_MSG("Failed to open %s for dumping frames, stopping the dump",
+				        file_name);
+				CaptureState &= ~CAPTURE_FRAMES;
 			}
-			png_write_row(png_ptr, (png_bytep)rowPointer);
 		}
-		/* Finish writing */
-		png_write_end(png_ptr, 0);
-		/*Destroy PNG structs*/
-		png_destroy_write_struct(&png_ptr, &info_ptr);
-		/*close file*/
-		fclose(fp);
 	}
-skip_shot:
 	if (CaptureState & CAPTURE_VIDEO) {
 		zmbv_format_t format;
 		/* Disable capturing if any of the test fails */
@@ -569,16 +924,29 @@ skip_shot:
 			capture.video.written = 0;
 			capture.video.audioused = 0;
 			capture.video.audiowritten = 0;
+
+			// Leave a core or two to the emulation and the encoder
+			const int cores = static_cast<int>(std::thread::hardware_concurrency());
+			video_encoder.Start(clamp(cores / 2 - 1, 0, 3));
 		}
-		int codecFlags;
-		if (capture.video.frames % 300 == 0)
-			codecFlags = 1;
-		else codecFlags = 0;
-		if (!capture.video.codec->PrepareCompressFrame( codecFlags, format, (char *)pal, capture.video.buf, capture.video.bufSize))
+		if (video_encoder.HasFailed()) {
+			LOG_MSG("Failed to encode the video, stopping the capture.");
+			CaptureState |= CAPTURE_VIDEO;
+			CAPTURE_VideoEvent(true);
 			goto skip_video;
+		}
+
+		CaptureFrame &frame = video_encoder.NextFrame();
+		const size_t pixel_size = (format == ZMBV_FORMAT_8BPP) ? 1
+		                          : (format == ZMBV_FORMAT_32BPP) ? 4 : 2;
+		frame.format = format;
+		frame.row_size = width * pixel_size;
+		frame.pixels.resize(frame.row_size * height);
+		if (pal)
+			memcpy(frame.palette, pal, sizeof(frame.palette));
 
 		for (i=0;i<height;i++) {
-			void * rowPointer;
+			void * rowPointer = &frame.pixels[i * frame.row_size];
 			void * srcLine;
 			if (flags & CAPTURE_FLAG_DBLH)
 				srcLine=(data+(i >> 1)*pitch);
@@ -590,55 +958,42 @@ skip_shot:
 				switch ( bpp) {
 				case 8:
 					for (x=0;x<countWidth;x++)
-						((Bit8u *)doubleRow)[x*2+0] =
-						((Bit8u *)doubleRow)[x*2+1] = ((Bit8u *)srcLine)[x];
+						((Bit8u *)rowPointer)[x*2+0] =
+						((Bit8u *)rowPointer)[x*2+1] = ((Bit8u *)srcLine)[x];
 					break;
 				case 15:
 				case 16:
 					for (x=0;x<countWidth;x++)
-						((Bit16u *)doubleRow)[x*2+0] =
-						((Bit16u *)doubleRow)[x*2+1] = ((Bit16u *)srcLine)[x];
+						((Bit16u *)rowPointer)[x*2+0] =
+						((Bit16u *)rowPointer)[x*2+1] = ((Bit16u *)srcLine)[x];
 					break;
 				case 24:
 					for (x = 0; x < countWidth; ++x) {
 						const auto pixel = static_cast<rgb24 *>(srcLine)[x];
-						reinterpret_cast<uint32_t *>(doubleRow)[x * 2 + 0] = pixel;
-						reinterpret_cast<uint32_t *>(doubleRow)[x * 2 + 1] = pixel;
+						reinterpret_cast<uint32_t *>(rowPointer)[x * 2 + 0] = pixel;
+						reinterpret_cast<uint32_t *>(rowPointer)[x * 2 + 1] = pixel;
 					}
 					break;
 				case 32:
 					for (x=0;x<countWidth;x++)
-						((Bit32u *)doubleRow)[x*2+0] =
-						((Bit32u *)doubleRow)[x*2+1] = ((Bit32u *)srcLine)[x];
+						((Bit32u *)rowPointer)[x*2+0] =
+						((Bit32u *)rowPointer)[x*2+1] = ((Bit32u *)srcLine)[x];
 					break;
 				}
-                rowPointer=doubleRow;
-			} else {
-				if (bpp == 24) {
-					const auto countWidth = width;
-					for (uint32_t x = 0; x < countWidth; ++x) {
-						const auto pixel = static_cast<rgb24 *>(srcLine)[x];
-						reinterpret_cast<uint32_t *>(doubleRow)[x] = pixel;
-					}
-					// Using doubleRow for this conversion when it is not actually double row!
-					rowPointer = doubleRow;
-				} else {
-					rowPointer = srcLine;
+			} else if (bpp == 24) {
+				for (uint32_t x = 0; x < width; ++x) {
+					const auto pixel = static_cast<rgb24 *>(srcLine)[x];
+					reinterpret_cast<uint32_t *>(rowPointer)[x] = pixel;
 				}
+			} else {
+				memcpy(rowPointer, srcLine, frame.row_size);
 			}
-			capture.video.codec->CompressLines( 1, &rowPointer );
-		}
-		int written = capture.video.codec->FinishCompressFrame();
-		if (written < 0)
-			goto skip_video;
-		CAPTURE_AddAviChunk( "00dc", written, capture.video.buf, codecFlags & 1 ? 0x10 : 0x0);
-		capture.video.frames++;
-//		LOG_MSG("Frame %d video %d audio %d",capture.video.frames, written, capture.video.audioused *4 );
-		if ( capture.video.audioused ) {
-			CAPTURE_AddAviChunk( "01wb", capture.video.audioused * 4, capture.video.audiobuf, 0);
-			capture.video.audiowritten = capture.video.audioused*4;
-			capture.video.audioused = 0;
 		}
+		// The audio mixed since the last frame goes along with it
+		const Bit16s *samples = &capture.video.audiobuf[0][0];
+		frame.audio.assign(samples, samples + capture.video.audioused * 2);
+		capture.video.audioused = 0;
+		video_encoder.Submit();
 
 		/* Everything went okay, set flag again for next frame */
 		CaptureState |= CAPTURE_VIDEO;
@@ -827,6 +1182,21 @@ public:
 		Prop_path* proppath= section->Get_path("captures");
 		capturedir = proppath->realpath;
 		CaptureState = 0;
+#if (C_SSHOT)
+		capture.image.compression = section->Get_int("png_compression");
+		capture.image.dump_interval = section->Get_int("frame_dump");
+		capture.image.frames = 0;
+		if (capture.image.dump_interval) {
+			if (capturedir.empty()) {
+				LOG_MSG("Please specify a capture directory");
+			} else {
+				create_dir(capturedir.c_str(), 0700, OK_IF_EXISTS);
+				LOG_MSG("Dumping one in every %d frames to %s",
+				        capture.image.dump_interval, capturedir.c_str());
+				CaptureState |= CAPTURE_FRAMES;
+			}
+		}
+#endif
 		MAPPER_AddHandler(CAPTURE_WaveEvent, SDL_SCANCODE_F6,
 		                  PRIMARY_MOD, "recwave", "Rec. Audio");
 		MAPPER_AddHandler(CAPTURE_MidiEvent, SDL_SCANCODE_UNKNOWN, 0,
@@ -841,6 +1211,9 @@ public:
 	~HARDWARE(){
 #if (C_SSHOT)
 		if (capture.video.handle) CAPTURE_VideoEvent(true);
+		image_encoder.Stop();
+		if (capture.image.dump_interval)
+			image_encoder.LogStats();
 #endif
 		if (capture.wave.handle) CAPTURE_WaveEvent(true);
 		if (capture.midi.handle) CAPTURE_MidiEvent(true);
@@ -24,7 +24,6 @@
 #include <cassert>
 #include <limits>
 #include <cstring>
-#include <unordered_map>
 
 #include "setup.h"
 #include "cpu.h"
@@ -33,10 +32,6 @@
 
 //#define ENABLE_PORTLOG
 
-// type-sized IO handler containers
-extern std::unordered_map<io_port_t, io_read_f> io_read_handlers[io_widths];
-extern std::unordered_map<io_port_t, io_write_f> io_write_handlers[io_widths];
-
 // type-sized IO handler API
 uint8_t read_byte_from_port(const io_port_t port);
 uint16_t read_word_from_port(const io_port_t port);
@@ -44,6 +39,7 @@ uint32_t read_dword_from_port(const io_port_t port);
 void write_byte_to_port(const io_port_t port, const uint8_t val);
 void write_word_to_port(const io_port_t port, const uint16_t val);
 void write_dword_to_port(const io_port_t port, const uint32_t val);
+void release_port_handlers();
 
 
 struct IOF_Entry {
@@ -397,20 +393,7 @@ public:
 	}
 	~IO()
 	{
-		size_t total_bytes = 0u;
-		for (uint8_t i = 0; i < io_widths; ++i) {
-			const auto readers = io_read_handlers[i].size();
-			const auto writers = io_write_handlers[i].size();
-			DEBUG_LOG_MSG("IOBUS: Releasing %d read and %d write %d-bit port handlers",
-			              static_cast<int>(readers), static_cast<int>(writers), 8 << i);
-
-			total_bytes += readers * sizeof(io_read_f) + sizeof(io_read_handlers[i]);
-			total_bytes += writers * sizeof(io_write_f) + sizeof(io_write_handlers[i]);
-			io_read_handlers[i].clear();
-			io_write_handlers[i].clear();
-		}
-		DEBUG_LOG_MSG("IOBUS: Handlers consumed %d total bytes",
-		              static_cast<int>(total_bytes));
+		release_port_handlers();
 	}
 };
 
@@ -21,11 +21,12 @@
 
 #include "dosbox.h"
 
+#include <array>
 #include <cassert>
 #include <cstring>
 #include <functional>
 #include <limits>
-#include <unordered_map>
+#include <memory>
 
 #include "inout.h"
 
@@ -53,13 +54,73 @@ IO_WriteHandleObject::~IO_WriteHandleObject(){
 	// static_cast<uint32_t>(m_port));
 }
 
+// Handlers are kept in pages of 256 ports, which are only allocated once a
+// port in their range gets a handler. Finding one takes two loads and no
+// hashing, which matters for the ports guests poll in tight loops.
+template <typename handler_t>
+class PortHandlers {
+public:
+	const handler_t *Find(const io_port_t port) const noexcept
+	{
+		const auto &page = pages[port >> 8];
+		if (!page)
+			return nullptr;
+		const auto &handler = (*page)[port & 0xff];
+		return handler ? &handler : nullptr;
+	}
+
+	handler_t &operator[](const io_port_t port)
+	{
+		auto &page = pages[port >> 8];
+		if (!page)
+			page = std::make_unique<page_t>();
+		return (*page)[port & 0xff];
+	}
+
+	void erase(const io_port_t port) noexcept
+	{
+		const auto &page = pages[port >> 8];
+		if (page)
+			(*page)[port & 0xff] = nullptr;
+	}
+
+	size_t size() const noexcept
+	{
+		size_t count = 0;
+		for (const auto &page : pages)
+			if (page)
+				for (const auto &handler : *page)
+					count += handler ? 1 : 0;
+		return count;
+	}
+
+	// Bytes taken by the allocated pages
+	size_t pages_bytes() const noexcept
+	{
+		size_t bytes = 0;
+		for (const auto &page : pages)
+			bytes += page ? sizeof(page_t) : 0;
+		return bytes;
+	}
+
+	void clear() noexcept
+	{
+		for (auto &page : pages)
+			page.reset();
+	}
+
+private:
+	using page_t = std::array<handler_t, 256>;
+	std::array<std::unique_ptr<page_t>, 256> pages = {};
+};
+
 // type-sized IO handlers
-std::unordered_map<io_port_t, io_read_f> io_read_handlers[io_widths] = {};
+PortHandlers<io_read_f> io_read_handlers[io_widths] = {};
 constexpr auto &io_read_byte_handler = io_read_handlers[0];
 constexpr auto &io_read_word_handler = io_read_handlers[1];
 constexpr auto &io_read_dword_handler = io_read_handlers[2];
 
-std::unordered_map<io_port_t, io_write_f> io_write_handlers[io_widths] = {};
+PortHandlers<io_write_f> io_write_handlers[io_widths] = {};
 constexpr auto &io_write_byte_handler = io_write_handlers[0];
 constexpr auto &io_write_word_handler = io_write_handlers[1];
 constexpr auto &io_write_dword_handler = io_write_handlers[2];
@@ -73,34 +134,31 @@ static uint8_t no_read(const io_port_t port)
 
 uint8_t read_byte_from_port(const io_port_t port)
 {
-	const auto reader = io_read_byte_handler.find(port);
-	const io_val_t value = reader != io_read_byte_handler.end()
-	                           ? (reader->second(port, io_width_t::byte) & 0xff)
-	                           : no_read(port);
+	const auto reader = io_read_byte_handler.Find(port);
+	const io_val_t value = reader ? ((*reader)(port, io_width_t::byte) & 0xff)
+	                              : no_read(port);
 	assert(value <= UINT8_MAX);
 	return static_cast<uint8_t>(value);
 }
 
 uint16_t read_word_from_port(const io_port_t port)
 {
-	const auto reader = io_read_word_handler.find(port);
-	const auto value = reader != io_read_word_handler.end()
-	                           ? (reader->second(port, io_width_t::word) & 0xffff)
-	                           : static_cast<io_val_t>(
-	                                     read_byte_from_port(port) |
-	                                     (read_byte_from_port(port + 1) << 8));
+	const auto reader = io_read_word_handler.Find(port);
+	const auto value = reader ? ((*reader)(port, io_width_t::word) & 0xffff)
+	                          : static_cast<io_val_t>(
+	                                    read_byte_from_port(port) |
+	                                    (read_byte_from_port(port + 1) << 8));
 	assert(value <= UINT16_MAX);
 	return static_cast<uint16_t>(value);
 }
 
 uint32_t read_dword_from_port(const io_port_t port)
 {
-	const auto reader = io_read_dword_handler.find(port);
-	const auto value = reader != io_read_dword_handler.end()
-	                           ? reader->second(port, io_width_t::dword)
-	                           : static_cast<io_val_t>(
-	                                     read_word_from_port(port) |
-	                                     (read_word_from_port(port + 2) << 16));
+	const auto reader = io_read_dword_handler.Find(port);
+	const auto value = reader ? (*reader)(port, io_width_t::dword)
+	                          : static_cast<io_val_t>(
+	                                    read_word_from_port(port) |
+	                                    (read_word_from_port(port + 2) << 16));
 	assert(value <= UINT32_MAX);
 	return static_cast<uint32_t>(value);
 }
@@ -112,18 +170,18 @@ static void no_write(const io_port_t port, const uint8_t val)
 
 void write_byte_to_port(const io_port_t port, const uint8_t val)
 {
-	const auto writer = io_write_byte_handler.find(port);
-	if (writer != io_write_byte_handler.end())
-		writer->second(port, val, io_width_t::byte);
+	const auto writer = io_write_byte_handler.Find(port);
+	if (writer)
+		(*writer)(port, val, io_width_t::byte);
 	else
 		no_write(port, val);
 }
 
 void write_word_to_port(const io_port_t port, const uint16_t val)
 {
-	const auto writer = io_write_word_handler.find(port);
-	if (writer != io_write_word_handler.end()) {
-		writer->second(port, val, io_width_t::word);
+	const auto writer = io_write_word_handler.Find(port);
+	if (writer) {
+		(*writer)(port, val, io_width_t::word);
 	} else {
 		write_byte_to_port(port, val & 0xff);
 		write_byte_to_port(port + 1, val >> 8);
@@ -132,15 +190,33 @@ void write_word_to_port(const io_port_t port, const uint16_t val)
 
 void write_dword_to_port(const io_port_t port, const uint32_t val)
 {
-	const auto writer = io_write_dword_handler.find(port);
-	if (writer != io_write_dword_handler.end()) {
-		writer->second(port, val, io_width_t::dword);
+	const auto writer = io_write_dword_handler.Find(port);
+	if (writer) {
+		(*writer)(port, val, io_width_t::dword);
 	} else {
 		write_word_to_port(port, val & 0xffff);
 		write_word_to_port(port + 2, val >> 16);
 	}
 }
 
+void release_port_handlers()
+{
+	size_t total_bytes = 0u;
+	for (uint8_t i = 0; i < io_widths; ++i) {
+		const auto readers = io_read_handlers[i].size();
+		const auto writers = io_write_handlers[i].size();
+		DEBUG_LOG_MSG("IOBUS: Releasing %d read and %d write %d-bit port handlers",
+		              static_cast<int>(readers), static_cast<int>(writers), 8 << i);
+
+		total_bytes += io_read_handlers[i].pages_bytes() + sizeof(io_read_handlers[i]);
+		total_bytes += io_write_handlers[i].pages_bytes() + sizeof(io_write_handlers[i]);
+		io_read_handlers[i].clear();
+		io_write_handlers[i].clear();
+	}
+	DEBUG_LOG_MSG("IOBUS: Handlers consumed %d total bytes",
+	              static_cast<int>(total_bytes));
+}
+
 void IO_RegisterReadHandler(io_port_t port,
                             const io_read_f handler,
                             const io_width_t max_width,
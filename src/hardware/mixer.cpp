@@ -31,6 +31,10 @@
 #include <algorithm>
 #include <array>
 #include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 #if defined (WIN32)
 //Midi listing
@@ -43,6 +47,7 @@
 
 #include <SDL.h>
 
+#include "control.h"
 #include "mem.h"
 #include "pic.h"
 #include "mixer.h"
@@ -54,6 +59,8 @@
 #include "hardware.h"
 #include "programs.h"
 #include "midi.h"
+#include "mixer_kernels.h"
+#include "support.h"
 
 #define MIXER_SSIZE 4
 
@@ -135,7 +142,8 @@ MixerChannel::MixerChannel(MIXER_Handler _handler,
         : name(_name),
           done(0),
           envelope(name),
-          handler(_handler)
+          handler(_handler),
+          work(mixer.work.data())
 {}
 
 MixerChannel * MIXER_AddChannel(MIXER_Handler handler, Bitu freq, const char * name) {
@@ -183,14 +191,21 @@ void MIXER_DelChannel(MixerChannel* delchan) {
 	}
 }
 
+// Set on the mixer's worker threads. They only ever run while the
+// emulation thread holds the audio device lock on their behalf, so taking it
+// again from a worker would deadlock.
+static thread_local bool is_mixer_worker = false;
+
 static void MIXER_LockAudioDevice()
 {
-	SDL_LockAudioDevice(mixer.sdldevice);
+	if (!is_mixer_worker)
+		SDL_LockAudioDevice(mixer.sdldevice);
 }
 
 static void MIXER_UnlockAudioDevice()
 {
-	SDL_UnlockAudioDevice(mixer.sdldevice);
+	if (!is_mixer_worker)
+		SDL_UnlockAudioDevice(mixer.sdldevice);
 }
 
 void MixerChannel::RegisterLevelCallBack(apply_level_callback_f cb)
@@ -282,6 +297,8 @@ void MixerChannel::Enable(const bool should_enable)
 		// start clean if/when this channel is re-enabled.
 		// Samples can be buffered into disable channels, so
 		// we don't perform this zero'ing in the enable phase.
+		if (is_mixing_in_parallel)
+			parallel_done = std::max<Bitu>(parallel_done, done);
 		done = 0u;
 		needed = 0u;
 		prev_sample[0] = 0;
@@ -325,6 +342,17 @@ void MixerChannel::SetPeakAmplitude(const uint32_t peak)
 	                ENVELOPE_MAX_EXPANSION_OVER_MS, ENVELOPE_EXPIRES_AFTER_S);
 }
 
+void MixerChannel::AllowParallelMix(std::function<void()> _joined)
+{
+	is_parallel_allowed = true;
+	joined = _joined;
+}
+
+bool MixerChannel::IsParallelMixAllowed() const
+{
+	return is_parallel_allowed;
+}
+
 void MixerChannel::Mix(Bitu _needed) {
 	needed=_needed;
 	while (is_enabled && needed > done) {
@@ -333,6 +361,10 @@ void MixerChannel::Mix(Bitu _needed) {
 		left  = (left >> FREQ_SHIFT) + ((left & FREQ_MASK)!=0);
 		handler(static_cast<uint16_t>(left));
 	}
+	// When mixing in parallel, this runs on the emulation thread after the
+	// workers have been joined instead
+	if (joined && !is_mixing_in_parallel)
+		joined();
 }
 
 void MixerChannel::AddSilence()
@@ -362,9 +394,9 @@ void MixerChannel::AddSilence()
 
 				mixpos &= MIXER_BUFMASK;
 
-				mixer.work[mixpos][0] += static_cast<int32_t>(
+				work[mixpos][0] += static_cast<int32_t>(
 				        prev_sample[0] * volmul[0]);
-				mixer.work[mixpos][1] += static_cast<int32_t>(
+				work[mixpos][1] += static_cast<int32_t>(
 				        (stereo ? prev_sample[1] : prev_sample[0]) *
 				        volmul[1]);
 
@@ -409,12 +441,82 @@ constexpr void fill_8to16_lut()
 #define MIXER_UPRAMP_STEPS 0
 #define MIXER_UPRAMP_SAVE 512
 
+// Decoded samples of the block being added; per thread, as the mixer's
+// workers add blocks concurrently.
+static thread_local std::vector<int32_t> decoded_samples = {};
+
+// Decode 'samples' values into signed 32-bit samples, the block-wise
+// counterpart of the per-sample conversions in AddSamples below. Note that
+// non-native data is little-endian, so it only needs swapping on big-endian
+// hosts.
+template <class Type, bool signeddata, bool nativeorder>
+static void decode_samples(const Type *data, size_t samples, int32_t *out)
+{
+#ifdef WORDS_BIGENDIAN
+	constexpr bool is_swapped = !nativeorder;
+#else
+	constexpr bool is_swapped = false;
+#endif
+	if constexpr (sizeof(Type) == 1) {
+		const int16_t *lut = signeddata ? lut_s8to16 : lut_u8to16;
+		for (size_t i = 0; i < samples; ++i)
+			out[i] = lut[data[i]];
+	} else if constexpr (sizeof(Type) == 2) {
+		mixer_kernels.decode16(reinterpret_cast<const uint16_t *>(data),
+		                       out, samples, signeddata, is_swapped);
+	} else {
+		static_assert(signeddata, "32-bit samples are always signed");
+		mixer_kernels.decode32(reinterpret_cast<const uint32_t *>(data),
+		                       out, samples, is_swapped);
+	}
+}
+
 template<class Type,bool stereo,bool signeddata,bool nativeorder>
 void MixerChannel::AddSamples(Bitu len, const Type* data) {
 	MIXER_LockAudioDevice();
 
 	last_samples_were_stereo = stereo;
 
+	// When the channel runs at the mixer's rate, with its default channel
+	// mapping, and the envelope has gone dormant, each output frame is
+	// simply the previous input frame. That lets us hand the whole block to
+	// the mixer kernels instead of stepping through it sample by sample.
+	const bool is_mapped_straight = channel_map[0] == 0 &&
+	                                (!stereo || channel_map[1] == 1);
+	if (MIXER_UPRAMP_STEPS == 0 && len && !interpolate &&
+	    freq_counter >= FREQ_NEXT && freq_counter < 2 * FREQ_NEXT &&
+	    is_mapped_straight && !envelope.IsActive()) {
+		constexpr size_t channels = stereo ? 2 : 1;
+		decoded_samples.resize((len + 1) * channels);
+		int32_t *frames = decoded_samples.data();
+
+		// The pending frame goes out first, then all but the last frame
+		// of the block, which becomes the new pending one.
+		for (size_t c = 0; c < channels; ++c)
+			frames[c] = static_cast<int32_t>(next_sample[c]);
+		decode_samples<Type, signeddata, nativeorder>(data, len * channels,
+		                                              frames + channels);
+
+		Bitu mixpos = (mixer.pos + done) & MIXER_BUFMASK;
+		for (Bitu remaining = len; remaining;) {
+			const Bitu n = std::min<Bitu>(remaining, MIXER_BUFSIZE - mixpos);
+			mixer_kernels.accumulate(work[mixpos].data(), frames,
+			                         n, stereo, volmul[0], volmul[1]);
+			frames += n * channels;
+			remaining -= n;
+			mixpos = (mixpos + n) & MIXER_BUFMASK;
+		}
+		const int32_t *last = frames - channels;
+		for (size_t c = 0; c < channels; ++c) {
+			prev_sample[c] = last[c];
+			next_sample[c] = frames[c];
+		}
+		done += len;
+		last_samples_were_silence = false;
+		MIXER_UnlockAudioDevice();
+		return;
+	}
+
 	//Position where to write the data
 	Bitu mixpos = mixer.pos + done;
 	//Position in the incoming data
@@ -551,22 +653,20 @@ void MixerChannel::AddSamples(Bitu len, const Type* data) {
 		//Where to write
 		mixpos &= MIXER_BUFMASK;
 		if (!interpolate) {
-			mixer.work[mixpos][0] += static_cast<int32_t>(
+			work[mixpos][0] += static_cast<int32_t>(
 			        prev_sample[left_map] * volmul[0]);
-			mixer.work[mixpos][1] += static_cast<int32_t>(
+			work[mixpos][1] += static_cast<int32_t>(
 			        (stereo ? prev_sample[right_map]
 			                : prev_sample[left_map]) *
 			        volmul[1]);
 		} else {
 			Bits diff_mul = freq_counter & FREQ_MASK;
 			Bits sample = prev_sample[left_map] + (((next_sample[left_map] - prev_sample[left_map]) * diff_mul) >> FREQ_SHIFT);
-			mixer.work[mixpos][0] += static_cast<int32_t>(sample *
-			                                              volmul[0]);
+			work[mixpos][0] += static_cast<int32_t>(sample * volmul[0]);
 			if (stereo) {
 				sample = prev_sample[right_map] + (((next_sample[right_map] - prev_sample[right_map]) * diff_mul) >> FREQ_SHIFT);
 			}
-			mixer.work[mixpos][1] += static_cast<int32_t>(sample *
-			                                              volmul[1]);
+			work[mixpos][1] += static_cast<int32_t>(sample * volmul[1]);
 		}
 		//Prepare for next sample
 		freq_counter += freq_add;
@@ -605,8 +705,8 @@ void MixerChannel::AddStretched(Bitu len,Bit16s * data) {
 		index += index_add;
 		mixpos &= MIXER_BUFMASK;
 		Bits sample = prev_sample[0] + ((diff * diff_mul) >> FREQ_SHIFT);
-		mixer.work[mixpos][0] += static_cast<int32_t>(sample * volmul[0]);
-		mixer.work[mixpos][1] += static_cast<int32_t>(sample * volmul[1]);
+		work[mixpos][0] += static_cast<int32_t>(sample * volmul[0]);
+		work[mixpos][1] += static_cast<int32_t>(sample * volmul[1]);
 		mixpos++;
 	}
 
@@ -668,9 +768,9 @@ void MixerChannel::FillUp()
 {
 	if (!is_enabled || done < mixer.done)
 		return;
-	const auto index = PIC_TickIndex();
+	const auto needed = PIC_TickPortion(mixer.needed);
 	MIXER_LockAudioDevice();
-	Mix((Bitu)(index * static_cast<double>(mixer.needed)));
+	Mix(static_cast<Bitu>(needed));
 	MIXER_UnlockAudioDevice();
 }
 
@@ -693,26 +793,184 @@ static constexpr Bit32u calc_tickadd(Bit32u freq) {
 #endif
 }
 
-/* Mix a certain amount of new samples */
-static void MIXER_MixData(Bitu needed) {
-	MixerChannel * chan=mixer.channels;
-	while (chan) {
+/*  Parallel Mixing
+ *  ---------------
+ *  Channels that allow it have their handlers run by a pool of worker
+ *  threads, each into the channel's private buffer, while the emulation
+ *  thread runs the remaining channels straight into the work buffer. The
+ *  emulation thread then waits for the workers and adds the private buffers
+ *  in channel order.
+ *
+ *  As the emulation thread is blocked for the whole tick, the guest can't
+ *  write to a device while its channel renders, so register writes keep
+ *  landing between ticks (or in FillUp) exactly as they do when mixing
+ *  serially. The summation wraps around in 32 bits just like the serial
+ *  accumulation, so the mixed output is bit-identical either way.
+ */
+class MixerWorkers {
+public:
+	~MixerWorkers() { Stop(); }
+
+	void Start(int num_threads);
+	void Stop();
+
+	// Mixes every channel up to 'needed' frames
+	void Mix(Bitu needed);
+
+private:
+	struct Job {
+		MixerChannel *chan = nullptr;
+		Bitu begin = 0u; // first frame the channel can write this tick
+	};
+
+	void Work();
+	void AddPrivateWork(const Job &job);
+
+	std::vector<std::thread> threads = {};
+	std::vector<Job> jobs = {};
+	std::mutex mutex = {};
+	std::condition_variable has_jobs = {};
+	std::condition_variable jobs_done = {};
+	// Guarded by the mutex
+	size_t next_job = 0;
+	size_t jobs_left = 0;
+	Bitu needed = 0u;
+	bool is_stopping = false;
+};
+
+static MixerWorkers workers;
+
+void MixerWorkers::Start(const int num_threads)
+{
+	assert(threads.empty());
+	is_stopping = false;
+	for (int i = 0; i < num_threads; ++i) {
+		threads.emplace_back(&MixerWorkers::Work, this);
+		set_thread_name(threads.back(), "dosbox:mixer");
+	}
+}
+
+void MixerWorkers::Stop()
+{
+	if (threads.empty())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		is_stopping = true;
+	}
+	has_jobs.notify_all();
+	for (auto &thread : threads)
+		thread.join();
+	threads.clear();
+}
+
+void MixerWorkers::Work()
+{
+	is_mixer_worker = true;
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true) {
+		has_jobs.wait(lock, [this] {
+			return is_stopping || next_job < jobs.size();
+		});
+		if (is_stopping)
+			return;
+		MixerChannel *chan = jobs[next_job++].chan;
+		lock.unlock();
 		chan->Mix(needed);
-		chan=chan->next;
+		lock.lock();
+		if (--jobs_left == 0)
+			jobs_done.notify_one();
+	}
+}
+
+void MixerWorkers::AddPrivateWork(const Job &job)
+{
+	MixerChannel &chan = *job.chan;
+	const Bitu end = std::max<Bitu>(chan.done, chan.parallel_done);
+	const Bitu frames = std::min<Bitu>(end - std::min(job.begin, end),
+	                                   MIXER_BUFSIZE);
+	Bitu pos = (mixer.pos + job.begin) & MIXER_BUFMASK;
+	for (Bitu i = 0; i < frames; ++i) {
+		auto &frame = chan.private_work[pos];
+		mixer.work[pos][0] += frame[0];
+		mixer.work[pos][1] += frame[1];
+		frame = {0, 0};
+		pos = (pos + 1) & MIXER_BUFMASK;
+	}
+	chan.work = mixer.work.data();
+	chan.is_mixing_in_parallel = false;
+	chan.parallel_done = 0u;
+	if (chan.joined)
+		chan.joined();
+}
+
+void MixerWorkers::Mix(const Bitu _needed)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	jobs.clear();
+	if (!threads.empty()) {
+		for (auto chan = mixer.channels; chan; chan = chan->next) {
+			if (!chan->is_parallel_allowed || !chan->is_enabled)
+				continue;
+			if (chan->private_work.empty())
+				chan->private_work.resize(MIXER_BUFSIZE);
+			chan->work = chan->private_work.data();
+			chan->is_mixing_in_parallel = true;
+			const Bitu begin = std::min<Bitu>(chan->done, mixer.done);
+			jobs.push_back({chan, begin});
+		}
+	}
+	next_job = 0;
+	jobs_left = jobs.size();
+	needed = _needed;
+	lock.unlock();
+	if (!jobs.empty())
+		has_jobs.notify_all();
+
+	for (auto chan = mixer.channels; chan; chan = chan->next)
+		if (!chan->is_mixing_in_parallel)
+			chan->Mix(_needed);
+
+	if (jobs.empty())
+		return;
+
+	// Help out with whatever the workers haven't picked up yet
+	lock.lock();
+	while (next_job < jobs.size()) {
+		MixerChannel *chan = jobs[next_job++].chan;
+		lock.unlock();
+		chan->Mix(_needed);
+		lock.lock();
+		--jobs_left;
 	}
+	jobs_done.wait(lock, [this] { return jobs_left == 0; });
+	lock.unlock();
+
+	for (const auto &job : jobs)
+		AddPrivateWork(job);
+}
+
+/* Mix a certain amount of new samples */
+static void MIXER_MixData(Bitu needed) {
+	workers.Mix(needed);
 	if (CaptureState & (CAPTURE_WAVE|CAPTURE_VIDEO)) {
 		int16_t convert[1024][2];
 		const size_t added = std::min<size_t>(needed - mixer.done, 1024);
 		size_t readpos = (mixer.pos + mixer.done) & MIXER_BUFMASK;
+		for (size_t i = 0; i < added;) {
+			const size_t n = std::min<size_t>(added - i,
+			                                  MIXER_BUFSIZE - readpos);
+			mixer_kernels.clip(mixer.work[readpos].data(), convert[i],
+			                   n * 2, MIXER_VOLSHIFT);
+			i += n;
+			readpos = (readpos + n) & MIXER_BUFMASK;
+		}
+#ifdef WORDS_BIGENDIAN
 		for (size_t i = 0; i < added; i++) {
-			const int32_t sample_1 = mixer.work[readpos][0] >> MIXER_VOLSHIFT;
-			const int32_t sample_2 = mixer.work[readpos][1] >> MIXER_VOLSHIFT;
-			const int16_t s1 = MIXER_CLIP(sample_1);
-			const int16_t s2 = MIXER_CLIP(sample_2);
-			convert[i][0] = host_to_le16(s1);
-			convert[i][1] = host_to_le16(s2);
-			readpos = (readpos + 1) & MIXER_BUFMASK;
+			convert[i][0] = host_to_le16(convert[i][0]);
+			convert[i][1] = host_to_le16(convert[i][1]);
 		}
+#endif
 		CAPTURE_AddWave(mixer.freq, added, reinterpret_cast<int16_t*>(convert));
 	}
 	//Reset the the tick_add for constant speed
@@ -861,15 +1119,15 @@ static void SDLCALL MIXER_CallBack(MAYBE_UNUSED void *userdata, Uint8 *stream, i
 			pos++;
 		}
 	} else {
-		while (reduce--) {
+		while (reduce) {
 			pos &= MIXER_BUFMASK;
-			sample = mixer.work[pos][0] >> MIXER_VOLSHIFT;
-			*output++ = MIXER_CLIP(sample);
-			sample = mixer.work[pos][1] >> MIXER_VOLSHIFT;
-			*output++ = MIXER_CLIP(sample);
-			mixer.work[pos][0] = 0;
-			mixer.work[pos][1] = 0;
-			pos++;
+			const auto n = std::min<Bit32u>(reduce, MIXER_BUFSIZE - pos);
+			int32_t *work = mixer.work[pos].data();
+			mixer_kernels.clip(work, output, n * 2, MIXER_VOLSHIFT);
+			memset(work, 0, n * sizeof(mixer.work[0]));
+			output += n * 2;
+			pos += n;
+			reduce -= n;
 		}
 	}
 }
@@ -877,7 +1135,9 @@ static void SDLCALL MIXER_CallBack(MAYBE_UNUSED void *userdata, Uint8 *stream, i
 #undef INDEX_SHIFT_LOCAL
 
 static void MIXER_Stop(MAYBE_UNUSED Section *sec)
-{}
+{
+	workers.Stop();
+}
 
 class MIXER final : public Program {
 public:
@@ -973,10 +1233,14 @@ void MIXER_Init(Section* sec) {
 	Section_prop * section=static_cast<Section_prop *>(sec);
 	/* Read out config section */
 
-	mixer.nosound=section->Get_bool("nosound");
+	// Headless runs have nobody listening, so mix into a null sink. The
+	// section keeps the user's setting, so writeconf doesn't save this.
+	mixer.nosound = section->Get_bool("nosound") ||
+	                control->cmdline->FindExist("-headless");
 	mixer.freq = static_cast<uint32_t>(section->Get_int("rate"));
 	mixer.blocksize = static_cast<uint16_t>(section->Get_int("blocksize"));
 	const auto negotiate = static_cast<bool>(section->Get_bool("negotiate"));
+	const auto num_threads = section->Get_int("threads");
 
 	/* Start the Mixer using SDL Sound at 22 khz */
 	SDL_AudioSpec spec;
@@ -1050,6 +1314,14 @@ void MIXER_Init(Section* sec) {
 	// Initialize the 8-bit to 16-bit lookup table
 	fill_8to16_lut();
 
+	LOG_MSG("MIXER: Using %s mixing kernels", MIXER_SelectKernels());
+
+	if (num_threads > 0) {
+		workers.Start(num_threads);
+		LOG_MSG("MIXER: Rendering channels in parallel on %d worker threads",
+		        num_threads);
+	}
+
 	PROGRAMS_MakeFile("MIXER.COM",MIXER_ProgramStart);
 }
 
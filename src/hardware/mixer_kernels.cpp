@@ -0,0 +1,431 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "mixer_kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || \
+        (defined(__i386__) && defined(__SSE2__))
+#define MIXER_KERNELS_SSE2 1
+#include <immintrin.h>
+// Only GCC and Clang let us build AVX2 functions into a baseline binary
+#if defined(__GNUC__)
+#define MIXER_KERNELS_AVX2 1
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define MIXER_KERNELS_NEON 1
+#include <arm_neon.h>
+#endif
+
+// Scalar reference
+// ~~~~~~~~~~~~~~~~
+// The SIMD sets below fall back to these for the leftover tail of a block.
+
+static inline uint16_t swap16(const uint16_t v)
+{
+	return static_cast<uint16_t>((v << 8) | (v >> 8));
+}
+
+static inline uint32_t swap32(const uint32_t v)
+{
+	return (v << 24) | ((v << 8) & 0x00ff0000) | ((v >> 8) & 0x0000ff00) |
+	       (v >> 24);
+}
+
+static void decode16_scalar(const uint16_t *in, int32_t *out, size_t samples,
+                            bool is_signed, bool is_swapped)
+{
+	for (size_t i = 0; i < samples; ++i) {
+		const uint16_t v = is_swapped ? swap16(in[i]) : in[i];
+		out[i] = is_signed ? static_cast<int16_t>(v)
+		                   : static_cast<int32_t>(v) - 32768;
+	}
+}
+
+static void decode32_scalar(const uint32_t *in, int32_t *out, size_t samples,
+                            bool is_swapped)
+{
+	for (size_t i = 0; i < samples; ++i)
+		out[i] = static_cast<int32_t>(is_swapped ? swap32(in[i]) : in[i]);
+}
+
+// The products and sums wrap at 32 bits, just like the per-sample code in
+// MixerChannel::AddSamples does; unsigned math keeps that well-defined.
+static inline void accumulate_frame(int32_t *work, int32_t left, int32_t right,
+                                    int32_t vol_left, int32_t vol_right)
+{
+	work[0] = static_cast<int32_t>(static_cast<uint32_t>(work[0]) +
+	                               static_cast<uint32_t>(left) *
+	                                       static_cast<uint32_t>(vol_left));
+	work[1] = static_cast<int32_t>(static_cast<uint32_t>(work[1]) +
+	                               static_cast<uint32_t>(right) *
+	                                       static_cast<uint32_t>(vol_right));
+}
+
+static void accumulate_scalar(int32_t *work, const int32_t *in, size_t frames,
+                              bool is_stereo, int32_t vol_left, int32_t vol_right)
+{
+	for (size_t i = 0; i < frames; ++i) {
+		const int32_t left = is_stereo ? in[i * 2] : in[i];
+		const int32_t right = is_stereo ? in[i * 2 + 1] : left;
+		accumulate_frame(work + i * 2, left, right, vol_left, vol_right);
+	}
+}
+
+static void clip_scalar(const int32_t *work, int16_t *out, size_t samples, int shift)
+{
+	for (size_t i = 0; i < samples; ++i) {
+		const int32_t s = work[i] >> shift;
+		out[i] = static_cast<int16_t>(s <= INT16_MIN   ? INT16_MIN
+		                              : s >= INT16_MAX ? INT16_MAX
+		                                               : s);
+	}
+}
+
+#if MIXER_KERNELS_SSE2
+
+// SSE2
+// ~~~~
+
+// SSE2 has no 32-bit low multiply, so build it from two 32x32->64 ones
+static inline __m128i mullo_epi32_sse2(const __m128i a, const __m128i b)
+{
+	const __m128i even = _mm_mul_epu32(a, b);
+	const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32),
+	                                  _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)),
+	                          _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+static void decode16_sse2(const uint16_t *in, int32_t *out, size_t samples,
+                          bool is_signed, bool is_swapped)
+{
+	const __m128i sign_flip = _mm_set1_epi16(is_signed ? 0 : INT16_MIN);
+	size_t i = 0;
+	for (; i + 8 <= samples; i += 8) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+		if (is_swapped)
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+		v = _mm_xor_si128(v, sign_flip);
+		const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+		const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), lo);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i + 4), hi);
+	}
+	decode16_scalar(in + i, out + i, samples - i, is_signed, is_swapped);
+}
+
+static void decode32_sse2(const uint32_t *in, int32_t *out, size_t samples,
+                          bool is_swapped)
+{
+	const __m128i mid_hi = _mm_set1_epi32(0x00ff0000);
+	const __m128i mid_lo = _mm_set1_epi32(0x0000ff00);
+	size_t i = 0;
+	for (; i + 4 <= samples; i += 4) {
+		__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+		if (is_swapped) {
+			const __m128i outer = _mm_or_si128(_mm_slli_epi32(v, 24),
+			                                   _mm_srli_epi32(v, 24));
+			const __m128i inner = _mm_or_si128(
+			        _mm_and_si128(_mm_slli_epi32(v, 8), mid_hi),
+			        _mm_and_si128(_mm_srli_epi32(v, 8), mid_lo));
+			v = _mm_or_si128(outer, inner);
+		}
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), v);
+	}
+	decode32_scalar(in + i, out + i, samples - i, is_swapped);
+}
+
+static void accumulate_sse2(int32_t *work, const int32_t *in, size_t frames,
+                            bool is_stereo, int32_t vol_left, int32_t vol_right)
+{
+	const __m128i vol = _mm_set_epi32(vol_right, vol_left, vol_right, vol_left);
+	size_t i = 0;
+	for (; i + 4 <= frames; i += 4) {
+		__m128i a, b;
+		if (is_stereo) {
+			a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 2));
+			b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i * 2 + 4));
+		} else {
+			const __m128i s = _mm_loadu_si128(
+			        reinterpret_cast<const __m128i *>(in + i));
+			a = _mm_unpacklo_epi32(s, s);
+			b = _mm_unpackhi_epi32(s, s);
+		}
+		__m128i *dst = reinterpret_cast<__m128i *>(work + i * 2);
+		_mm_storeu_si128(dst, _mm_add_epi32(_mm_loadu_si128(dst),
+		                                    mullo_epi32_sse2(a, vol)));
+		_mm_storeu_si128(dst + 1, _mm_add_epi32(_mm_loadu_si128(dst + 1),
+		                                        mullo_epi32_sse2(b, vol)));
+	}
+	accumulate_scalar(work + i * 2, in + (is_stereo ? i * 2 : i), frames - i,
+	                  is_stereo, vol_left, vol_right);
+}
+
+static void clip_sse2(const int32_t *work, int16_t *out, size_t samples, int shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	size_t i = 0;
+	for (; i + 8 <= samples; i += 8) {
+		const __m128i a = _mm_sra_epi32(
+		        _mm_loadu_si128(reinterpret_cast<const __m128i *>(work + i)),
+		        count);
+		const __m128i b = _mm_sra_epi32(
+		        _mm_loadu_si128(reinterpret_cast<const __m128i *>(work + i + 4)),
+		        count);
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i),
+		                 _mm_packs_epi32(a, b));
+	}
+	clip_scalar(work + i, out + i, samples - i, shift);
+}
+
+#endif // MIXER_KERNELS_SSE2
+
+#if MIXER_KERNELS_AVX2
+
+// AVX2
+// ~~~~
+
+#define AVX2_TARGET __attribute__((target("avx2")))
+
+AVX2_TARGET static void decode16_avx2(const uint16_t *in, int32_t *out,
+                                      size_t samples, bool is_signed,
+                                      bool is_swapped)
+{
+	const __m256i swap_mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8,
+	                                           11, 10, 13, 12, 15, 14, 1, 0,
+	                                           3, 2, 5, 4, 7, 6, 9, 8, 11,
+	                                           10, 13, 12, 15, 14);
+	const __m256i sign_flip = _mm256_set1_epi16(is_signed ? 0 : INT16_MIN);
+	size_t i = 0;
+	for (; i + 16 <= samples; i += 16) {
+		__m256i v = _mm256_loadu_si256(
+		        reinterpret_cast<const __m256i *>(in + i));
+		if (is_swapped)
+			v = _mm256_shuffle_epi8(v, swap_mask);
+		v = _mm256_xor_si256(v, sign_flip);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i),
+		                    _mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i + 8),
+		                    _mm256_cvtepi16_epi32(
+		                            _mm256_extracti128_si256(v, 1)));
+	}
+	decode16_sse2(in + i, out + i, samples - i, is_signed, is_swapped);
+}
+
+AVX2_TARGET static void decode32_avx2(const uint32_t *in, int32_t *out,
+                                      size_t samples, bool is_swapped)
+{
+	const __m256i swap_mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10,
+	                                           9, 8, 15, 14, 13, 12, 3, 2, 1,
+	                                           0, 7, 6, 5, 4, 11, 10, 9, 8,
+	                                           15, 14, 13, 12);
+	size_t i = 0;
+	for (; i + 8 <= samples; i += 8) {
+		__m256i v = _mm256_loadu_si256(
+		        reinterpret_cast<const __m256i *>(in + i));
+		if (is_swapped)
+			v = _mm256_shuffle_epi8(v, swap_mask);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), v);
+	}
+	decode32_sse2(in + i, out + i, samples - i, is_swapped);
+}
+
+AVX2_TARGET static void accumulate_avx2(int32_t *work, const int32_t *in,
+                                        size_t frames, bool is_stereo,
+                                        int32_t vol_left, int32_t vol_right)
+{
+	const __m256i vol = _mm256_setr_epi32(vol_left, vol_right, vol_left,
+	                                      vol_right, vol_left, vol_right,
+	                                      vol_left, vol_right);
+	const __m256i dup = _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3);
+	size_t i = 0;
+	for (; i + 4 <= frames; i += 4) {
+		__m256i s;
+		if (is_stereo)
+			s = _mm256_loadu_si256(
+			        reinterpret_cast<const __m256i *>(in + i * 2));
+		else
+			s = _mm256_permutevar8x32_epi32(
+			        _mm256_castsi128_si256(_mm_loadu_si128(
+			                reinterpret_cast<const __m128i *>(in + i))),
+			        dup);
+		__m256i *dst = reinterpret_cast<__m256i *>(work + i * 2);
+		_mm256_storeu_si256(dst, _mm256_add_epi32(_mm256_loadu_si256(dst),
+		                                          _mm256_mullo_epi32(s, vol)));
+	}
+	accumulate_sse2(work + i * 2, in + (is_stereo ? i * 2 : i), frames - i,
+	                is_stereo, vol_left, vol_right);
+}
+
+AVX2_TARGET static void clip_avx2(const int32_t *work, int16_t *out,
+                                  size_t samples, int shift)
+{
+	const __m128i count = _mm_cvtsi32_si128(shift);
+	size_t i = 0;
+	for (; i + 16 <= samples; i += 16) {
+		const __m256i a = _mm256_sra_epi32(
+		        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(work + i)),
+		        count);
+		const __m256i b = _mm256_sra_epi32(
+		        _mm256_loadu_si256(
+		                reinterpret_cast<const __m256i *>(work + i + 8)),
+		        count);
+		// packs works per 128-bit lane, so put the quarters back in order
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(a, b),
+		                                                _MM_SHUFFLE(3, 1, 2, 0));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), packed);
+	}
+	clip_sse2(work + i, out + i, samples - i, shift);
+}
+
+#undef AVX2_TARGET
+
+#endif // MIXER_KERNELS_AVX2
+
+#if MIXER_KERNELS_NEON
+
+// NEON
+// ~~~~
+
+static void decode16_neon(const uint16_t *in, int32_t *out, size_t samples,
+                          bool is_signed, bool is_swapped)
+{
+	const uint16x8_t sign_flip = vdupq_n_u16(is_signed ? 0 : 0x8000);
+	size_t i = 0;
+	for (; i + 8 <= samples; i += 8) {
+		uint16x8_t v = vld1q_u16(in + i);
+		if (is_swapped)
+			v = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(v)));
+		const int16x8_t s = vreinterpretq_s16_u16(veorq_u16(v, sign_flip));
+		vst1q_s32(out + i, vmovl_s16(vget_low_s16(s)));
+		vst1q_s32(out + i + 4, vmovl_s16(vget_high_s16(s)));
+	}
+	decode16_scalar(in + i, out + i, samples - i, is_signed, is_swapped);
+}
+
+static void decode32_neon(const uint32_t *in, int32_t *out, size_t samples,
+                          bool is_swapped)
+{
+	size_t i = 0;
+	for (; i + 4 <= samples; i += 4) {
+		uint32x4_t v = vld1q_u32(in + i);
+		if (is_swapped)
+			v = vreinterpretq_u32_u8(vrev32q_u8(vreinterpretq_u8_u32(v)));
+		vst1q_s32(out + i, vreinterpretq_s32_u32(v));
+	}
+	decode32_scalar(in + i, out + i, samples - i, is_swapped);
+}
+
+static void accumulate_neon(int32_t *work, const int32_t *in, size_t frames,
+                            bool is_stereo, int32_t vol_left, int32_t vol_right)
+{
+	const int32_t vols[4] = {vol_left, vol_right, vol_left, vol_right};
+	const int32x4_t vol = vld1q_s32(vols);
+	size_t i = 0;
+	for (; i + 4 <= frames; i += 4) {
+		int32x4x2_t s;
+		if (is_stereo) {
+			s.val[0] = vld1q_s32(in + i * 2);
+			s.val[1] = vld1q_s32(in + i * 2 + 4);
+		} else {
+			const int32x4_t m = vld1q_s32(in + i);
+			s = vzipq_s32(m, m);
+		}
+		int32_t *dst = work + i * 2;
+		vst1q_s32(dst, vmlaq_s32(vld1q_s32(dst), s.val[0], vol));
+		vst1q_s32(dst + 4, vmlaq_s32(vld1q_s32(dst + 4), s.val[1], vol));
+	}
+	accumulate_scalar(work + i * 2, in + (is_stereo ? i * 2 : i), frames - i,
+	                  is_stereo, vol_left, vol_right);
+}
+
+static void clip_neon(const int32_t *work, int16_t *out, size_t samples, int shift)
+{
+	const int32x4_t count = vdupq_n_s32(-shift);
+	size_t i = 0;
+	for (; i + 8 <= samples; i += 8) {
+		const int32x4_t a = vshlq_s32(vld1q_s32(work + i), count);
+		const int32x4_t b = vshlq_s32(vld1q_s32(work + i + 4), count);
+		vst1q_s16(out + i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+	}
+	clip_scalar(work + i, out + i, samples - i, shift);
+}
+
+#endif // MIXER_KERNELS_NEON
+
+// Dispatch
+// ~~~~~~~~
+
+static const MixerKernels kernel_sets[] = {
+        {decode16_scalar, decode32_scalar, accumulate_scalar, clip_scalar, "scalar"},
+#if MIXER_KERNELS_SSE2
+        {decode16_sse2, decode32_sse2, accumulate_sse2, clip_sse2, "SSE2"},
+#endif
+#if MIXER_KERNELS_AVX2
+        {decode16_avx2, decode32_avx2, accumulate_avx2, clip_avx2, "AVX2"},
+#endif
+#if MIXER_KERNELS_NEON
+        {decode16_neon, decode32_neon, accumulate_neon, clip_neon, "NEON"},
+#endif
+};
+
+constexpr size_t num_kernel_sets = sizeof(kernel_sets) / sizeof(kernel_sets[0]);
+
+// SSE2 and NEON are part of their architectures' baselines, so only AVX2
+// needs to be confirmed by the CPU.
+static bool is_supported(const MixerKernels &set)
+{
+#if MIXER_KERNELS_AVX2
+	if (set.decode16 == decode16_avx2) {
+		__builtin_cpu_init();
+		return __builtin_cpu_supports("avx2");
+	}
+#endif
+	return set.decode16 != nullptr;
+}
+
+#if MIXER_KERNELS_AVX2
+MixerKernels mixer_kernels = kernel_sets[num_kernel_sets - 2];
+#else
+MixerKernels mixer_kernels = kernel_sets[num_kernel_sets - 1];
+#endif
+
+const char *MIXER_SelectKernels()
+{
+	for (size_t i = num_kernel_sets; i-- > 0;) {
+		if (is_supported(kernel_sets[i])) {
+			mixer_kernels = kernel_sets[i];
+			break;
+		}
+	}
+	return mixer_kernels.name;
+}
+
+size_t MIXER_GetKernelSets(const MixerKernels **sets)
+{
+	// Sets needing CPU support come last, so trim them from the end
+	size_t n = num_kernel_sets;
+	while (n > 1 && !is_supported(kernel_sets[n - 1]))
+		--n;
+	*sets = kernel_sets;
+	return n;
+}
@@ -0,0 +1,65 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_MIXER_KERNELS_H
+#define DOSBOX_MIXER_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+
+/*  Mixer Kernels
+ *  -------------
+ *  Block-wise versions of the mixer's inner loops. Every set produces
+ *  bit-identical results to the scalar set, including the 32-bit wrap-around
+ *  when accumulating into the work buffer, so which set runs only affects
+ *  speed.
+ *
+ *  - decode16:   16-bit samples (optionally unsigned and/or byte-swapped)
+ *                into signed 32-bit samples.
+ *  - decode32:   32-bit signed samples, optionally byte-swapped.
+ *  - accumulate: adds 'frames' mono or interleaved stereo samples, scaled by
+ *                the left and right volume multipliers, into the interleaved
+ *                stereo work buffer.
+ *  - clip:       shifts 'samples' work values right by 'shift' and saturates
+ *                them to the signed 16-bit range.
+ */
+
+struct MixerKernels {
+	void (*decode16)(const uint16_t *in, int32_t *out, size_t samples,
+	                 bool is_signed, bool is_swapped);
+	void (*decode32)(const uint32_t *in, int32_t *out, size_t samples,
+	                 bool is_swapped);
+	void (*accumulate)(int32_t *work, const int32_t *in, size_t frames,
+	                   bool is_stereo, int32_t vol_left, int32_t vol_right);
+	void (*clip)(const int32_t *work, int16_t *out, size_t samples, int shift);
+	const char *name;
+};
+
+// The kernels in use; starts out as the best set the build targets without
+// asking the CPU, MIXER_SelectKernels() upgrades it at runtime.
+extern MixerKernels mixer_kernels;
+
+// Picks the fastest set supported by the host CPU and returns its name
+const char *MIXER_SelectKernels();
+
+// Every set the host CPU can run, the scalar reference comes first
+size_t MIXER_GetKernelSets(const MixerKernels **sets);
+
+#endif
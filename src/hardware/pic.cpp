@@ -23,6 +23,11 @@
 #include "pic.h"
 #include "timer.h"
 #include "setup.h"
+#include "pic_event_queue.h"
+
+#include <algorithm>
+#include <cmath>
+#include <utility>
 
 // PIC Controllers
 // ~~~~~~~~~~~~~~~
@@ -38,8 +43,6 @@
 // "master-slave" relationship, which is misleading given that fact that the
 // primary has no control over the secondary.
 
-#define PIC_QUEUESIZE 512
-
 struct PIC_Controller {
 	Bitu icw_words;
 	Bitu icw_index;
@@ -135,6 +138,7 @@ static PIC_Controller pics[2];
 static PIC_Controller &primary_controller = pics[0];
 static PIC_Controller &secondary_controller = pics[1];
 uint32_t PIC_Ticks = 0;
+PIC_Time PIC_TickStart = 0;
 uint32_t PIC_IRQCheck = 0; // x86 dynamic core expects a 32 bit variable size
 
 void PIC_Controller::set_imr(Bit8u val) {
@@ -190,18 +194,10 @@ void PIC_Controller::start_irq(Bit8u val) {
 }
 
 
-struct PICEntry {
-	double index;
-	Bitu value;
-	PIC_EventHandler pic_event;
-	PICEntry * next;
-};
+static PicEventQueue pic_queue;
 
-static struct {
-	PICEntry entries[PIC_QUEUESIZE];
-	PICEntry * free_entry;
-	PICEntry * next_entry;
-} pic_queue;
+// When the event being serviced was due
+static PIC_Time service_timestamp = 0;
 
 static void write_command(io_port_t port, uint8_t val, io_width_t)
 {
@@ -413,106 +409,57 @@ void PIC_SetIRQMask(uint32_t irq, bool masked)
 	pic->set_imr(newmask);
 }
 
-static void AddEntry(PICEntry * entry) {
-	PICEntry * find_entry=pic_queue.next_entry;
-	if (GCC_UNLIKELY(find_entry ==0)) {
-		entry->next=0;
-		pic_queue.next_entry=entry;
-	} else if (find_entry->index>entry->index) {
-		pic_queue.next_entry=entry;
-		entry->next=find_entry;
-	} else while (find_entry) {
-		if (find_entry->next) {
-			/* See if the next index comes later than this one */
-			if (find_entry->next->index > entry->index) {
-				entry->next=find_entry->next;
-				find_entry->next=entry;
-				break;
-			} else {
-				find_entry=find_entry->next;
-			}
-		} else {
-			entry->next=find_entry->next;
-			find_entry->next=entry;
-			break;
-		}
-	}
-	Bits cycles=PIC_MakeCycles(pic_queue.next_entry->index-PIC_TickIndex());
-	if (cycles<CPU_Cycles) {
-		CPU_CycleLeft+=CPU_Cycles;
-		CPU_Cycles=0;
-	}
+// The event's position within the current tick in cycles, scaled up by
+// PIC_TIME_PER_MS. Overdue events are placed at the start of the tick and
+// events beyond the next tick are capped, which keeps the product in range.
+static int64_t ScaledDueCycle(const PicEventQueue::Entry &entry)
+{
+	const auto offset = std::clamp(entry.timestamp - PIC_TickStart,
+	                               PIC_Time(0), 2 * PIC_TIME_PER_MS);
+	return offset * CPU_CycleMax;
 }
+
 static bool InEventService = false;
-static double srv_lag = 0.0;
 
-void PIC_AddEvent(PIC_EventHandler handler, double delay, uint32_t val)
+PIC_EventHandle PIC_AddEvent(PIC_EventHandler handler, double delay, uint32_t val)
 {
-	if (GCC_UNLIKELY(!pic_queue.free_entry)) {
+	if (GCC_UNLIKELY(pic_queue.IsFull())) {
 		LOG(LOG_PIC,LOG_ERROR)("Event queue full");
-		return;
+		return 0;
 	}
-	PICEntry * entry=pic_queue.free_entry;
-	if(InEventService) entry->index = delay + srv_lag;
-	else entry->index = delay + PIC_TickIndex();
-
-	entry->pic_event=handler;
-	entry->value=val;
-	pic_queue.free_entry=pic_queue.free_entry->next;
-	AddEntry(entry);
+	// Events added by an event handler are timed from when that event was
+	// due rather than from when it ran, so periodic events don't drift.
+	const auto start = InEventService ? service_timestamp : PIC_Now();
+	const auto handle = pic_queue.Add(start + PIC_MsToTime(delay), handler, val);
+
+	// End the current run of cycles early if the first event comes sooner
+	const auto cycles = ScaledDueCycle(pic_queue.First()) / PIC_TIME_PER_MS -
+	                    PIC_TickIndexND();
+	if (cycles < CPU_Cycles) {
+		CPU_CycleLeft += CPU_Cycles;
+		CPU_Cycles = 0;
+	}
+	return handle;
 }
 
-void PIC_RemoveSpecificEvents(PIC_EventHandler handler, uint32_t val)
+void PIC_RemoveEvent(const PIC_EventHandle handle)
 {
-	PICEntry *entry = pic_queue.next_entry;
-	PICEntry *prev_entry;
-	prev_entry = 0;
-	while (entry) {
-		if (GCC_UNLIKELY((entry->pic_event == handler)) && (entry->value == val)) {
-			if (prev_entry) {
-				prev_entry->next=entry->next;
-				entry->next=pic_queue.free_entry;
-				pic_queue.free_entry=entry;
-				entry=prev_entry->next;
-				continue;
-			} else {
-				pic_queue.next_entry=entry->next;
-				entry->next=pic_queue.free_entry;
-				pic_queue.free_entry=entry;
-				entry=pic_queue.next_entry;
-				continue;
-			}
-		}
-		prev_entry=entry;
-		entry=entry->next;
-	}
+	pic_queue.Remove(handle);
 }
 
-void PIC_RemoveEvents(PIC_EventHandler handler) {
-	PICEntry * entry=pic_queue.next_entry;
-	PICEntry * prev_entry;
-	prev_entry=0;
-	while (entry) {
-		if (GCC_UNLIKELY(entry->pic_event==handler)) {
-			if (prev_entry) {
-				prev_entry->next=entry->next;
-				entry->next=pic_queue.free_entry;
-				pic_queue.free_entry=entry;
-				entry=prev_entry->next;
-				continue;
-			} else {
-				pic_queue.next_entry=entry->next;
-				entry->next=pic_queue.free_entry;
-				pic_queue.free_entry=entry;
-				entry=pic_queue.next_entry;
-				continue;
-			}
-		}
-		prev_entry=entry;
-		entry=entry->next;
-	}
+void PIC_RemoveSpecificEvents(PIC_EventHandler handler, uint32_t val)
+{
+	pic_queue.RemoveIf([=](const PicEventQueue::Entry &entry) {
+		return entry.pic_event == handler && entry.value == val;
+	});
 }
 
+void PIC_RemoveEvents(PIC_EventHandler handler)
+{
+	pic_queue.RemoveIf([=](const PicEventQueue::Entry &entry) {
+		return entry.pic_event == handler;
+	});
+}
 
 bool PIC_RunQueue(void) {
 	/* Check to see if a new millisecond needs to be started */
@@ -522,33 +469,31 @@ bool PIC_RunQueue(void) {
 		return false;
 	}
 
-	const auto index_nd_f = static_cast<double>(PIC_TickIndexND());
+	const int64_t index_nd = PIC_TickIndexND();
+	const auto scaled_nd = index_nd * PIC_TIME_PER_MS;
 
 	/* Check the queue for an entry */
 	InEventService = true;
-	while (pic_queue.next_entry &&
-	       (pic_queue.next_entry->index * static_cast<double>(CPU_CycleMax) <= index_nd_f)) {
-		PICEntry *entry = pic_queue.next_entry;
-		pic_queue.next_entry = entry->next;
-
-		srv_lag = entry->index;
-		(entry->pic_event)(entry->value); // call the event handler
-
-		/* Put the entry in the free list */
-		entry->next=pic_queue.free_entry;
-		pic_queue.free_entry=entry;
+	while (!pic_queue.IsEmpty() &&
+	       ScaledDueCycle(pic_queue.First()) <= scaled_nd) {
+		const auto &entry = pic_queue.First();
+		const auto handler = entry.pic_event;
+		const auto value = entry.value;
+		service_timestamp = entry.timestamp;
+
+		// Release the entry first, the handler may queue new events
+		pic_queue.RemoveFirst();
+		handler(value);
 	}
 	InEventService = false;
 
 	/* Check when to set the new cycle end */
 	CPU_Cycles = [&] {
-		if (!pic_queue.next_entry) return CPU_CycleLeft;
-		auto cycles = static_cast<int32_t>(
-			pic_queue.next_entry->index * static_cast<double>(CPU_CycleMax) -
-			index_nd_f);
+		if (pic_queue.IsEmpty()) return CPU_CycleLeft;
+		auto cycles = ScaledDueCycle(pic_queue.First()) / PIC_TIME_PER_MS - index_nd;
 		if (GCC_UNLIKELY(!cycles))
 			cycles = 1;
-		return std::min(cycles, CPU_CycleLeft);
+		return static_cast<int32_t>(std::min(cycles, int64_t(CPU_CycleLeft)));
 	}();
 	CPU_CycleLeft-=CPU_Cycles;
 	if (PIC_IRQCheck) PIC_runIRQs();
@@ -590,12 +535,7 @@ void TIMER_AddTick(void) {
 	CPU_CycleLeft=CPU_CycleMax;
 	CPU_Cycles=0;
 	PIC_Ticks++;
-	/* Go through the list of scheduled events and lower their index with 1000 */
-	PICEntry * entry=pic_queue.next_entry;
-	while (entry) {
-		entry->index -= 1.0f;
-		entry=entry->next;
-	}
+	PIC_TickStart += PIC_TIME_PER_MS;
 	/* Call our list of ticker handlers */
 	TickerBlock * ticker=firstticker;
 	while (ticker) {
@@ -615,6 +555,7 @@ public:
 		/* Setup pic0 and pic1 with initial values like DOS has normally */
 		PIC_IRQCheck = 0;
 		PIC_Ticks = 0;
+		PIC_TickStart = 0;
 		Bitu i;
 		for (i=0;i<2;i++) {
 			pics[i].auto_eoi=false;
@@ -649,12 +590,7 @@ public:
 		WriteHandler[2].Install(0xa0, write_command, io_width_t::byte);
 		WriteHandler[3].Install(0xa1, write_data, io_width_t::byte);
 		/* Initialize the pic queue */
-		for (i=0;i<PIC_QUEUESIZE-1;i++) {
-			pic_queue.entries[i].next=&pic_queue.entries[i+1];
-		}
-		pic_queue.entries[PIC_QUEUESIZE-1].next=0;
-		pic_queue.free_entry=&pic_queue.entries[0];
-		pic_queue.next_entry=0;
+		pic_queue.Reset();
 	}
 
 	~PIC_8259A(){
@@ -0,0 +1,204 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#ifndef DOSBOX_PIC_EVENT_QUEUE_H
+#define DOSBOX_PIC_EVENT_QUEUE_H
+
+#include "pic.h"
+
+#include <cassert>
+#include <cstdint>
+
+// PIC Event Queue
+// ~~~~~~~~~~~~~~~
+// Events are due at fixed points in emulated time, so nothing needs updating
+// as the ticks go by. Pending entries form a binary min-heap ordered by
+// timestamp and then by the order they were added, which keeps events that
+// are due at the same time running first-in first-out.
+//
+// Entries come from a fixed pool. Each slot's generation is bumped when its
+// event runs or is removed, so handles to it from before then are ignored.
+
+class PicEventQueue {
+public:
+	static constexpr uint16_t capacity = 512;
+
+	struct Entry {
+		PIC_Time timestamp = 0;
+		uint64_t sequence = 0;
+		uint32_t value = 0;
+		PIC_EventHandler pic_event = nullptr;
+		uint16_t heap_pos = 0;   // index into the heap while pending
+		uint16_t generation = 1; // bumped on release, so stale handles miss
+	};
+
+	PicEventQueue() { Reset(); }
+
+	// Drops every pending event
+	void Reset()
+	{
+		heap_size = 0;
+		free_size = 0;
+		for (auto slot = capacity; slot-- > 0;) {
+			ReleaseSlot(slot);
+		}
+		sequence = 0;
+	}
+
+	bool IsEmpty() const { return heap_size == 0; }
+	bool IsFull() const { return free_size == 0; }
+	uint16_t Size() const { return heap_size; }
+
+	// Returns the handle of the new event, or zero if the queue is full
+	PIC_EventHandle Add(const PIC_Time timestamp, PIC_EventHandler handler,
+	                    const uint32_t value)
+	{
+		if (IsFull())
+			return 0;
+		const auto slot = free_slots[--free_size];
+		auto &entry = entries[slot];
+		entry.timestamp = timestamp;
+		entry.sequence = sequence++;
+		entry.pic_event = handler;
+		entry.value = value;
+
+		PlaceInHeap(slot, heap_size++);
+		SiftUp(entry.heap_pos);
+		return (static_cast<uint32_t>(entry.generation) << 16) | slot;
+	}
+
+	// The event due first; only valid while the queue isn't empty
+	const Entry &First() const
+	{
+		assert(!IsEmpty());
+		return entries[heap[0]];
+	}
+
+	void RemoveFirst() { RemoveAt(0); }
+
+	// Cancels the event if it's still pending, stale handles are ignored
+	void Remove(const PIC_EventHandle handle)
+	{
+		const auto slot = handle & 0xffff;
+		if (slot >= capacity)
+			return;
+		const auto &entry = entries[slot];
+		const auto pos = entry.heap_pos;
+		if (entry.generation == (handle >> 16) && pos < heap_size &&
+		    heap[pos] == slot)
+			RemoveAt(pos);
+	}
+
+	// Drops every pending event that matches, then restores the heap in
+	// one pass
+	template <typename Pred>
+	void RemoveIf(Pred matches)
+	{
+		uint16_t kept = 0;
+		for (uint16_t pos = 0; pos < heap_size; ++pos) {
+			const auto slot = heap[pos];
+			if (matches(entries[slot]))
+				ReleaseSlot(slot);
+			else
+				PlaceInHeap(slot, kept++);
+		}
+		if (kept == heap_size)
+			return;
+		heap_size = kept;
+		for (auto pos = kept / 2; pos-- > 0;)
+			SiftDown(static_cast<uint16_t>(pos));
+	}
+
+private:
+	bool IsEarlier(const uint16_t a, const uint16_t b) const
+	{
+		const auto &ea = entries[a];
+		const auto &eb = entries[b];
+		return ea.timestamp != eb.timestamp ? ea.timestamp < eb.timestamp
+		                                    : ea.sequence < eb.sequence;
+	}
+
+	void PlaceInHeap(const uint16_t slot, const uint16_t pos)
+	{
+		heap[pos] = slot;
+		entries[slot].heap_pos = pos;
+	}
+
+	void SiftUp(uint16_t pos)
+	{
+		const auto slot = heap[pos];
+		while (pos > 0) {
+			const auto parent = static_cast<uint16_t>((pos - 1) / 2);
+			if (!IsEarlier(slot, heap[parent]))
+				break;
+			PlaceInHeap(heap[parent], pos);
+			pos = parent;
+		}
+		PlaceInHeap(slot, pos);
+	}
+
+	void SiftDown(uint16_t pos)
+	{
+		const auto slot = heap[pos];
+		while (true) {
+			auto child = 2 * pos + 1;
+			if (child >= heap_size)
+				break;
+			if (child + 1 < heap_size && IsEarlier(heap[child + 1], heap[child]))
+				++child;
+			if (!IsEarlier(heap[child], slot))
+				break;
+			PlaceInHeap(heap[child], pos);
+			pos = static_cast<uint16_t>(child);
+		}
+		PlaceInHeap(slot, pos);
+	}
+
+	void ReleaseSlot(const uint16_t slot)
+	{
+		auto &generation = entries[slot].generation;
+		if (++generation == 0)
+			generation = 1;
+		free_slots[free_size++] = slot;
+	}
+
+	void RemoveAt(const uint16_t pos)
+	{
+		const auto slot = heap[pos];
+		const auto last = heap[--heap_size];
+		if (pos < heap_size) {
+			PlaceInHeap(last, pos);
+			if (pos > 0 && IsEarlier(last, heap[(pos - 1) / 2]))
+				SiftUp(pos);
+			else
+				SiftDown(pos);
+		}
+		ReleaseSlot(slot);
+	}
+
+	Entry entries[capacity] = {};
+	uint16_t heap[capacity] = {};
+	uint16_t free_slots[capacity] = {};
+	uint16_t heap_size = 0;
+	uint16_t free_size = 0;
+	uint64_t sequence = 0;
+};
+
+#endif
@@ -363,6 +363,7 @@ Ps1Synth::Ps1Synth() : device(machine_config(), 0, 0, clock_rate_hz)
 	channel = mixer_channel_t(MIXER_AddChannel(callback, 0, "PS1"),
 	                          MIXER_DelChannel);
 	assert(channel);
+	channel->AllowParallelMix();
 
 	const auto generate_sound = std::bind(&Ps1Synth::WriteSoundGeneratorPort205, this, _1, _2, _3);
 	write_handler.Install(0x205, generate_sound, io_width_t::byte);
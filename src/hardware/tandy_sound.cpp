@@ -377,6 +377,7 @@ public:
 
 		const auto sample_rate = static_cast<uint32_t>(section->Get_int("tandyrate"));
 		tandy.chan=MixerChan.Install(&SN76496Update,sample_rate,"TANDY");
+		tandy.chan->AllowParallelMix();
 
 		WriteHandler[0].Install(0xc0, SN76496Write, io_width_t::byte, 2);
 
@@ -45,7 +45,7 @@ static INLINE void BCD2BIN(Bit16u& val) {
 struct PIT_Block {
 	uint32_t cntr;
 	double delay;
-	double start;
+	PIC_Time start;
 
 	Bit16u read_latch;
 	Bit16u write_latch;
@@ -75,7 +75,9 @@ static void PIT0_Event(uint32_t /*val*/)
 {
 	PIC_ActivateIRQ(0);
 	if (pit[0].mode != 0) {
-		pit[0].start += pit[0].delay;
+		// Advance by the same rounded delay the event was queued with,
+		// so the counter stays in step with the interrupts
+		pit[0].start += PIC_MsToTime(pit[0].delay);
 
 		if (GCC_UNLIKELY(pit[0].update_count)) {
 			pit[0].delay = (1000.0 / (static_cast<double>(PIT_TICK_RATE) /
@@ -89,7 +91,7 @@ static void PIT0_Event(uint32_t /*val*/)
 static bool counter_output(const uint32_t counter)
 {
 	PIT_Block *p = &pit[counter];
-	auto index = PIC_FullIndex() - p->start;
+	auto index = PIC_TimeToMs(PIC_Now() - p->start);
 	switch (p->mode) {
 	case 0:
 		if (p->new_mode) return false;
@@ -156,7 +158,7 @@ static void counter_latch(uint32_t counter)
 	//If gate2 is disabled don't update the read_latch
 	if (counter == 2 && !gate2 && p->mode !=1) return;
 
-	auto elapsed_ms = PIC_FullIndex() - p->start;
+	auto elapsed_ms = PIC_TimeToMs(PIC_Now() - p->start);
 	auto save_read_latch = [p](double latch_time) {
 		// Latch is a 16-bit counter, so ensure it doesn't overflow
 		const auto bound_latch = clamp(static_cast<int>(latch_time), 0,
@@ -273,7 +275,7 @@ static void write_latch(io_port_t port, uint8_t val, io_width_t)
 			p->update_count = true;
 			return;
 		}
-		p->start = PIC_FullIndex();
+		p->start = PIC_Now();
 		p->delay = (1000.0 / ((double)PIT_TICK_RATE / (double)p->cntr));
 
 		switch (counter) {
@@ -373,8 +375,7 @@ static void write_p43(io_port_t, uint8_t val, io_width_t)
 				pit[latch].counterstatus_set = false;
 				latched_timerstatus_locked = false;
 			}
-			pit[latch].start = PIC_FullIndex(); // for undocumented
-			                                    // newmode
+			pit[latch].start = PIC_Now(); // for undocumented newmode
 			pit[latch].go_read_latch = true;
 			pit[latch].update_count = false;
 			pit[latch].counting = false;
@@ -437,7 +438,7 @@ void TIMER_SetGate2(bool in) {
 	Bit8u & mode=pit[2].mode;
 	switch (mode) {
 	case 0:
-		if(in) pit[2].start = PIC_FullIndex();
+		if(in) pit[2].start = PIC_Now();
 		else {
 			//Fill readlatch and store it.
 			counter_latch(2);
@@ -448,13 +449,13 @@ void TIMER_SetGate2(bool in) {
 		// gate 1 on: reload counter; off: nothing
 		if(in) {
 			pit[2].counting = true;
-			pit[2].start = PIC_FullIndex();
+			pit[2].start = PIC_Now();
 		}
 		break;
 	case 2:
 	case 3:
 		//If gate is enabled restart counting. If disable store the current read_latch
-		if(in) pit[2].start = PIC_FullIndex();
+		if(in) pit[2].start = PIC_Now();
 		else counter_latch(2);
 		break;
 	case 4:
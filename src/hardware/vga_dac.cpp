@@ -64,6 +64,13 @@ static void VGA_DAC_SendColor(uint8_t index, uint8_t src)
 	                                         (((red >> 1) & 0x1f) << 11));
 	var_write(&vga.dac.xlat16[index], pixel);
 
+#ifdef VGA_KEEP_CHANGES
+	// Lines drawn through xlat16 take their colours in the drawer, so the
+	// renderer can't tell they changed; draw them all from here on
+	vga.changes.active = false;
+	vga.changes.fullFrame = true;
+#endif
+
 	RENDER_SetPal(index, static_cast<uint8_t>((red << 2) | (red >> 4)),
 	              static_cast<uint8_t>((green << 2) | (green >> 4)),
 	              static_cast<uint8_t>((blue << 2) | (blue >> 4)));
@@ -279,29 +279,19 @@ static Bit8u * VGA_Draw_4BPP_Line_Double(Bitu vidstart, Bitu line) {
 }
 
 #ifdef VGA_KEEP_CHANGES
-static Bit8u * VGA_Draw_Changes_Line(Bitu vidstart, Bitu line) {
-	Bitu checkMask = vga.changes.checkMask;
-	Bit8u *map = vga.changes.map;
-	Bitu start = (vidstart >> VGA_CHANGE_SHIFT);
-	Bitu end = ((vidstart + vga.draw.line_length ) >> VGA_CHANGE_SHIFT);
-	for (; start <= end; ++start) {
-		if ( map[start] & checkMask ) {
-			Bitu offset = vidstart & vga.draw.linear_mask;
-			if (vga.draw.linear_mask-offset < vga.draw.line_length)
-				memcpy(vga.draw.linear_base+vga.draw.linear_mask+1, vga.draw.linear_base, vga.draw.line_length);
-			Bit8u *ret = &vga.draw.linear_base[ offset ];
-#if !defined(C_UNALIGNED_MEMORY)
-			if (GCC_UNLIKELY( ((Bitu)ret) & (sizeof(Bitu)-1)) ) {
-				memcpy( TempLine, ret, vga.draw.line_length );
-				return TempLine;
-			}
-#endif
-			return ret;
-		}
+// Whether any memory drawn on this line was written to since the last frame
+static bool VGA_IsLineChanged(Bitu vidstart) {
+	const Bitu offset = vidstart & vga.draw.linear_mask;
+	const Bitu last = offset + vga.draw.line_length - 1;
+	// Lines wrapping around the end of memory are rare, just draw them
+	if (last > vga.draw.linear_mask)
+		return true;
+	const Bit8u checkMask = vga.changes.checkMask;
+	for (Bitu block = offset >> VGA_CHANGE_SHIFT; block <= (last >> VGA_CHANGE_SHIFT); ++block) {
+		if (vga.changes.map[block] & checkMask)
+			return true;
 	}
-//	memset( TempLine, 0x30, vga.changes.lineWidth );
-//	return TempLine;
-	return 0;
+	return false;
 }
 
 #endif
@@ -694,18 +684,15 @@ static uint8_t *VGA_TEXT_Xlat16_Draw_Line(Bitu vidstart, Bitu line)
 }
 
 #ifdef VGA_KEEP_CHANGES
+// Forget the writes this frame was checked against. This covers memory
+// that wasn't shown too, which is fine: showing it takes a different
+// layout, and that draws the full frame anyway.
 static INLINE void VGA_ChangesEnd(void ) {
-	if ( vga.changes.active ) {
-//		vga.changes.active = false;
-		Bitu end = vga.draw.address >> VGA_CHANGE_SHIFT;
-		Bitu total = 4 + end - vga.changes.start;
-		Bit32u clearMask = vga.changes.clearMask;
-		total >>= 2;
-		Bit32u *clear = (Bit32u *)&vga.changes.map[  vga.changes.start & ~3 ];
-		while ( total-- ) {
-			clear[0] &= clearMask;
-			++clear;
-		}
+	const Bit32u clearMask = vga.changes.clearMask;
+	Bit32u *clear = (Bit32u *)vga.changes.map;
+	for (Bitu total = vga.changes.mapSize >> 2; total; --total) {
+		clear[0] &= clearMask;
+		++clear;
 	}
 }
 #endif
@@ -832,7 +819,13 @@ static void VGA_DrawEGASingleLine(uint32_t /*blah*/)
 static void VGA_DrawPart(uint32_t lines)
 {
 	while (lines--) {
-		Bit8u * data=VGA_DrawLine( vga.draw.address, vga.draw.address_line );
+		Bit8u *data = nullptr;
+#ifdef VGA_KEEP_CHANGES
+		// Unchanged lines are passed on empty, so the renderer keeps
+		// what it has and neither converts, scales, nor uploads them
+		if (!vga.changes.active || VGA_IsLineChanged(vga.draw.address))
+#endif
+			data = VGA_DrawLine(vga.draw.address, vga.draw.address_line);
 		RENDER_DrawLine(data);
 		++vga.draw.address_line;
 		if (vga.draw.address_line>=vga.draw.address_line_total) {
@@ -840,15 +833,7 @@ static void VGA_DrawPart(uint32_t lines)
 			vga.draw.address+=vga.draw.address_add;
 		}
 		++vga.draw.lines_done;
-		if (vga.draw.split_line==vga.draw.lines_done) {
-#ifdef VGA_KEEP_CHANGES
-			VGA_ChangesEnd( );
-#endif
-			VGA_ProcessSplit();
-#ifdef VGA_KEEP_CHANGES
-			vga.changes.start = vga.draw.address >> VGA_CHANGE_SHIFT;
-#endif
-		}
+		if (vga.draw.split_line==vga.draw.lines_done) VGA_ProcessSplit();
 	}
 	if (--vga.draw.parts_left) {
 		PIC_AddEvent(VGA_DrawPart, vga.draw.delay.parts,
@@ -882,21 +867,29 @@ void VGA_SetBlinking(const uint8_t enabled)
 }
 
 #ifdef VGA_KEEP_CHANGES
-static void INLINE VGA_ChangesStart( void ) {
-	vga.changes.start = vga.draw.address >> VGA_CHANGE_SHIFT;
-	vga.changes.last = vga.changes.start;
-	if ( vga.changes.lastAddress != vga.draw.address ) {
-//		LOG_MSG("Address");
-		VGA_DrawLine = VGA_Draw_Linear_Line;
-		vga.changes.lastAddress = vga.draw.address;
-	} else if ( render.fullFrame ) {
-//		LOG_MSG("Full Frame");
-		VGA_DrawLine = VGA_Draw_Linear_Line;
-	} else {
-//		LOG_MSG("Changes");
-		VGA_DrawLine = VGA_Draw_Changes_Line;
-	}
-	vga.changes.active = true;
+static void INLINE VGA_ChangesStart(bool linear) {
+	// Lines can only be skipped if the page handler marked every write to
+	// the memory they're drawn from, they show the same memory as in the
+	// last frame, and the renderer has them all cached. Chained writes
+	// are marked at their fastmem address only.
+	const bool sameLayout = vga.changes.lastAddress == vga.draw.address &&
+	                        vga.changes.lastAddressAdd == vga.draw.address_add &&
+	                        vga.changes.lastAddressLine == vga.draw.address_line &&
+	                        vga.changes.lastSplitLine == vga.draw.split_line &&
+	                        vga.changes.lastModeControl == vga.attr.mode_control &&
+	                        vga.changes.lastBase == vga.draw.linear_base;
+	vga.changes.active = linear && sameLayout && vga.changes.tracked &&
+	                     vga.draw.mode == PART && !vga.changes.fullFrame &&
+	                     !render.fullFrame &&
+	                     (vga.draw.linear_base == vga.fastmem || !vga.config.chained);
+	vga.changes.fullFrame = false;
+	vga.changes.lastAddress = vga.draw.address;
+	vga.changes.lastAddressAdd = vga.draw.address_add;
+	vga.changes.lastAddressLine = vga.draw.address_line;
+	vga.changes.lastSplitLine = vga.draw.split_line;
+	vga.changes.lastModeControl = vga.attr.mode_control;
+	vga.changes.lastBase = vga.draw.linear_base;
+
 	vga.changes.checkMask = vga.changes.writeMask;
 	vga.changes.clearMask = ~( 0x01010101 << (vga.changes.frame & 7));
 	++vga.changes.frame;
@@ -933,7 +926,7 @@ static void VGA_PanningLatch(uint32_t /*val*/)
 
 static void VGA_VerticalTimer(uint32_t /*val*/)
 {
-	vga.draw.delay.framestart = PIC_FullIndex();
+	vga.draw.delay.framestart = PIC_Now();
 	PIC_AddEvent(VGA_VerticalTimer, vga.draw.delay.vtotal);
 
 	switch(machine) {
@@ -1065,7 +1058,7 @@ static void VGA_VerticalTimer(uint32_t /*val*/)
 	}
 	if (GCC_UNLIKELY(vga.draw.split_line==0)) VGA_ProcessSplit();
 #ifdef VGA_KEEP_CHANGES
-	if (startaddr_changed) VGA_ChangesStart();
+	VGA_ChangesStart(startaddr_changed);
 #endif
 
 	// check if some lines at the top off the screen are blanked
@@ -1082,6 +1075,10 @@ static void VGA_VerticalTimer(uint32_t /*val*/)
 			LOG(LOG_VGAMISC, LOG_NORMAL)("Parts left: %u", vga.draw.parts_left);
 			PIC_RemoveEvents(VGA_DrawPart);
 			RENDER_EndUpdate(true);
+#ifdef VGA_KEEP_CHANGES
+			// The lines that weren't drawn still hold older writes
+			vga.changes.active = false;
+#endif
 		}
 		vga.draw.lines_done = 0;
 		vga.draw.parts_left = vga.draw.parts_total;
@@ -1799,8 +1796,7 @@ void VGA_SetupDrawing(uint32_t /*val*/)
 	vga.draw.line_length = width * ((bpp + 1) / 8);
 #ifdef VGA_KEEP_CHANGES
 	vga.changes.active = false;
-	vga.changes.frame = 0;
-	vga.changes.writeMask = 1;
+	vga.changes.fullFrame = true;
 #endif
 	/*
 	   Cheap hack to just make all > 640x480 modes have square pixels
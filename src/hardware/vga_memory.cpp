@@ -46,9 +46,10 @@
 #define CHECKED4(v) ((v)&((vga.vmemwrap>>2)-1))
 
 
+// Marks the block holding the drawn byte at _MEM; multi-byte writes also
+// mark their last byte, in case they straddle two blocks.
 #ifdef VGA_KEEP_CHANGES
 #define MEM_CHANGED( _MEM ) vga.changes.map[ (_MEM) >> VGA_CHANGE_SHIFT ] |= vga.changes.writeMask;
-//#define MEM_CHANGED( _MEM ) vga.changes.map[ (_MEM) >> VGA_CHANGE_SHIFT ] = 1;
 #else
 #define MEM_CHANGED( _MEM ) 
 #endif
@@ -215,14 +216,15 @@ public:
 		addr = paging.GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED(addr);
-		MEM_CHANGED( addr << 3);
+		MEM_CHANGED( (addr >> 2) << 3 );
 		writeHandler(addr+0,(Bit8u)(val >> 0));
 	}
 	void writew(PhysPt addr,Bitu val) {
 		addr = paging.GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED(addr);
-		MEM_CHANGED( addr << 3);
+		MEM_CHANGED( (addr >> 2) << 3 );
+		MEM_CHANGED( ((addr + 1) >> 2) << 3 );
 		writeHandler(addr+0,(Bit8u)(val >> 0));
 		writeHandler(addr+1,(Bit8u)(val >> 8));
 	}
@@ -230,7 +232,8 @@ public:
 		addr = paging.GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED(addr);
-		MEM_CHANGED( addr << 3);
+		MEM_CHANGED( (addr >> 2) << 3 );
+		MEM_CHANGED( ((addr + 3) >> 2) << 3 );
 		writeHandler(addr+0,(Bit8u)(val >> 0));
 		writeHandler(addr+1,(Bit8u)(val >> 8));
 		writeHandler(addr+2,(Bit8u)(val >> 16));
@@ -306,6 +309,7 @@ public:
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
 		MEM_CHANGED( addr << 3);
+		MEM_CHANGED( (addr + 1) << 3 );
 		writeHandler(addr+0,(Bit8u)(val >> 0));
 		writeHandler(addr+1,(Bit8u)(val >> 8));
 	}
@@ -314,6 +318,7 @@ public:
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
 		MEM_CHANGED( addr << 3);
+		MEM_CHANGED( (addr + 3) << 3 );
 		writeHandler(addr+0,(Bit8u)(val >> 0));
 		writeHandler(addr+1,(Bit8u)(val >> 8));
 		writeHandler(addr+2,(Bit8u)(val >> 16));
@@ -387,7 +392,7 @@ public:
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED(addr);
 		MEM_CHANGED( addr );
-//		MEM_CHANGED( addr + 1);
+		MEM_CHANGED( addr + 1 );
 		if (GCC_UNLIKELY(addr & 1)) {
 			writeHandler<Bit8u>( addr+0, val >> 0 );
 			writeHandler<Bit8u>( addr+1, val >> 8 );
@@ -401,7 +406,7 @@ public:
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED(addr);
 		MEM_CHANGED( addr );
-//		MEM_CHANGED( addr + 3);
+		MEM_CHANGED( addr + 3 );
 		if (GCC_UNLIKELY(addr & 3)) {
 			writeHandler<Bit8u>( addr+0, val >> 0 );
 			writeHandler<Bit8u>( addr+1, val >> 8 );
@@ -442,6 +447,7 @@ public:
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
 		MEM_CHANGED( addr << 2);
+		MEM_CHANGED( (addr + 1) << 2 );
 		writeHandler(addr+0,(Bit8u)(val >> 0));
 		writeHandler(addr+1,(Bit8u)(val >> 8));
 	}
@@ -450,6 +456,7 @@ public:
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED2(addr);
 		MEM_CHANGED( addr << 2);
+		MEM_CHANGED( (addr + 3) << 2 );
 		writeHandler(addr+0,(Bit8u)(val >> 0));
 		writeHandler(addr+1,(Bit8u)(val >> 8));
 		writeHandler(addr+2,(Bit8u)(val >> 16));
@@ -541,13 +548,15 @@ public:
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED(addr);
 		MEM_CHANGED( addr );
+		MEM_CHANGED( addr + 1 );
 		hostWrite<Bit16u>( &vga.mem.linear[addr], val );
 	}
 	void writed(PhysPt addr,Bitu val) {
 		addr = paging.GetPhysicalAddress(addr) & vgapages.mask;
 		addr += vga.svga.bank_write_full;
 		addr = CHECKED(addr);
-		MEM_CHANGED( addr );	
+		MEM_CHANGED( addr );
+		MEM_CHANGED( addr + 3 );
 		hostWrite<Bit32u>( &vga.mem.linear[addr], val );
 	}
 };
@@ -567,6 +576,7 @@ public:
 		addr = vga.svga.bank_write_full + (paging.GetPhysicalAddress(addr) & 0xffff);
 		addr = CHECKED4(addr);
 		MEM_CHANGED( addr << 3 );
+		MEM_CHANGED( (addr + 1) << 3 );
 		writeHandler(addr+0,(Bit8u)(val >> 0));
 		writeHandler(addr+1,(Bit8u)(val >> 8));
 	}
@@ -574,6 +584,7 @@ public:
 		addr = vga.svga.bank_write_full + (paging.GetPhysicalAddress(addr) & 0xffff);
 		addr = CHECKED4(addr);
 		MEM_CHANGED( addr << 3 );
+		MEM_CHANGED( (addr + 3) << 3 );
 		writeHandler(addr+0,(Bit8u)(val >> 0));
 		writeHandler(addr+1,(Bit8u)(val >> 8));
 		writeHandler(addr+2,(Bit8u)(val >> 16));
@@ -634,12 +645,14 @@ public:
 		addr = CHECKED(addr);
 		hostWrite<Bit16u>( &vga.mem.linear[addr], val );
 		MEM_CHANGED( addr );
+		MEM_CHANGED( addr + 1 );
 	}
 	void writed(PhysPt addr,Bitu val) {
 		addr = paging.GetPhysicalAddress(addr) - vga.lfb.addr;
 		addr = CHECKED(addr);
 		hostWrite<Bit32u>( &vga.mem.linear[addr], val );
 		MEM_CHANGED( addr );
+		MEM_CHANGED( addr + 3 );
 	}
 };
 
@@ -790,6 +803,9 @@ void VGA_SetupHandlers(void) {
 	vga.svga.bank_write_full = vga.svga.bank_write*vga.svga.bank_size;
 
 	PageHandler *newHandler;
+#ifdef VGA_KEEP_CHANGES
+	vga.changes.tracked = false;
+#endif
 	switch (machine) {
 	case MCH_CGA:
 	case MCH_PCJR:
@@ -923,8 +939,18 @@ void VGA_SetupHandlers(void) {
 		MEM_SetPageHandler( VGA_PAGE_B0, 8, &vgaph.empty );
 		break;
 	}
-	if(svgaCard == SVGA_S3Trio && (vga.s3.ext_mem_ctrl & 0x10))
+#ifdef VGA_KEEP_CHANGES
+	// Mapped memory goes straight to the host, so nothing sees those
+	// writes, and text memory isn't drawn linearly
+	vga.changes.tracked = (newHandler != &vgaph.map && newHandler != &vgaph.text);
+#endif
+	if(svgaCard == SVGA_S3Trio && (vga.s3.ext_mem_ctrl & 0x10)) {
 		MEM_SetPageHandler(VGA_PAGE_A0, 16, &vgaph.mmio);
+#ifdef VGA_KEEP_CHANGES
+		// The accelerator writes to video memory directly
+		vga.changes.tracked = false;
+#endif
+	}
 range_done:
 	paging.clearTLB();
 }
@@ -969,10 +995,12 @@ void VGA_SetupMemory(Section* sec) {
 	vga.vmemwrap = vga.vmemsize;
 
 #ifdef VGA_KEEP_CHANGES
-	memset( &vga.changes, 0, sizeof( vga.changes ));
-	int changesMapSize = (vga.vmemsize >> VGA_CHANGE_SHIFT) + 32;
-	vga.changes.map = new Bit8u[changesMapSize];
-	memset(vga.changes.map, 0, changesMapSize);
+	vga.changes = {};
+	// Planar modes draw from fastmem, which is twice the size. Keep the
+	// map a multiple of 4 bytes as it's cleared 32 bits at a time.
+	vga.changes.mapSize = ((vga.vmemsize << 1) >> VGA_CHANGE_SHIFT) + 32;
+	vga.changes.map = new Bit8u[vga.changes.mapSize];
+	memset(vga.changes.map, 0, vga.changes.mapSize);
 #endif
 	vga.svga.bank_read = vga.svga.bank_write = 0;
 	vga.svga.bank_read_full = vga.svga.bank_write_full = 0;
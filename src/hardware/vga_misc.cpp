@@ -31,7 +31,7 @@ uint8_t vga_read_p3d5(io_port_t port, io_width_t);
 uint8_t vga_read_p3da(io_port_t, io_width_t)
 {
 	Bit8u retval = 4; // bit 2 set, needed by Blues Brothers
-	const auto timeInFrame = PIC_FullIndex() - vga.draw.delay.framestart;
+	const auto timeInFrame = PIC_TimeToMs(PIC_Now() - vga.draw.delay.framestart);
 
 	vga.internal.attrindex=false;
 	vga.tandy.pcjr_flipflop=false;
@@ -187,7 +187,7 @@ static void write_lightpen(io_port_t port, uint8_t /*val*/, io_width_t)
 		if (!vga.other.lightpen_triggered) {
 			vga.other.lightpen_triggered = true; // TODO: this shows at port 3ba/3da bit 1
 
-			const auto timeInFrame = PIC_FullIndex() - vga.draw.delay.framestart;
+			const auto timeInFrame = PIC_TimeToMs(PIC_Now() - vga.draw.delay.framestart);
 			const auto timeInLine = fmod(timeInFrame, vga.draw.delay.htotal);
 			Bitu current_scanline = (Bitu)(timeInFrame / vga.draw.delay.htotal);
 
@@ -1333,7 +1333,7 @@ uint8_t read_herc_status(io_port_t, io_width_t)
 	//			111: Unknown clone
 	//       7  Vertical sync inverted
 
-	const auto timeInFrame = PIC_FullIndex() - vga.draw.delay.framestart;
+	const auto timeInFrame = PIC_TimeToMs(PIC_Now() - vga.draw.delay.framestart);
 	uint8_t retval = 0x72; // Hercules ident; from a working card (Winbond
 	                       // W86855AF) Another known working card has 0x76
 	                       // ("KeysoGood", full-length)
@@ -21,6 +21,7 @@
 #include <algorithm>
 #include <cassert>
 #include <utility>
+#include <vector>
 
 #include "callback.h"
 #include "regs.h"
@@ -57,6 +58,9 @@ static bool swapping_requested;
 
 void BIOS_SetEquipment(Bit16u equipment);
 
+// Pages of 4 KiB kept for each image, enough to hold a whole floppy
+constexpr size_t disk_cache_pages = 768;
+
 /* 2 floppys and 2 harddrives, max */
 std::array<std::shared_ptr<imageDisk>, MAX_DISK_IMAGES> imageDiskList;
 std::array<std::shared_ptr<imageDisk>, MAX_SWAPPABLE_DISKS> diskSwap;
@@ -155,51 +159,77 @@ void swapInNextDisk(bool pressed) {
 
 
 Bit8u imageDisk::Read_Sector(Bit32u head,Bit32u cylinder,Bit32u sector,void * data) {
+	return Read_Sectors(head, cylinder, sector, 1, data);
+}
+
+Bit8u imageDisk::Read_Sectors(Bit32u head,Bit32u cylinder,Bit32u sector,Bit32u count,void * data) {
 	Bit32u sectnum;
 
 	sectnum = ( (cylinder * heads + head) * sectors ) + sector - 1L;
 
-	return Read_AbsoluteSector(sectnum, data);
+	return Read_AbsoluteSectors(sectnum, count, data);
 }
 
 Bit8u imageDisk::Read_AbsoluteSector(Bit32u sectnum, void * data) {
+	return Read_AbsoluteSectors(sectnum, 1, data);
+}
+
+Bit8u imageDisk::Read_AbsoluteSectors(Bit32u sectnum, Bit32u count, void * data) {
 	Bit32u bytenum;
 
 	bytenum = sectnum * sector_size;
 
-	if (last_action==WRITE || bytenum!=current_fpos) fseek(diskimg,bytenum,SEEK_SET);
-	size_t ret=fread(data, 1, sector_size, diskimg);
-	current_fpos=bytenum+ret;
-	last_action=READ;
+	cache->Read(diskimg, bytenum, static_cast<uint8_t *>(data), count * sector_size);
 
 	return 0x00;
 }
 
 Bit8u imageDisk::Write_Sector(Bit32u head,Bit32u cylinder,Bit32u sector,void * data) {
+	return Write_Sectors(head, cylinder, sector, 1, data);
+}
+
+Bit8u imageDisk::Write_Sectors(Bit32u head,Bit32u cylinder,Bit32u sector,Bit32u count,void * data) {
 	Bit32u sectnum;
 
 	sectnum = ( (cylinder * heads + head) * sectors ) + sector - 1L;
 
-	return Write_AbsoluteSector(sectnum, data);
+	return Write_AbsoluteSectors(sectnum, count, data);
 }
 
-
 Bit8u imageDisk::Write_AbsoluteSector(Bit32u sectnum, void *data) {
+	return Write_AbsoluteSectors(sectnum, 1, data);
+}
+
+Bit8u imageDisk::Write_AbsoluteSectors(Bit32u sectnum, Bit32u count, void *data) {
 	Bit32u bytenum;
 
 	bytenum = sectnum * sector_size;
 
 	//LOG_MSG("Writing sectors to %ld at bytenum %d", sectnum, bytenum);
 
-	if (last_action==READ || bytenum!=current_fpos) fseek(diskimg,bytenum,SEEK_SET);
-	size_t ret=fwrite(data, 1, sector_size, diskimg);
-	current_fpos=bytenum+ret;
-	last_action=WRITE;
-
+	if (read_only) return 0x05;
+	const auto size = count * sector_size;
+	const auto ret = cache->Write(diskimg, bytenum, static_cast<const uint8_t *>(data), size);
+	write_count += count;
+
+	/* Images opened read-only only fail once the write reaches the file */
+	if (!write_checked) {
+		write_checked = true;
+		if (!cache->Flush(diskimg)) {
+			LOG_MSG("ImageLoader: can't write to \"%s\", treating it as read-only", diskname);
+			read_only = true;
+			cache.reset(new HostFileCache(diskimg, true, disk_cache_pages));
+			return 0x05;
+		}
+	}
 	return ((ret>0)?0x00:0x05);
 
 }
 
+bool imageDisk::Flush(void) {
+	return cache->Flush(diskimg);
+}
+
 imageDisk::imageDisk(FILE *img_file, const char *img_name, uint32_t img_size_k, bool is_hdd)
         : hardDrive(is_hdd),
           active(false),
@@ -208,11 +238,9 @@ imageDisk::imageDisk(FILE *img_file, const char *img_name, uint32_t img_size_k,
           sector_size(512),
           heads(0),
           cylinders(0),
-          sectors(0),
-          current_fpos(0),
-          last_action(NONE)
+          sectors(0)
 {
-	fseek(diskimg,0,SEEK_SET);
+	cache.reset(new HostFileCache(diskimg, true, disk_cache_pages));
 	memset(diskname,0,512);
 	safe_strcpy(diskname, img_name);
 	if (!is_hdd) {
@@ -241,6 +269,15 @@ imageDisk::imageDisk(FILE *img_file, const char *img_name, uint32_t img_size_k,
 	}
 }
 
+imageDisk::~imageDisk()
+{
+	if (diskimg != nullptr) {
+		Flush();
+		cache->Disable(diskimg);
+		fclose(diskimg);
+	}
+}
+
 void imageDisk::Set_Geometry(Bit32u setHeads, Bit32u setCyl, Bit32u setSect, Bit32u setSectSize) {
 	heads = setHeads;
 	cylinders = setCyl;
@@ -314,8 +351,8 @@ static bool has_image(const std::array<T, N> &arr) {
 }
 
 static Bitu INT13_DiskHandler(void) {
+	static std::vector<Bit8u> sectbufs;
 	Bit16u segat, bufptr;
-	Bit8u sectbuf[512];
 	Bit8u  drivenum;
 	Bitu t;
 	last_drive = reg_dl;
@@ -396,17 +433,22 @@ static Bitu INT13_DiskHandler(void) {
 
 		segat = SegValue(es);
 		bufptr = reg_bx;
-		for (Bitu i = 0; i < reg_al; i++) {
-			last_status = imageDiskList[drivenum]->Read_Sector((Bit32u)reg_dh, (Bit32u)(reg_ch | ((reg_cl & 0xc0)<< 2)), (Bit32u)((reg_cl & 63)+i), sectbuf);
-			if((last_status != 0x00) || (killRead)) {
-				LOG_MSG("Error in disk read");
-				killRead = false;
-				reg_ah = 0x04;
-				CALLBACK_SCF(true);
-				return CBRET_NONE;
-			}
-			for(t=0;t<512;t++) {
-				real_writeb(segat,bufptr,sectbuf[t]);
+		/* All the sectors are read with one request */
+		sectbufs.resize(reg_al * imageDiskList[drivenum]->getSectSize());
+		last_status = imageDiskList[drivenum]->Read_Sectors((Bit32u)reg_dh, (Bit32u)(reg_ch | ((reg_cl & 0xc0)<< 2)), (Bit32u)(reg_cl & 63), reg_al, sectbufs.data());
+		if((last_status != 0x00) || (killRead)) {
+			LOG_MSG("Error in disk read");
+			killRead = false;
+			reg_ah = 0x04;
+			CALLBACK_SCF(true);
+			return CBRET_NONE;
+		}
+		if (bufptr + sectbufs.size() <= 0x10000) {
+			MEM_BlockWrite(PhysMake(segat, bufptr), sectbufs.data(), sectbufs.size());
+		} else {
+			/* The buffer wraps around within its segment */
+			for (t = 0; t < sectbufs.size(); t++) {
+				real_writeb(segat,bufptr,sectbufs[t]);
 				bufptr++;
 			}
 		}
@@ -420,16 +462,19 @@ static Bitu INT13_DiskHandler(void) {
 			return CBRET_NONE;
 		}
 		bufptr = reg_bx;
-		for (Bitu i = 0; i < reg_al; i++) {
-			for(t=0;t<imageDiskList[drivenum]->getSectSize();t++) {
-				sectbuf[t] = real_readb(SegValue(es),bufptr);
+		sectbufs.resize(reg_al * imageDiskList[drivenum]->getSectSize());
+		if (bufptr + sectbufs.size() <= 0x10000) {
+			MEM_BlockRead(PhysMake(SegValue(es), bufptr), sectbufs.data(), sectbufs.size());
+		} else {
+			for (t = 0; t < sectbufs.size(); t++) {
+				sectbufs[t] = real_readb(SegValue(es),bufptr);
 				bufptr++;
 			}
-			last_status = imageDiskList[drivenum]->Write_Sector((Bit32u)reg_dh, (Bit32u)(reg_ch | ((reg_cl & 0xc0) << 2)), (Bit32u)((reg_cl & 63) + i), &sectbuf[0]);
-			if(last_status != 0x00) {
-				CALLBACK_SCF(true);
-				return CBRET_NONE;
-			}
+		}
+		last_status = imageDiskList[drivenum]->Write_Sectors((Bit32u)reg_dh, (Bit32u)(reg_ch | ((reg_cl & 0xc0) << 2)), (Bit32u)(reg_cl & 63), reg_al, sectbufs.data());
+		if(last_status != 0x00) {
+			CALLBACK_SCF(true);
+			return CBRET_NONE;
 		}
 		reg_ah = 0x00;
 		CALLBACK_SCF(false);
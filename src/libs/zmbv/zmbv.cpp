@@ -18,12 +18,20 @@
 
 #include "zmbv.h"
 
+#include <algorithm>
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 
+#if defined(__x86_64__) || defined(_M_X64) || \
+        (defined(__i386__) && defined(__SSE2__))
+#define ZMBV_SSE2 1
+#include <immintrin.h>
+#endif
+
 #define DBZV_VERSION_HIGH 0
 #define DBZV_VERSION_LOW 1
 
@@ -32,6 +40,9 @@
 
 #define MAX_VECTOR	16
 
+// Blocks searched per tile; small enough to balance the load between threads
+#define BLOCKS_PER_TILE	32
+
 #define Mask_KeyFrame			0x01
 #define	Mask_DeltaPalette		0x02
 
@@ -113,6 +124,9 @@ bool VideoCodec::SetupBuffers(zmbv_format_t _format, int blockwidth, int blockhe
 			} else {
 				blocks[i].dy=blockheight;
 			}
+			blocks[i].vx=0;
+			blocks[i].vy=0;
+			blocks[i].change=0;
 			i++;
 		}
 	}
@@ -142,62 +156,200 @@ void VideoCodec::CreateVectorTable(void) {
 	}
 }
 
-template<class P>
-INLINE int VideoCodec::PossibleBlock(int vx,int vy,FrameBlock * block) {
-	int ret=0;
-	P * pold=((P*)oldframe)+block->start+(vy*pitch)+vx;
-	P * pnew=((P*)newframe)+block->start;;	
-	for (int y=0;y<block->dy;y+=4) {
-		for (int x=0;x<block->dx;x+=4) {
-			int test=0-((pold[x]-pnew[x])&0x00ffffff);
-			ret-=(test>>31);
+/*
+Block kernels
+~~~~~~~~~~~~~
+count_changes() counts the pixels that differ between a block of the new
+frame and a displaced block of the old one, either all of them (step 1) or
+every 4th pixel of every 4th line (step 4). 32bpp pixels only compare their
+colour bytes. xor_block() writes the XOR of the two blocks out row by row and
+returns the number of bytes written.
+
+Full 16-pixel-wide blocks, which is all of them but the right-hand column
+when the width isn't a multiple of 16, use SSE2 where the host has it. The
+results are the same as the scalar versions'.
+*/
+
+template <class P>
+static constexpr P change_mask()
+{
+	return sizeof(P) == 4 ? static_cast<P>(0x00ffffff) : static_cast<P>(~0u);
+}
+
+template <class P>
+static int count_changes_scalar(const P *pold, const P *pnew, const int pitch,
+                                const int dx, const int dy, const int step)
+{
+	int changes = 0;
+	for (int y = 0; y < dy; y += step) {
+		for (int x = 0; x < dx; x += step)
+			changes += ((pold[x] ^ pnew[x]) & change_mask<P>()) != 0;
+		pold += pitch * step;
+		pnew += pitch * step;
+	}
+	return changes;
+}
+
+template <class P>
+static int xor_block_scalar(const P *pold, const P *pnew, const int pitch,
+                            const int dx, const int dy, unsigned char *out)
+{
+	const unsigned char *start = out;
+	for (int y = 0; y < dy; y++) {
+		for (int x = 0; x < dx; x++) {
+			const P value = pnew[x] ^ pold[x];
+			memcpy(out, &value, sizeof(P));
+			out += sizeof(P);
 		}
-		pold+=pitch*4;
-		pnew+=pitch*4;
+		pold += pitch;
+		pnew += pitch;
 	}
-	return ret;
+	return static_cast<int>(out - start);
 }
 
-template<class P>
-INLINE int VideoCodec::CompareBlock(int vx,int vy,FrameBlock * block) {
-	int ret=0;
-	P * pold=((P*)oldframe)+block->start+(vy*pitch)+vx;
-	P * pnew=((P*)newframe)+block->start;;	
-	for (int y=0;y<block->dy;y++) {
-		for (int x=0;x<block->dx;x++) {
-			int test=0-((pold[x]-pnew[x])&0x00ffffff);
-			ret-=(test>>31);
+#if ZMBV_SSE2
+
+static inline __m128i load16(const void *p)
+{
+	return _mm_loadu_si128(static_cast<const __m128i *>(p));
+}
+
+// Compares 16 pixels, giving one byte per pixel that is 0xff when equal
+static inline __m128i equal_pixels(const uint8_t *a, const uint8_t *b)
+{
+	return _mm_cmpeq_epi8(load16(a), load16(b));
+}
+
+static inline __m128i equal_pixels(const uint16_t *a, const uint16_t *b)
+{
+	const auto lo = _mm_cmpeq_epi16(load16(a), load16(b));
+	const auto hi = _mm_cmpeq_epi16(load16(a + 8), load16(b + 8));
+	return _mm_packs_epi16(lo, hi);
+}
+
+static inline __m128i equal_pixels(const uint32_t *a, const uint32_t *b)
+{
+	const auto mask = _mm_set1_epi32(static_cast<int>(change_mask<uint32_t>()));
+	const auto zero = _mm_setzero_si128();
+	__m128i eq[4];
+	for (int i = 0; i < 4; i++) {
+		const auto diff = _mm_xor_si128(load16(a + i * 4), load16(b + i * 4));
+		eq[i] = _mm_cmpeq_epi32(_mm_and_si128(diff, mask), zero);
+	}
+	return _mm_packs_epi16(_mm_packs_epi32(eq[0], eq[1]),
+	                       _mm_packs_epi32(eq[2], eq[3]));
+}
+
+template <class P>
+static int count_changes_sse2(const P *pold, const P *pnew, const int pitch,
+                              const int dy, const int step)
+{
+	if (step == 1) {
+		// Each byte counts the equal pixels in its column, at most 16
+		auto equal = _mm_setzero_si128();
+		for (int y = 0; y < dy; y++) {
+			equal = _mm_sub_epi8(equal, equal_pixels(pold, pnew));
+			pold += pitch;
+			pnew += pitch;
 		}
-		pold+=pitch;
-		pnew+=pitch;
+		const auto sums = _mm_sad_epu8(equal, _mm_setzero_si128());
+		const int total = _mm_cvtsi128_si32(sums) + _mm_extract_epi16(sums, 4);
+		return 16 * dy - total;
+	}
+	assert(step == 4);
+	int changes = 0;
+	for (int y = 0; y < dy; y += 4) {
+		const int equal = _mm_movemask_epi8(equal_pixels(pold, pnew));
+		changes += 4 - ((equal & 1) + ((equal >> 4) & 1) +
+		                ((equal >> 8) & 1) + ((equal >> 12) & 1));
+		pold += pitch * 4;
+		pnew += pitch * 4;
 	}
-	return ret;
+	return changes;
 }
 
-template<class P>
-INLINE void VideoCodec::AddXorBlock(int vx,int vy,FrameBlock * block) {
-	P * pold=((P*)oldframe)+block->start+(vy*pitch)+vx;
-	P * pnew=((P*)newframe)+block->start;
-	for (int y=0;y<block->dy;y++) {
-		for (int x=0;x<block->dx;x++) {
-			*((P*)&work[workUsed])=pnew[x] ^ pold[x];
-			workUsed+=sizeof(P);
+template <class P>
+static int xor_block_sse2(const P *pold, const P *pnew, const int pitch,
+                          const int dy, unsigned char *out)
+{
+	constexpr int row_size = 16 * sizeof(P);
+	for (int y = 0; y < dy; y++) {
+		const auto old_bytes = reinterpret_cast<const unsigned char *>(pold);
+		const auto new_bytes = reinterpret_cast<const unsigned char *>(pnew);
+		for (int i = 0; i < row_size; i += 16) {
+			const auto x = _mm_xor_si128(load16(new_bytes + i),
+			                             load16(old_bytes + i));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), x);
 		}
-		pold+=pitch;
-		pnew+=pitch;
+		out += row_size;
+		pold += pitch;
+		pnew += pitch;
 	}
+	return row_size * dy;
+}
+
+#endif // ZMBV_SSE2
+
+template <class P>
+static int count_changes(const P *pold, const P *pnew, const int pitch,
+                         const int dx, const int dy, const int step)
+{
+#if ZMBV_SSE2
+	if (dx == 16)
+		return count_changes_sse2(pold, pnew, pitch, dy, step);
+#endif
+	return count_changes_scalar(pold, pnew, pitch, dx, dy, step);
+}
+
+template <class P>
+static int xor_block(const P *pold, const P *pnew, const int pitch,
+                     const int dx, const int dy, unsigned char *out)
+{
+#if ZMBV_SSE2
+	if (dx == 16)
+		return xor_block_sse2(pold, pnew, pitch, dy, out);
+#endif
+	return xor_block_scalar(pold, pnew, pitch, dx, dy, out);
 }
 
 template<class P>
-void VideoCodec::AddXorFrame(void) {
-	signed char * vectors=(signed char*)&work[workUsed];
-	/* Align the following xor data on 4 byte boundary*/
-	workUsed=(workUsed + blockcount*2 +3) & ~3;
-	for (int b=0;b<blockcount;b++) {
+INLINE int VideoCodec::PossibleBlock(int vx,int vy,FrameBlock * block) {
+	const P * pold=((P*)oldframe)+block->start+(vy*pitch)+vx;
+	const P * pnew=((P*)newframe)+block->start;
+	return count_changes(pold, pnew, pitch, block->dx, block->dy, 4);
+}
+
+template<class P>
+INLINE int VideoCodec::CompareBlock(int vx,int vy,FrameBlock * block) {
+	const P * pold=((P*)oldframe)+block->start+(vy*pitch)+vx;
+	const P * pnew=((P*)newframe)+block->start;
+	return count_changes(pold, pnew, pitch, block->dx, block->dy, 1);
+}
+
+template<class P>
+INLINE void VideoCodec::AddXorBlock(int vx,int vy,FrameBlock * block) {
+	const P * pold=((P*)oldframe)+block->start+(vy*pitch)+vx;
+	const P * pnew=((P*)newframe)+block->start;
+	workUsed+=xor_block(pold, pnew, pitch, block->dx, block->dy, &work[workUsed]);
+}
+
+template<class P>
+void VideoCodec::FindVectors(int first_block, int last_block) {
+	for (int b=first_block;b<last_block;b++) {
 		FrameBlock * block=&blocks[b];
 		int bestvx = 0;
 		int bestvy = 0;
 		int bestchange=CompareBlock<P>(0,0, block);
+		// Scrolling and moving sprites tend to keep going the same way, so
+		// try the block's last vector before searching outwards
+		if (bestchange>=4 && (block->vx || block->vy)) {
+			int testchange=CompareBlock<P>(block->vx, block->vy, block);
+			if (testchange<bestchange) {
+				bestchange=testchange;
+				bestvx = block->vx;
+				bestvy = block->vy;
+			}
+		}
 		int possibles=64;
 		for (int v=0;v<VectorCount && possibles;v++) {
 			if (bestchange<4) break;
@@ -214,15 +366,95 @@ void VideoCodec::AddXorFrame(void) {
 				}
 			}
 		}
-		vectors[b*2+0]=(bestvx << 1);
-		vectors[b*2+1]=(bestvy << 1);
-		if (bestchange) {
+		block->vx = bestvx;
+		block->vy = bestvy;
+		block->change = bestchange;
+	}
+}
+
+template<class P>
+void VideoCodec::AddXorFrame(void) {
+	SearchTiles(&VideoCodec::FindVectors<P>);
+
+	signed char * vectors=(signed char*)&work[workUsed];
+	/* Align the following xor data on 4 byte boundary*/
+	workUsed=(workUsed + blockcount*2 +3) & ~3;
+	for (int b=0;b<blockcount;b++) {
+		FrameBlock * block=&blocks[b];
+		vectors[b*2+0]=(block->vx << 1);
+		vectors[b*2+1]=(block->vy << 1);
+		if (block->change) {
 			vectors[b*2+0]|=1;
-			AddXorBlock<P>(bestvx, bestvy, block);
+			AddXorBlock<P>(block->vx, block->vy, block);
 		}
 	}
 }
 
+void VideoCodec::SearchTile(int tile) {
+	const int first_block = tile * BLOCKS_PER_TILE;
+	const int last_block = std::min(first_block + BLOCKS_PER_TILE, blockcount);
+	(this->*helpers.search)(first_block, last_block);
+}
+
+void VideoCodec::SearchTiles(void (VideoCodec::*search)(int first_block, int last_block)) {
+	std::unique_lock<std::mutex> lock(helpers.mutex);
+	helpers.search = search;
+	helpers.next_tile = 0;
+	helpers.tile_count = (blockcount + BLOCKS_PER_TILE - 1) / BLOCKS_PER_TILE;
+	helpers.tiles_left = helpers.tile_count;
+	lock.unlock();
+	if (!helpers.threads.empty())
+		helpers.has_tiles.notify_all();
+
+	// Search alongside the helpers, then wait for their last tiles
+	lock.lock();
+	while (helpers.next_tile < helpers.tile_count) {
+		const int tile = helpers.next_tile++;
+		lock.unlock();
+		SearchTile(tile);
+		lock.lock();
+		--helpers.tiles_left;
+	}
+	helpers.tiles_done.wait(lock, [this] { return helpers.tiles_left == 0; });
+}
+
+void VideoCodec::HelpSearch(void) {
+	std::unique_lock<std::mutex> lock(helpers.mutex);
+	while (true) {
+		helpers.has_tiles.wait(lock, [this] {
+			return helpers.is_stopping || helpers.next_tile < helpers.tile_count;
+		});
+		if (helpers.is_stopping)
+			return;
+		const int tile = helpers.next_tile++;
+		lock.unlock();
+		SearchTile(tile);
+		lock.lock();
+		if (--helpers.tiles_left == 0)
+			helpers.tiles_done.notify_one();
+	}
+}
+
+void VideoCodec::SetSearchThreads(int count) {
+	StopHelpers();
+	helpers.is_stopping = false;
+	for (int i = 0; i < count; i++)
+		helpers.threads.emplace_back(&VideoCodec::HelpSearch, this);
+}
+
+void VideoCodec::StopHelpers(void) {
+	if (helpers.threads.empty())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(helpers.mutex);
+		helpers.is_stopping = true;
+	}
+	helpers.has_tiles.notify_all();
+	for (auto &thread : helpers.threads)
+		thread.join();
+	helpers.threads.clear();
+}
+
 bool VideoCodec::SetupCompress( int _width, int _height ) {
 	width = _width;
 	height = _height;
@@ -335,14 +567,14 @@ int VideoCodec::FinishCompressFrame( void ) {
 		/* Add the delta frame data */
 		switch (format) {
 		case ZMBV_FORMAT_8BPP:
-			AddXorFrame<char>();
+			AddXorFrame<uint8_t>();
 			break;
 		case ZMBV_FORMAT_15BPP:
 		case ZMBV_FORMAT_16BPP:
-			AddXorFrame<short>();
+			AddXorFrame<uint16_t>();
 			break;
 		case ZMBV_FORMAT_32BPP:
-			AddXorFrame<long>();
+			AddXorFrame<uint32_t>();
 			break;
 		default:
 			break;
@@ -461,14 +693,14 @@ bool VideoCodec::DecompressFrame(void * framedata, int size) {
 		}
 		switch (format) {
 		case ZMBV_FORMAT_8BPP:
-			UnXorFrame<char>();
+			UnXorFrame<uint8_t>();
 			break;
 		case ZMBV_FORMAT_15BPP:
 		case ZMBV_FORMAT_16BPP:
-			UnXorFrame<short>();
+			UnXorFrame<uint16_t>();
 			break;
 		case ZMBV_FORMAT_32BPP:
-			UnXorFrame<long>();
+			UnXorFrame<uint32_t>();
 			break;
 		default:
 			break;
@@ -560,8 +792,15 @@ VideoCodec::VideoCodec()
           pitch(0),
           format(ZMBV_FORMAT_NONE),
           pixelsize(0),
-          zstream{}
+          zstream{},
+          helpers{}
 {
 	CreateVectorTable();
 	memset(&zstream, 0, sizeof(zstream));
 }
+
+VideoCodec::~VideoCodec()
+{
+	StopHelpers();
+	FreeBuffers();
+}
@@ -27,6 +27,11 @@
 #endif
 #endif
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 #include <zlib.h>
 
 #define CODEC_4CC "ZMBV"
@@ -49,6 +54,10 @@ private:
 	struct FrameBlock {
 		int start;
 		int dx,dy;
+		// Best motion vector found for the block, and how many of its
+		// pixels still differ when using it
+		int vx,vy;
+		int change;
 	};
 	struct CodecVector {
 		int x,y;
@@ -89,11 +98,32 @@ private:
 
 	z_stream zstream;
 
+	// Threads that help out with the motion vector search. The blocks are
+	// handed out in tiles, which are searched independently.
+	struct {
+		std::vector<std::thread> threads;
+		std::mutex mutex;
+		std::condition_variable has_tiles;
+		std::condition_variable tiles_done;
+		// Guarded by the mutex
+		void (VideoCodec::*search)(int first_block, int last_block);
+		int next_tile;
+		int tile_count;
+		int tiles_left;
+		bool is_stopping;
+	} helpers;
+
 	// methods
 	void FreeBuffers(void);
+	void StopHelpers(void);
+	void HelpSearch(void);
+	void SearchTile(int tile);
+	void SearchTiles(void (VideoCodec::*search)(int first_block, int last_block));
 	void CreateVectorTable(void);
 	bool SetupBuffers(zmbv_format_t format, int blockwidth, int blockheight);
 
+	template<class P>
+		void FindVectors(int first_block, int last_block);
 	template<class P>
 		void AddXorFrame(void);
 	template<class P>
@@ -110,7 +140,13 @@ private:
 		INLINE void CopyBlock(int vx, int vy,FrameBlock * block);
 public:
 	VideoCodec();
+	~VideoCodec();
+	VideoCodec(const VideoCodec &) = delete;
+	VideoCodec &operator=(const VideoCodec &) = delete;
+
 	bool SetupCompress( int _width, int _height);
+	// Number of extra threads searching for motion vectors while compressing
+	void SetSearchThreads(int count);
 	bool SetupDecompress( int _width, int _height);
 	zmbv_format_t BPPFormat( int bpp );
 	int NeededSize( int _width, int _height, zmbv_format_t _format);
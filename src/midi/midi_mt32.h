@@ -73,8 +73,8 @@ private:
 
 	std::vector<int16_t> play_buffer = {};
 	static constexpr auto num_buffers = 4;
-	RWQueue<std::vector<int16_t>> playable{num_buffers};
-	RWQueue<std::vector<int16_t>> backstock{num_buffers};
+	SPSCQueue<std::vector<int16_t>> playable{num_buffers};
+	SPSCQueue<std::vector<int16_t>> backstock{num_buffers};
 
 	std::mutex service_mutex = {};
 	service_t service = {};
@@ -0,0 +1,336 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "host_file_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "cross.h"
+
+HostFileCache::HostFileCache(FILE *file, const bool use_pages, const size_t max_cached)
+        : page_limit(std::max<size_t>(max_cached, 1)),
+          enabled(use_pages)
+{
+	struct stat status;
+	if (file && fstat(cross_fileno(file), &status) == 0 && status.st_size > 0)
+		file_size = static_cast<uint32_t>(
+		        std::min<int64_t>(status.st_size, UINT32_MAX));
+}
+
+HostFileCache::~HostFileCache()
+{
+	if (last_file && IsDirty())
+		Flush(last_file);
+}
+
+void HostFileCache::Disable(FILE *file)
+{
+	Flush(file);
+	pages.clear();
+	page_index.clear();
+	enabled = false;
+}
+
+uint32_t HostFileCache::RefreshSize(FILE *file)
+{
+	struct stat status;
+	if (!file || fstat(cross_fileno(file), &status) != 0)
+		return file_size;
+	const auto host_size = static_cast<uint32_t>(
+	        std::clamp<int64_t>(status.st_size, 0, UINT32_MAX));
+	if (!enabled) {
+		file_size = host_size;
+	} else if (host_size > file_size) {
+		// The page holding the old end has nothing of what came after it
+		Flush(file);
+		const auto number = file_size / page_size;
+		pages.erase(std::remove_if(pages.begin(), pages.end(),
+		                           [number](const auto &page) {
+			                           return page->number == number;
+		                           }),
+		            pages.end());
+		page_index.erase(number);
+		file_size = host_size;
+	}
+	return file_size;
+}
+
+bool HostFileCache::IsDirty() const
+{
+	return std::any_of(pages.begin(), pages.end(), [](const auto &page) {
+		return page->dirty_begin != page->dirty_end;
+	});
+}
+
+uint32_t HostFileCache::Read(FILE *file, const uint32_t pos, uint8_t *data, uint32_t size)
+{
+	++stats.reads;
+	if (!enabled)
+		return static_cast<uint32_t>(HostRead(file, pos, data, size));
+
+	if (pos >= file_size) {
+		++stats.read_hits;
+		return 0;
+	}
+	size = std::min(size, file_size - pos);
+
+	const auto host_reads = stats.host_reads;
+	uint32_t done = 0;
+	while (done < size) {
+		const uint32_t at = pos + done;
+		const uint32_t offset = at % page_size;
+		const uint32_t chunk = std::min(size - done, page_size - offset);
+		const Page *page = GetPage(file, at / page_size, false);
+		if (!page)
+			break;
+		memcpy(data + done, page->data.data() + offset, chunk);
+		done += chunk;
+	}
+	if (stats.host_reads == host_reads)
+		++stats.read_hits;
+	return done;
+}
+
+uint32_t HostFileCache::Write(FILE *file, const uint32_t pos, const uint8_t *data, uint32_t size)
+{
+	++stats.writes;
+	last_file = file;
+	size = std::min(size, UINT32_MAX - pos);
+	if (!enabled) {
+		const auto actual = static_cast<uint32_t>(
+		        HostWrite(file, pos, data, size));
+		// The other handles to the file must see the bytes right away
+		fflush(file);
+		file_size = std::max(file_size, pos + actual);
+		return actual;
+	}
+
+	uint32_t done = 0;
+	while (done < size) {
+		const uint32_t at = pos + done;
+		const uint32_t offset = at % page_size;
+		const uint32_t chunk = std::min(size - done, page_size - offset);
+		// Pages written whole, or past the end of the file, aren't read
+		const bool overwrite = (chunk == page_size) || (at - offset >= file_size);
+		Page *page = GetPage(file, at / page_size, overwrite);
+		if (!page)
+			break;
+		memcpy(page->data.data() + offset, data + done, chunk);
+		if (page->dirty_begin == page->dirty_end) {
+			page->dirty_begin = offset;
+			page->dirty_end = offset + chunk;
+		} else {
+			page->dirty_begin = std::min(page->dirty_begin, offset);
+			page->dirty_end = std::max(page->dirty_end, offset + chunk);
+		}
+		done += chunk;
+		file_size = std::max(file_size, at + chunk);
+	}
+	return done;
+}
+
+bool HostFileCache::Truncate(FILE *file, const uint32_t pos)
+{
+	const bool flushed = Flush(file);
+	const auto handle = cross_fileno(file);
+	if (handle == -1 || ftruncate(handle, pos) != 0)
+		return false;
+	file_size = pos;
+	host_pos = -1;
+
+	// Drop the pages that reach the new end, as it may have moved either way
+	pages.erase(std::remove_if(pages.begin(), pages.end(),
+	                           [pos](const auto &page) {
+		                           return page->number >= pos / page_size;
+	                           }),
+	            pages.end());
+	page_index.clear();
+	for (const auto &page : pages)
+		page_index[page->number] = page.get();
+	return flushed;
+}
+
+bool HostFileCache::Flush(FILE *file)
+{
+	last_file = file;
+	std::vector<Page *> dirty = {};
+	for (const auto &page : pages)
+		if (page->dirty_begin != page->dirty_end)
+			dirty.push_back(page.get());
+	std::sort(dirty.begin(), dirty.end(), [](const Page *a, const Page *b) {
+		return a->number < b->number;
+	});
+
+	bool written = true;
+	for (size_t first = 0; first < dirty.size();) {
+		// Join the pages whose changes run into each other
+		size_t last = first;
+		while (last + 1 < dirty.size() &&
+		       dirty[last]->dirty_end == page_size &&
+		       dirty[last + 1]->dirty_begin == 0 &&
+		       dirty[last + 1]->number == dirty[last]->number + 1)
+			++last;
+
+		const Page &start = *dirty[first];
+		const uint32_t pos = start.number * page_size + start.dirty_begin;
+		const uint8_t *data = start.data.data() + start.dirty_begin;
+		size_t size = start.dirty_end - start.dirty_begin;
+		if (last > first) {
+			write_buffer.clear();
+			for (size_t i = first; i <= last; ++i) {
+				const auto &page_data = dirty[i]->data;
+				write_buffer.insert(write_buffer.end(),
+				                    page_data.begin() + dirty[i]->dirty_begin,
+				                    page_data.begin() + dirty[i]->dirty_end);
+			}
+			data = write_buffer.data();
+			size = write_buffer.size();
+		}
+		if (HostWrite(file, pos, data, size) == size) {
+			for (size_t i = first; i <= last; ++i)
+				dirty[i]->dirty_begin = dirty[i]->dirty_end = 0;
+		} else {
+			written = false;
+		}
+		first = last + 1;
+	}
+	// Hand the stream's own buffer to the host too
+	if (last_action == WRITE && fflush(file) != 0)
+		written = false;
+	return written;
+}
+
+HostFileCache::Page *HostFileCache::FindPage(const uint32_t number)
+{
+	const auto it = page_index.find(number);
+	return (it != page_index.end()) ? it->second : nullptr;
+}
+
+HostFileCache::Page *HostFileCache::GetPage(FILE *file, const uint32_t number,
+                                            const bool overwrite)
+{
+	if (Page *page = FindPage(number)) {
+		page->last_use = ++use_counter;
+		return page;
+	}
+	if (overwrite) {
+		Page *page = AddPage(file, number);
+		if (page)
+			page->data.fill(0);
+		return page;
+	}
+
+	// Misses that follow each other through the file read further ahead
+	read_ahead = (number == next_miss)
+	                     ? std::min(read_ahead * 2, max_read_ahead)
+	                     : 1;
+	const uint32_t last_page = file_size ? (file_size - 1) / page_size : 0;
+	uint32_t count = 1;
+	while (count < read_ahead && number + count <= last_page &&
+	       !FindPage(number + count))
+		++count;
+	next_miss = number + count;
+
+	read_buffer.resize(count * page_size);
+	const auto actual = HostRead(file, number * page_size,
+	                             read_buffer.data(), read_buffer.size());
+	if (actual == 0)
+		return nullptr;
+
+	Page *first = nullptr;
+	for (uint32_t i = 0; i < count; ++i) {
+		Page *page = AddPage(file, number + i);
+		if (!page)
+			break;
+		const size_t from = i * page_size;
+		const size_t valid = (actual > from)
+		                             ? std::min<size_t>(actual - from, page_size)
+		                             : 0;
+		std::copy_n(read_buffer.begin() + from, valid, page->data.begin());
+		std::fill(page->data.begin() + valid, page->data.end(), 0);
+		if (!first)
+			first = page;
+	}
+	return first;
+}
+
+// Returns a page to fill, making room for it if needed
+HostFileCache::Page *HostFileCache::AddPage(FILE *file, const uint32_t number)
+{
+	Page *page = nullptr;
+	if (pages.size() < page_limit) {
+		pages.emplace_back(std::make_unique<Page>());
+		page = pages.back().get();
+	} else {
+		const auto oldest = std::min_element(
+		        pages.begin(), pages.end(), [](const auto &a, const auto &b) {
+			        return a->last_use < b->last_use;
+		        });
+		page = oldest->get();
+		// Write back all the changes while at it, so they go out together
+		if (page->dirty_begin != page->dirty_end && !Flush(file))
+			return nullptr;
+		page_index.erase(page->number);
+	}
+	page->number = number;
+	page_index[number] = page;
+	page->dirty_begin = page->dirty_end = 0;
+	page->last_use = ++use_counter;
+	return page;
+}
+
+size_t HostFileCache::HostRead(FILE *file, const uint32_t pos, uint8_t *data,
+                               const size_t size)
+{
+	++stats.host_reads;
+	// Streams need a seek between writing and reading
+	if (file != host_file || last_action == WRITE || pos != host_pos) {
+		if (fseek(file, static_cast<long>(pos), SEEK_SET) != 0) {
+			host_pos = -1;
+			return 0;
+		}
+	}
+	host_file = file;
+	last_action = READ;
+	const auto actual = fread(data, 1, size, file);
+	host_pos = (actual == size) ? static_cast<int64_t>(pos + actual) : -1;
+	return actual;
+}
+
+size_t HostFileCache::HostWrite(FILE *file, const uint32_t pos,
+                                const uint8_t *data, const size_t size)
+{
+	++stats.host_writes;
+	if (file != host_file || last_action == READ || pos != host_pos) {
+		if (fseek(file, static_cast<long>(pos), SEEK_SET) != 0) {
+			host_pos = -1;
+			return 0;
+		}
+	}
+	host_file = file;
+	last_action = WRITE;
+	const auto actual = fwrite(data, 1, size, file);
+	host_pos = (actual == size) ? static_cast<int64_t>(pos + actual) : -1;
+	return actual;
+}
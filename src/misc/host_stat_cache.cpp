@@ -0,0 +1,328 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "host_stat_cache.h"
+
+#include <cerrno>
+#include <cstring>
+
+#include "logging.h"
+#include "timer.h"
+
+#if defined(__linux__)
+#define HOST_STAT_CACHE_INOTIFY 1
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+unsigned HostStatCache::stale_generation = 0;
+
+#if HOST_STAT_CACHE_INOTIFY
+
+constexpr uint32_t watch_mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM |
+                                IN_MOVED_TO | IN_MODIFY | IN_ATTRIB |
+                                IN_CLOSE_WRITE | IN_DELETE_SELF |
+                                IN_MOVE_SELF | IN_ONLYDIR;
+
+constexpr uint32_t ancestor_mask = IN_DELETE | IN_MOVED_FROM | IN_DELETE_SELF |
+                                   IN_MOVE_SELF | IN_ONLYDIR;
+
+static std::string trim_separator(const char *path)
+{
+	std::string trimmed = path;
+	while (trimmed.size() > 1 && trimmed.back() == '/')
+		trimmed.pop_back();
+	return trimmed;
+}
+
+// Returns an empty string for / and for relative names
+static std::string parent_dir(const std::string &path)
+{
+	const auto pos = path.rfind('/');
+	if (pos == std::string::npos || path == "/")
+		return {};
+	return (pos == 0) ? std::string("/") : path.substr(0, pos);
+}
+
+static std::string join_path(const std::string &dir, const char *name)
+{
+	return (dir == "/") ? dir + name : dir + '/' + name;
+}
+
+static bool is_within(const std::string &path, const std::string &dir)
+{
+	return path.compare(0, dir.size(), dir) == 0 &&
+	       (path.size() == dir.size() || path[dir.size()] == '/' || dir == "/");
+}
+
+#endif
+
+HostStatCache::HostStatCache(const bool use_watches, const int poll_interval)
+        : poll_interval_us(poll_interval)
+{
+#if HOST_STAT_CACHE_INOTIFY
+	if (use_watches) {
+		watch_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+		if (watch_fd < 0)
+			LOG_MSG("FS: Can't watch host directories, not caching them: %s",
+			        strerror(errno));
+	}
+#else
+	(void)use_watches;
+#endif
+	last_poll_us = GetTicksUs();
+	seen_generation = stale_generation;
+}
+
+HostStatCache::~HostStatCache()
+{
+#if HOST_STAT_CACHE_INOTIFY
+	if (watch_fd >= 0)
+		close(watch_fd);
+#endif
+}
+
+bool HostStatCache::Stat(const char *path, struct stat &result)
+{
+	if (!IsWatching())
+		return stat(path, &result) == 0;
+#if HOST_STAT_CACHE_INOTIFY
+	Poll();
+	auto key = trim_separator(path);
+	const auto it = entries.find(key);
+	if (it != entries.end()) {
+		if (it->second.exists)
+			result = it->second.status;
+		return it->second.exists;
+	}
+
+	// Watch before looking, so a change in between isn't missed
+	const bool is_watched = WatchParent(key);
+	Entry entry = {};
+	entry.exists = (stat(path, &entry.status) == 0);
+	if (is_watched) {
+		if (entries.size() >= max_entries)
+			entries.clear();
+		entries.emplace(std::move(key), entry);
+	}
+	if (entry.exists)
+		result = entry.status;
+	return entry.exists;
+#else
+	return false;
+#endif
+}
+
+void HostStatCache::SetRoot(const std::string &dir)
+{
+#if HOST_STAT_CACHE_INOTIFY
+	root = trim_separator(dir.c_str());
+#else
+	(void)dir;
+#endif
+}
+
+void HostStatCache::Watch(const std::string &dir)
+{
+#if HOST_STAT_CACHE_INOTIFY
+	if (IsWatching())
+		WatchWithAncestors(trim_separator(dir.c_str()));
+#else
+	(void)dir;
+#endif
+}
+
+std::vector<HostChange> HostStatCache::TakeChanges()
+{
+	Poll();
+	std::vector<HostChange> taken = {};
+	taken.swap(changes);
+	return taken;
+}
+
+void HostStatCache::Clear()
+{
+#if HOST_STAT_CACHE_INOTIFY
+	for (const auto &watch : watches)
+		inotify_rm_watch(watch_fd, watch.second);
+#endif
+	entries.clear();
+	watched_dirs.clear();
+	watches.clear();
+	ancestor_watches.clear();
+	changes.clear();
+}
+
+void HostStatCache::Poll()
+{
+	if (!IsWatching())
+		return;
+	if (seen_generation == stale_generation &&
+	    GetTicksUsSince(last_poll_us) < poll_interval_us)
+		return;
+	ReadEvents();
+	seen_generation = stale_generation;
+	last_poll_us = GetTicksUs();
+}
+
+void HostStatCache::ReadEvents()
+{
+#if HOST_STAT_CACHE_INOTIFY
+	alignas(inotify_event) char buffer[16 * 1024];
+	ssize_t length;
+	while ((length = read(watch_fd, buffer, sizeof(buffer))) > 0) {
+		for (const char *p = buffer; p < buffer + length;) {
+			const auto &event = *reinterpret_cast<const inotify_event *>(p);
+			p += sizeof(inotify_event) + event.len;
+
+			// Events were dropped, or nobody takes the changes: start over
+			if ((event.mask & IN_Q_OVERFLOW) ||
+			    changes.size() >= max_entries) {
+				entries.clear();
+				changes.clear();
+				changes.push_back({HostChange::Type::Lost, "", "", false});
+				continue;
+			}
+			const auto dir_it = watched_dirs.find(event.wd);
+			if (dir_it == watched_dirs.end())
+				continue;
+			const auto dir = dir_it->second;
+			if (event.mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+				ForgetDir(dir);
+				continue;
+			}
+			if (!event.len)
+				continue;
+
+			const auto path = join_path(dir, event.name);
+			const bool is_dir = (event.mask & IN_ISDIR) != 0;
+			if (ancestor_watches.count(event.wd)) {
+				if (is_dir && (event.mask & (IN_DELETE | IN_MOVED_FROM)))
+					ForgetDir(path);
+				continue;
+			}
+			entries.erase(path);
+			if (event.mask & (IN_DELETE | IN_MOVED_FROM)) {
+				if (is_dir)
+					ForgetDir(path);
+				changes.push_back({HostChange::Type::Removed, dir,
+				                   event.name, is_dir});
+			}
+			if (event.mask & (IN_CREATE | IN_MOVED_TO))
+				changes.push_back({HostChange::Type::Added, dir,
+				                   event.name, is_dir});
+		}
+	}
+#endif
+}
+
+bool HostStatCache::WatchParent(const std::string &path)
+{
+#if HOST_STAT_CACHE_INOTIFY
+	const auto dir = parent_dir(path);
+	return !dir.empty() && WatchWithAncestors(dir);
+#else
+	(void)path;
+	return false;
+#endif
+}
+
+// Watches the directory, and the ones above it up to the root for moves and
+// removals, as those take the directory's contents along without an event
+// in the directory itself. Returns true if all the watches are in place.
+bool HostStatCache::WatchWithAncestors(const std::string &dir)
+{
+#if HOST_STAT_CACHE_INOTIFY
+	if (!AddWatch(dir, false))
+		return false;
+	// Every watched directory has its ancestors watched, so stop at the
+	// first one that is
+	for (auto ancestor = parent_dir(dir);
+	     !ancestor.empty() && !watches.count(ancestor) &&
+	     is_within(ancestor, root);
+	     ancestor = parent_dir(ancestor)) {
+		if (!AddWatch(ancestor, true))
+			return false;
+	}
+	return true;
+#else
+	(void)dir;
+	return false;
+#endif
+}
+
+bool HostStatCache::AddWatch(const std::string &dir, const bool is_ancestor)
+{
+#if HOST_STAT_CACHE_INOTIFY
+	const auto it = watches.find(dir);
+	if (it != watches.end()) {
+		// Already watched for moves only; widen it to everything
+		if (!is_ancestor && ancestor_watches.count(it->second)) {
+			if (inotify_add_watch(watch_fd, dir.c_str(), watch_mask) < 0)
+				return false;
+			ancestor_watches.erase(it->second);
+		}
+		return true;
+	}
+	const auto mask = is_ancestor ? ancestor_mask : watch_mask;
+	const int wd = inotify_add_watch(watch_fd, dir.c_str(), mask);
+	if (wd < 0)
+		return false;
+	// Another name for a directory that's already watched; its events
+	// come in under the first name, so leave this one uncached
+	if (watched_dirs.count(wd))
+		return false;
+	watched_dirs[wd] = dir;
+	watches[dir] = wd;
+	if (is_ancestor)
+		ancestor_watches.insert(wd);
+	return true;
+#else
+	(void)dir;
+	(void)is_ancestor;
+	return false;
+#endif
+}
+
+// Forgets a directory that went away or moved, along with everything in
+// it, as the watches below it would report their events under stale names
+void HostStatCache::ForgetDir(const std::string &dir)
+{
+#if HOST_STAT_CACHE_INOTIFY
+	for (auto it = entries.begin(); it != entries.end();) {
+		if (is_within(it->first, dir))
+			it = entries.erase(it);
+		else
+			++it;
+	}
+	for (auto it = watches.begin(); it != watches.end();) {
+		if (is_within(it->first, dir)) {
+			inotify_rm_watch(watch_fd, it->second);
+			watched_dirs.erase(it->second);
+			ancestor_watches.erase(it->second);
+			it = watches.erase(it);
+		} else {
+			++it;
+		}
+	}
+#else
+	(void)dir;
+#endif
+}
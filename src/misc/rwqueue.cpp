@@ -21,6 +21,7 @@
 #include "rwqueue.h"
 
 #include <cassert>
+#include <thread>
 
 template <typename T>
 RWQueue<T>::RWQueue(size_t queue_capacity) : capacity(queue_capacity)
@@ -92,8 +93,115 @@ T RWQueue<T>::Dequeue()
 	return item;
 }
 
+template <typename T>
+SPSCQueue<T>::SPSCQueue(size_t queue_capacity)
+        : slots(queue_capacity),
+          capacity(queue_capacity)
+{
+	assert(capacity > 0);
+}
+
+template <typename T>
+size_t SPSCQueue<T>::Size() const
+{
+	const auto t = tail.load(std::memory_order_acquire);
+	return head.load(std::memory_order_acquire) - t;
+}
+
+template <typename T>
+size_t SPSCQueue<T>::MaxCapacity() const
+{
+	return capacity;
+}
+
+template <typename T>
+bool SPSCQueue<T>::IsEmpty() const
+{
+	return !Size();
+}
+
+// The waiting side raises its flag and re-checks the ring under the mutex;
+// the other side checks the flag after publishing its counter, so with
+// sequentially consistent ordering one of them always sees the other.
+template <typename T>
+void SPSCQueue<T>::Wake(std::atomic_bool &waiting, std::condition_variable &cv)
+{
+	if (!waiting.load())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+	}
+	cv.notify_one();
+}
+
+// Handoffs on the audio paths are usually only a few microseconds apart, so
+// briefly yield to the other side before falling back to sleeping on the mutex.
+constexpr int spsc_yields_before_sleeping = 16;
+
+template <typename T>
+void SPSCQueue<T>::WaitForRoom()
+{
+	for (int i = 0; i != spsc_yields_before_sleeping; ++i) {
+		if (head.load(std::memory_order_relaxed) - tail.load() < capacity)
+			return;
+		std::this_thread::yield();
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	producer_waiting.store(true);
+	while (head.load(std::memory_order_relaxed) - tail.load() >= capacity)
+		has_room.wait(lock);
+	producer_waiting.store(false);
+}
+
+template <typename T>
+void SPSCQueue<T>::WaitForItems()
+{
+	for (int i = 0; i != spsc_yields_before_sleeping; ++i) {
+		if (head.load() != tail.load(std::memory_order_relaxed))
+			return;
+		std::this_thread::yield();
+	}
+	std::unique_lock<std::mutex> lock(mutex);
+	consumer_waiting.store(true);
+	while (head.load() == tail.load(std::memory_order_relaxed))
+		has_items.wait(lock);
+	consumer_waiting.store(false);
+}
+
+template <typename T>
+void SPSCQueue<T>::Enqueue(const T &item)
+{
+	WaitForRoom();
+	const auto h = head.load(std::memory_order_relaxed);
+	slots[h % capacity] = item;
+	head.store(h + 1);
+	Wake(consumer_waiting, has_items);
+}
+
+template <typename T>
+void SPSCQueue<T>::Enqueue(T &&item)
+{
+	WaitForRoom();
+	const auto h = head.load(std::memory_order_relaxed);
+	slots[h % capacity] = std::move(item);
+	head.store(h + 1);
+	Wake(consumer_waiting, has_items);
+}
+
+template <typename T>
+T SPSCQueue<T>::Dequeue()
+{
+	WaitForItems();
+	const auto t = tail.load(std::memory_order_relaxed);
+	T item = std::move(slots[t % capacity]);
+	tail.store(t + 1);
+	Wake(producer_waiting, has_room);
+	return item;
+}
+
 // Explicit template instantiations
 // ~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-#include <vector>
 template class RWQueue<int>; // Unit tests
-template class RWQueue<std::vector<int16_t>>; // MT-32 and FluidSynth
+template class RWQueue<std::vector<int16_t>>; // Unit tests
+template class SPSCQueue<int>; // Unit tests
+template class SPSCQueue<std::vector<int16_t>>; // MT-32, FluidSynth, and Innovation
@@ -0,0 +1,164 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "tick_pacer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <thread>
+
+#include "support.h"
+
+TickPacer::TickPacer(const int latency, clock_f clock_fn, sleep_f sleep_fn)
+        : clock(std::move(clock_fn)),
+          sleep(std::move(sleep_fn)),
+          latency_us(latency)
+{
+	assert(latency_us >= 0);
+	Reset();
+	stats.start_us = clock();
+}
+
+void TickPacer::Reset()
+{
+	origin_us = clock();
+	ticks_done = 0;
+	ResetTuning();
+}
+
+int TickPacer::TicksDue(const int32_t cycle_max)
+{
+	const auto elapsed_ticks = (clock() - origin_us) / 1000;
+	const auto due = elapsed_ticks - ticks_done;
+	if (due <= 0)
+		return 0;
+
+	// Running too far behind to catch up, so let the dropped ticks go
+	const auto dropped = std::max(due - max_backlog, int64_t(0));
+	origin_us += dropped * 1000;
+	window.overruns += static_cast<int>(dropped);
+	stats.overruns += static_cast<int>(dropped);
+
+	const auto ticks = static_cast<int>(due - dropped);
+	const auto cycles = static_cast<int64_t>(cycle_max) * ticks;
+	ticks_done += ticks;
+	window.ticks += ticks;
+	window.cycles += cycles;
+	stats.cycles += cycles;
+	return ticks;
+}
+
+void TickPacer::WaitForTick()
+{
+	const auto start = clock();
+	const auto deadline = origin_us + (ticks_done + 1) * 1000;
+	const auto remaining = deadline - start;
+
+	if (remaining > 0) {
+		// Sleep through as much of the wait as the latency target
+		// allows, given how late the host tends to wake us up
+		const auto early = std::max(oversleep_us - latency_us, 0.0);
+		const auto sleep_us = remaining - std::lround(early);
+		if (sleep_us > 0) {
+			const auto before = clock();
+			sleep(static_cast<int>(sleep_us));
+			const auto overslept = clock() - before - sleep_us;
+			oversleep_us += (std::max(static_cast<double>(overslept), 0.0) -
+			                 oversleep_us) / 8;
+		}
+		while (clock() < deadline)
+			std::this_thread::yield();
+	}
+
+	const auto end = clock();
+	window.slept_us += end - start;
+	stats.slept_us += end - start;
+	stats.slack_us += end - deadline;
+	++stats.wakeups;
+}
+
+void TickPacer::RemoveCycles(const int64_t cycles)
+{
+	window.removed_cycles += std::max(cycles, int64_t(0));
+}
+
+int32_t TickPacer::TuneCycles(const int32_t cycle_max, const int percent_used)
+{
+	// Close the window early when running behind, to back off quickly
+	const bool is_behind = window.overruns > 0 && window.ticks >= 5;
+	if (window.ticks < window_ticks && !is_behind)
+		return cycle_max;
+
+	const auto now = clock();
+	const auto busy_us = now - window.start_us - window.slept_us;
+	const auto worked_cycles = window.cycles - window.removed_cycles;
+	auto new_cycle_max = cycle_max;
+	if (busy_us > 0 && worked_cycles > 0 && cycle_max > 0) {
+		// What the host could run in the budget, judging by the cycles
+		// that did work
+		const auto budget_us = window.ticks * 10.0 * percent_used * target_load;
+		const auto wanted = static_cast<double>(worked_cycles) /
+		                    window.ticks * budget_us /
+		                    static_cast<double>(busy_us);
+		const auto wanted_ratio = wanted / cycle_max;
+
+		// Below 1% it's a dropout from a passing load imbalance, and below
+		// 12% over a long window most likely another application hogging
+		// the host; neither says anything about the guest
+		const bool is_dropout = wanted_ratio < 0.01 ||
+		                        (wanted_ratio < 0.12 &&
+		                         now - window.start_us >= long_window_us);
+		if (!is_dropout) {
+			auto ratio = clamp(wanted_ratio, 0.5, 2.0);
+			if (ratio > 0.8 && ratio < 1.25)
+				ratio = std::sqrt(ratio);
+			new_cycle_max = static_cast<int32_t>(
+			        std::min(cycle_max * ratio,
+			                 static_cast<double>(INT32_MAX)));
+		}
+	}
+	ResetTuning();
+	return new_cycle_max;
+}
+
+void TickPacer::ResetTuning()
+{
+	window = {};
+	window.start_us = clock();
+}
+
+TickPacerStats TickPacer::TakeStats()
+{
+	const auto now = clock();
+	const auto elapsed_us = static_cast<double>(now - stats.start_us);
+
+	TickPacerStats result = {};
+	if (elapsed_us > 0) {
+		result.cycles_per_ms = static_cast<double>(stats.cycles) * 1000 / elapsed_us;
+		result.idle_percent = static_cast<double>(stats.slept_us) * 100 / elapsed_us;
+	}
+	if (stats.wakeups)
+		result.slack_us = static_cast<double>(stats.slack_us) / stats.wakeups;
+	result.overruns = stats.overruns;
+
+	stats = {};
+	stats.start_us = now;
+	return result;
+}
@@ -0,0 +1,214 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "../src/dos/decode_ahead.cpp"
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr uint32_t ring_frames = 64;
+constexpr uint32_t chunk_frames = 16;
+
+// A mono track at 1000 Hz, so a millisecond is a frame, and each sample
+// holds the number of its frame
+struct FakeTrack {
+	uint32_t length = 0;
+	uint32_t fail_at = UINT32_MAX;
+	uint32_t pos = 0;
+	std::atomic<bool> gate_open{true};
+	std::atomic<bool> decoding{false};
+
+	explicit FakeTrack(const uint32_t frames) : length(frames) {}
+
+	std::unique_ptr<DecodeAhead> Decoder(DecodeAhead::idle_f idle = {})
+	{
+		const auto seek = [this](const uint32_t ms) {
+			if (ms > length)
+				return false;
+			pos = ms;
+			return true;
+		};
+		const auto decode = [this](int16_t *buffer, const uint32_t frames,
+		                           bool &failed) {
+			decoding = true;
+			while (!gate_open)
+				std::this_thread::yield();
+			decoding = false;
+			if (pos >= fail_at) {
+				failed = true;
+				return 0u;
+			}
+			uint32_t decoded = 0;
+			while (decoded < frames && pos < length && pos < fail_at)
+				buffer[decoded++] = static_cast<int16_t>(pos++);
+			return decoded;
+		};
+		return std::make_unique<DecodeAhead>(1, ring_frames, chunk_frames,
+		                                     seek, decode, idle);
+	}
+};
+
+// Tells if the frames count up from first
+bool counts_from(const std::vector<int16_t> &frames, const uint32_t n, const int first)
+{
+	for (uint32_t i = 0; i < n; ++i)
+		if (frames[i] != static_cast<int16_t>(first + static_cast<int>(i)))
+			return false;
+	return true;
+}
+
+TEST(DecodeAhead, ReadsTheTrackInOrder)
+{
+	FakeTrack track(1000);
+	auto decoder = track.Decoder();
+	ASSERT_TRUE(decoder->Seek(0));
+
+	// Takes of all sizes, including ones wrapping around the ring
+	std::vector<int16_t> frames(ring_frames);
+	int next = 0;
+	for (const uint32_t n : {1, 7, 16, 48, 33, 47, 48, 3}) {
+		ASSERT_EQ(decoder->Take(frames.data(), n), n);
+		EXPECT_TRUE(counts_from(frames, n, next));
+		next += static_cast<int>(n);
+	}
+
+	// Asking for more than the ring holds ahead gets what it does hold
+	const uint32_t ahead = ring_frames - chunk_frames;
+	ASSERT_EQ(decoder->Take(frames.data(), ring_frames), ahead);
+	EXPECT_TRUE(counts_from(frames, ahead, next));
+	EXPECT_FALSE(decoder->HasFailed());
+}
+
+TEST(DecodeAhead, SeeksWhileDecoding)
+{
+	FakeTrack track(1000);
+	track.gate_open = false;
+	auto decoder = track.Decoder();
+	ASSERT_TRUE(decoder->Seek(0));
+
+	// Let the decode that's underway finish only once the seek is waiting
+	std::thread opener([&track] {
+		while (!track.decoding)
+			std::this_thread::yield();
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		track.gate_open = true;
+	});
+	EXPECT_TRUE(decoder->Seek(500));
+	opener.join();
+
+	// Nothing decoded from before the seek is played
+	std::vector<int16_t> frames(ring_frames);
+	ASSERT_EQ(decoder->Take(frames.data(), 40), 40u);
+	EXPECT_TRUE(counts_from(frames, 40, 500));
+}
+
+TEST(DecodeAhead, StopsAtTheEndOfTheTrack)
+{
+	FakeTrack track(100);
+	auto decoder = track.Decoder();
+	ASSERT_TRUE(decoder->Seek(90));
+
+	std::vector<int16_t> frames(ring_frames);
+	ASSERT_EQ(decoder->Take(frames.data(), 16), 10u);
+	EXPECT_TRUE(counts_from(frames, 10, 90));
+	EXPECT_EQ(decoder->Take(frames.data(), 16), 0u);
+	EXPECT_FALSE(decoder->HasFailed());
+
+	// Seeking back plays the track again
+	ASSERT_TRUE(decoder->Seek(0));
+	ASSERT_EQ(decoder->Take(frames.data(), 4), 4u);
+	EXPECT_TRUE(counts_from(frames, 4, 0));
+}
+
+TEST(DecodeAhead, ReportsDecodeErrors)
+{
+	FakeTrack track(1000);
+	track.fail_at = 50;
+	auto decoder = track.Decoder();
+	ASSERT_TRUE(decoder->Seek(0));
+
+	std::vector<int16_t> frames(ring_frames);
+	uint32_t taken = 0;
+	while (const uint32_t n = decoder->Take(frames.data(), 16)) {
+		EXPECT_TRUE(counts_from(frames, n, static_cast<int>(taken)));
+		taken += n;
+	}
+	EXPECT_EQ(taken, 50u);
+	EXPECT_TRUE(decoder->HasFailed());
+}
+
+TEST(DecodeAhead, ReportsFailedSeeks)
+{
+	FakeTrack track(100);
+	auto decoder = track.Decoder();
+	EXPECT_FALSE(decoder->Seek(101));
+
+	std::vector<int16_t> frames(ring_frames);
+	EXPECT_EQ(decoder->Take(frames.data(), 16), 0u);
+}
+
+TEST(DecodeAhead, DoesIdleWorkUntilThereIsNoneLeft)
+{
+	FakeTrack track(1000);
+	std::atomic<int> steps{0};
+	auto decoder = track.Decoder([&steps] { return ++steps < 3; });
+	ASSERT_TRUE(decoder->Seek(0));
+
+	const auto deadline = std::chrono::steady_clock::now() +
+	                      std::chrono::seconds(5);
+	while (steps < 3 && std::chrono::steady_clock::now() < deadline)
+		std::this_thread::yield();
+	EXPECT_EQ(steps, 3);
+
+	// Playback goes on as before
+	std::vector<int16_t> frames(ring_frames);
+	ASSERT_EQ(decoder->Take(frames.data(), 48), 48u);
+	EXPECT_TRUE(counts_from(frames, 48, 0));
+}
+
+TEST(DecodeAhead, KeepsPlayingBetweenIdleSteps)
+{
+	// Idle work that never ends, such as hashing a huge track file
+	FakeTrack track(100000);
+	auto decoder = track.Decoder([] {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		return true;
+	});
+	ASSERT_TRUE(decoder->Seek(0));
+
+	std::vector<int16_t> frames(ring_frames);
+	for (int i = 0; i < 50; ++i) {
+		const auto start = std::chrono::steady_clock::now();
+		ASSERT_TRUE(decoder->Seek(static_cast<uint32_t>(i * 1000)));
+		ASSERT_EQ(decoder->Take(frames.data(), 48), 48u);
+		EXPECT_TRUE(counts_from(frames, 48, i * 1000));
+		EXPECT_LT(std::chrono::steady_clock::now() - start,
+		          std::chrono::milliseconds(500));
+	}
+}
+
+} // namespace
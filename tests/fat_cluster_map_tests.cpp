@@ -0,0 +1,161 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "../src/dos/fat_cluster_map.h"
+
+#include <functional>
+#include <initializer_list>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr Bit32u end_of_chain = 0xffff;
+
+// A FAT16 table, moving its generation on the way fatDrive does
+struct FakeFat {
+	std::vector<Bit32u> entries = std::vector<Bit32u>(64, 0);
+	Bit32u generation = 1;
+	int lookups = 0;
+
+	void Set(const Bit32u clust, const Bit32u value)
+	{
+		if (FatClusterMap::invalidates(entries[clust], value,
+		                               entries[clust] >= 0xfff8))
+			++generation;
+		entries[clust] = value;
+	}
+
+	void Chain(std::initializer_list<Bit32u> clusters)
+	{
+		const Bit32u *prev = nullptr;
+		for (const auto &clust : clusters) {
+			Set(clust, end_of_chain);
+			if (prev)
+				Set(*prev, clust);
+			prev = &clust;
+		}
+	}
+
+	std::function<Bit32u(Bit32u)> Next()
+	{
+		return [this](const Bit32u clust) {
+			++lookups;
+			const auto value = entries[clust];
+			return (value >= 0xfff8) ? 0 : value;
+		};
+	}
+
+	Bit32u Find(FatClusterMap &map, const Bit32u first, const Bit32u file_clust,
+	            Bit32u *run_clusts = nullptr)
+	{
+		return map.find(first, generation, file_clust, Next(), run_clusts);
+	}
+};
+
+TEST(FatClusterMap, SeeksWithinRuns)
+{
+	FakeFat fat;
+	fat.Chain({2, 3, 4, 10, 11, 20});
+	FatClusterMap map;
+	Bit32u run = 0;
+
+	EXPECT_EQ(fat.Find(map, 2, 4, &run), 11u);
+	EXPECT_EQ(run, 1u);
+	EXPECT_EQ(fat.Find(map, 2, 1, &run), 3u);
+	EXPECT_EQ(run, 2u);
+	EXPECT_EQ(fat.Find(map, 2, 5, &run), 20u);
+	EXPECT_EQ(run, 1u);
+	EXPECT_EQ(fat.Find(map, 2, 6), 0u);
+
+	// Seeking around the mapped part doesn't read the FAT again
+	const auto lookups = fat.lookups;
+	for (const Bit32u clust : {5, 0, 3, 2, 4, 1})
+		EXPECT_NE(fat.Find(map, 2, clust), 0u);
+	EXPECT_EQ(fat.lookups, lookups);
+}
+
+TEST(FatClusterMap, KeepsMapWhileOthersAppend)
+{
+	FakeFat fat;
+	fat.Chain({2, 3, 4});
+	FatClusterMap map;
+	EXPECT_EQ(fat.Find(map, 2, 3), 0u);
+	const auto generation = fat.generation;
+
+	// Another file grows, as when copying this one
+	fat.Chain({5});
+	for (Bit32u clust = 6; clust < 10; ++clust) {
+		fat.Set(clust, end_of_chain);
+		fat.Set(clust - 1, clust);
+	}
+	EXPECT_EQ(fat.generation, generation);
+	const auto lookups = fat.lookups;
+	EXPECT_EQ(fat.Find(map, 2, 2), 4u);
+	EXPECT_EQ(fat.lookups, lookups);
+
+	// Another handle to this file appends; the map carries on from its end
+	fat.Set(10, end_of_chain);
+	fat.Set(4, 10);
+	EXPECT_EQ(fat.generation, generation);
+	EXPECT_EQ(fat.Find(map, 2, 3), 10u);
+	EXPECT_EQ(fat.lookups, lookups + 1);
+}
+
+TEST(FatClusterMap, MapsAgainAfterTruncateByAnotherHandle)
+{
+	FakeFat fat;
+	fat.Chain({2, 3, 4, 5});
+	FatClusterMap map;
+	EXPECT_EQ(fat.Find(map, 2, 3), 5u);
+
+	// Cut after the second cluster, then reuse the freed ones elsewhere
+	fat.Set(3, end_of_chain);
+	fat.Set(4, 0);
+	fat.Set(5, 0);
+	fat.Chain({4, 5});
+	EXPECT_EQ(fat.Find(map, 2, 2), 0u);
+	EXPECT_EQ(fat.Find(map, 2, 3), 0u);
+	EXPECT_EQ(fat.Find(map, 2, 1), 3u);
+}
+
+TEST(FatClusterMap, ExtendsFromLastCluster)
+{
+	FakeFat fat;
+	fat.Chain({2, 3});
+	FatClusterMap map;
+	EXPECT_EQ(map.lastCluster(2, fat.generation, fat.Next()), 3u);
+
+	fat.Set(7, end_of_chain);
+	fat.Set(3, 7);
+	map.append(7);
+	const auto lookups = fat.lookups;
+	Bit32u run = 0;
+	EXPECT_EQ(fat.Find(map, 2, 2, &run), 7u);
+	EXPECT_EQ(run, 1u);
+	EXPECT_EQ(fat.lookups, lookups);
+
+	// A file without clusters has no last one
+	FatClusterMap empty;
+	EXPECT_EQ(empty.lastCluster(0, fat.generation, fat.Next()), 0u);
+}
+
+} // namespace
@@ -0,0 +1,258 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "host_file_cache.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr auto page_size = HostFileCache::page_size;
+
+// A temporary host file, filled with a known pattern
+struct HostFile {
+	FILE *file = tmpfile();
+
+	explicit HostFile(const size_t size)
+	{
+		std::vector<uint8_t> data(size);
+		for (size_t i = 0; i < size; ++i)
+			data[i] = static_cast<uint8_t>(i * 7 + i / 251);
+		if (size)
+			fwrite(data.data(), 1, size, file);
+		fflush(file);
+	}
+	~HostFile() { fclose(file); }
+	HostFile(const HostFile &) = delete;
+	HostFile &operator=(const HostFile &) = delete;
+
+	std::vector<uint8_t> Contents() const
+	{
+		fseek(file, 0, SEEK_END);
+		std::vector<uint8_t> data(static_cast<size_t>(ftell(file)));
+		fseek(file, 0, SEEK_SET);
+		EXPECT_EQ(fread(data.data(), 1, data.size(), file), data.size());
+		return data;
+	}
+};
+
+TEST(HostFileCache, SmallReadsAreServedFromPages)
+{
+	HostFile host(64 * 1024 + 100);
+	const auto expected = host.Contents();
+	HostFileCache cache(host.file);
+	EXPECT_EQ(cache.Size(), expected.size());
+
+	std::vector<uint8_t> read(expected.size() + 1000);
+	uint32_t pos = 0;
+	while (const auto actual = cache.Read(host.file, pos, read.data() + pos, 128))
+		pos += actual;
+	read.resize(pos);
+	EXPECT_EQ(read, expected);
+
+	// The misses read further ahead as they go through the file
+	const auto &stats = cache.GetStats();
+	EXPECT_LE(stats.host_reads, 6u);
+	EXPECT_GT(stats.read_hits * 100, stats.reads * 98);
+}
+
+TEST(HostFileCache, WritesAreJoined)
+{
+	HostFile host(0);
+	std::vector<uint8_t> record(100);
+	std::vector<uint8_t> expected = {};
+	{
+		HostFileCache cache(host.file);
+		for (int i = 0; i < 1000; ++i) {
+			std::fill(record.begin(), record.end(), static_cast<uint8_t>(i));
+			EXPECT_EQ(cache.Write(host.file, cache.Size(), record.data(), 100), 100u);
+			expected.insert(expected.end(), record.begin(), record.end());
+		}
+		// Nothing reached the host until the pages ran out
+		EXPECT_EQ(cache.GetStats().host_writes, 0u);
+		EXPECT_TRUE(cache.Flush(host.file));
+		EXPECT_FALSE(cache.IsDirty());
+		EXPECT_EQ(cache.GetStats().host_writes, 1u);
+	}
+	EXPECT_EQ(host.Contents(), expected);
+}
+
+TEST(HostFileCache, WritesBackWhenDestroyed)
+{
+	HostFile host(3 * page_size);
+	auto expected = host.Contents();
+	std::vector<uint8_t> data(page_size + 100, 0xaa);
+	{
+		HostFileCache cache(host.file);
+		EXPECT_EQ(cache.Write(host.file, 50, data.data(), data.size()), data.size());
+		EXPECT_EQ(cache.Write(host.file, 3 * page_size, data.data(), 10), 10u);
+		EXPECT_EQ(cache.GetStats().host_writes, 0u);
+	}
+	std::copy(data.begin(), data.end(), expected.begin() + 50);
+	expected.insert(expected.end(), data.begin(), data.begin() + 10);
+	EXPECT_EQ(host.Contents(), expected);
+}
+
+TEST(HostFileCache, MatchesHostOverRandomRequests)
+{
+	HostFile host(3 * page_size + 17);
+	auto expected = host.Contents();
+	HostFileCache cache(host.file);
+
+	std::mt19937 random(42);
+	std::vector<uint8_t> buffer(3 * page_size);
+	for (int i = 0; i < 5000; ++i) {
+		// Past the end now and then, to leave gaps
+		const auto pos = static_cast<uint32_t>(random() % (expected.size() + 300));
+		const auto size = static_cast<uint32_t>(random() % buffer.size());
+		switch (random() % 8) {
+		case 0:
+			ASSERT_TRUE(cache.Flush(host.file));
+			break;
+		case 1:
+			if (random() % 8 == 0) {
+				ASSERT_TRUE(cache.Truncate(host.file, pos));
+				expected.resize(pos);
+			}
+			break;
+		case 2:
+		case 3:
+		case 4:
+			for (auto &byte : buffer)
+				byte = static_cast<uint8_t>(random());
+			ASSERT_EQ(cache.Write(host.file, pos, buffer.data(), size), size);
+			if (expected.size() < pos + size)
+				expected.resize(pos + size);
+			std::copy_n(buffer.begin(), size, expected.begin() + pos);
+			break;
+		default: {
+			const auto actual = cache.Read(host.file, pos, buffer.data(), size);
+			const auto available = (pos < expected.size()) ? expected.size() - pos : 0;
+			ASSERT_EQ(actual, std::min<size_t>(size, available));
+			ASSERT_TRUE(std::equal(buffer.begin(), buffer.begin() + actual,
+			                       expected.begin() + pos));
+		}
+		}
+		ASSERT_EQ(cache.Size(), expected.size());
+	}
+	ASSERT_TRUE(cache.Flush(host.file));
+	EXPECT_EQ(host.Contents(), expected);
+}
+
+TEST(HostFileCache, KeepsAsManyPagesAsAsked)
+{
+	constexpr size_t page_limit = 200;
+	HostFile host(page_limit * page_size);
+	const auto expected = host.Contents();
+	HostFileCache cache(host.file, true, page_limit);
+
+	std::vector<uint8_t> read(page_size);
+	uint32_t first_pass_reads = 0;
+	for (int pass = 0; pass < 2; ++pass) {
+		for (uint32_t page = 0; page < page_limit; ++page) {
+			const uint32_t pos = page * page_size;
+			ASSERT_EQ(cache.Read(host.file, pos, read.data(), page_size), page_size);
+			ASSERT_TRUE(std::equal(read.begin(), read.end(),
+			                       expected.begin() + pos));
+		}
+		if (pass == 0)
+			first_pass_reads = cache.GetStats().host_reads;
+	}
+	// The second pass found every page still there
+	EXPECT_EQ(cache.GetStats().host_reads, first_pass_reads);
+	EXPECT_EQ(cache.GetStats().read_hits, page_limit * 2 - first_pass_reads);
+}
+
+TEST(HostFileCache, DisabledGoesToHost)
+{
+	HostFile host(2 * page_size);
+	HostFileCache cache(host.file);
+	const uint8_t data[] = {1, 2, 3};
+	cache.Write(host.file, 10, data, sizeof(data));
+	cache.Disable(host.file);
+	EXPECT_FALSE(cache.IsEnabled());
+	EXPECT_EQ(host.Contents()[11], 2);
+
+	cache.Write(host.file, 20, data, sizeof(data));
+	uint8_t read[3] = {};
+	EXPECT_EQ(cache.Read(host.file, 20, read, sizeof(read)), 3u);
+	EXPECT_EQ(read[2], 3);
+	fflush(host.file);
+	EXPECT_EQ(host.Contents()[22], 3);
+	EXPECT_EQ(cache.GetStats().read_hits, 0u);
+}
+
+TEST(HostFileCache, HandlesSeeEachOthersAppends)
+{
+	// Two handles to one file, with their caches disabled as for a file
+	// opened twice
+	const char name[] = "host_file_cache_appends.tmp";
+	FILE *first = fopen(name, "wb+");
+	ASSERT_NE(first, nullptr);
+	FILE *second = fopen(name, "rb+");
+	ASSERT_NE(second, nullptr);
+	HostFileCache first_cache(first, false);
+	HostFileCache second_cache(second, false);
+
+	const uint8_t a[] = {'a', 'a'};
+	const uint8_t b[] = {'b', 'b', 'b'};
+	for (int i = 0; i < 3; ++i) {
+		auto end = first_cache.RefreshSize(first);
+		EXPECT_EQ(first_cache.Write(first, end, a, sizeof(a)), sizeof(a));
+		end = second_cache.RefreshSize(second);
+		EXPECT_EQ(second_cache.Write(second, end, b, sizeof(b)), sizeof(b));
+	}
+	EXPECT_EQ(first_cache.RefreshSize(first), 15u);
+
+	std::vector<uint8_t> read(16);
+	ASSERT_EQ(first_cache.Read(first, 0, read.data(), 16), 15u);
+	EXPECT_EQ(std::string(read.begin(), read.begin() + 15), "aabbbaabbbaabbb");
+	fclose(first);
+	fclose(second);
+	remove(name);
+}
+
+TEST(HostFileCache, SeesTheHostGrowTheFile)
+{
+	HostFile host(page_size + 10);
+	auto expected = host.Contents();
+	HostFileCache cache(host.file);
+	std::vector<uint8_t> read(2 * page_size);
+	ASSERT_EQ(cache.Read(host.file, 0, read.data(), page_size + 10), page_size + 10);
+
+	// Another program appends behind the cache's back
+	const std::vector<uint8_t> more(100, 0x55);
+	fseek(host.file, 0, SEEK_END);
+	fwrite(more.data(), 1, more.size(), host.file);
+	fflush(host.file);
+	expected.insert(expected.end(), more.begin(), more.end());
+
+	ASSERT_EQ(cache.RefreshSize(host.file), expected.size());
+	ASSERT_EQ(cache.Read(host.file, 0, read.data(), 2 * page_size), expected.size());
+	EXPECT_TRUE(std::equal(expected.begin(), expected.end(), read.begin()));
+}
+
+} // namespace
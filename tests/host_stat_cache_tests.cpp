@@ -0,0 +1,176 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "host_stat_cache.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include <gtest/gtest.h>
+
+// The cache only keeps anything where inotify can watch the directories
+#if defined(__linux__)
+
+#include <unistd.h>
+
+namespace {
+
+class HostStatCacheTest : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		char name[] = "/tmp/host_stat_cache_XXXXXX";
+		ASSERT_NE(mkdtemp(name), nullptr);
+		dir = name;
+	}
+
+	void TearDown() override
+	{
+		for (const char *file : {"/a.txt", "/b.txt", "/sub/c.txt",
+		                         "/sub/deep/d.txt", "/moved/deep/d.txt"})
+			remove((dir + file).c_str());
+		for (const char *sub : {"/sub/deep", "/sub", "/moved/deep", "/moved"})
+			rmdir((dir + sub).c_str());
+		rmdir(dir.c_str());
+	}
+
+	void WriteFile(const std::string &name, const char *text)
+	{
+		FILE *f = fopen((dir + name).c_str(), "wb");
+		ASSERT_NE(f, nullptr);
+		fputs(text, f);
+		fclose(f);
+	}
+
+	std::string dir = {};
+};
+
+TEST_F(HostStatCacheTest, SeesHostChanges)
+{
+	HostStatCache cache(true, 0);
+	ASSERT_TRUE(cache.IsWatching());
+	struct stat st;
+	const auto path = dir + "/a.txt";
+
+	EXPECT_FALSE(cache.Stat(path.c_str(), st));
+	WriteFile("/a.txt", "hello");
+	ASSERT_TRUE(cache.Stat(path.c_str(), st));
+	EXPECT_EQ(st.st_size, 5);
+
+	WriteFile("/a.txt", "hello, world");
+	ASSERT_TRUE(cache.Stat(path.c_str(), st));
+	EXPECT_EQ(st.st_size, 12);
+
+	ASSERT_EQ(rename(path.c_str(), (dir + "/b.txt").c_str()), 0);
+	EXPECT_FALSE(cache.Stat(path.c_str(), st));
+	EXPECT_TRUE(cache.Stat((dir + "/b.txt").c_str(), st));
+}
+
+TEST_F(HostStatCacheTest, KeepsResultsBetweenPolls)
+{
+	HostStatCache cache(true, 1000 * 1000 * 1000);
+	struct stat st;
+	const auto path = dir + "/a.txt";
+
+	EXPECT_FALSE(cache.Stat(path.c_str(), st));
+	WriteFile("/a.txt", "hello");
+	// Too soon to read the events, so the old result stands...
+	EXPECT_FALSE(cache.Stat(path.c_str(), st));
+	// ...unless the change is known to come from DOSBox itself
+	HostStatCache::MarkStale();
+	EXPECT_TRUE(cache.Stat(path.c_str(), st));
+}
+
+TEST_F(HostStatCacheTest, ReportsNameChanges)
+{
+	HostStatCache cache(true, 0);
+	cache.Watch(dir + "/");
+	ASSERT_EQ(mkdir((dir + "/sub").c_str(), 0700), 0);
+	WriteFile("/a.txt", "x");
+	remove((dir + "/a.txt").c_str());
+
+	const auto changes = cache.TakeChanges();
+	ASSERT_EQ(changes.size(), 3u);
+	EXPECT_EQ(changes[0].type, HostChange::Type::Added);
+	EXPECT_EQ(changes[0].dir, dir);
+	EXPECT_EQ(changes[0].name, "sub");
+	EXPECT_TRUE(changes[0].is_dir);
+	EXPECT_EQ(changes[1].type, HostChange::Type::Added);
+	EXPECT_EQ(changes[1].name, "a.txt");
+	EXPECT_EQ(changes[2].type, HostChange::Type::Removed);
+	EXPECT_EQ(changes[2].name, "a.txt");
+	EXPECT_TRUE(cache.TakeChanges().empty());
+}
+
+TEST_F(HostStatCacheTest, ForgetsRemovedDirectories)
+{
+	HostStatCache cache(true, 0);
+	struct stat st;
+	ASSERT_EQ(mkdir((dir + "/sub").c_str(), 0700), 0);
+	WriteFile("/sub/c.txt", "x");
+	const auto path = dir + "/sub/c.txt";
+	EXPECT_TRUE(cache.Stat(path.c_str(), st));
+
+	// Moving the directory away and back leaves the file where it was
+	ASSERT_EQ(rename((dir + "/sub").c_str(), (dir + "/moved").c_str()), 0);
+	EXPECT_FALSE(cache.Stat(path.c_str(), st));
+	ASSERT_EQ(rename((dir + "/moved").c_str(), (dir + "/sub").c_str()), 0);
+	EXPECT_TRUE(cache.Stat(path.c_str(), st));
+}
+
+TEST_F(HostStatCacheTest, ForgetsTreesBelowMovedAncestors)
+{
+	HostStatCache cache(true, 0);
+	cache.SetRoot(dir);
+	struct stat st;
+	ASSERT_EQ(mkdir((dir + "/sub").c_str(), 0700), 0);
+	ASSERT_EQ(mkdir((dir + "/sub/deep").c_str(), 0700), 0);
+	WriteFile("/sub/deep/d.txt", "x");
+	const auto path = dir + "/sub/deep/d.txt";
+	EXPECT_TRUE(cache.Stat(path.c_str(), st));
+	EXPECT_FALSE(cache.Stat((dir + "/sub/deep/e.txt").c_str(), st));
+
+	// Only the directory two levels up changes
+	ASSERT_EQ(rename((dir + "/sub").c_str(), (dir + "/moved").c_str()), 0);
+	EXPECT_FALSE(cache.Stat(path.c_str(), st));
+	EXPECT_TRUE(cache.Stat((dir + "/moved/deep/d.txt").c_str(), st));
+
+	// A new tree under the old name is seen as well
+	ASSERT_EQ(mkdir((dir + "/sub").c_str(), 0700), 0);
+	ASSERT_EQ(mkdir((dir + "/sub/deep").c_str(), 0700), 0);
+	WriteFile("/sub/deep/e.txt", "x");
+	EXPECT_TRUE(cache.Stat((dir + "/sub/deep/e.txt").c_str(), st));
+	remove((dir + "/sub/deep/e.txt").c_str());
+}
+
+TEST(HostStatCache, PassesThroughWithoutWatches)
+{
+	HostStatCache cache(false);
+	EXPECT_FALSE(cache.IsWatching());
+	struct stat st;
+	EXPECT_TRUE(cache.Stat("/", st));
+	EXPECT_TRUE(S_ISDIR(st.st_mode));
+	EXPECT_FALSE(cache.Stat("/no/such/path", st));
+}
+
+} // namespace
+
+#endif
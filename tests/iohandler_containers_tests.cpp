@@ -21,7 +21,10 @@
 #include "../src/hardware/iohandler_containers.cpp"
 
 #include <cassert>
+#include <chrono>
 #include <cstdint>
+#include <cstdio>
+#include <unordered_map>
 
 #include <gtest/gtest.h>
 
@@ -195,4 +198,83 @@ TEST(iohandler_containers, adjacent_dword_write)
 	EXPECT_EQ(read_word_from_port(word_port_start), val >> 16);
 }
 
+TEST(iohandler_containers, freed_handlers)
+{
+	constexpr uint16_t port = 0x3da;
+	IO_RegisterReadHandler(port, read_dword_new, io_width_t::dword);
+	IO_RegisterWriteHandler(port, write_dword_new, io_width_t::dword);
+	IO_FreeReadHandler(port, io_width_t::dword);
+	IO_FreeWriteHandler(port, io_width_t::dword);
+
+	dword_val_new = 0;
+	write_dword_to_port(port, UINT32_MAX);
+	EXPECT_EQ(dword_val_new, 0u);
+	EXPECT_EQ(read_byte_from_port(port), 0xff);
+	EXPECT_EQ(read_word_from_port(port), 0xffff);
+}
+
+// Lookup benchmarks, comparing the paged tables against the hashed map they
+// replaced: once polling a single port, like a guest waiting on the VGA
+// retrace, and once sweeping the ports of a typical machine. They're left out
+// of normal runs; add --gtest_also_run_disabled_tests to time them.
+
+constexpr auto bench_lookups = 10000000;
+constexpr uint16_t bench_ports[] = {0x20,  0x21,  0x40,  0x43,  0x60,
+                                    0x61,  0x220, 0x22c, 0x22e, 0x240,
+                                    0x388, 0x389, 0x3c9, 0x3d4, 0x3da};
+
+static uint8_t read_bench(io_port_t port, io_width_t)
+{
+	return static_cast<uint8_t>(port);
+}
+
+template <typename Find>
+double bench_lookup(const Find &find, const bool sweep)
+{
+	constexpr auto num_ports = sizeof(bench_ports) / sizeof(bench_ports[0]);
+	uint32_t sum = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i != bench_lookups; ++i) {
+		const auto port = bench_ports[sweep ? i % num_ports : num_ports - 1];
+		const io_read_f *reader = find(port);
+		sum += reader ? (*reader)(port, io_width_t::byte) : 0xff;
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() -
+	                                              start;
+	EXPECT_NE(sum, 0u);
+	return bench_lookups / elapsed.count();
+}
+
+void bench_both(const bool sweep)
+{
+	std::unordered_map<io_port_t, io_read_f> map = {};
+	PortHandlers<io_read_f> table = {};
+	for (const auto port : bench_ports) {
+		map[port] = read_bench;
+		table[port] = read_bench;
+	}
+
+	const auto hashed = bench_lookup(
+	        [&](io_port_t port) -> const io_read_f * {
+		        const auto it = map.find(port);
+		        return it != map.end() ? &it->second : nullptr;
+	        },
+	        sweep);
+	const auto paged = bench_lookup(
+	        [&](io_port_t port) { return table.Find(port); }, sweep);
+	printf("%s: hashed %.0f lookups/s, paged %.0f lookups/s\n",
+	       sweep ? "port sweep" : "hot port", hashed, paged);
+}
+
+TEST(iohandler_containers, DISABLED_benchmark_hot_port)
+{
+	bench_both(false);
+}
+
+TEST(iohandler_containers, DISABLED_benchmark_port_sweep)
+{
+	bench_both(true);
+}
+
 } // namespace
@@ -0,0 +1,180 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "../src/hardware/mixer_kernels.cpp"
+
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// Odd lengths so every set also runs its scalar tail
+constexpr size_t lengths[] = {0, 1, 3, 7, 8, 15, 16, 17, 33, 1023};
+
+std::vector<uint32_t> random_words(size_t n)
+{
+	std::mt19937 gen(n);
+	std::vector<uint32_t> v(n);
+	for (auto &w : v)
+		w = gen();
+	// include the extremes near the start
+	const uint32_t edges[] = {0, 0x7fff, 0x8000, 0xffff, 0x7fffffff, 0x80000000};
+	for (size_t i = 0; i < n && i < sizeof(edges) / sizeof(edges[0]); ++i)
+		v[i] = edges[i];
+	return v;
+}
+
+class MixerKernelsTest : public ::testing::Test {
+protected:
+	void SetUp() override
+	{
+		num_sets = MIXER_GetKernelSets(&sets);
+		ASSERT_GE(num_sets, 1u);
+		ASSERT_STREQ(sets[0].name, "scalar");
+	}
+
+	const MixerKernels *sets = nullptr;
+	size_t num_sets = 0;
+};
+
+TEST_F(MixerKernelsTest, Decode16)
+{
+	for (const auto n : lengths) {
+		std::vector<uint16_t> in(n);
+		const auto words = random_words(n);
+		for (size_t i = 0; i < n; ++i)
+			in[i] = static_cast<uint16_t>(words[i]);
+
+		for (const bool is_signed : {false, true}) {
+			for (const bool is_swapped : {false, true}) {
+				std::vector<int32_t> expected(n);
+				sets[0].decode16(in.data(), expected.data(), n,
+				                 is_signed, is_swapped);
+				for (size_t s = 1; s < num_sets; ++s) {
+					std::vector<int32_t> out(n);
+					sets[s].decode16(in.data(), out.data(), n,
+					                 is_signed, is_swapped);
+					EXPECT_EQ(out, expected) << sets[s].name;
+				}
+			}
+		}
+	}
+}
+
+TEST_F(MixerKernelsTest, Decode16Reference)
+{
+	const uint16_t in[] = {0x0000, 0x7fff, 0x8000, 0xffff, 0x0180};
+	int32_t out[5];
+	sets[0].decode16(in, out, 5, true, false);
+	EXPECT_EQ(out[1], INT16_MAX);
+	EXPECT_EQ(out[2], INT16_MIN);
+	EXPECT_EQ(out[3], -1);
+	sets[0].decode16(in, out, 5, false, false);
+	EXPECT_EQ(out[0], -32768);
+	EXPECT_EQ(out[2], 0);
+	EXPECT_EQ(out[3], 32767);
+	sets[0].decode16(in, out, 5, true, true);
+	EXPECT_EQ(out[4], 0x8001 - 0x10000);
+}
+
+TEST_F(MixerKernelsTest, Decode32)
+{
+	for (const auto n : lengths) {
+		const auto in = random_words(n);
+		for (const bool is_swapped : {false, true}) {
+			std::vector<int32_t> expected(n);
+			sets[0].decode32(in.data(), expected.data(), n, is_swapped);
+			for (size_t s = 1; s < num_sets; ++s) {
+				std::vector<int32_t> out(n);
+				sets[s].decode32(in.data(), out.data(), n, is_swapped);
+				EXPECT_EQ(out, expected) << sets[s].name;
+			}
+		}
+	}
+}
+
+TEST_F(MixerKernelsTest, Accumulate)
+{
+	// The last pair makes the products and sums wrap around
+	const int32_t volumes[][2] = {{8192, 8192}, {0, 12345}, {-3, 70000}, {1 << 20, 1 << 21}};
+	for (const auto n : lengths) {
+		for (const bool is_stereo : {false, true}) {
+			const auto words = random_words(n * 2);
+			std::vector<int32_t> in(n * 2);
+			std::vector<int32_t> work(n * 2);
+			for (size_t i = 0; i < n * 2; ++i) {
+				in[i] = static_cast<int16_t>(words[i]);
+				work[i] = static_cast<int32_t>(words[i] ^ 0x5a5a5a5a);
+			}
+			for (const auto &vol : volumes) {
+				auto expected = work;
+				sets[0].accumulate(expected.data(), in.data(), n,
+				                   is_stereo, vol[0], vol[1]);
+				for (size_t s = 1; s < num_sets; ++s) {
+					auto out = work;
+					sets[s].accumulate(out.data(), in.data(), n,
+					                   is_stereo, vol[0], vol[1]);
+					EXPECT_EQ(out, expected) << sets[s].name;
+				}
+			}
+		}
+	}
+}
+
+TEST_F(MixerKernelsTest, Clip)
+{
+	for (const auto n : lengths) {
+		const auto words = random_words(n);
+		std::vector<int32_t> work(n);
+		for (size_t i = 0; i < n; ++i)
+			work[i] = static_cast<int32_t>(words[i]);
+		for (const int shift : {0, 13}) {
+			std::vector<int16_t> expected(n);
+			sets[0].clip(work.data(), expected.data(), n, shift);
+			for (size_t s = 1; s < num_sets; ++s) {
+				std::vector<int16_t> out(n);
+				sets[s].clip(work.data(), out.data(), n, shift);
+				EXPECT_EQ(out, expected) << sets[s].name;
+			}
+		}
+	}
+}
+
+TEST_F(MixerKernelsTest, ClipReference)
+{
+	const int32_t work[] = {INT32_MIN, -(40000 << 13), 1000 << 13, 40000 << 13, INT32_MAX};
+	int16_t out[5];
+	sets[0].clip(work, out, 5, 13);
+	EXPECT_EQ(out[0], INT16_MIN);
+	EXPECT_EQ(out[1], INT16_MIN);
+	EXPECT_EQ(out[2], 1000);
+	EXPECT_EQ(out[3], INT16_MAX);
+	EXPECT_EQ(out[4], INT16_MAX);
+}
+
+TEST_F(MixerKernelsTest, SelectsSupportedSet)
+{
+	const std::string name = MIXER_SelectKernels();
+	EXPECT_EQ(name, sets[num_sets - 1].name);
+}
+
+} // namespace
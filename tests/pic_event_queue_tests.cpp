@@ -0,0 +1,192 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "../src/hardware/pic_event_queue.h"
+
+#include <iterator>
+#include <map>
+#include <memory>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+void handler_a(uint32_t) {}
+void handler_b(uint32_t) {}
+
+// Takes every event off the queue, returning their values in the order due
+std::vector<uint32_t> drain(PicEventQueue &queue)
+{
+	std::vector<uint32_t> values;
+	PIC_Time last = INT64_MIN;
+	while (!queue.IsEmpty()) {
+		const auto &first = queue.First();
+		EXPECT_GE(first.timestamp, last);
+		last = first.timestamp;
+		values.push_back(first.value);
+		queue.RemoveFirst();
+	}
+	return values;
+}
+
+TEST(PicEventQueue, RunsEventsInTimeOrder)
+{
+	auto queue = std::make_unique<PicEventQueue>();
+	for (const uint32_t ms : {5, 1, 9, 3, 7, 2, 8, 0, 6, 4})
+		queue->Add(ms * PIC_TIME_PER_MS, handler_a, ms);
+	EXPECT_EQ(queue->Size(), 10);
+
+	const std::vector<uint32_t> expected = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+	EXPECT_EQ(drain(*queue), expected);
+}
+
+TEST(PicEventQueue, RunsEventsDueTogetherFirstInFirstOut)
+{
+	auto queue = std::make_unique<PicEventQueue>();
+	for (uint32_t i = 0; i < 20; ++i)
+		queue->Add((i % 2) * PIC_TIME_PER_MS, handler_a, i);
+
+	const std::vector<uint32_t> expected = {0, 2,  4,  6,  8,  10, 12,
+	                                        14, 16, 18, 1,  3,  5,  7,
+	                                        9,  11, 13, 15, 17, 19};
+	EXPECT_EQ(drain(*queue), expected);
+}
+
+TEST(PicEventQueue, RemovesByHandle)
+{
+	auto queue = std::make_unique<PicEventQueue>();
+	std::vector<PIC_EventHandle> handles;
+	for (uint32_t i = 0; i < 8; ++i)
+		handles.push_back(queue->Add(i * PIC_TIME_PER_MS, handler_a, i));
+
+	queue->Remove(handles[0]);
+	queue->Remove(handles[5]);
+	queue->Remove(handles[3]);
+	EXPECT_EQ(queue->Size(), 5);
+
+	// Removing them again, or with no handle, leaves the others alone
+	queue->Remove(handles[5]);
+	queue->Remove(0);
+	EXPECT_EQ(queue->Size(), 5);
+
+	const std::vector<uint32_t> expected = {1, 2, 4, 6, 7};
+	EXPECT_EQ(drain(*queue), expected);
+}
+
+TEST(PicEventQueue, IgnoresHandlesToEventsThatRan)
+{
+	auto queue = std::make_unique<PicEventQueue>();
+	const auto ran = queue->Add(0, handler_a, 1);
+	queue->RemoveFirst();
+
+	// The new event reuses the slot, but not the handle
+	const auto pending = queue->Add(0, handler_a, 2);
+	EXPECT_NE(pending, ran);
+	queue->Remove(ran);
+	ASSERT_EQ(queue->Size(), 1);
+	EXPECT_EQ(queue->First().value, 2u);
+
+	// Nor do handles survive a reset
+	queue->Reset();
+	const auto after_reset = queue->Add(0, handler_a, 3);
+	queue->Remove(pending);
+	EXPECT_EQ(queue->Size(), 1);
+	queue->Remove(after_reset);
+	EXPECT_TRUE(queue->IsEmpty());
+}
+
+TEST(PicEventQueue, RemovesMatchingEvents)
+{
+	auto queue = std::make_unique<PicEventQueue>();
+	for (uint32_t i = 0; i < 30; ++i)
+		queue->Add((29 - i) * PIC_TIME_PER_MS, i % 3 ? handler_a : handler_b, i);
+
+	queue->RemoveIf([](const PicEventQueue::Entry &entry) {
+		return entry.pic_event == handler_b;
+	});
+	EXPECT_EQ(queue->Size(), 20);
+
+	std::vector<uint32_t> expected;
+	for (uint32_t i = 30; i-- > 0;)
+		if (i % 3)
+			expected.push_back(i);
+	EXPECT_EQ(drain(*queue), expected);
+}
+
+TEST(PicEventQueue, RefusesEventsWhenFull)
+{
+	auto queue = std::make_unique<PicEventQueue>();
+	for (uint32_t i = 0; i < PicEventQueue::capacity; ++i)
+		EXPECT_NE(queue->Add(i, handler_a, i), 0u);
+	EXPECT_TRUE(queue->IsFull());
+	EXPECT_EQ(queue->Add(0, handler_a, 0), 0u);
+
+	queue->RemoveFirst();
+	EXPECT_FALSE(queue->IsFull());
+	EXPECT_NE(queue->Add(0, handler_a, 0), 0u);
+}
+
+// Mixes every operation and checks the order against a sorted map
+TEST(PicEventQueue, MatchesSortedOrderUnderRandomChanges)
+{
+	auto queue = std::make_unique<PicEventQueue>();
+	std::map<std::pair<PIC_Time, uint32_t>, PIC_EventHandle> model;
+	std::mt19937 rng(1234);
+	uint32_t next_value = 0;
+
+	for (int step = 0; step < 20000; ++step) {
+		const auto op = rng() % 10;
+		if (op < 5 && !queue->IsFull()) {
+			// Few distinct times, so plenty of events are due together
+			const PIC_Time time = rng() % 64;
+			const auto handle = queue->Add(time, handler_a, next_value);
+			model[{time, next_value++}] = handle;
+		} else if (op < 7 && !model.empty()) {
+			auto it = model.begin();
+			std::advance(it, rng() % model.size());
+			queue->Remove(it->second);
+			model.erase(it);
+		} else if (op < 9 && !model.empty()) {
+			ASSERT_EQ(queue->First().value, model.begin()->first.second);
+			queue->RemoveFirst();
+			model.erase(model.begin());
+		} else {
+			const auto divisor = rng() % 7 + 2;
+			queue->RemoveIf([=](const PicEventQueue::Entry &entry) {
+				return entry.value % divisor == 0;
+			});
+			for (auto it = model.begin(); it != model.end();)
+				it = (it->first.second % divisor == 0) ? model.erase(it)
+				                                       : std::next(it);
+		}
+		ASSERT_EQ(queue->Size(), model.size());
+	}
+	for (const auto &event : model) {
+		ASSERT_EQ(queue->First().timestamp, event.first.first);
+		ASSERT_EQ(queue->First().value, event.first.second);
+		queue->RemoveFirst();
+	}
+	EXPECT_TRUE(queue->IsEmpty());
+}
+
+} // namespace
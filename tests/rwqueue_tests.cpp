@@ -22,6 +22,8 @@
 
 #include <gtest/gtest.h>
 
+#include <chrono>
+#include <cstdio>
 #include <thread>
 #include <vector>
 
@@ -66,7 +68,8 @@ TEST(RWQueue, TrivialZeroCapacity)
 	EXPECT_DEBUG_DEATH({ RWQueue<int> q(0); }, "");
 }
 
-void rw_consume_trivial(RWQueue<int> *q, const size_t *max_depth)
+template <typename Queue>
+void rw_consume_trivial(Queue *q, const size_t *max_depth)
 {
 	int item;
 	for (int i = 0; i != iterations; ++i) {
@@ -76,7 +79,8 @@ void rw_consume_trivial(RWQueue<int> *q, const size_t *max_depth)
 	}
 }
 
-void rw_produce_copy_trivial(RWQueue<int> *q, const size_t *max_depth)
+template <typename Queue>
+void rw_produce_copy_trivial(Queue *q, const size_t *max_depth)
 {
 	for (int i = 0; i != iterations; ++i) {
 		q->Enqueue(i);
@@ -84,7 +88,8 @@ void rw_produce_copy_trivial(RWQueue<int> *q, const size_t *max_depth)
 	}
 }
 
-void rw_produce_move_trivial(RWQueue<int> *q, const size_t *max_depth)
+template <typename Queue>
+void rw_produce_move_trivial(Queue *q, const size_t *max_depth)
 {
 	for (int i = 0; i != iterations; ++i) {
 		q->Enqueue(std::move(i));
@@ -97,8 +102,8 @@ TEST(RWQueue, TrivialCopyAsync)
 	const size_t max_depth = 8;
 	RWQueue<int> q(max_depth);
 
-	std::thread writer(rw_produce_copy_trivial, &q, &max_depth);
-	std::thread reader(rw_consume_trivial, &q, &max_depth);
+	std::thread writer(rw_produce_copy_trivial<RWQueue<int>>, &q, &max_depth);
+	std::thread reader(rw_consume_trivial<RWQueue<int>>, &q, &max_depth);
 
 	writer.join();
 	reader.join();
@@ -112,8 +117,8 @@ TEST(RWQueue, TrivialMoveAsync)
 	const size_t max_depth = 8;
 	RWQueue<int> q(max_depth);
 
-	std::thread writer(rw_produce_move_trivial, &q, &max_depth);
-	std::thread reader(rw_consume_trivial, &q, &max_depth);
+	std::thread writer(rw_produce_move_trivial<RWQueue<int>>, &q, &max_depth);
+	std::thread reader(rw_consume_trivial<RWQueue<int>>, &q, &max_depth);
 
 	writer.join();
 	reader.join();
@@ -174,7 +179,8 @@ TEST(RWQueue,ContainerZeroCapacity)
 	EXPECT_DEBUG_DEATH({ RWQueue<container_t> q(0); }, "");
 }
 
-void rw_consume_container(RWQueue<container_t> *q, const size_t *max_depth)
+template <typename Queue>
+void rw_consume_container(Queue *q, const size_t *max_depth)
 {
 	container_t v;
 	for (int i = 0; i != iterations; ++i) {
@@ -185,7 +191,8 @@ void rw_consume_container(RWQueue<container_t> *q, const size_t *max_depth)
 	}
 }
 
-void rw_produce_copy_container(RWQueue<container_t> *q, const size_t *max_depth)
+template <typename Queue>
+void rw_produce_copy_container(Queue *q, const size_t *max_depth)
 {
 	for (int i = 0; i != iterations; ++i) {
 		container_t v(i + 1);
@@ -196,7 +203,8 @@ void rw_produce_copy_container(RWQueue<container_t> *q, const size_t *max_depth)
 	}
 }
 
-void rw_produce_move_container(RWQueue<container_t> *q, const size_t *max_depth)
+template <typename Queue>
+void rw_produce_move_container(Queue *q, const size_t *max_depth)
 {
 	for (int i = 0; i != iterations; ++i) {
 		container_t v(i + 1);
@@ -212,8 +220,8 @@ TEST(RWQueue,ContainerCopyAsync)
 	const size_t max_depth = 8;
 	RWQueue<container_t> q(max_depth);
 
-	std::thread writer(rw_produce_copy_container, &q, &max_depth);
-	std::thread reader(rw_consume_container, &q, &max_depth);
+	std::thread writer(rw_produce_copy_container<RWQueue<container_t>>, &q, &max_depth);
+	std::thread reader(rw_consume_container<RWQueue<container_t>>, &q, &max_depth);
 
 	writer.join();
 	reader.join();
@@ -227,8 +235,8 @@ TEST(RWQueue,ContainerMoveAsync)
 	const size_t max_depth = 8;
 	RWQueue<container_t> q(max_depth);
 
-	std::thread writer(rw_produce_move_container, &q, &max_depth);
-	std::thread reader(rw_consume_container, &q, &max_depth);
+	std::thread writer(rw_produce_move_container<RWQueue<container_t>>, &q, &max_depth);
+	std::thread reader(rw_consume_container<RWQueue<container_t>>, &q, &max_depth);
 
 	writer.join();
 	reader.join();
@@ -237,4 +245,144 @@ TEST(RWQueue,ContainerMoveAsync)
 	EXPECT_EQ(q.Size(), 0);
 }
 
+TEST(SPSCQueue, TrivialSerial)
+{
+	SPSCQueue<int> q(65);
+	for (int iteration = 0; iteration != 128; ++iteration) {
+		EXPECT_EQ(q.MaxCapacity(), 65);
+		EXPECT_TRUE(q.IsEmpty());
+		for (int i = 0; i != 65; ++i)
+			q.Enqueue(i);
+		EXPECT_EQ(q.Size(), 65);
+		for (int i = 0; i != 65; ++i)
+			EXPECT_EQ(q.Dequeue(), i);
+		EXPECT_TRUE(q.IsEmpty());
+	}
+}
+
+TEST(SPSCQueue, TrivialZeroCapacity)
+{
+	EXPECT_DEBUG_DEATH({ SPSCQueue<int> q(0); }, "");
+}
+
+TEST(SPSCQueue, TrivialCopyAsync)
+{
+	const size_t max_depth = 8;
+	SPSCQueue<int> q(max_depth);
+
+	std::thread writer(rw_produce_copy_trivial<SPSCQueue<int>>, &q, &max_depth);
+	std::thread reader(rw_consume_trivial<SPSCQueue<int>>, &q, &max_depth);
+
+	writer.join();
+	reader.join();
+
+	EXPECT_EQ(q.Size(), 0);
+}
+
+TEST(SPSCQueue, ContainerCopyAsync)
+{
+	const size_t max_depth = 8;
+	SPSCQueue<container_t> q(max_depth);
+
+	std::thread writer(rw_produce_copy_container<SPSCQueue<container_t>>,
+	                   &q, &max_depth);
+	std::thread reader(rw_consume_container<SPSCQueue<container_t>>, &q,
+	                   &max_depth);
+
+	writer.join();
+	reader.join();
+
+	EXPECT_EQ(q.Size(), 0);
+}
+
+TEST(SPSCQueue, ContainerMoveAsync)
+{
+	const size_t max_depth = 8;
+	SPSCQueue<container_t> q(max_depth);
+
+	std::thread writer(rw_produce_move_container<SPSCQueue<container_t>>,
+	                   &q, &max_depth);
+	std::thread reader(rw_consume_container<SPSCQueue<container_t>>, &q,
+	                   &max_depth);
+
+	writer.join();
+	reader.join();
+
+	EXPECT_EQ(q.Size(), 0);
+}
+
+// Throughput comparisons of the two queues that mimic the audio paths: a
+// renderer cycling a handful of fixed-size buffers through 'playable' and
+// 'backstock' queues while the mixer drains them. Disabled by default; run
+// with --gtest_also_run_disabled_tests --gtest_filter='RWQueueBenchmark.*'.
+
+constexpr auto bench_buffers = 4;
+constexpr auto bench_handoffs = 200000;
+constexpr auto bench_samples = 96 * 2;
+
+template <typename Queue>
+double bench_buffer_ring()
+{
+	Queue playable(bench_buffers);
+	Queue backstock(bench_buffers);
+	for (int i = 0; i != bench_buffers; ++i)
+		backstock.Enqueue(container_t(bench_samples));
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::thread renderer([&]() {
+		for (int i = 0; i != bench_handoffs; ++i) {
+			auto buffer = backstock.Dequeue();
+			buffer[0] = static_cast<int16_t>(i);
+			playable.Enqueue(std::move(buffer));
+		}
+	});
+	for (int i = 0; i != bench_handoffs; ++i) {
+		auto buffer = playable.Dequeue();
+		EXPECT_EQ(buffer[0], static_cast<int16_t>(i));
+		backstock.Enqueue(std::move(buffer));
+	}
+	renderer.join();
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() -
+	                                              start;
+	return bench_handoffs / elapsed.count();
+}
+
+template <typename Queue>
+double bench_trivial()
+{
+	const size_t max_depth = 64;
+	Queue q(max_depth);
+
+	const auto start = std::chrono::steady_clock::now();
+
+	std::thread writer([&]() {
+		for (int i = 0; i != bench_handoffs; ++i)
+			q.Enqueue(i);
+	});
+	for (int i = 0; i != bench_handoffs; ++i)
+		EXPECT_EQ(q.Dequeue(), i);
+	writer.join();
+
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() -
+	                                              start;
+	return bench_handoffs / elapsed.count();
+}
+
+TEST(RWQueueBenchmark, DISABLED_BufferRing)
+{
+	const auto rw = bench_buffer_ring<RWQueue<container_t>>();
+	const auto spsc = bench_buffer_ring<SPSCQueue<container_t>>();
+	printf("buffer ring: RWQueue %.0f buffers/s, SPSCQueue %.0f buffers/s\n",
+	       rw, spsc);
+}
+
+TEST(RWQueueBenchmark, DISABLED_Trivial)
+{
+	const auto rw = bench_trivial<RWQueue<int>>();
+	const auto spsc = bench_trivial<SPSCQueue<int>>();
+	printf("trivial: RWQueue %.0f items/s, SPSCQueue %.0f items/s\n", rw, spsc);
+}
+
 } // namespace
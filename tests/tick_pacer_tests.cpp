@@ -0,0 +1,226 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "tick_pacer.h"
+
+#include <cmath>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+// A host clock that only moves when told to, or by a microsecond each time
+// it's read while spinning. Sleeps overshoot by a fixed amount.
+struct FakeHost {
+	int64_t now = 0;
+	int oversleep = 0;
+	bool tick_on_read = false;
+
+	TickPacer MakePacer(const int latency_us)
+	{
+		return TickPacer(
+		        latency_us, [this]() { return tick_on_read ? now++ : now; },
+		        [this](int us) { now += us + oversleep; });
+	}
+};
+
+TEST(TickPacer, TicksFollowClock)
+{
+	FakeHost host;
+	auto pacer = host.MakePacer(0);
+
+	host.now = 999;
+	EXPECT_EQ(pacer.TicksDue(1000), 0);
+	host.now = 1000;
+	EXPECT_EQ(pacer.TicksDue(1000), 1);
+	EXPECT_EQ(pacer.TicksDue(1000), 0);
+	host.now = 3500;
+	EXPECT_EQ(pacer.TicksDue(1000), 2);
+
+	// Uneven steps don't lose or gain ticks over a long run
+	int64_t ticks = 3;
+	for (int i = 0; i < 100000; ++i) {
+		host.now += 333;
+		ticks += pacer.TicksDue(1000);
+	}
+	EXPECT_EQ(ticks, host.now / 1000);
+	EXPECT_EQ(pacer.TakeStats().overruns, 0);
+}
+
+TEST(TickPacer, DropsTicksBeyondBacklog)
+{
+	FakeHost host;
+	auto pacer = host.MakePacer(0);
+
+	host.now = 50 * 1000;
+	EXPECT_EQ(pacer.TicksDue(1000), TickPacer::max_backlog);
+	EXPECT_EQ(pacer.TicksDue(1000), 0);
+	host.now += 1000;
+	EXPECT_EQ(pacer.TicksDue(1000), 1);
+	EXPECT_EQ(pacer.TakeStats().overruns, 50 - TickPacer::max_backlog);
+}
+
+TEST(TickPacer, WaitSpinsWithinLatency)
+{
+	FakeHost host;
+	host.oversleep = 300;
+	host.tick_on_read = true;
+	auto pacer = host.MakePacer(0);
+
+	// Once the oversleep is learnt, the spinning absorbs it
+	for (int i = 0; i < 200; ++i) {
+		pacer.WaitForTick();
+		EXPECT_EQ(pacer.TicksDue(1000), 1);
+	}
+	pacer.TakeStats();
+	for (int i = 0; i < 100; ++i) {
+		pacer.WaitForTick();
+		EXPECT_EQ(pacer.TicksDue(1000), 1);
+	}
+	const auto stats = pacer.TakeStats();
+	EXPECT_LT(stats.slack_us, 5);
+	EXPECT_GT(stats.idle_percent, 90);
+}
+
+TEST(TickPacer, WaitOnlySleepsAtHighLatency)
+{
+	FakeHost host;
+	host.oversleep = 300;
+	host.tick_on_read = true;
+	auto pacer = host.MakePacer(1000);
+
+	for (int i = 0; i < 100; ++i) {
+		pacer.WaitForTick();
+		pacer.TicksDue(1000);
+	}
+	const auto stats = pacer.TakeStats();
+	EXPECT_GT(stats.slack_us, 250);
+	EXPECT_LT(stats.slack_us, 350);
+}
+
+// Emulates a host that runs the given cycles per microsecond and returns
+// the number of windows it took for the cycles to settle within 5% of what
+// fills the requested share of each millisecond, less the headroom.
+int windows_to_settle(const double cycles_per_us, int32_t cycle_max,
+                      const int percent_used)
+{
+	FakeHost host;
+	auto pacer = host.MakePacer(1000);
+	const auto target = cycles_per_us * 10.0 * percent_used * TickPacer::target_load;
+
+	int windows = 0;
+	for (int i = 0; i < 100000 && windows < 100; ++i) {
+		const auto tuned = pacer.TuneCycles(cycle_max, percent_used);
+		if (tuned != cycle_max) {
+			++windows;
+			cycle_max = tuned;
+			if (std::fabs(cycle_max - target) < target * 0.05)
+				return windows;
+		}
+		const auto ticks = pacer.TicksDue(cycle_max);
+		if (ticks)
+			host.now += std::lround(ticks * cycle_max / cycles_per_us);
+		else
+			pacer.WaitForTick();
+	}
+	return windows;
+}
+
+TEST(TickPacer, TuneCyclesSettlesQuickly)
+{
+	// Rising from the real mode default to a fast host
+	EXPECT_LE(windows_to_settle(200.0, 3000, 100), 8);
+	// Falling from 'max' on a slow host
+	EXPECT_LE(windows_to_settle(5.0, 200000, 90), 8);
+	// Already close
+	EXPECT_LE(windows_to_settle(50.0, 45000, 100), 3);
+}
+
+TEST(TickPacer, TuneCyclesIgnoresIdleCycles)
+{
+	// The guest halts through 90% of every tick, which costs the host
+	// nothing; the cycles must stay at what the host can really run
+	constexpr double cycles_per_us = 50.0;
+	constexpr auto target = static_cast<int32_t>(50000 * TickPacer::target_load);
+	FakeHost host;
+	auto pacer = host.MakePacer(1000);
+	int32_t cycle_max = target;
+	for (int i = 0; i < 2000; ++i) {
+		cycle_max = pacer.TuneCycles(cycle_max, 100);
+		const auto ticks = pacer.TicksDue(cycle_max);
+		if (ticks) {
+			const auto removed = ticks * cycle_max * 9 / 10;
+			pacer.RemoveCycles(removed);
+			host.now += std::lround((ticks * cycle_max - removed) / cycles_per_us);
+		} else {
+			pacer.WaitForTick();
+		}
+	}
+	EXPECT_NEAR(cycle_max, target, target * 0.05);
+}
+
+TEST(TickPacer, TuneCyclesSkipsDropouts)
+{
+	// The host got stuck elsewhere for most of a second
+	FakeHost host;
+	auto pacer = host.MakePacer(1000);
+	constexpr int32_t cycle_max = 50000;
+	for (int i = 0; i < TickPacer::window_ticks; ++i) {
+		host.now += 1000;
+		EXPECT_EQ(pacer.TicksDue(cycle_max), 1);
+	}
+	host.now += 800 * 1000;
+	EXPECT_EQ(pacer.TuneCycles(cycle_max, 100), cycle_max);
+}
+
+TEST(TickPacer, TuneCyclesKeepsUpAtFullSpeed)
+{
+	// Running at 100% on a host whose ticks also carry some rendering and
+	// mixing, with every tenth one taking a good deal longer
+	constexpr double cycles_per_us = 50.0;
+	FakeHost host;
+	auto pacer = host.MakePacer(1000);
+	int32_t cycle_max = 3000;
+	int64_t tick = 0;
+	const auto run = [&](const int n) {
+		for (int i = 0; i < n; ++i) {
+			cycle_max = pacer.TuneCycles(cycle_max, 100);
+			const auto ticks = pacer.TicksDue(cycle_max);
+			if (!ticks) {
+				pacer.WaitForTick();
+				continue;
+			}
+			for (int t = 0; t < ticks; ++t) {
+				const auto overhead = (++tick % 10) ? 50 : 250;
+				host.now += std::lround(cycle_max / cycles_per_us) + overhead;
+			}
+		}
+	};
+
+	// Once settled, the ticks keep up and the host has time to spare
+	run(20000);
+	pacer.TakeStats();
+	run(20000);
+	const auto stats = pacer.TakeStats();
+	EXPECT_EQ(stats.overruns, 0);
+	EXPECT_GT(stats.idle_percent, 5);
+}
+
+} // namespace
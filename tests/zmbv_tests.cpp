@@ -0,0 +1,390 @@
+/*
+ *  SPDX-License-Identifier: GPL-2.0-or-later
+ *
+ *  Copyright (C) 2021-2021  The DOSBox Staging Team
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with this program; if not, write to the Free Software Foundation, Inc.,
+ *  51 Franklin Street, Fifth Floor, Boston, MA 02110-1301, USA.
+ */
+
+#include "../src/libs/zmbv/zmbv.cpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <random>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+namespace {
+
+constexpr int width = 320;
+constexpr int height = 200;
+constexpr int num_frames = 12;
+
+// A noisy background scrolling diagonally under a fixed status bar, with
+// some pixels changing at random, so the blocks need a mix of motion vectors
+std::vector<uint8_t> make_frame(const int n, const int pixel_size)
+{
+	std::mt19937 gen(1234);
+	std::vector<uint8_t> background((width + 64) * (height + 64));
+	for (auto &pixel : background)
+		pixel = static_cast<uint8_t>(gen() & 0x3f);
+
+	std::mt19937 noise(n);
+	std::vector<uint8_t> frame(width * height * pixel_size);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			uint8_t value = background[(y + n * 3) * (width + 64) + x + n * 2];
+			if (y >= height - 16)
+				value = static_cast<uint8_t>(x / 8);
+			if (noise() % 500 == 0)
+				value = static_cast<uint8_t>(noise());
+			for (int b = 0; b < pixel_size; ++b)
+				frame[(y * width + x) * pixel_size + b] =
+				        static_cast<uint8_t>(value * (b + 1));
+		}
+	}
+	return frame;
+}
+
+std::vector<std::vector<uint8_t>> compress(const zmbv_format_t format,
+                                           const int pixel_size,
+                                           const int search_threads,
+                                           char *palette)
+{
+	VideoCodec codec;
+	EXPECT_TRUE(codec.SetupCompress(width, height));
+	codec.SetSearchThreads(search_threads);
+	const int size = codec.NeededSize(width, height, format);
+
+	std::vector<std::vector<uint8_t>> chunks;
+	for (int n = 0; n < num_frames; ++n) {
+		std::vector<uint8_t> chunk(size);
+		const int flags = (n % 5 == 0) ? 1 : 0;
+		EXPECT_TRUE(codec.PrepareCompressFrame(flags, format, palette,
+		                                       chunk.data(), size));
+		auto frame = make_frame(n, pixel_size);
+		for (int y = 0; y < height; ++y) {
+			void *row = &frame[y * width * pixel_size];
+			codec.CompressLines(1, &row);
+		}
+		const int written = codec.FinishCompressFrame();
+		EXPECT_GT(written, 0);
+		chunk.resize(written);
+		chunks.push_back(std::move(chunk));
+	}
+	return chunks;
+}
+
+TEST(ZMBV, ParallelSearchMatchesSerial)
+{
+	char palette[256 * 4] = {};
+	for (const auto threads : {1, 3, 7}) {
+		EXPECT_EQ(compress(ZMBV_FORMAT_8BPP, 1, threads, palette),
+		          compress(ZMBV_FORMAT_8BPP, 1, 0, palette));
+		EXPECT_EQ(compress(ZMBV_FORMAT_16BPP, 2, threads, nullptr),
+		          compress(ZMBV_FORMAT_16BPP, 2, 0, nullptr));
+		EXPECT_EQ(compress(ZMBV_FORMAT_32BPP, 4, threads, nullptr),
+		          compress(ZMBV_FORMAT_32BPP, 4, 0, nullptr));
+	}
+}
+
+void expect_decodes_to_frames(const std::vector<std::vector<uint8_t>> &chunks,
+                              const int pixel_size, const char *palette)
+{
+	VideoCodec decoder;
+	ASSERT_TRUE(decoder.SetupDecompress(width, height));
+	std::vector<uint8_t> decoded(width * height * 3);
+	for (int n = 0; n < num_frames; ++n) {
+		auto chunk = chunks[n];
+		ASSERT_TRUE(decoder.DecompressFrame(chunk.data(), static_cast<int>(chunk.size())));
+		decoder.Output_UpsideDown_24(decoded.data());
+
+		const auto frame = make_frame(n, pixel_size);
+		std::vector<uint8_t> expected;
+		for (int y = height - 1; y >= 0; --y) {
+			for (int x = 0; x < width; ++x) {
+				const auto pixel = &frame[(y * width + x) * pixel_size];
+				if (palette) {
+					const int c = pixel[0];
+					expected.push_back(static_cast<uint8_t>(palette[c * 4 + 2]));
+					expected.push_back(static_cast<uint8_t>(palette[c * 4 + 1]));
+					expected.push_back(static_cast<uint8_t>(palette[c * 4 + 0]));
+				} else {
+					expected.insert(expected.end(), pixel, pixel + 3);
+				}
+			}
+		}
+		ASSERT_EQ(decoded, expected) << "frame " << n;
+	}
+}
+
+TEST(ZMBV, DecodesWhatWasEncoded)
+{
+	char palette[256 * 4] = {};
+	for (int i = 0; i < 256; ++i) {
+		palette[i * 4 + 0] = static_cast<char>(i);
+		palette[i * 4 + 1] = static_cast<char>(255 - i);
+		palette[i * 4 + 2] = static_cast<char>(i / 2);
+	}
+	expect_decodes_to_frames(compress(ZMBV_FORMAT_8BPP, 1, 3, palette), 1, palette);
+	expect_decodes_to_frames(compress(ZMBV_FORMAT_32BPP, 4, 3, nullptr), 4, nullptr);
+}
+
+// A 64x64 area of pixels drawn from only a few values, so displaced blocks
+// match in places. 32bpp pixels also get a random top byte, which the
+// kernels must ignore when comparing.
+template <class P>
+std::vector<P> make_block_area(std::mt19937 &gen)
+{
+	std::vector<P> area(64 * 64);
+	for (auto &pixel : area) {
+		pixel = static_cast<P>(gen() % 3 * 0x010101);
+		if (sizeof(P) == 4)
+			pixel = static_cast<P>(pixel | (gen() << 24));
+	}
+	return area;
+}
+
+template <class P>
+void expect_kernels_match_scalar()
+{
+	std::mt19937 gen(sizeof(P));
+	const auto old_area = make_block_area<P>(gen);
+	const auto new_area = make_block_area<P>(gen);
+	constexpr int pitch = 64;
+
+	for (const int dx : {16, 7}) {
+		for (int dy = 1; dy <= 16; ++dy) {
+			for (int i = 0; i < 20; ++i) {
+				const auto pold = &old_area[gen() % 32 * pitch + gen() % 32];
+				const auto pnew = &new_area[16 * pitch + 16];
+				for (const int step : {1, 4})
+					EXPECT_EQ(count_changes(pold, pnew, pitch, dx, dy, step),
+					          count_changes_scalar(pold, pnew, pitch, dx, dy, step))
+					        << "dx " << dx << " dy " << dy << " step " << step;
+
+				std::vector<unsigned char> out(16 * 16 * sizeof(P));
+				std::vector<unsigned char> expected(out.size());
+				EXPECT_EQ(xor_block(pold, pnew, pitch, dx, dy, out.data()),
+				          xor_block_scalar(pold, pnew, pitch, dx, dy,
+				                           expected.data()));
+				EXPECT_EQ(out, expected) << "dx " << dx << " dy " << dy;
+			}
+		}
+	}
+}
+
+TEST(ZMBV, BlockKernelsMatchScalar)
+{
+	expect_kernels_match_scalar<uint8_t>();
+	expect_kernels_match_scalar<uint16_t>();
+	expect_kernels_match_scalar<uint32_t>();
+}
+
+TEST(ZMBV, BlockKernelsReference)
+{
+	// Only the top byte of the third pixel and the colour of the last differ
+	uint32_t pold[16] = {};
+	uint32_t pnew[16] = {};
+	pnew[2] = 0xff000000;
+	pnew[15] = 0x00000100;
+	EXPECT_EQ(count_changes(pold, pnew, 16, 16, 1, 1), 1);
+	EXPECT_EQ(count_changes_scalar(pold, pnew, 16, 16, 1, 1), 1);
+	// Sampling only looks at pixels 0, 4, 8 and 12
+	EXPECT_EQ(count_changes(pold, pnew, 16, 16, 1, 4), 0);
+	pnew[12] = 1;
+	EXPECT_EQ(count_changes(pold, pnew, 16, 16, 1, 4), 1);
+}
+
+// Benchmarks of the block comparison against its scalar version, and of
+// encoding a frame sequence at each pixel format with and without search
+// threads. The sequence is synthetic unless ZMBV_BENCH_AVI names a capture
+// made with the ZMBV codec, whose frames are then decoded and re-encoded at
+// 32bpp. Each takes seconds and checks nothing, so they're disabled; to print
+// the rates, run the binary with --gtest_also_run_disabled_tests
+// --gtest_filter='ZMBV.DISABLED_benchmark*'.
+
+constexpr auto bench_compares = 2000000;
+constexpr auto bench_frames = 240;
+
+template <class P, typename Count>
+double bench_count(const Count &count)
+{
+	std::mt19937 gen(1);
+	const auto old_area = make_block_area<P>(gen);
+	const auto new_area = make_block_area<P>(gen);
+	int sum = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i != bench_compares; ++i) {
+		const auto pold = &old_area[(i & 31) * 64 + (i >> 5 & 31)];
+		sum += count(pold, &new_area[16 * 64 + 16], 64, 16, 16, 1);
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() -
+	                                              start;
+	EXPECT_NE(sum, 0);
+	return bench_compares / elapsed.count();
+}
+
+template <class P>
+void bench_block_compare(const char *name)
+{
+	const auto scalar = bench_count<P>(count_changes_scalar<P>);
+	const auto dispatched = bench_count<P>(count_changes<P>);
+	printf("%s block compares/s: %.3g scalar, %.3g dispatched (%.1fx)\n",
+	       name, scalar, dispatched, dispatched / scalar);
+}
+
+TEST(ZMBV, DISABLED_benchmark_block_compare)
+{
+	bench_block_compare<uint8_t>("8bpp");
+	bench_block_compare<uint16_t>("16bpp");
+	bench_block_compare<uint32_t>("32bpp");
+}
+
+struct FrameSequence {
+	int width = 0;
+	int height = 0;
+	std::vector<std::vector<uint8_t>> frames = {};
+};
+
+uint32_t read_le32(const std::vector<uint8_t> &data, const size_t pos)
+{
+	return data[pos] | data[pos + 1] << 8 | data[pos + 2] << 16 |
+	       static_cast<uint32_t>(data[pos + 3]) << 24;
+}
+
+size_t find_tag(const std::vector<uint8_t> &data, const char *tag, const size_t from = 0)
+{
+	const auto it = std::search(data.begin() + from, data.end(), tag, tag + 4);
+	return static_cast<size_t>(it - data.begin());
+}
+
+// Decodes the video chunks of an AVI capture to 32bpp frames
+FrameSequence load_capture(const char *path)
+{
+	FrameSequence seq;
+	std::ifstream file(path, std::ios::binary);
+	const std::vector<uint8_t> data((std::istreambuf_iterator<char>(file)),
+	                                std::istreambuf_iterator<char>());
+	const auto avih = find_tag(data, "avih");
+	auto pos = find_tag(data, "movi");
+	if (avih + 48 > data.size() || pos >= data.size())
+		return seq;
+	seq.width = static_cast<int>(read_le32(data, avih + 8 + 32));
+	seq.height = static_cast<int>(read_le32(data, avih + 8 + 36));
+
+	VideoCodec decoder;
+	if (!decoder.SetupDecompress(seq.width, seq.height))
+		return seq;
+	const int row_size = seq.width * 3 + (seq.width & 3);
+	std::vector<uint8_t> decoded(row_size * seq.height);
+	for (pos += 4; pos + 8 <= data.size() && seq.frames.size() < bench_frames;) {
+		const auto size = read_le32(data, pos + 4);
+		if (pos + 8 + size > data.size())
+			break;
+		if (std::equal(data.begin() + pos, data.begin() + pos + 4, "00dc") && size) {
+			std::vector<uint8_t> chunk(data.begin() + pos + 8,
+			                           data.begin() + pos + 8 + size);
+			if (!decoder.DecompressFrame(chunk.data(), static_cast<int>(size)))
+				break;
+			decoder.Output_UpsideDown_24(decoded.data());
+			std::vector<uint8_t> frame;
+			for (int y = seq.height - 1; y >= 0; --y)
+				for (int x = 0; x < seq.width; ++x) {
+					const auto pixel = &decoded[y * row_size + x * 3];
+					frame.insert(frame.end(), pixel, pixel + 3);
+					frame.push_back(0);
+				}
+			seq.frames.push_back(std::move(frame));
+		}
+		pos += 8 + size + (size & 1);
+	}
+	return seq;
+}
+
+FrameSequence make_sequence(const int pixel_size)
+{
+	FrameSequence seq;
+	seq.width = width;
+	seq.height = height;
+	for (int n = 0; n < bench_frames; ++n)
+		seq.frames.push_back(make_frame(n % num_frames, pixel_size));
+	return seq;
+}
+
+// Encodes the sequence with a keyframe every 300 frames, like the capture
+// does, and returns the frames encoded per second
+double bench_encode(const FrameSequence &seq, const zmbv_format_t format,
+                    const int pixel_size, const int search_threads)
+{
+	char palette[256 * 4] = {};
+	VideoCodec codec;
+	EXPECT_TRUE(codec.SetupCompress(seq.width, seq.height));
+	codec.SetSearchThreads(search_threads);
+	const int size = codec.NeededSize(seq.width, seq.height, format);
+	std::vector<uint8_t> chunk(size);
+	int64_t total = 0;
+
+	const auto start = std::chrono::steady_clock::now();
+	for (size_t n = 0; n < seq.frames.size(); ++n) {
+		codec.PrepareCompressFrame(n % 300 == 0, format,
+		                           pixel_size == 1 ? palette : nullptr,
+		                           chunk.data(), size);
+		for (int y = 0; y < seq.height; ++y) {
+			auto row = const_cast<uint8_t *>(
+			        &seq.frames[n][y * seq.width * pixel_size]);
+			void *line = row;
+			codec.CompressLines(1, &line);
+		}
+		total += codec.FinishCompressFrame();
+	}
+	const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() -
+	                                              start;
+	EXPECT_GT(total, 0);
+	return static_cast<double>(seq.frames.size()) / elapsed.count();
+}
+
+void bench_sequence(const char *name, const FrameSequence &seq,
+                    const zmbv_format_t format, const int pixel_size)
+{
+	if (seq.frames.empty()) {
+		printf("%s: no frames to encode\n", name);
+		return;
+	}
+	const auto serial = bench_encode(seq, format, pixel_size, 0);
+	const auto parallel = bench_encode(seq, format, pixel_size, 3);
+	printf("%s, %dx%d, %zu frames: %.1f fps, %.1f fps with 3 search threads\n",
+	       name, seq.width, seq.height, seq.frames.size(), serial, parallel);
+}
+
+TEST(ZMBV, DISABLED_benchmark_encode)
+{
+	const char *path = getenv("ZMBV_BENCH_AVI");
+	if (path) {
+		bench_sequence(path, load_capture(path), ZMBV_FORMAT_32BPP, 4);
+		return;
+	}
+	bench_sequence("8bpp", make_sequence(1), ZMBV_FORMAT_8BPP, 1);
+	bench_sequence("16bpp", make_sequence(2), ZMBV_FORMAT_16BPP, 2);
+	bench_sequence("32bpp", make_sequence(4), ZMBV_FORMAT_32BPP, 4);
+}
+
+} // namespace